@@ -0,0 +1,244 @@
+#include "benchmark.h"
+
+#include "memory/pmemory.h"
+#include "memory/linearAllocator.h"
+#include "memory/stackAllocator.h"
+#include "memory/poolAllocator.h"
+#include "core/logger.h"
+#include "platform/platform.h"
+
+#include <vector>
+
+/**
+ * Allocates a spread of small and large sizes through memAllocate and
+ * through the platform allocator, and logs allocs/s and pool fragmentation.
+ */
+void memoryBenchmark()
+{
+    // Mostly small blocks and one in 64 between 8 and 72 KiB.
+    std::vector<u64> sizes;
+    u32 seed = 1;
+    for(u32 i = 0; i < 20000; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        sizes.push_back((seed >> 8) % 64 == 0 ? 8192 + (seed >> 16) % 65536 : 8 + (seed >> 12) % 1024);
+    }
+
+    const u32 rounds = 4;
+    u64 count = sizes.size();
+    std::vector<void*> blocks(count);
+
+    // Everything is allocated, half is freed and allocated again, like
+    // a level being streamed while the previous one is released.
+    f32 internal = 0.0f, external = 0.0f;
+    f64 start = platformGetCurrentTime();
+    for(u32 r = 0; r < rounds; ++r)
+    {
+        for(u64 i = 0; i < count; ++i)
+            blocks[i] = memAllocate(sizes[i], MEMORY_TAG_SYSTEM);
+        for(u64 i = 1; i < count; i += 2)
+            memFree(blocks[i], sizes[i], MEMORY_TAG_SYSTEM);
+        for(u64 i = 1; i < count; i += 2)
+            blocks[i] = memAllocate(sizes[i], MEMORY_TAG_SYSTEM);
+
+        if(r == 0)
+        {
+            MemoryTotalStats stats = memoryGetTotalStats();
+            internal = stats.poolUsed ? 1.0f - (f32)stats.poolRequested / (f32)stats.poolUsed : 0.0f;
+            external = stats.poolReserved ? 1.0f - (f32)stats.poolUsed / (f32)stats.poolReserved : 0.0f;
+        }
+        for(u64 i = 0; i < count; ++i)
+            memFree(blocks[i], sizes[i], MEMORY_TAG_SYSTEM);
+    }
+    f64 memTime = platformGetCurrentTime() - start;
+
+    start = platformGetCurrentTime();
+    for(u32 r = 0; r < rounds; ++r)
+    {
+        for(u64 i = 0; i < count; ++i)
+            blocks[i] = platformZeroMemory(platformAllocateMemory(sizes[i]), sizes[i]);
+        for(u64 i = 1; i < count; i += 2)
+            platformFreeMemory(blocks[i]);
+        for(u64 i = 1; i < count; i += 2)
+            blocks[i] = platformZeroMemory(platformAllocateMemory(sizes[i]), sizes[i]);
+        for(u64 i = 0; i < count; ++i)
+            platformFreeMemory(blocks[i]);
+    }
+    f64 platformTime = platformGetCurrentTime() - start;
+
+    f64 operations = (f64)rounds * (count + count / 2) * 2;
+    PINFO("Memory: %llu allocations, memAllocate %.2f M allocs+frees/s, platform %.2f M allocs+frees/s.",
+        count, operations / memTime / 1e6, operations / platformTime / 1e6);
+    PINFO("Memory: pool fragmentation internal %d%%, external %d%% at the peak.",
+        (i32)(internal * 100.0f), (i32)(external * 100.0f));
+}
+
+/**
+ * Times building a list of elementCount draws every frame with a
+ * std::vector and with an arena like the frame one, and logs it.
+ */
+void frameAllocatorBenchmark(u32 elementCount)
+{
+    const u32 frames = 64;
+
+    // Same size as a draw list entry: a model matrix and two pointers.
+    struct BenchDraw
+    {
+        f32 model[16];
+        void* mesh;
+        void* material;
+    };
+
+    // A private arena so the one of the current frame is left untouched.
+    u64 arenaSize = sizeof(BenchDraw) * elementCount + alignof(BenchDraw);
+    LinearAllocator arena;
+    linearAllocatorCreate(arenaSize, nullptr, &arena);
+
+    // The lists were built with a fresh std::vector every frame.
+    u32 heapAllocations = 0;
+    u64 sum = 0;
+    f64 start = platformGetCurrentTime();
+    for(u32 f = 0; f < frames; ++f)
+    {
+        std::vector<BenchDraw> draws;
+        u64 capacity = 0;
+        for(u32 i = 0; i < elementCount; ++i)
+        {
+            BenchDraw draw = {};
+            draw.model[0] = (f32)i;
+            draws.push_back(draw);
+            if(draws.capacity() != capacity) {
+                capacity = draws.capacity();
+                heapAllocations++;
+            }
+        }
+        sum += (u64)draws[elementCount - 1].model[0];
+    }
+    f64 vectorTime = platformGetCurrentTime() - start;
+
+    start = platformGetCurrentTime();
+    for(u32 f = 0; f < frames; ++f)
+    {
+        linearAllocatorFreeAll(&arena);
+        BenchDraw* draws = (BenchDraw*)linearAllocatorAllocateAligned(&arena, sizeof(BenchDraw) * elementCount, alignof(BenchDraw));
+        for(u32 i = 0; i < elementCount; ++i)
+        {
+            BenchDraw draw = {};
+            draw.model[0] = (f32)i;
+            draws[i] = draw;
+        }
+        sum += (u64)draws[elementCount - 1].model[0];
+    }
+    f64 arenaTime = platformGetCurrentTime() - start;
+
+    PINFO("Frame arena: %u element list, std::vector %.3f ms per frame with %u heap allocations, arena %.3f ms per frame with none. (%llu)",
+        elementCount, vectorTime * 1000.0 / frames, heapAllocations / frames, arenaTime * 1000.0 / frames, sum);
+
+    linearAllocatorDestroy(&arena);
+}
+
+/**
+ * Times pushing and popping blockCount blocks of random sizes
+ * against new/delete and logs it.
+ */
+void stackAllocatorBenchmark(u32 blockCount)
+{
+    const u32 rounds = 16;
+
+    // Scratch blocks of 16 to 1024 bytes, like temporary arrays of a system update.
+    u32* sizes = (u32*)memAllocate(sizeof(u32) * blockCount, MEMORY_TAG_STACK_ALLOCATOR);
+    void** blocks = (void**)memAllocate(sizeof(void*) * blockCount, MEMORY_TAG_STACK_ALLOCATOR);
+    u64 totalSize = 0;
+    u32 seed = 1;
+    for(u32 i = 0; i < blockCount; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        sizes[i] = 16 + (seed >> 8) % 1009;
+        totalSize += sizes[i] + 32; // Block header and alignment.
+    }
+
+    StackAllocator stack;
+    stackAllocatorCreate(totalSize, nullptr, &stack);
+
+    f64 start = platformGetCurrentTime();
+    for(u32 r = 0; r < rounds; ++r)
+    {
+        for(u32 i = 0; i < blockCount; ++i)
+            blocks[i] = stackAllocatorPush(&stack, sizes[i], 16);
+        for(u32 i = blockCount; i > 0; --i)
+            stackAllocatorPop(&stack, blocks[i - 1]);
+    }
+    f64 stackTime = platformGetCurrentTime() - start;
+
+    start = platformGetCurrentTime();
+    for(u32 r = 0; r < rounds; ++r)
+    {
+        for(u32 i = 0; i < blockCount; ++i)
+            blocks[i] = new u8[sizes[i]];
+        for(u32 i = blockCount; i > 0; --i)
+            delete[] (u8*)blocks[i - 1];
+    }
+    f64 newTime = platformGetCurrentTime() - start;
+
+    f64 operations = (f64)rounds * blockCount;
+    PINFO("Stack allocator: %u blocks of 16 to 1024 bytes, %.2f ns per push+pop, new/delete %.2f ns.",
+        blockCount, stackTime * 1e9 / operations, newTime * 1e9 / operations);
+
+    stackAllocatorDestroy(&stack);
+    memFree(blocks, sizeof(void*) * blockCount, MEMORY_TAG_STACK_ALLOCATOR);
+    memFree(sizes, sizeof(u32) * blockCount, MEMORY_TAG_STACK_ALLOCATOR);
+}
+
+/**
+ * Times allocating and freeing blockCount blocks against new/delete
+ * and logs it.
+ */
+void poolAllocatorBenchmark(u32 blockCount)
+{
+    const u32 rounds = 16;
+
+    // A slot sized like a mesh or material entry.
+    struct BenchBlock
+    {
+        u64 data[8];
+    };
+
+    PoolAllocator pool;
+    poolAllocatorCreate(sizeof(BenchBlock), blockCount, nullptr, &pool);
+    BenchBlock** blocks = (BenchBlock**)memAllocate(sizeof(BenchBlock*) * blockCount, MEMORY_TAG_POOL_ALLOCATOR);
+
+    // Allocate all, free every other one, allocate them again and free all.
+    f64 start = platformGetCurrentTime();
+    for(u32 r = 0; r < rounds; ++r)
+    {
+        for(u32 i = 0; i < blockCount; ++i)
+            blocks[i] = (BenchBlock*)poolAllocatorAllocate(&pool);
+        for(u32 i = 0; i < blockCount; i += 2)
+            poolAllocatorFree(&pool, blocks[i]);
+        for(u32 i = 0; i < blockCount; i += 2)
+            blocks[i] = (BenchBlock*)poolAllocatorAllocate(&pool);
+        for(u32 i = 0; i < blockCount; ++i)
+            poolAllocatorFree(&pool, blocks[i]);
+    }
+    f64 poolTime = platformGetCurrentTime() - start;
+
+    start = platformGetCurrentTime();
+    for(u32 r = 0; r < rounds; ++r)
+    {
+        for(u32 i = 0; i < blockCount; ++i)
+            blocks[i] = new BenchBlock();
+        for(u32 i = 0; i < blockCount; i += 2)
+            delete blocks[i];
+        for(u32 i = 0; i < blockCount; i += 2)
+            blocks[i] = new BenchBlock();
+        for(u32 i = 0; i < blockCount; ++i)
+            delete blocks[i];
+    }
+    f64 newTime = platformGetCurrentTime() - start;
+
+    f64 operations = (f64)rounds * blockCount * 3;
+    PINFO("Pool allocator: %u blocks of %u bytes, %.2f ns per alloc+free, new/delete %.2f ns.",
+        blockCount, (u32)sizeof(BenchBlock), poolTime * 1e9 / operations, newTime * 1e9 / operations);
+
+    memFree(blocks, sizeof(BenchBlock*) * blockCount, MEMORY_TAG_POOL_ALLOCATOR);
+    poolAllocatorDestroy(&pool);
+}
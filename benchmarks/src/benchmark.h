@@ -0,0 +1,25 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * Benchmarks of the engine systems. Every benchmark is registered in
+ * main.cpp and logs its results, the executable runs all of them or the
+ * ones named in the command line. The systems they need are initialized
+ * once by main.
+ */
+
+// Benchmarks
+void hashtableBenchmark(u32 entryCount);
+void memoryBenchmark();
+void frameAllocatorBenchmark(u32 elementCount);
+void stackAllocatorBenchmark(u32 blockCount);
+void poolAllocatorBenchmark(u32 blockCount);
+void jobSystemBenchmark();
+void archetypeBenchmark(u32 entityCount);
+void transformBenchmark(u32 nodeCount);
+void updateStagesBenchmark(u32 transformCount);
+void radixSortBenchmark(u32 count);
+void renderKeysBenchmark(u32 drawCount, u32 togglePercent);
+void frustumCullingBenchmark(u32 count);
+void lightClustersBenchmark(u32 lightCount);
@@ -0,0 +1,271 @@
+#include "benchmark.h"
+
+#include "systems/entity/archetype.h"
+#include "systems/components/comp_transform.h"
+#include "systems/components/comp_light_point.h"
+#include "systems/transformSystem.h"
+#include "systems/jobSystem.h"
+#include "core/logger.h"
+#include "platform/platform.h"
+
+#include <vector>
+
+/**
+ * Times a transform and light query over entityCount entities in a
+ * private storage against the same walk hopping through managers,
+ * and logs it.
+ */
+void archetypeBenchmark(u32 entityCount)
+{
+    const u32 iterations = 16;
+    u32 seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    // A private storage so the one of the scene is left untouched. A
+    // quarter of extra entities without light, the query must skip them.
+    CArchetypeStorage* storage = new CArchetypeStorage();
+    storage->registerComponent<TCompTransform>();
+    storage->registerComponent<TCompLightPoint>();
+    TComponentSignature transformOnly, transformAndLight;
+    transformOnly.set(CArchetypeStorage::typeOf<TCompTransform>());
+    transformAndLight = transformOnly;
+    transformAndLight.set(CArchetypeStorage::typeOf<TCompLightPoint>());
+    for(u32 i = 0; i < entityCount + entityCount / 4; ++i)
+    {
+        TArchetypeEntity e = storage->createEntity(i % 5 == 4 ? transformOnly : transformAndLight);
+        // Through the base class, these transforms have no node in the transform system.
+        storage->get<TCompTransform>(e)->CTransform::setPosition(glm::vec3((f32)i, 0.0f, 0.0f));
+    }
+
+    // Manager hopping: the light manager is walked, each light goes to its
+    // owner entity, the entity gives the transform handle and the transform
+    // manager maps it to its object. After objects are destroyed and
+    // compacted, none of those arrays are in the same order.
+    struct TBenchEntity
+    {
+        u32 transform; // External index of the transform.
+    };
+    std::vector<TCompTransform> transforms(entityCount);
+    std::vector<TCompLightPoint> lights(entityCount);
+    std::vector<TBenchEntity> entities(entityCount);
+    std::vector<u32> transformExternalToInternal(entityCount);
+    std::vector<u32> lightOwners(entityCount);
+    for(u32 i = 0; i < entityCount; ++i)
+    {
+        transforms[i].CTransform::setPosition(glm::vec3((f32)i, 0.0f, 0.0f));
+        transformExternalToInternal[i] = i;
+        lightOwners[i] = i;
+        entities[i].transform = i;
+    }
+    for(u32 i = entityCount; i > 1; --i)
+    {
+        std::swap(transformExternalToInternal[i - 1], transformExternalToInternal[random() % i]);
+        std::swap(lightOwners[i - 1], lightOwners[random() % i]);
+    }
+
+    f32 sum = 0.0f;
+    f64 start = platformGetCurrentTime();
+    for(u32 it = 0; it < iterations; ++it)
+    {
+        for(u32 i = 0; i < entityCount; ++i)
+        {
+            TCompLightPoint& light = lights[i];
+            const TBenchEntity& owner = entities[lightOwners[i]];
+            TCompTransform& transform = transforms[transformExternalToInternal[owner.transform]];
+            light.position = transform.getPosition();
+            sum += light.position.x * light.intensity;
+        }
+    }
+    f64 managerTime = platformGetCurrentTime() - start;
+
+    u32 visited = 0;
+    start = platformGetCurrentTime();
+    for(u32 it = 0; it < iterations; ++it)
+    {
+        storage->forEach<TCompTransform, TCompLightPoint>([&sum, &visited](TCompTransform& transform, TCompLightPoint& light) {
+            light.position = transform.getPosition();
+            sum += light.position.x * light.intensity;
+            visited++;
+        });
+    }
+    f64 archetypeTime = platformGetCurrentTime() - start;
+
+    f64 queries = (f64)entityCount * iterations;
+    PINFO("Archetype query: %u of %u entities, manager hopping %.2f M/s, archetype chunks %.2f M/s (%.2fx). (%.0f)",
+        visited / iterations, storage->size(), queries / managerTime / 1e6, queries / archetypeTime / 1e6,
+        managerTime / archetypeTime, sum);
+
+    delete storage;
+}
+
+/**
+ * Times updates of a private hierarchy of nodeCount nodes with 1%, 10%
+ * and all of them dirty, and logs it. Local matrices stay identity, so
+ * only the hierarchy walk and the matrix products are timed.
+ */
+void transformBenchmark(u32 nodeCount)
+{
+    const u32 frames = 32;
+    const u32 percents[] = { 1, 10, 100 };
+
+    // Roots with three children of two children each, like small props.
+    CTransformSystem* system = new CTransformSystem();
+    std::vector<u32> ids(nodeCount);
+    for(u32 i = 0; i < nodeCount; ++i)
+    {
+        ids[i] = system->createNode(CHandle());
+        u32 slot = i % 10;
+        if(slot >= 1 && slot <= 3)
+            system->setParent(ids[i], ids[i - slot]);
+        else if(slot >= 4)
+            system->setParent(ids[i], ids[i - slot + 1 + (slot - 4) / 2]);
+    }
+    system->update();
+
+    u32 seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    for(u32 percent : percents)
+    {
+        u32 nDirty = (u32)((u64)nodeCount * percent / 100);
+        u32 nUpdated = 0;
+        f64 elapsed = 0.0;
+        for(u32 f = 0; f < frames; ++f)
+        {
+            for(u32 i = 0; i < nDirty; ++i)
+                system->markDirty(ids[percent == 100 ? i : random() % nodeCount]);
+            f64 start = platformGetCurrentTime();
+            system->update();
+            elapsed += platformGetCurrentTime() - start;
+            nUpdated += system->getUpdatedLastFrame();
+        }
+        PINFO("Transforms: %u nodes, %u%% dirty, %.3f ms per update (%u nodes updated).",
+            nodeCount, percent, elapsed * 1000.0 / frames, nUpdated / frames);
+    }
+
+    delete system;
+}
+
+/**
+ * Manager of plain objects used by the update stages benchmark. The update
+ * moves a position and rebuilds a world matrix, work times per object so
+ * some types are heavier than others. It is not a predefined manager, it
+ * only gets a type when the benchmark inits it.
+ */
+class CBenchManager : public CHandleManager
+{
+    struct TBenchObj
+    {
+        glm::vec3 position;
+        glm::vec3 velocity;
+        f32 angle;
+        glm::mat4 world;
+    };
+    std::vector<TBenchObj> objs;
+    u32 work;
+
+    void allocatePage(u32 page, u32 count) override { objs.resize(pageBase(page) + count); }
+    void createObj(u32 internalIndex) override {
+        TBenchObj& obj = objs[internalIndex];
+        obj.position = glm::vec3((f32)internalIndex, 0.0f, 0.0f);
+        obj.velocity = glm::vec3(0.0f, 1.0f, (f32)(internalIndex % 7));
+        obj.angle = 0.0f;
+        obj.world = glm::mat4(1.0f);
+    }
+    void destroyObj(u32) override {}
+    void moveObj(u32 src, u32 dst) override { objs[dst] = objs[src]; }
+    void loadObj(u32, const json&, TEntityParseContext&) override {}
+    void debugInMenuObj(u32) override {}
+    void renderDebugObj(u32) override {}
+    void onEntityCreatedObj(u32) override {}
+
+    void updateRange(f32 dt, u32 begin, u32 end) override {
+        for(u32 i = begin; i < end; ++i)
+        {
+            TBenchObj& obj = objs[i];
+            for(u32 w = 0; w < work; ++w)
+            {
+                obj.position += obj.velocity * dt;
+                obj.angle += dt;
+                obj.world = glm::rotate(glm::translate(glm::mat4(1.0f), obj.position), obj.angle, glm::vec3(0.0f, 1.0f, 0.0f));
+            }
+        }
+    }
+
+public:
+    CBenchManager(const char* newName, u32 newWork) : work(newWork) { name = newName; }
+
+    void updateAll(f32 dt) override { updateRange(dt, 0, nObjectsUsed); }
+    void renderDebugAll() override {}
+    void debugInMenuAll() override {}
+
+    void populate(u32 count) {
+        init(count);
+        for(u32 i = 0; i < count; ++i)
+            createHandle();
+    }
+    void release() {
+        std::vector<TBenchObj>().swap(objs);
+        nObjectsUsed = 0;
+    }
+};
+
+static CBenchManager benchVelocity("bench_velocity", 1);
+static CBenchManager benchTransform("bench_transform", 2);
+static CBenchManager benchLight("bench_light", 4);
+static CBenchManager benchAi("bench_ai", 8);
+
+/**
+ * Runs the update stages of synthetic managers at every thread count and
+ * logs the speedup. Transforms read the velocities and lights the
+ * transforms, ai is independent and shares stages with them.
+ */
+void updateStagesBenchmark(u32 transformCount)
+{
+    const u32 frames = 32;
+    const f32 dt = 1.0f / 60.0f;
+
+    benchVelocity.populate(transformCount);
+    benchTransform.populate(transformCount);
+    benchLight.populate(transformCount / 8);
+    benchAi.populate(transformCount / 4);
+    benchVelocity.setAccess({}, {});
+    benchTransform.setAccess({ benchVelocity.getType() }, {});
+    benchLight.setAccess({ benchTransform.getType() }, {});
+    benchAi.setAccess({}, {});
+    for(CBenchManager* om : { &benchVelocity, &benchTransform, &benchLight, &benchAi })
+        om->setParallelGrain(256);
+
+    std::vector<std::vector<CHandleManager*>> updateStages;
+    CHandleManager::buildUpdateStages({ &benchVelocity, &benchTransform, &benchLight, &benchAi }, updateStages);
+
+    f64 baseTime = 0.0;
+    for(u32 threads = 1; threads <= jobSystemThreadCount(); ++threads)
+    {
+        jobSystemSetActiveThreads(threads);
+        f64 start = platformGetCurrentTime();
+        for(u32 f = 0; f < frames; ++f)
+        {
+            for(auto& stage : updateStages)
+            {
+                CHandleManager::updateStage(stage, dt);
+                CHandleManager::destroyAllPendingObjects();
+            }
+        }
+        f64 frameTime = (platformGetCurrentTime() - start) / frames;
+        if(threads == 1)
+            baseTime = frameTime;
+        PINFO("Entities update: %u transforms, 4 types in %u stages, %2u threads %.3f ms (%.2fx).",
+            transformCount, (u32)updateStages.size(), threads, frameTime * 1000.0, baseTime / frameTime);
+    }
+    jobSystemSetActiveThreads(0);
+
+    for(CBenchManager* om : { &benchVelocity, &benchTransform, &benchLight, &benchAi })
+        om->release();
+}
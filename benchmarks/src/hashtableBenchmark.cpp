@@ -0,0 +1,116 @@
+#include "benchmark.h"
+
+#include "containers/hashtable.h"
+#include "memory/pmemory.h"
+#include "core/logger.h"
+#include "platform/platform.h"
+
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+
+// The table before the open addressing one: a multiply by 97 string hash
+// indexing the slots directly, colliding keys overwrite each other.
+static u64
+oldHash(const char* name, u32 elementCount)
+{
+    u64 hash = 0;
+    for(const char* c = name; *c; ++c) {
+        hash = hash * 97 + *c;
+    }
+    return hash % elementCount;
+}
+
+/**
+ * Times lookups against the previous table and std::unordered_map,
+ * measures probe lengths and insert/erase churn, and logs it.
+ */
+void hashtableBenchmark(u32 entryCount)
+{
+    const u32 iterations = 8;
+    const u32 slotCount = entryCount * 2;
+    const u32 nameLength = 32;
+
+    char* names = (char*)memAllocate(nameLength * entryCount * 2, MEMORY_TAG_SYSTEM);
+    for(u32 i = 0; i < entryCount * 2; ++i) {
+        snprintf(names + i * nameLength, nameLength, "textures/entry_%u.png", i);
+    }
+    // The second half of the names is never inserted, used for misses.
+    const char* missNames = names + entryCount * nameLength;
+
+    u64 memorySize = hashtableMemoryRequirement(sizeof(u64), slotCount);
+    void* memory = memAllocate(memorySize, MEMORY_TAG_SYSTEM);
+    Hashtable table;
+    hashtableCreate(sizeof(u64), slotCount, memory, &table);
+
+    u64* oldTable = (u64*)memAllocate(sizeof(u64) * slotCount, MEMORY_TAG_SYSTEM);
+    std::unordered_map<std::string, u64> map;
+    map.reserve(entryCount);
+
+    for(u64 i = 0; i < entryCount; ++i)
+    {
+        const char* name = names + i * nameLength;
+        hashtableSetValue(&table, name, &i);
+        oldTable[oldHash(name, slotCount)] = i;
+        map[name] = i;
+    }
+
+    u64 hitProbes = 0, missProbes = 0;
+    u32 maxProbes = 0, oldCollisions = 0;
+    for(u32 i = 0; i < entryCount; ++i)
+    {
+        u32 hit = hashtableProbeLength(&table, names + i * nameLength);
+        u32 miss = hashtableProbeLength(&table, missNames + i * nameLength);
+        hitProbes += hit;
+        missProbes += miss;
+        maxProbes = hit > maxProbes ? hit : maxProbes;
+        if(oldTable[oldHash(names + i * nameLength, slotCount)] != i)
+            oldCollisions++;
+    }
+
+    // The sum is only there so the lookups are not optimized away.
+    u64 sum = 0, value;
+    f64 start = platformGetCurrentTime();
+    for(u32 it = 0; it < iterations; ++it)
+        for(u32 i = 0; i < entryCount; ++i)
+            if(hashtableGetValue(&table, names + i * nameLength, &value))
+                sum += value;
+    f64 tableTime = platformGetCurrentTime() - start;
+
+    start = platformGetCurrentTime();
+    for(u32 it = 0; it < iterations; ++it)
+        for(u32 i = 0; i < entryCount; ++i)
+            sum += oldTable[oldHash(names + i * nameLength, slotCount)];
+    f64 oldTime = platformGetCurrentTime() - start;
+
+    start = platformGetCurrentTime();
+    for(u32 it = 0; it < iterations; ++it)
+        for(u32 i = 0; i < entryCount; ++i) {
+            auto found = map.find(names + i * nameLength);
+            if(found != map.end())
+                sum += found->second;
+        }
+    f64 mapTime = platformGetCurrentTime() - start;
+
+    // Erase and insert churn, tombstones must not pile up.
+    start = platformGetCurrentTime();
+    for(u64 i = 0; i < entryCount; ++i)
+    {
+        hashtableErase(&table, names + i * nameLength);
+        hashtableSetValue(&table, missNames + i * nameLength, &i);
+    }
+    f64 churnTime = platformGetCurrentTime() - start;
+
+    f64 lookups = (f64)entryCount * iterations;
+    PINFO("Hashtable: %u entries in %u slots, probes hit avg %.2f max %u, miss avg %.2f.",
+        entryCount, slotCount, (f64)hitProbes / entryCount, maxProbes, (f64)missProbes / entryCount);
+    PINFO("Hashtable: %.2f M lookups/s, old table %.2f M lookups/s (%u keys lost to collisions), std::unordered_map %.2f M lookups/s.",
+        lookups / tableTime / 1e6, lookups / oldTime / 1e6, oldCollisions, lookups / mapTime / 1e6);
+    PINFO("Hashtable: churn of %u erase+insert %.3f ms, %u tombstones left. (%llu)",
+        entryCount, churnTime * 1000.0, table.tombstoneCount, sum);
+
+    hashtableDestroy(&table);
+    memFree(oldTable, sizeof(u64) * slotCount, MEMORY_TAG_SYSTEM);
+    memFree(memory, memorySize, MEMORY_TAG_SYSTEM);
+    memFree(names, nameLength * entryCount * 2, MEMORY_TAG_SYSTEM);
+}
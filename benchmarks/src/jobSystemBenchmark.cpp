@@ -0,0 +1,76 @@
+#include "benchmark.h"
+
+#include "systems/jobSystem.h"
+#include "memory/pmemory.h"
+#include "core/logger.h"
+#include "platform/platform.h"
+
+#include <math.h>
+
+// Fine grained: a cheap function over many elements in small ranges.
+static void benchmarkFine(f32* values, u32 count)
+{
+    parallelFor(0, count, 256, [values](u32 begin, u32 end) {
+        for(u32 i = begin; i < end; ++i)
+            values[i] = sqrtf(values[i] * 0.5f + (f32)i);
+    });
+}
+
+// Coarse grained: a few long jobs.
+static void benchmarkCoarse(u64* results, u32 jobCount)
+{
+    parallelFor(0, jobCount, 1, [results](u32 begin, u32 end) {
+        for(u32 j = begin; j < end; ++j)
+        {
+            u64 seed = j + 1;
+            for(u32 i = 0; i < 200000; ++i)
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            results[j] = seed;
+        }
+    });
+}
+
+/**
+ * Runs fine and coarse grained parallelFor loads from one thread up to
+ * all of them and logs the times and the speedup.
+ */
+void jobSystemBenchmark()
+{
+    if(jobSystemThreadIndex() != 0) {
+        PWARN("jobSystemBenchmark - must run on the main thread.");
+        return;
+    }
+
+    const u32 iterations = 8;
+    const u32 fineCount = 1 << 20;
+    const u32 coarseCount = 64;
+    f32* values = (f32*)memAllocate(sizeof(f32) * fineCount, MEMORY_TAG_JOB);
+    u64* results = (u64*)memAllocate(sizeof(u64) * coarseCount, MEMORY_TAG_JOB);
+
+    f64 fineBase = 0.0, coarseBase = 0.0;
+    for(u32 threads = 1; threads <= jobSystemThreadCount(); ++threads)
+    {
+        jobSystemSetActiveThreads(threads);
+
+        f64 start = platformGetCurrentTime();
+        for(u32 i = 0; i < iterations; ++i)
+            benchmarkFine(values, fineCount);
+        f64 fine = (platformGetCurrentTime() - start) / iterations;
+
+        start = platformGetCurrentTime();
+        for(u32 i = 0; i < iterations; ++i)
+            benchmarkCoarse(results, coarseCount);
+        f64 coarse = (platformGetCurrentTime() - start) / iterations;
+
+        if(threads == 1) {
+            fineBase = fine;
+            coarseBase = coarse;
+        }
+        PINFO("Job system: %2u threads, fine %u x 256 %.3f ms (%.2fx), coarse %u jobs %.3f ms (%.2fx).",
+            threads, fineCount / 256, fine * 1000.0, fineBase / fine, coarseCount, coarse * 1000.0, coarseBase / coarse);
+    }
+    jobSystemSetActiveThreads(0);
+
+    memFree(values, sizeof(f32) * fineCount, MEMORY_TAG_JOB);
+    memFree(results, sizeof(u64) * coarseCount, MEMORY_TAG_JOB);
+}
@@ -0,0 +1,93 @@
+#include "benchmark.h"
+
+#include "memory/pmemory.h"
+#include "memory/linearAllocator.h"
+#include "memory/frameAllocator.h"
+#include "systems/jobSystem.h"
+#include "systems/handle/handleManager.h"
+
+#include <stdio.h>
+#include <string.h>
+
+struct Benchmark
+{
+    const char* name;
+    void (*function)();
+};
+
+static const Benchmark benchmarks[] = {
+    { "hashtable",      []() { hashtableBenchmark(512); hashtableBenchmark(4096); hashtableBenchmark(65536); } },
+    { "memory",         []() { memoryBenchmark(); } },
+    { "frame_arena",    []() { frameAllocatorBenchmark(1000); frameAllocatorBenchmark(50000); } },
+    { "stack_pool",     []() { stackAllocatorBenchmark(10000); poolAllocatorBenchmark(10000); } },
+    { "job_system",     []() { jobSystemBenchmark(); } },
+    { "archetypes",     []() { archetypeBenchmark(100000); } },
+    { "transforms",     []() { transformBenchmark(50000); } },
+    { "update_stages",  []() { updateStagesBenchmark(10000); updateStagesBenchmark(16000); } },
+    { "radix_sort",     []() { radixSortBenchmark(100000); } },
+    { "render_keys",    []() { renderKeysBenchmark(50000, 1); } },
+    { "frustum",        []() { frustumCullingBenchmark(100000); } },
+    { "light_clusters", []() { lightClustersBenchmark(1000); lightClustersBenchmark(10000); } },
+};
+
+static bool isSelected(const char* name, int argc, char** argv)
+{
+    if(argc < 2)
+        return true;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], name) == 0)
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    // Same systems as the application, nothing of the renderer.
+    LinearAllocator systemsAllocator;
+    linearAllocatorCreate(64 * 1024 * 1024, 0, &systemsAllocator);
+
+    MemorySystemConfig memoryConfig;
+    memoryConfig.allocatorType = MEMORY_ALLOCATOR_POOLED;
+    memoryConfig.captureCapacity = 0;
+    u64 memoryRequirement = 0;
+    memorySystemInit(&memoryRequirement, nullptr, memoryConfig);
+    void* memoryState = linearAllocatorAllocate(&systemsAllocator, memoryRequirement);
+    memorySystemInit(&memoryRequirement, memoryState, memoryConfig);
+
+    FrameAllocatorConfig frameConfig;
+    frameConfig.frameSize = 8 * 1024 * 1024;
+    u64 frameRequirement = 0;
+    frameAllocatorInit(&frameRequirement, nullptr, frameConfig);
+    void* frameState = linearAllocatorAllocate(&systemsAllocator, frameRequirement);
+    frameAllocatorInit(&frameRequirement, frameState, frameConfig);
+
+    JobSystemConfig jobConfig;
+    jobConfig.workerCount = 0;
+    jobConfig.maxJobsPerThread = 4096;
+    u64 jobRequirement = 0;
+    jobSystemInit(&jobRequirement, nullptr, jobConfig);
+    void* jobState = linearAllocatorAllocateAligned(&systemsAllocator, jobRequirement, 64);
+    jobSystemInit(&jobRequirement, jobState, jobConfig);
+
+    // Managers grow, the first page only has to be small.
+    for(u32 i = 0; i < CHandleManager::nPredefinedManagers; ++i)
+        CHandleManager::predefinedManagers[i]->init(1024);
+
+    u32 ran = 0;
+    for(const Benchmark& benchmark : benchmarks)
+    {
+        if(!isSelected(benchmark.name, argc, argv))
+            continue;
+        printf("[%s]\n", benchmark.name);
+        benchmark.function();
+        frameAllocatorBeginFrame();
+        ++ran;
+    }
+    printf("%u benchmarks run.\n", ran);
+
+    // The memory system stays up, the static managers free their pages on exit.
+    jobSystemShutdown(jobState);
+    frameAllocatorShutdown(frameState);
+    return 0;
+}
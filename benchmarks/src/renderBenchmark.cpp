@@ -0,0 +1,294 @@
+#include "benchmark.h"
+
+#include "containers/radixSort.h"
+#include "renderer/renderTypes.h"
+#include "renderer/frustumCulling.h"
+#include "renderer/lightClusters.h"
+#include "systems/renderSystem.h"
+#include "systems/entity/entity.h"
+#include "systems/components/comp_transform.h"
+#include "systems/jobSystem.h"
+#include "memory/frameAllocator.h"
+#include "memory/pmemory.h"
+#include "core/logger.h"
+#include "platform/platform.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/**
+ * Times sorting count packed render-like keys against std::stable_sort
+ * and logs it.
+ */
+void radixSortBenchmark(u32 count)
+{
+    const u32 iterations = 16;
+
+    // Keys shaped like the render ones: a few pipelines, materials and
+    // meshes and a depth, the top byte mostly empty.
+    u64* source = (u64*)memAllocate(sizeof(u64) * count, MEMORY_TAG_RENDERER);
+    u64* keys = (u64*)memAllocate(sizeof(u64) * count, MEMORY_TAG_RENDERER);
+    u64* tmpKeys = (u64*)memAllocate(sizeof(u64) * count, MEMORY_TAG_RENDERER);
+    u32* values = (u32*)memAllocate(sizeof(u32) * count, MEMORY_TAG_RENDERER);
+    u32* tmpValues = (u32*)memAllocate(sizeof(u32) * count, MEMORY_TAG_RENDERER);
+    std::pair<u64, u32>* pairs = (std::pair<u64, u32>*)memAllocate(sizeof(std::pair<u64, u32>) * count, MEMORY_TAG_RENDERER);
+
+    u32 seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+    for(u32 i = 0; i < count; ++i)
+    {
+        u64 pipeline = random() % 4;
+        u64 material = random() % 500;
+        u64 mesh = random() % 2000;
+        u64 depth = random() & 0xFFFFFF;
+        source[i] = (pipeline << 56) | (material << 40) | (mesh << 24) | depth;
+    }
+
+    f64 radixTime = 0.0;
+    for(u32 it = 0; it < iterations; ++it)
+    {
+        memCopy(source, keys, sizeof(u64) * count);
+        for(u32 i = 0; i < count; ++i)
+            values[i] = i;
+        f64 start = platformGetCurrentTime();
+        radixSort64(keys, values, tmpKeys, tmpValues, count);
+        radixTime += platformGetCurrentTime() - start;
+    }
+    bool sorted = std::is_sorted(keys, keys + count);
+
+    f64 stdTime = 0.0;
+    for(u32 it = 0; it < iterations; ++it)
+    {
+        for(u32 i = 0; i < count; ++i)
+            pairs[i] = std::make_pair(source[i], i);
+        f64 start = platformGetCurrentTime();
+        std::stable_sort(pairs, pairs + count, [](const std::pair<u64, u32>& a, const std::pair<u64, u32>& b) {
+            return a.first < b.first;
+        });
+        stdTime += platformGetCurrentTime() - start;
+    }
+
+    PINFO("Radix sort: %u keys%s, %.3f ms per sort (%.1f M keys/s), std::stable_sort %.3f ms.",
+        count, sorted ? "" : " NOT SORTED", radixTime * 1000.0 / iterations,
+        (f64)count * iterations / radixTime / 1e6, stdTime * 1000.0 / iterations);
+
+    memFree(pairs, sizeof(std::pair<u64, u32>) * count, MEMORY_TAG_RENDERER);
+    memFree(tmpValues, sizeof(u32) * count, MEMORY_TAG_RENDERER);
+    memFree(values, sizeof(u32) * count, MEMORY_TAG_RENDERER);
+    memFree(tmpKeys, sizeof(u64) * count, MEMORY_TAG_RENDERER);
+    memFree(keys, sizeof(u64) * count, MEMORY_TAG_RENDERER);
+    memFree(source, sizeof(u64) * count, MEMORY_TAG_RENDERER);
+}
+
+/**
+ * Toggles a share of drawCount keys of a private manager every frame and
+ * logs the cost against a full resort. Creates and destroys its own entities.
+ */
+void renderKeysBenchmark(u32 drawCount, u32 togglePercent)
+{
+    const u32 frames = 64;
+    const u32 drawsPerEntity = 100;
+    u32 seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    // A private manager with fake meshes and materials, nothing is drawn.
+    // Keys need an owner with a transform, a few entities own many draws.
+    const u32 meshCount = 256, materialCount = 64;
+    std::vector<Mesh> meshes(meshCount);
+    std::vector<Material> materials(materialCount);
+    for(u32 i = 0; i < meshCount; ++i)
+        meshes[i].rendererId = i;
+    for(u32 i = 0; i < materialCount; ++i) {
+        materials[i].rendererId = i;
+        materials[i].diffuseColor = glm::vec4(1.0f);
+    }
+
+    // Frame memory used by the simulated frames is given back on each of them.
+    u64 frameMarker = frameAllocatorGetMarker();
+    CRenderManager* manager = new CRenderManager();
+    std::vector<CHandle> entities;
+    std::vector<u32> ids(drawCount);
+    for(u32 i = 0; i < drawCount; ++i)
+    {
+        if(i % drawsPerEntity == 0) {
+            CHandle hEntity = getObjectManager<CEntity>()->createHandle();
+            CHandle hTransform = getObjectManager<TCompTransform>()->createHandle();
+            CEntity* e = hEntity;
+            e->set(hTransform);
+            entities.push_back(hEntity);
+        }
+        CEntity* e = entities.back();
+        ids[i] = manager->addKey(e->get<TCompTransform>(), &meshes[random() % meshCount], &materials[random() % materialCount]);
+    }
+    manager->render();
+
+    // Every frame a share of the draws flips between enabled and disabled.
+    u32 toggles = drawCount * togglePercent / 100;
+    f64 incrementalTime = 0.0, fullTime = 0.0;
+    u64* sortKeys = frameAlloc<u64>(drawCount);
+    u32* sortValues = frameAlloc<u32>(drawCount);
+    u64* tmpKeys = frameAlloc<u64>(drawCount);
+    u32* tmpValues = frameAlloc<u32>(drawCount);
+    u64 loopMarker = frameAllocatorGetMarker();
+    for(u32 f = 0; f < frames; ++f)
+    {
+        frameAllocatorFreeToMarker(loopMarker);
+        f64 start = platformGetCurrentTime();
+        for(u32 t = 0; t < toggles; ++t) {
+            u32 id = ids[random() % drawCount];
+            manager->setKeyEnabled(id, !manager->isKeyEnabled(id));
+        }
+        manager->render();
+        incrementalTime += platformGetCurrentTime() - start;
+
+        // What a full resort of the enabled keys costs, as before the slot map.
+        if(!sortKeys || !tmpValues)
+            continue;
+        start = platformGetCurrentTime();
+        u32 n = 0;
+        for(u32 id : ids) {
+            if(manager->isKeyEnabled(id)) {
+                sortKeys[n] = manager->keys[id].sortKey;
+                sortValues[n++] = id;
+            }
+        }
+        radixSort64(sortKeys, sortValues, tmpKeys, tmpValues, n);
+        fullTime += platformGetCurrentTime() - start;
+    }
+
+    u32 sorted = 0;
+    for(const CRenderManager::TSortedKey& sk : manager->getSortedKeys())
+        sorted += manager->isValid(sk) ? 1 : 0;
+    PINFO("Render keys: %u draws, %u%% toggled per frame, incremental %.3f ms per frame, full resort %.3f ms. %u sorted.",
+        drawCount, togglePercent, incrementalTime * 1000.0 / frames, fullTime * 1000.0 / frames, sorted);
+
+    for(CHandle h : entities)
+        h.destroy();
+    CHandleManager::destroyAllPendingObjects();
+    delete manager;
+    frameAllocatorFreeToMarker(frameMarker);
+}
+
+/**
+ * Times culling count random boxes around a camera, one object at a time,
+ * with SIMD and with SIMD over the job system, and logs the ns per object
+ * and the visible counts.
+ */
+void frustumCullingBenchmark(u32 count)
+{
+    const u32 iterations = 16;
+    const u32 meshCount = 16;
+
+    Frustum frustum;
+    frustumFromMatrix(
+        glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f)
+            * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+        &frustum);
+
+    // Unit boxes of a few sizes spread all around the camera, about a
+    // sixth of them in the view.
+    Mesh* meshes = (Mesh*)memAllocate(sizeof(Mesh) * meshCount, MEMORY_TAG_RENDERER);
+    RenderMeshData* draws = (RenderMeshData*)memAllocate(sizeof(RenderMeshData) * count, MEMORY_TAG_RENDERER);
+    u32* visible = (u32*)memAllocate(sizeof(u32) * count, MEMORY_TAG_RENDERER);
+    u32 seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (f32)(seed >> 8) / (f32)(1u << 24);
+    };
+    for(u32 i = 0; i < meshCount; ++i)
+    {
+        f32 size = 0.5f + random() * 4.0f;
+        meshes[i].boundsMin = glm::vec3(-size);
+        meshes[i].boundsMax = glm::vec3(size);
+        meshes[i].boundingSphere = glm::vec4(0.0f, 0.0f, 0.0f, size * 1.7320508f);
+    }
+    for(u32 i = 0; i < count; ++i)
+    {
+        glm::vec3 position((random() - 0.5f) * 1000.0f, (random() - 0.5f) * 200.0f, (random() - 0.5f) * 1000.0f);
+        draws[i].model = glm::rotate(glm::translate(glm::mat4(1.0f), position),
+            random() * 6.2831853f, glm::normalize(glm::vec3(random(), random(), random()) + 0.1f));
+        draws[i].mesh = &meshes[i % meshCount];
+        draws[i].material = nullptr;
+    }
+
+    u32 scalarVisible = 0;
+    f64 start = platformGetCurrentTime();
+    for(u32 it = 0; it < iterations; ++it)
+        scalarVisible = frustumCullDrawsSerial(&frustum, draws, count, visible, false);
+    f64 scalarTime = platformGetCurrentTime() - start;
+
+    u32 simdVisible = 0;
+    start = platformGetCurrentTime();
+    for(u32 it = 0; it < iterations; ++it)
+        simdVisible = frustumCullDrawsSerial(&frustum, draws, count, visible, true);
+    f64 simdTime = platformGetCurrentTime() - start;
+
+    u32 parallelVisible = 0;
+    start = platformGetCurrentTime();
+    for(u32 it = 0; it < iterations; ++it)
+        parallelVisible = frustumCullDraws(&frustum, draws, count, visible);
+    f64 parallelTime = platformGetCurrentTime() - start;
+
+    f64 toNs = 1e9 / ((f64)iterations * count);
+    PINFO("Frustum culling: %u objects, scalar %.1f ns/object (%u visible), SIMD %.1f ns/object (%u visible), "
+        "SIMD on %u threads %.1f ns/object (%u visible).",
+        count, scalarTime * toNs, scalarVisible, simdTime * toNs, simdVisible,
+        jobSystemThreadCount(), parallelTime * toNs, parallelVisible);
+
+    memFree(visible, sizeof(u32) * count, MEMORY_TAG_RENDERER);
+    memFree(draws, sizeof(RenderMeshData) * count, MEMORY_TAG_RENDERER);
+    memFree(meshes, sizeof(Mesh) * meshCount, MEMORY_TAG_RENDERER);
+}
+
+/**
+ * Times the build of random lights in front of a camera and logs it.
+ */
+void lightClustersBenchmark(u32 lightCount)
+{
+    const u32 iterations = 16;
+    const f32 zmin = 0.1f;
+    const f32 zmax = 1000.0f;
+
+    LightClusterView view;
+    lightClusterViewInit(
+        glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+        glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, zmin, zmax),
+        zmin, zmax, &view);
+
+    // Lights spread in a box in front of the camera, some out of the view.
+    glm::vec4* spheres = (glm::vec4*)memAllocate(sizeof(glm::vec4) * lightCount, MEMORY_TAG_RENDERER);
+    u32* cells = (u32*)memAllocate(sizeof(u32) * LIGHT_CLUSTER_COUNT * 2, MEMORY_TAG_RENDERER);
+    u32* indices = (u32*)memAllocate(sizeof(u32) * LIGHT_CLUSTER_MAX_INDICES, MEMORY_TAG_RENDERER);
+    u32 seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (f32)(seed >> 8) / (f32)(1u << 24);
+    };
+    for(u32 i = 0; i < lightCount; ++i)
+    {
+        spheres[i] = glm::vec4(
+            (random() - 0.5f) * 400.0f,
+            (random() - 0.5f) * 100.0f,
+            -random() * 500.0f,
+            1.0f + random() * 9.0f);
+    }
+
+    u32 indexCount = 0;
+    f64 start = platformGetCurrentTime();
+    for(u32 i = 0; i < iterations; ++i)
+        indexCount = lightClustersBuild(view, spheres, lightCount, cells, indices, LIGHT_CLUSTER_MAX_INDICES);
+    f64 elapsed = platformGetCurrentTime() - start;
+
+    PINFO("Light clusters: %u lights, %u indices, %.3f ms per build.", lightCount, indexCount, elapsed * 1000.0 / iterations);
+
+    memFree(spheres, sizeof(glm::vec4) * lightCount, MEMORY_TAG_RENDERER);
+    memFree(cells, sizeof(u32) * LIGHT_CLUSTER_COUNT * 2, MEMORY_TAG_RENDERER);
+    memFree(indices, sizeof(u32) * LIGHT_CLUSTER_MAX_INDICES, MEMORY_TAG_RENDERER);
+}
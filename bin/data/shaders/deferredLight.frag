@@ -2,29 +2,15 @@
 
 #extension GL_GOOGLE_include_directive : enable
 #include "pbr_funcs.glsl"
+#include "lights.glsl"
+#include "gbuffer.glsl"
 
 layout(location = 0) in vec2 inUV;
 
-const int MAX_LIGHTS = 16;
-struct Light
-{
-    vec3 position;
-    float intensity;
-    vec3 color;
-    float radius;
-    vec3 forward;
-    float cosineCutoff;
-    float spotExponent;
-    bool enabled;
-    int type;
-    float dummyValue;
-};
-
 layout(set = 0, binding = 0) uniform sampler2D gbuf[3];
-layout(set = 0, binding = 1) uniform LightBuffer
-{
-    Light[MAX_LIGHTS] l;
-} lights;
+#ifdef COMPACT_GBUFFER
+layout(set = 0, binding = 4) uniform sampler2D gbufDepth;
+#endif
 
 layout(set = 0, binding = 2) uniform cameraInfo {
     mat4 view;
@@ -34,14 +20,48 @@ layout(set = 0, binding = 2) uniform cameraInfo {
     vec3 position;
 }camera;
 
+// Light lists of the view froxels, built on the CPU each frame. data holds
+// the offset and count of every cluster followed by the light indices.
+layout(std430, set = 0, binding = 3) readonly buffer ClusterBuffer
+{
+    uvec4 dims;         // x, y and z clusters, light index count.
+    vec4 projection;    // projection[0][0], projection[1][1], slice scale and bias.
+    uint data[];
+} clusters;
+
+// Same mapping as lightClustersBuild.
+uint clusterIndex(vec3 position)
+{
+    vec3 viewPos = (camera.view * vec4(position, 1.0)).xyz;
+    float depth = max(-viewPos.z, 1e-4);
+    vec2 ndc = clusters.projection.xy * viewPos.xy / depth;
+    uvec2 tile = uvec2(clamp((ndc * 0.5 + 0.5) * vec2(clusters.dims.xy), vec2(0.0), vec2(clusters.dims.xy - 1u)));
+    float slice = log(depth) * clusters.projection.z + clusters.projection.w;
+    uint z = uint(clamp(slice, 0.0, float(clusters.dims.z - 1u)));
+    return (z * clusters.dims.y + tile.y) * clusters.dims.x + tile.x;
+}
+
 layout(location = 0) out vec4 fragColor;
 
 void main()
 {
     // Basic information from previous passes
+#ifdef COMPACT_GBUFFER
+    ivec2 pixel     = ivec2(gl_FragCoord.xy);
+    float depth     = texelFetch(gbufDepth, pixel, 0).r;
+    vec3 position   = reconstructPosition(pixel, vec2(textureSize(gbufDepth, 0)), depth, camera.inverse_viewprojection);
+    vec3 N          = decodeNormal(texelFetch(gbuf[0], pixel, 0).xy);
+    vec3 albedo     = texelFetch(gbuf[1], pixel, 0).xyz;
+    vec2 metallicRoughness = texelFetch(gbuf[2], pixel, 0).xy;
+    float metallic  = metallicRoughness.x;
+    float roughness = metallicRoughness.y;
+#else
     vec3 albedo     = texture(gbuf[2], inUV).xyz;
     vec3 position   = texture(gbuf[0], inUV).xyz;
     vec3 N          = normalize(texture(gbuf[1], inUV).xyz * 2.0 - vec3(1));
+    float metallic  = texture(gbuf[0], inUV).w;
+    float roughness = texture(gbuf[1], inUV).w;
+#endif
 
     vec3 cameraPosition = camera.position;
     float ambient_factor = 0.1;
@@ -49,14 +69,17 @@ void main()
     vec3 V = normalize(cameraPosition - position);
     float NdotV = max(dot(N, V), 0.0);
 
-    float metallic  = texture(gbuf[0], inUV).w;
-    float roughness = texture(gbuf[1], inUV).w;
     vec3 F0         = mix(vec3(0.04), pow(albedo, vec3(2.2)), metallic);
 
-    // Light calculations
+    // Only the lights touching the cluster of the pixel
+    uint cluster    = clusterIndex(position);
+    uint first      = clusters.dims.x * clusters.dims.y * clusters.dims.z * 2u + clusters.data[cluster * 2u];
+    uint lightCount = clusters.data[cluster * 2u + 1u];
+
     vec4 light = vec4(0.0);
-    for(int i = 0; i < MAX_LIGHTS; i++)
+    for(uint c = 0; c < lightCount; c++)
     {
+        uint i = clusters.data[first + c];
         if(!lights.l[i].enabled || lights.l[i].intensity < 0.1)
             continue;
 
@@ -75,7 +98,7 @@ void main()
         att_factor = max(att_factor, 0.0);
         att_factor = att_factor * att_factor;
 
-        vec3 radiance = lights.l[i].color * lightIntensity * att_factor;
+        vec3 radiance = lights.l[i].color * lightIntensity * att_factor * spotFactor(lights.l[i], L);
 
         float NdotL = dot(N, L);
 
@@ -0,0 +1,36 @@
+// G-buffer packing shared by the geometry and deferred light shaders.
+// Compiled with COMPACT_GBUFFER the normal is octahedral encoded in two
+// channels and the light pass rebuilds the position from the depth.
+
+vec2 octWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit normal to [0, 1] on both channels.
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+    return e * 0.5 + 0.5;
+}
+
+vec3 decodeNormal(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// World position of a pixel from its depth. The geometry pass viewport
+// is flipped, so the first row is the top of NDC.
+vec3 reconstructPosition(ivec2 pixel, vec2 size, float depth, mat4 inverseViewProjection)
+{
+    vec2 uv = (vec2(pixel) + 0.5) / size;
+    vec4 ndc = vec4(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, depth, 1.0);
+    vec4 world = inverseViewProjection * ndc;
+    return world.xyz / world.w;
+}
@@ -1,40 +1,48 @@
 #version 460
 
 #extension GL_GOOGLE_include_directive : enable
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 #include "utils.glsl"
+#include "material.glsl"
+#include "gbuffer.glsl"
 
 layout (location = 0) in vec3 inWorldPos;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec3 inColor;
 layout (location = 3) in vec2 inUV;
 
+#ifdef COMPACT_GBUFFER
+layout(location = 0) out vec2 outNormal;
+layout(location = 1) out vec4 outAlbedo;
+layout(location = 2) out vec2 outMetallicRoughness;
+#else
 layout(location = 0) out vec4 outPosition;
 layout(location = 1) out vec4 outNormal;
 layout(location = 2) out vec4 outAlbedo;
-
-layout(set = 1, binding = 0) uniform Material
-{
-    vec4 diffuse;
-} mat;
-
-layout(set = 1, binding = 1) uniform sampler2D diffuseSampler;
-layout(set = 1, binding = 2) uniform sampler2D normalSampler;
-layout(set = 1, binding = 3) uniform sampler2D metallicRoughnessSampler;
+#endif
 
 void main()
 {
     vec3 wNorm  = inNormal;
     vec3 wPos   = inWorldPos;
-    vec3 N      = normalize(texture(normalSampler, inUV).xyz);
+    vec3 N      = normalize(sampleNormal(inUV).xyz);
 
     N = perturbNormal(wNorm, wPos, inUV, N);
 
-    float metallic  = texture(metallicRoughnessSampler, inUV).z;
-    float roughness = texture(metallicRoughnessSampler, inUV).y;
+    float metallic  = sampleMetallicRoughness(inUV).z;
+    float roughness = sampleMetallicRoughness(inUV).y;
 
+    vec3 color  = inColor * materialDiffuse().xyz;
+    vec3 albedo = color * sampleDiffuse(inUV).xyz;
+#ifdef COMPACT_GBUFFER
+    outNormal               = encodeNormal(normalize(N));
+    outAlbedo               = vec4(albedo, 1.0);
+    outMetallicRoughness    = vec2(metallic, roughness);
+#else
     outPosition = vec4(wPos, metallic);
     outNormal   = (vec4( N * 0.5 + vec3(0.5), roughness));
-    vec3 color  = inColor * mat.diffuse.xyz;
-    vec3 albedo = color * texture(diffuseSampler, inUV).xyz;
     outAlbedo   = vec4(albedo, 1.0);
+#endif
 }
\ No newline at end of file
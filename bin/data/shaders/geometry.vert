@@ -1,10 +1,34 @@
 #version 460
 
+// Compiled with INDIRECT the draws come from the culling shader, the
+// model and the material are read from the object of the instance.
+
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 color;
 layout(location = 2) in vec2 uv;
 layout(location = 3) in vec3 normal;
 
+#ifdef INDIRECT
+struct ObjectData
+{
+    mat4 model;
+    vec4 sphere;
+    uint mesh;
+    uint material;
+    uint padding0;
+    uint padding1;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Objects
+{
+    ObjectData o[];
+} objects;
+
+layout(location = 4) flat out uint outMaterial;
+#else
+layout(location = 4) in mat4 model;     // Per instance.
+#endif
+
 layout(location = 0) out vec3 outPosition;
 layout(location = 1) out vec3 outNormal;
 layout(location = 2) out vec3 outColor;
@@ -18,18 +42,16 @@ layout(set = 0, binding = 0) uniform UBO {
     vec3 position;
 } ubo;
 
-layout (push_constant) uniform pushConstant
-{
-    mat4 model;
-} constant;
-
 void main()
 {
-    mat4 model      = constant.model;
+#ifdef INDIRECT
+    mat4 model      = objects.o[gl_InstanceIndex].model;
+    outMaterial     = objects.o[gl_InstanceIndex].material;
+#endif
     vec3 worldPos   = (model * vec4(position, 1.0)).xyz;
     outPosition     = worldPos;
     outColor        = color.xyz;
     outNormal       = mat3(transpose(inverse(model))) * normal;
     outUV           = uv;
     gl_Position     = ubo.proj * ubo.view * vec4(worldPos, 1.0);
-}
\ No newline at end of file
+}
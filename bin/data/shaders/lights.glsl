@@ -0,0 +1,36 @@
+// Lights of the forward and deferred lighting shaders.
+// Matches VulkanLightData, the enabled lights are packed at the start of the array.
+
+#define LIGHT_TYPE_POINT 0
+#define LIGHT_TYPE_SPOT  1
+
+struct Light
+{
+    vec3 position;
+    float intensity;
+    vec3 color;
+    float radius;
+    vec3 forward;
+    float cosineCutoff;
+    float spotExponent;
+    bool enabled;
+    int type;
+    float dummyValue;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffer
+{
+    uint count;
+    Light l[];
+} lights;
+
+// Cone falloff of spot lights, 1 for point lights. L goes from the surface to the light.
+float spotFactor(Light light, vec3 L)
+{
+    if(light.type != LIGHT_TYPE_SPOT)
+        return 1.0;
+    float cosAngle = dot(-L, light.forward);
+    if(cosAngle < light.cosineCutoff)
+        return 0.0;
+    return pow(cosAngle, light.spotExponent);
+}
@@ -0,0 +1,98 @@
+// Material of the forward and geometry fragment shaders.
+// Compiled with BINDLESS the material is read from the material buffer at
+// the index pushed by the draw and its textures from the texture array.
+// The including shader enables GL_EXT_nonuniform_qualifier in that case.
+// With INDIRECT too the index comes from the object, through the vertex shader.
+// Otherwise each material has its own set with a uniform and three samplers.
+
+#ifdef BINDLESS
+
+#define INVALID_TEXTURE 0xFFFFFFFFu
+
+struct MaterialData
+{
+    vec4 diffuse;
+    uint diffuseTexture;
+    uint normalTexture;
+    uint metallicRoughnessTexture;
+    uint padding;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer MaterialBuffer
+{
+    MaterialData m[];
+} materials;
+
+layout(set = 1, binding = 1) uniform sampler2D textures[];
+
+#ifdef INDIRECT
+layout(location = 4) flat in uint inMaterial;
+#define MATERIAL_INDEX inMaterial
+#else
+layout(push_constant) uniform DrawConstants
+{
+    uint material;
+} draw;
+#define MATERIAL_INDEX draw.material
+#endif
+
+// Materials without a texture get the fallback value.
+vec4 sampleMaterialTexture(uint index, vec2 uv, vec4 fallback)
+{
+    if(index == INVALID_TEXTURE)
+        return fallback;
+    return texture(textures[nonuniformEXT(index)], uv);
+}
+
+vec4 materialDiffuse()
+{
+    return materials.m[MATERIAL_INDEX].diffuse;
+}
+
+vec4 sampleDiffuse(vec2 uv)
+{
+    return sampleMaterialTexture(materials.m[MATERIAL_INDEX].diffuseTexture, uv, vec4(1.0));
+}
+
+vec4 sampleNormal(vec2 uv)
+{
+    return sampleMaterialTexture(materials.m[MATERIAL_INDEX].normalTexture, uv, vec4(0.5, 0.5, 1.0, 1.0));
+}
+
+vec4 sampleMetallicRoughness(vec2 uv)
+{
+    return sampleMaterialTexture(materials.m[MATERIAL_INDEX].metallicRoughnessTexture, uv, vec4(0.0, 1.0, 0.0, 1.0));
+}
+
+#else
+
+layout(set = 1, binding = 0) uniform Material
+{
+    vec4 diffuse;
+} mat;
+
+layout(set = 1, binding = 1) uniform sampler2D diffuseSampler;
+layout(set = 1, binding = 2) uniform sampler2D normalSampler;
+layout(set = 1, binding = 3) uniform sampler2D metallicRoughnessSampler;
+
+vec4 materialDiffuse()
+{
+    return mat.diffuse;
+}
+
+vec4 sampleDiffuse(vec2 uv)
+{
+    return texture(diffuseSampler, uv);
+}
+
+vec4 sampleNormal(vec2 uv)
+{
+    return texture(normalSampler, uv);
+}
+
+vec4 sampleMetallicRoughness(vec2 uv)
+{
+    return texture(metallicRoughnessSampler, uv);
+}
+
+#endif
@@ -1,25 +1,14 @@
 
 #version 460
 #extension GL_GOOGLE_include_directive : enable
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
 #include "utils.glsl"
 #include "pbr_funcs.glsl"
-
-const int MAX_LIGHTS = 16;
-
-struct Light
-{
-    vec3 position;
-    float intensity;
-    vec3 color;
-    float radius;
-    vec3 forward;
-    float cosineCutoff;
-    float spotExponent;
-    bool enabled;
-    int type;
-    float dummy;
-};
+#include "material.glsl"
+#include "lights.glsl"
 
 vec4 ComputeLight(in Light l, in vec3 N, in vec3 pos)
 {
@@ -32,20 +21,6 @@ layout(location = 2) in vec3 inWorldPos;
 layout(location = 3) in vec3 inWorldNormal;
 layout(location = 4) in vec3 inCamPosition;
 
-layout(set = 0, binding = 1) uniform LightBuffer
-{
-    Light[MAX_LIGHTS] l;
-} lights;
-
-layout(set = 1, binding = 0) uniform Material
-{
-    vec4 diffuse;
-} mat;
-
-layout(set = 1, binding = 1) uniform sampler2D diffuseSampler;
-layout(set = 1, binding = 2) uniform sampler2D normalSampler;
-layout(set = 1, binding = 3) uniform sampler2D metallicRoughnessSampler;
-
 layout(location = 0) out vec4 fragColor;
 
 void main()
@@ -58,17 +33,17 @@ void main()
     float NdotV = max(dot(N, V), 0.0);
 
     // Diffuse color
-    vec4 diffuseTxt = texture(diffuseSampler, inUV);
+    vec4 diffuseTxt = sampleDiffuse(inUV);
     if(diffuseTxt.w < 1.0)
         discard;
-    vec4 diffuse    = mat.diffuse * diffuseTxt;
-    float metallic  = texture(metallicRoughnessSampler, inUV).z;
-    float roughness = texture(metallicRoughnessSampler, inUV).y;
+    vec4 diffuse    = materialDiffuse() * diffuseTxt;
+    float metallic  = sampleMetallicRoughness(inUV).z;
+    float roughness = sampleMetallicRoughness(inUV).y;
     vec3 F0         = mix(vec3(0.04), pow(diffuseTxt.xyz, vec3(2.2)), metallic);
 
     // Multipass lights
     vec4 light = vec4(0.0);
-    for(int i = 0; i < MAX_LIGHTS; i++)
+    for(uint i = 0; i < lights.count; i++)
     {
         Light l = lights.l[i];
         if(!lights.l[i].enabled)
@@ -89,9 +64,9 @@ void main()
         att_factor = max(att_factor, 0.0);
         att_factor = att_factor * att_factor;
 
-        vec3 radiance = lights.l[i].color * lightIntensity * att_factor;
+        vec3 radiance = lights.l[i].color * lightIntensity * att_factor * spotFactor(lights.l[i], L);
 
-        N = normalize(texture(normalSampler, inUV).xyz);
+        N = normalize(sampleNormal(inUV).xyz);
         N = perturbNormal(wNorm, wPos, inUV, N);
         float NdotL = dot(N, L);
 
@@ -3,20 +3,214 @@
 #include "core/logger.h"
 #include "memory/pmemory.h"
 
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Reserved key hashes. Real hashes colliding with them are remapped.
+#define HASHTABLE_EMPTY_KEY     0
+#define HASHTABLE_TOMBSTONE_KEY 1
+
+// Tombstones above this percent of the slots trigger a rehash.
+#define HASHTABLE_MAX_TOMBSTONE_PERCENT 25
+
+static const u64 wySecret[4] = {
+    0xa0761d6478bd642full,
+    0xe7037ed1a0b428dbull,
+    0x8ebc6af09c88c6e3ull,
+    0x589965cc75374cc3ull
+};
+
+static void
+wyMum(u64* a, u64* b)
+{
+#ifdef _MSC_VER
+    *a = _umul128(*a, *b, b);
+#else
+    __uint128_t r = (__uint128_t)(*a) * (*b);
+    *a = (u64)r;
+    *b = (u64)(r >> 64);
+#endif
+}
+
+static u64
+wyMix(u64 a, u64 b)
+{
+    wyMum(&a, &b);
+    return a ^ b;
+}
+
+static u64
+wyRead8(const u8* p)
+{
+    u64 v;
+    memcpy(&v, p, sizeof(u64));
+    return v;
+}
+
+static u64
+wyRead4(const u8* p)
+{
+    u32 v;
+    memcpy(&v, p, sizeof(u32));
+    return v;
+}
+
 static u64
-makeHash(const char* name, u32 elementCount)
+wyRead3(const u8* p, u64 length)
+{
+    return (((u64)p[0]) << 16) | (((u64)p[length >> 1]) << 8) | p[length - 1];
+}
+
+u64
+hashtableHashString(const char* name)
+{
+    const u8* p = (const u8*)name;
+    u64 length = strlen(name);
+    u64 seed = wyMix(wySecret[0], wySecret[1]);
+    u64 a, b;
+
+    if(length <= 16)
+    {
+        if(length >= 4) {
+            a = (wyRead4(p) << 32) | wyRead4(p + ((length >> 3) << 2));
+            b = (wyRead4(p + length - 4) << 32) | wyRead4(p + length - 4 - ((length >> 3) << 2));
+        }
+        else if(length > 0) {
+            a = wyRead3(p, length);
+            b = 0;
+        }
+        else {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        u64 i = length;
+        while(i > 16) {
+            seed = wyMix(wyRead8(p) ^ wySecret[1], wyRead8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = wyRead8(p + i - 16);
+        b = wyRead8(p + i - 8);
+    }
+
+    a ^= wySecret[1];
+    b ^= seed;
+    wyMum(&a, &b);
+    return wyMix(a ^ wySecret[0] ^ length, b ^ wySecret[1]);
+}
+
+static u64
+makeKey(const char* name)
+{
+    u64 key = hashtableHashString(name);
+    if(key == HASHTABLE_EMPTY_KEY || key == HASHTABLE_TOMBSTONE_KEY) {
+        key += 2;
+    }
+    return key;
+}
+
+static void*
+valueAt(Hashtable* hashtable, u32 slot)
+{
+    return ((u8*)hashtable->memory) + (hashtable->elementSize * slot);
+}
+
+/**
+ * Walks the probe chain of key. Returns the slot holding the key or
+ * INVALID_ID if it is not found. If outInsertSlot is provided it receives
+ * the first slot where the key could be inserted.
+ */
+static u32
+findSlot(Hashtable* hashtable, u64 key, u32* outInsertSlot, u32* outProbeLength)
+{
+    const u32 count = hashtable->elementCount;
+    u32 slot = (u32)(key % count);
+    u32 insertSlot = INVALID_ID;
+    u32 probes = 0;
+    u32 found = INVALID_ID;
+
+    while(probes < count)
+    {
+        ++probes;
+        u64 slotKey = hashtable->keys[slot];
+        if(slotKey == key) {
+            found = slot;
+            break;
+        }
+        if(slotKey == HASHTABLE_EMPTY_KEY) {
+            if(insertSlot == INVALID_ID)
+                insertSlot = slot;
+            break;
+        }
+        if(slotKey == HASHTABLE_TOMBSTONE_KEY && insertSlot == INVALID_ID) {
+            insertSlot = slot;
+        }
+
+        if(++slot == count)
+            slot = 0;
+    }
+
+    if(outInsertSlot)
+        *outInsertSlot = insertSlot;
+    if(outProbeLength)
+        *outProbeLength = probes;
+    return found;
+}
+
+/**
+ * Removes every tombstone by inserting the live entries again in a new
+ * slot array, a single pass over the table. The array is temporary, the
+ * result is copied back to the block of the caller.
+ */
+static void
+rehash(Hashtable* hashtable)
 {
-    static const u64 multiplier = 97;
-    u64 hash = 0;
+    const u32 count = hashtable->elementCount;
+    const u64 memorySize = hashtableMemoryRequirement(hashtable->elementSize, count);
+    u64* keys = (u64*)memAllocate(memorySize, MEMORY_TAG_SYSTEM);
+    u8* values = (u8*)(keys + count);
+    memZero(keys, memorySize);
 
-    u32 length = strlen(name);
+    for(u32 i = 0; i < count; ++i)
+    {
+        u64 key = hashtable->keys[i];
+        if(key == HASHTABLE_EMPTY_KEY || key == HASHTABLE_TOMBSTONE_KEY)
+            continue;
 
-    for(u32 i = 0; i < length; ++i) {
-        hash = hash * multiplier + name[i];
+        u32 slot = (u32)(key % count);
+        while(keys[slot] != HASHTABLE_EMPTY_KEY)
+            slot = slot + 1 == count ? 0 : slot + 1;
+        keys[slot] = key;
+        memCopy(valueAt(hashtable, i), values + hashtable->elementSize * slot, hashtable->elementSize);
+    }
+
+    memCopy(keys, hashtable->keys, memorySize);
+    memFree(keys, memorySize, MEMORY_TAG_SYSTEM);
+    hashtable->tombstoneCount = 0;
+}
+
+/**
+ * Only erases leave tombstones, and inserts reuse them. Rehashing once
+ * they pass a share of the slots keeps misses from scanning the whole
+ * table under churn, without a rehash for every erase and insert pair.
+ */
+static void
+checkTombstones(Hashtable* hashtable)
+{
+    if((u64)hashtable->tombstoneCount * 100 > (u64)hashtable->elementCount * HASHTABLE_MAX_TOMBSTONE_PERCENT) {
+        rehash(hashtable);
     }
+}
 
-    hash %= elementCount;
-    return hash;
+u64
+hashtableMemoryRequirement(u64 elementSize, u32 elementCount)
+{
+    return (sizeof(u64) + elementSize) * elementCount;
 }
 
 void
@@ -32,21 +226,25 @@ hashtableCreate(u64 elementSize, u32 elementCount, void* memory, Hashtable* outH
         return;
     }
 
-    outHashtable->memory        = memory;
-    outHashtable->elementCount  = elementCount;
-    outHashtable->elementSize   = elementSize;
-    memZero(outHashtable->memory, elementSize * elementCount);
+    // Keys go first so values stay 8 bytes aligned.
+    outHashtable->keys              = (u64*)memory;
+    outHashtable->memory            = outHashtable->keys + elementCount;
+    outHashtable->elementCount      = elementCount;
+    outHashtable->elementSize       = elementSize;
+    outHashtable->usedCount         = 0;
+    outHashtable->tombstoneCount    = 0;
+    memZero(memory, hashtableMemoryRequirement(elementSize, elementCount));
 }
 
 void
-hashtableDestroy(Hashtable* hashtable) 
+hashtableDestroy(Hashtable* hashtable)
 {
     if(hashtable) {
-        memZero(hashtable, sizeof(hashtable));
+        memZero(hashtable, sizeof(Hashtable));
     }
 }
 
-bool 
+bool
 hashtableSetValue(Hashtable* hashtable, const char* name, void* value)
 {
     if(!hashtable || !name || !value) {
@@ -54,41 +252,110 @@ hashtableSetValue(Hashtable* hashtable, const char* name, void* value)
         return false;
     }
 
-    u64 hash = makeHash(name, hashtable->elementCount);
-    memCopy(value, ((char*)hashtable->memory) + (hashtable->elementSize * hash), hashtable->elementSize);
+    u64 key = makeKey(name);
+    u32 insertSlot;
+    u32 slot = findSlot(hashtable, key, &insertSlot, nullptr);
+
+    if(slot == INVALID_ID)
+    {
+        if(insertSlot == INVALID_ID) {
+            PERROR("hashtableSetValue - hashtable is full, could not insert '%s'.", name);
+            return false;
+        }
+
+        slot = insertSlot;
+        if(hashtable->keys[slot] == HASHTABLE_TOMBSTONE_KEY)
+            hashtable->tombstoneCount--;
+        hashtable->keys[slot] = key;
+        hashtable->usedCount++;
+        memCopy(value, valueAt(hashtable, slot), hashtable->elementSize);
+        return true;
+    }
+
+    memCopy(value, valueAt(hashtable, slot), hashtable->elementSize);
     return true;
 }
 
 bool
 hashtableGetValue(Hashtable* hashtable, const char* name, void* outValue)
 {
-    if(!hashtable || !name) {
-        PERROR("hashtableGetValue - a valid hashtable or name must be provided!");
+    if(!hashtable || !name || !outValue) {
+        PERROR("hashtableGetValue - a valid hashtable, name and outValue must be provided!");
         return false;
     }
 
-    u64 hash = makeHash(name, hashtable->elementCount);
-    memCopy(((char*)hashtable->memory) + (hashtable->elementSize * hash), outValue, sizeof(hashtable->elementSize));
-    //*outValue = ((char*)hashtable->memory) + (hashtable->elementSize * hash);
+    u32 slot = findSlot(hashtable, makeKey(name), nullptr, nullptr);
+    if(slot == INVALID_ID)
+        return false;
+
+    memCopy(valueAt(hashtable, slot), outValue, hashtable->elementSize);
     return true;
 }
 
 bool
-hashtableFill(Hashtable* hashtable, void* value)
+hashtableErase(Hashtable* hashtable, const char* name)
 {
-    if(!hashtable || !value) {
-        PERROR("Could not fill hashtable! Hashtable or value must be valid.");
+    if(!hashtable || !name) {
+        PERROR("hashtableErase - a valid hashtable and name must be provided!");
         return false;
     }
 
-    for(u32 i = 0; i < hashtable->elementCount; i++) {
-        memCopy(value, (char*)hashtable->memory + (hashtable->elementSize * i), hashtable->elementSize);
+    u32 slot = findSlot(hashtable, makeKey(name), nullptr, nullptr);
+    if(slot == INVALID_ID)
+        return false;
+
+    // If the next slot is empty no chain goes through this one,
+    // so it can be released as empty instead of tombstone.
+    u32 next = slot + 1 == hashtable->elementCount ? 0 : slot + 1;
+    if(hashtable->keys[next] == HASHTABLE_EMPTY_KEY) {
+        hashtable->keys[slot] = HASHTABLE_EMPTY_KEY;
+    } else {
+        hashtable->keys[slot] = HASHTABLE_TOMBSTONE_KEY;
+        hashtable->tombstoneCount++;
     }
+    hashtable->usedCount--;
+    memZero(valueAt(hashtable, slot), hashtable->elementSize);
+    checkTombstones(hashtable);
     return true;
 }
 
+bool
+hashtableNext(Hashtable* hashtable, u32* iterator, u64* outKey, void** outValue)
+{
+    if(!hashtable || !iterator) {
+        return false;
+    }
+
+    for(u32 i = *iterator; i < hashtable->elementCount; ++i)
+    {
+        u64 key = hashtable->keys[i];
+        if(key == HASHTABLE_EMPTY_KEY || key == HASHTABLE_TOMBSTONE_KEY)
+            continue;
+
+        if(outKey)
+            *outKey = key;
+        if(outValue)
+            *outValue = valueAt(hashtable, i);
+        *iterator = i + 1;
+        return true;
+    }
+
+    *iterator = hashtable->elementCount;
+    return false;
+}
+
+u32
+hashtableProbeLength(Hashtable* hashtable, const char* name)
+{
+    if(!hashtable || !name) {
+        return 0;
+    }
+
+    u32 probes = 0;
+    findSlot(hashtable, makeKey(name), nullptr, &probes);
+    return probes;
+}
 
-// TODO make a way to dehash the value.
 void
 hashtablePrint(Hashtable* hashtable)
 {
@@ -97,7 +364,12 @@ hashtablePrint(Hashtable* hashtable)
         return;
     }
 
-    for(u32 i = 0; i < hashtable->elementCount; ++i) {
-        //hashtable->
+    PINFO("Hashtable [%u/%u used, %u tombstones].",
+        hashtable->usedCount, hashtable->elementCount, hashtable->tombstoneCount);
+
+    u32 it = 0;
+    u64 key;
+    while(hashtableNext(hashtable, &it, &key, nullptr)) {
+        PINFO("\t[%u] 0x%016llx", it - 1, key);
     }
-}
\ No newline at end of file
+}
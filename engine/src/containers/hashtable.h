@@ -2,27 +2,90 @@
 
 #include "defines.h"
 
+/**
+ * Open addressing hashtable keyed by strings.
+ * The table does not own its memory, the caller provides a block of
+ * hashtableMemoryRequirement() bytes. The block is split in two arrays,
+ * the 64-bit hashes of the keys and the values. Collisions are solved
+ * by linear probing and erased entries are marked with a tombstone so
+ * probe chains are kept intact. When tombstones pass 25% of the slots
+ * they are cleared by rehashing, the only time the table allocates, a
+ * temporary block the size of the table.
+ */
+
 struct Hashtable
 {
     u64 elementSize;
-    u32 elementCount;
-    void* memory;
+    u32 elementCount;   // Number of slots in the table.
+    u32 usedCount;      // Number of slots holding a live entry.
+    u32 tombstoneCount; // Number of slots holding an erased entry.
+    u64* keys;          // 64-bit key hashes, one per slot.
+    void* memory;       // Values, one per slot.
 };
 
+/**
+ * Hashes a string with a wyhash-like 64-bit function.
+ * @param const char* name
+ * @return u64 hash of the string.
+ */
+u64
+hashtableHashString(const char* name);
+
+/**
+ * Returns the bytes the caller must provide in order to create
+ * a hashtable with elementCount slots of elementSize bytes.
+ * @param u64 elementSize
+ * @param u32 elementCount
+ * @return u64 memory requirement in bytes.
+ */
+u64
+hashtableMemoryRequirement(u64 elementSize, u32 elementCount);
+
 void
 hashtableCreate(u64 elementSize, u32 elementCount, void* memory, Hashtable* outHastable);
 
 void
 hashtableDestroy(Hashtable* hashtable);
 
-bool 
+/**
+ * Inserts the value for the given name or overwrites it if the key
+ * already exists. Fails if the table is full.
+ */
+bool
 hashtableSetValue(Hashtable* hashtable, const char* name, void* value);
 
+/**
+ * Copies the value stored for name into outValue.
+ * @return bool false if the key is not in the table.
+ */
 bool
 hashtableGetValue(Hashtable* hashtable, const char* name, void* outValue);
 
+/**
+ * Removes the entry for name, leaving a tombstone in its slot.
+ * @return bool false if the key is not in the table.
+ */
 bool
-hashtableFill(Hashtable* hashtable, void* value);
+hashtableErase(Hashtable* hashtable, const char* name);
+
+/**
+ * Iterates over all live entries. Start with *iterator = 0 and
+ * call it until it returns false.
+ * @param Hashtable* hashtable
+ * @param u32* iterator Slot where the search continues.
+ * @param u64* outKey Hash of the entry key. Optional.
+ * @param void** outValue Pointer to the value inside the table.
+ * @return bool false when there are no more entries.
+ */
+bool
+hashtableNext(Hashtable* hashtable, u32* iterator, u64* outKey, void** outValue);
+
+/**
+ * Returns the number of slots visited to find name, or to
+ * know it is not in the table. Used for profiling the table.
+ */
+u32
+hashtableProbeLength(Hashtable* hashtable, const char* name);
 
 void
-hashtablePrint(Hashtable* hashtable);
\ No newline at end of file
+hashtablePrint(Hashtable* hashtable);
@@ -0,0 +1,59 @@
+#include "radixSort.h"
+
+#include "memory/pmemory.h"
+
+void
+radixSort64(u64* keys, u32* values, u64* tmpKeys, u32* tmpValues, u32 count)
+{
+    if(count < 2)
+        return;
+
+    // All histograms in one read of the keys.
+    u32 histograms[8][256];
+    memZero(histograms, sizeof(histograms));
+    for(u32 i = 0; i < count; ++i)
+    {
+        u64 key = keys[i];
+        for(u32 pass = 0; pass < 8; ++pass)
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+    }
+
+    u64* srcKeys = keys;
+    u32* srcValues = values;
+    u64* dstKeys = tmpKeys;
+    u32* dstValues = tmpValues;
+
+    for(u32 pass = 0; pass < 8; ++pass)
+    {
+        u32* histogram = histograms[pass];
+        const u32 shift = pass * 8;
+
+        // Nothing to do if every key has the same byte.
+        if(histogram[(srcKeys[0] >> shift) & 0xFF] == count)
+            continue;
+
+        u32 offset = 0;
+        for(u32 b = 0; b < 256; ++b)
+        {
+            u32 n = histogram[b];
+            histogram[b] = offset;
+            offset += n;
+        }
+
+        for(u32 i = 0; i < count; ++i)
+        {
+            u32 slot = histogram[(srcKeys[i] >> shift) & 0xFF]++;
+            dstKeys[slot] = srcKeys[i];
+            dstValues[slot] = srcValues[i];
+        }
+
+        u64* swapKeys = srcKeys; srcKeys = dstKeys; dstKeys = swapKeys;
+        u32* swapValues = srcValues; srcValues = dstValues; dstValues = swapValues;
+    }
+
+    if(srcKeys != keys)
+    {
+        memCopy(srcKeys, keys, sizeof(u64) * count);
+        memCopy(srcValues, values, sizeof(u32) * count);
+    }
+}
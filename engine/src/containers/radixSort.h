@@ -0,0 +1,20 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * LSD radix sort of 64-bit keys, one byte per pass.
+ * Every key carries a 32-bit value, usually the index of the element
+ * it was built from. The sort is stable. The caller provides scratch
+ * arrays of the same size, so it can run on frame memory without any
+ * allocation. Passes where all keys share the same byte are skipped,
+ * which is common with packed keys that leave high bits empty.
+ * Sorted keys and values end up in keys and values.
+ * @param u64* keys
+ * @param u32* values
+ * @param u64* tmpKeys Scratch, count elements.
+ * @param u32* tmpValues Scratch, count elements.
+ * @param u32 count
+ */
+void
+radixSort64(u64* keys, u32* values, u64* tmpKeys, u32* tmpValues, u32 count);
@@ -3,6 +3,8 @@
 
 #include "platform/platform.h"
 #include "memory/pmemory.h"
+#include "memory/frameAllocator.h"
+#include "systems/jobSystem.h"
 
 #include "event.h"
 #include "input.h"
@@ -61,9 +63,39 @@ bool applicationInit(Game* pGameInst)
 
     //* Init Subsystems
     // Init memory system
-    memorySystemInit(&pState->memorySystemMemoryRequirements, nullptr);
+    MemorySystemConfig memoryConfig;
+    memoryConfig.allocatorType = MEMORY_ALLOCATOR_POOLED;
+#ifdef DEBUG
+    memoryConfig.captureCapacity = 64 * 1024;
+#else
+    memoryConfig.captureCapacity = 0;
+#endif
+    memorySystemInit(&pState->memorySystemMemoryRequirements, nullptr, memoryConfig);
     pState->memorySystem = linearAllocatorAllocate(&pState->systemsAllocator, pState->memorySystemMemoryRequirements);
-    memorySystemInit(&pState->memorySystemMemoryRequirements, pState->memorySystem);
+    memorySystemInit(&pState->memorySystemMemoryRequirements, pState->memorySystem, memoryConfig);
+
+    // Init per frame scratch memory.
+    FrameAllocatorConfig frameAllocatorConfig;
+    frameAllocatorConfig.frameSize = 8 * 1024 * 1024; // 8mb per frame
+    frameAllocatorInit(&pState->frameAllocatorMemoryRequirements, nullptr, frameAllocatorConfig);
+    pState->frameAllocator = linearAllocatorAllocate(&pState->systemsAllocator, pState->frameAllocatorMemoryRequirements);
+    if(!frameAllocatorInit(&pState->frameAllocatorMemoryRequirements, pState->frameAllocator, frameAllocatorConfig))
+    {
+        PFATAL("Frame allocator could not be initialized!");
+        return false;
+    }
+
+    // Init job system. Workers are started right away.
+    JobSystemConfig jobSystemConfig;
+    jobSystemConfig.workerCount = 0;
+    jobSystemConfig.maxJobsPerThread = 4096;
+    jobSystemInit(&pState->jobSystemMemoryRequirements, nullptr, jobSystemConfig);
+    pState->jobSystem = linearAllocatorAllocateAligned(&pState->systemsAllocator, pState->jobSystemMemoryRequirements, 64);
+    if(!jobSystemInit(&pState->jobSystemMemoryRequirements, pState->jobSystem, jobSystemConfig))
+    {
+        PFATAL("Job system could not be initialized!");
+        return false;
+    }
 
     // Init event system.
     eventSystemInit(&pState->eventSystemMemoryRequirements, nullptr);
@@ -96,9 +128,13 @@ bool applicationInit(Game* pGameInst)
     eventRegister(EVENT_CODE_RESIZED, 0, appOnResize);
 
     // Init renderer system.
-    renderSystemInit(&pState->renderSystemMemoryRequirements, nullptr, nullptr, nullptr);
+    RenderSystemConfig renderConfig;
+    renderConfig.gbufferLayout = RENDER_GBUFFER_COMPACT;
+    renderConfig.presentMode = RENDER_PRESENT_MAILBOX;
+    renderConfig.framesInFlight = 2;
+    renderSystemInit(&pState->renderSystemMemoryRequirements, nullptr, nullptr, nullptr, renderConfig);
     pState->renderSystem = linearAllocatorAllocate(&pState->systemsAllocator, pState->renderSystemMemoryRequirements);
-    if(!renderSystemInit(&pState->renderSystemMemoryRequirements, pState->renderSystem, "Pinatsu engine", platformGetWinHandle()))
+    if(!renderSystemInit(&pState->renderSystemMemoryRequirements, pState->renderSystem, "Pinatsu engine", platformGetWinHandle(), renderConfig))
     {
         PFATAL("Render system could not be initialized! Shuting down now.");
         return false;
@@ -120,7 +156,7 @@ bool applicationInit(Game* pGameInst)
 
     // Init Mesh system
     MeshSystemConfig meshSystemConfig;
-    meshSystemConfig.maxMeshesCount = 512;
+    meshSystemConfig.maxMeshesCount = 1024;
     meshSystemInit(&pState->meshSystemMemoryRequirements, nullptr, meshSystemConfig);
     pState->meshSystem = linearAllocatorAllocate(&pState->systemsAllocator, pState->meshSystemMemoryRequirements);
     if(!meshSystemInit(&pState->meshSystemMemoryRequirements, pState->meshSystem, meshSystemConfig))
@@ -207,6 +243,10 @@ bool applicationRun()
 
         if(!pState->m_isSuspended)
         {
+            // Memory from two frames ago is not used anymore.
+            frameAllocatorBeginFrame();
+            memorySystemBeginFrame();
+
             // Update the clock
             clockUpdate(&pState->clock);
             f64 currentTime = pState->clock.elapsedTime; // convert to seconds
@@ -255,6 +295,8 @@ bool applicationRun()
     inputSystemShutdown(pState->inputSystem);
     platformShutdown(pState->platformSystem);
     eventSystemShutdown(pState->eventSystem);
+    jobSystemShutdown(pState->jobSystem);
+    frameAllocatorShutdown(pState->frameAllocator);
     memorySystemShutdown(pState->memorySystem);
 
     return true;
@@ -32,6 +32,12 @@ typedef struct ApplicationState
     u64 memorySystemMemoryRequirements;
     void* memorySystem;
 
+    u64 frameAllocatorMemoryRequirements;
+    void* frameAllocator;
+
+    u64 jobSystemMemoryRequirements;
+    void* jobSystem;
+
     u64 eventSystemMemoryRequirements;
     void* eventSystem;
 
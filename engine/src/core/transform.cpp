@@ -43,9 +43,11 @@ void CTransform::fromMatrix(glm::mat4 matrix)
 
 CTransform CTransform::combinedWith(const CTransform& deltaTransform) const
 {
+    // Same as asMatrix() * deltaTransform.asMatrix() while scales are uniform.
     CTransform newTransform;
-    newTransform.rotation = deltaTransform.rotation * rotation;
-    glm::vec3 deltaPosRotated = rotation * deltaTransform.position;
+    newTransform.rotation = rotation * deltaTransform.rotation;
+    glm::vec3 deltaPosRotated = rotation * (scale * deltaTransform.position);
+    newTransform.position = position + deltaPosRotated;
     newTransform.scale = scale * deltaTransform.scale;
     return newTransform;
 }
@@ -141,8 +143,9 @@ bool CTransform::renderGuizmo()
     static ImGuizmo::OPERATION currentOperation(ImGuizmo::TRANSLATE);
     static ImGuizmo::MODE currentMode(ImGuizmo::WORLD);
 
-    ImGui::DragFloat3("Position", &position.x, 1.0f);
-    ImGui::DragFloat3("Scale", &scale.x, 1.0f);
+    bool changed = false;
+    changed |= ImGui::DragFloat3("Position", &position.x, 1.0f);
+    changed |= ImGui::DragFloat3("Scale", &scale.x, 1.0f);
     if(ImGui::RadioButton("Translate", currentOperation == ImGuizmo::TRANSLATE))
         currentOperation = ImGuizmo::TRANSLATE;
     ImGui::SameLine();
@@ -166,7 +169,6 @@ bool CTransform::renderGuizmo()
     //applicationGetFramebufferSize(&w, &h);
     //f32 ratio = (f32)w / (f32)h;
     glm::mat4 projection = c->getProjection(/* ratio */);
-    bool changed = false;
 
     ImGui::SameLine();
     if (ImGui::SmallButton("Reset"))
@@ -190,7 +192,7 @@ bool CTransform::renderGuizmo()
     }
 
     ImGuizmo::BeginFrame();
-    changed |= ImGuizmo::Manipulate(
+    bool manipulated = ImGuizmo::Manipulate(
         glm::value_ptr(cameraView), 
         glm::value_ptr(projection), 
         currentOperation, 
@@ -209,8 +211,10 @@ bool CTransform::renderGuizmo()
         fromMatrix(matrix);
     }*/
 
-    if(changed){
+    // Only the guizmo edits the matrix, the buttons above already set the members.
+    if(manipulated){
         fromMatrix(matrix);
+        changed = true;
     }
 
     ImGuiIO& io = ImGui::GetIO();
@@ -0,0 +1,158 @@
+#include "frameAllocator.h"
+
+#include "linearAllocator.h"
+#include "pmemory.h"
+#include "core/logger.h"
+
+// Heap block taken when an arena is exhausted, released with the arena.
+typedef struct FrameOverflowBlock
+{
+    FrameOverflowBlock* next;
+    u64 size;
+} FrameOverflowBlock;
+
+typedef struct FrameAllocatorState
+{
+    FrameAllocatorConfig config;
+    LinearAllocator arenas[2];
+    FrameOverflowBlock* overflow[2];
+    u64 overflowSize[2];    // Bytes asked from the heap since the arena was reset.
+    u32 currentArena;
+} FrameAllocatorState;
+
+static FrameAllocatorState* pState;
+
+bool frameAllocatorInit(u64* memoryRequirements, void* state, FrameAllocatorConfig config)
+{
+    if(config.frameSize == 0)
+    {
+        PERROR("frameAllocatorInit - frameSize must be a non-zero value.");
+        return false;
+    }
+
+    u64 stateMemoryRequirements = sizeof(FrameAllocatorState);
+    *memoryRequirements = stateMemoryRequirements + config.frameSize * 2;
+    if(!state)
+        return true;
+
+    pState = static_cast<FrameAllocatorState*>(state);
+    pState->config = config;
+    pState->currentArena = 0;
+    pState->overflow[0] = pState->overflow[1] = nullptr;
+    pState->overflowSize[0] = pState->overflowSize[1] = 0;
+
+    u8* arenaMemory = static_cast<u8*>(state) + stateMemoryRequirements;
+    linearAllocatorCreate(config.frameSize, arenaMemory, &pState->arenas[0]);
+    linearAllocatorCreate(config.frameSize, arenaMemory + config.frameSize, &pState->arenas[1]);
+
+    PINFO("Frame allocator initialized with %llu bytes per frame.", config.frameSize);
+    return true;
+}
+
+static void freeOverflow(u32 arena)
+{
+    FrameOverflowBlock* block = pState->overflow[arena];
+    while(block)
+    {
+        FrameOverflowBlock* next = block->next;
+        memFree(block, block->size, MEMORY_TAG_LINEAR_ALLOCATOR);
+        block = next;
+    }
+    pState->overflow[arena] = nullptr;
+}
+
+/**
+ * Exhausted arena, the block comes from the heap and lives as long as
+ * the arena memory would have.
+ */
+static void* overflowAllocate(u32 arena, u64 size, u64 alignment)
+{
+    u64 blockSize = sizeof(FrameOverflowBlock) + size + alignment;
+    FrameOverflowBlock* block = (FrameOverflowBlock*)memAllocate(blockSize, MEMORY_TAG_LINEAR_ALLOCATOR);
+    if(!block)
+        return nullptr;
+    block->next = pState->overflow[arena];
+    block->size = blockSize;
+    pState->overflow[arena] = block;
+    pState->overflowSize[arena] += size + alignment;
+
+    u64 start = (u64)(block + 1);
+    void* memory = (void*)((start + alignment - 1) & ~(alignment - 1));
+    memZero(memory, size);
+    return memory;
+}
+
+void frameAllocatorShutdown(void* state)
+{
+    if(pState)
+    {
+        freeOverflow(0);
+        freeOverflow(1);
+        linearAllocatorDestroy(&pState->arenas[0]);
+        linearAllocatorDestroy(&pState->arenas[1]);
+        pState = nullptr;
+    }
+}
+
+void frameAllocatorBeginFrame()
+{
+    if(!pState)
+        return;
+
+    u32 current = pState->currentArena ^ 1;
+    pState->currentArena = current;
+    freeOverflow(current);
+
+    // The frame that last used this arena did not fit, it grows to what that frame needed.
+    LinearAllocator* arena = &pState->arenas[current];
+    if(pState->overflowSize[current] > 0)
+    {
+        u64 size = arena->totalSize + pState->overflowSize[current];
+        size = (size + 1024 * 1024 - 1) & ~(u64)(1024 * 1024 - 1);
+        PWARN("Frame allocator - %llu bytes came from the heap, arena grown to %llu bytes.",
+            pState->overflowSize[current], size);
+        linearAllocatorDestroy(arena);
+        linearAllocatorCreate(size, nullptr, arena);
+        memZero(arena->memory, size);
+        pState->overflowSize[current] = 0;
+        return;
+    }
+    linearAllocatorFreeAll(arena);
+}
+
+void* frameAllocate(u64 size, u64 alignment)
+{
+    if(!pState)
+    {
+        PERROR("frameAllocate - frame allocator is not initialized.");
+        return nullptr;
+    }
+
+    if(size == 0)
+        return nullptr;
+
+    u32 current = pState->currentArena;
+    LinearAllocator* arena = &pState->arenas[current];
+    u64 top = (u64)(static_cast<u8*>(arena->memory) + arena->allocatedSize);
+    u64 padding = ((top + alignment - 1) & ~(alignment - 1)) - top;
+    if(arena->totalSize - arena->allocatedSize < size + padding)
+        return overflowAllocate(current, size, alignment);
+
+    return linearAllocatorAllocateAligned(arena, size, alignment);
+}
+
+u64 frameAllocatorUsedSize()
+{
+    return pState ? pState->arenas[pState->currentArena].allocatedSize + pState->overflowSize[pState->currentArena] : 0;
+}
+
+u64 frameAllocatorGetMarker()
+{
+    return pState ? linearAllocatorGetMarker(&pState->arenas[pState->currentArena]) : 0;
+}
+
+void frameAllocatorFreeToMarker(u64 marker)
+{
+    if(pState)
+        linearAllocatorFreeToMarker(&pState->arenas[pState->currentArena], marker);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * Per frame scratch memory.
+ * Two linear allocators are used in turns, one per frame. The one
+ * for the new frame is reset at the top of every frame, so memory
+ * handed out stays valid until the end of the next frame.
+ * Memory is not constructed nor destroyed, use it for plain data
+ * like render keys, light lists or sorted draw lists.
+ * When an arena runs out the rest of the frame is served from the heap
+ * with the same lifetime, and the arena grows when it is reset.
+ */
+
+typedef struct FrameAllocatorConfig
+{
+    u64 frameSize; // Bytes available on each frame.
+} FrameAllocatorConfig;
+
+bool frameAllocatorInit(u64* memoryRequirements, void* state, FrameAllocatorConfig config);
+void frameAllocatorShutdown(void* state);
+
+/**
+ * Swaps to the other arena and resets it.
+ * Called by the application at the top of every frame.
+ */
+void frameAllocatorBeginFrame();
+
+/**
+ * Allocates size bytes from the current frame arena.
+ * @param u64 size
+ * @param u64 alignment Must be a power of two.
+ * @return void* block, from the heap if the arena is exhausted.
+ */
+void* frameAllocate(u64 size, u64 alignment);
+
+/**
+ * Returns the bytes used so far in the current frame.
+ */
+u64 frameAllocatorUsedSize();
+
+/**
+ * Markers of the current frame arena, everything allocated after the
+ * marker is released by frameAllocatorFreeToMarker. Memory allocated
+ * before it stays valid. Heap blocks are kept until the arena is reset.
+ */
+u64 frameAllocatorGetMarker();
+void frameAllocatorFreeToMarker(u64 marker);
+
+template<typename T>
+T* frameAlloc(u32 count)
+{
+    return static_cast<T*>(frameAllocate(sizeof(T) * count, alignof(T)));
+}
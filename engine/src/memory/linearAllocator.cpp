@@ -2,6 +2,7 @@
 
 #include "pmemory.h"
 #include "core/logger.h"
+#include "core/assert.h"
 
 /**
  * This functions create a linear allocator by receiving
@@ -78,15 +79,86 @@ void* linearAllocatorAllocate(LinearAllocator* allocator, u64 size)
     return 0;
 }
 
+/**
+ * Same as linearAllocatorAllocate but the returned block
+ * starts at an address multiple of alignment.
+ * @param LinearAllocator allocator
+ * @param u64 size
+ * @param u64 alignment Must be a power of two.
+ */
+void* linearAllocatorAllocateAligned(LinearAllocator* allocator, u64 size, u64 alignment)
+{
+    if(allocator)
+    {
+        PASSERT_MSG(alignment && (alignment & (alignment - 1)) == 0, "Alignment must be a power of two.")
+
+        u64 current = (u64)(static_cast<u8*>(allocator->memory) + allocator->allocatedSize);
+        u64 aligned = (current + alignment - 1) & ~(alignment - 1);
+        u64 padding = aligned - current;
+
+        if((allocator->totalSize - allocator->allocatedSize) < size + padding)
+        {
+            PERROR("Not enough available space to allocate. Asked for %llu but only %llu is available.",
+                    size + padding, (allocator->totalSize - allocator->allocatedSize));
+            return 0;
+        }
+
+        allocator->allocatedSize += size + padding;
+        return (void*)aligned;
+    }
+    PERROR("No allocator provided. No memory has been allocated.");
+    return 0;
+}
+
+/**
+ * Clears the range [from, allocatedSize) once it is not used anymore.
+ */
+static void clearFreedMemory(LinearAllocator* allocator, u64 from)
+{
+    u8* block = static_cast<u8*>(allocator->memory) + from;
+    u64 size = allocator->allocatedSize - from;
+#ifdef LINEAR_ALLOCATOR_POISON_FREED
+    memSet(block, LINEAR_ALLOCATOR_POISON_VALUE, size);
+#else
+    memZero(block, size);
+#endif
+}
+
+/**
+ * Returns the current top of the allocator.
+ * @param LinearAllocator allocator
+ * @return u64 marker to roll back to.
+ */
+u64 linearAllocatorGetMarker(LinearAllocator* allocator)
+{
+    return allocator ? allocator->allocatedSize : 0;
+}
+
+/**
+ * Frees everything allocated after the marker was taken.
+ * @param LinearAllocator allocator
+ * @param u64 marker
+ */
+void linearAllocatorFreeToMarker(LinearAllocator* allocator, u64 marker)
+{
+    if(allocator && allocator->memory)
+    {
+        PASSERT_MSG(marker <= allocator->allocatedSize, "Marker is above the top of the allocator.")
+        clearFreedMemory(allocator, marker);
+        allocator->allocatedSize = marker;
+    }
+}
+
 /**
  * Frees all memory in the allocator.
+ * Only the memory used since the last reset is cleared.
  * @param LinearAllocator allocator
  */
 void linearAllocatorFreeAll(LinearAllocator* allocator)
 {
     if(allocator && allocator->memory)
     {
+        clearFreedMemory(allocator, 0);
         allocator->allocatedSize = 0;
-        memZero(allocator->memory, allocator->totalSize);
     }
 }
\ No newline at end of file
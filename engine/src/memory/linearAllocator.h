@@ -9,6 +9,11 @@
  * more memory but it can only free them all at once.  
  */ 
 
+// With LINEAR_ALLOCATOR_POISON_FREED (PINATSU_POISON_FREED in cmake) freed
+// memory is filled with this value instead of zeroes, so reading memory after
+// a reset is easy to spot. Off by default, callers get zeroed memory.
+#define LINEAR_ALLOCATOR_POISON_VALUE 0xCD
+
 typedef struct LinearAllocator
 {
     u64 totalSize;
@@ -23,4 +28,14 @@ void linearAllocatorDestroy(LinearAllocator* allocator);
 
 void* linearAllocatorAllocate(LinearAllocator* allocator, u64 size);
 
+void* linearAllocatorAllocateAligned(LinearAllocator* allocator, u64 size, u64 alignment);
+
+/**
+ * Markers save the current top of the allocator so everything
+ * allocated after it can be rolled back at once.
+ */
+u64 linearAllocatorGetMarker(LinearAllocator* allocator);
+
+void linearAllocatorFreeToMarker(LinearAllocator* allocator, u64 marker);
+
 void linearAllocatorFreeAll(LinearAllocator* allocator);
\ No newline at end of file
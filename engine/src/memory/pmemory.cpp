@@ -1,18 +1,109 @@
 #include "pmemory.h"
 
 #include "platform/platform.h"
-#include "core\logger.h"
+#include "core/logger.h"
+#include "core/assert.h"
+#include "platform/filesystem.h"
 
+#include <atomic>
+#include <algorithm>
+#include <new>
+#include <string.h>
+#include <vector>
+
+// Size classes go from 32 bytes to 4 KiB, header included.
+#define MEMORY_POOL_CLASS_COUNT     8
+#define MEMORY_POOL_MIN_BLOCK_SIZE  32
+#define MEMORY_POOL_MAX_BLOCK_SIZE  (MEMORY_POOL_MIN_BLOCK_SIZE << (MEMORY_POOL_CLASS_COUNT - 1))
+#define MEMORY_POOL_CHUNK_SIZE      (64 * 1024)
+#define MEMORY_LARGE_CLASS          0xFF
+#define MEMORY_BLOCK_MAGIC          0xB10C
+
+/**
+ * Header placed before every block returned by memAllocate.
+ * It keeps what memFree needs to return the block to its origin,
+ * so the size given by the caller is not trusted.
+ * It is 16 bytes to keep the user block 16 bytes aligned.
+ */
+struct memoryBlockHeader
+{
+    u64 size;       // Size requested by the caller.
+    u32 tag;
+    u8  sizeClass;  // Pool index or MEMORY_LARGE_CLASS.
+    u8  tracked;    // Allocated after the memory system was initialized.
+    u16 magic;
+};
+
+STATIC_ASSERT(sizeof(memoryBlockHeader) == 16, "Expected memoryBlockHeader to be 16 bytes.");
+
+struct memoryFreeBlock
+{
+    memoryFreeBlock* next;
+};
+
+// Chunks requested to the platform are linked so they can be released on shutdown.
+struct memoryChunk
+{
+    memoryChunk* next;
+    u64 padding;
+};
+
+struct memoryPool
+{
+    std::atomic_flag lock;
+    u64 blockSize;
+    memoryFreeBlock* freeList;
+    memoryChunk* chunks;
+    u64 chunkCount;
+    u64 blocksInUse;
+};
+
+/**
+ * Counters are atomics so memAllocate and memFree can be called from
+ * any thread. They are updated with relaxed ordering, readers get a
+ * consistent value per counter but not across counters.
+ */
 struct memoryStats
 {
-    u64 totalAllocated;
-    u64 taggedAllocations[MEMORY_TAG_MAX_TAGS];
+    std::atomic<u64> totalAllocated;
+    std::atomic<u64> peakAllocated;
+    std::atomic<u64> liveAllocations;
+    std::atomic<u64> allocationCount; // Accumulated since init.
+    std::atomic<u64> taggedAllocations[MEMORY_TAG_MAX_TAGS];
+    std::atomic<u64> taggedPeak[MEMORY_TAG_MAX_TAGS];
+    std::atomic<u64> taggedCount[MEMORY_TAG_MAX_TAGS];
+    std::atomic<u64> taggedTotal[MEMORY_TAG_MAX_TAGS];
+
+    std::atomic<u64> poolReserved;   // Bytes requested to the platform for chunks.
+    std::atomic<u64> poolUsed;       // Bytes of blocks handed out, headers included.
+    std::atomic<u64> poolRequested;  // Bytes asked by callers served from pools.
+
+    // Reported by the renderer backend.
+    std::atomic<u64> gpuBlockCount;
+    std::atomic<u64> gpuReserved;
+    std::atomic<u64> gpuUsed;
+    std::atomic<u64> gpuFreeRanges;
+    std::atomic<u64> gpuLiveCount;
+    std::atomic<u64> gpuTotalCount;
+    std::atomic<u64> gpuMapCalls;
+};
+
+// One captured allocation.
+struct memoryCaptureEntry
+{
+    const char* file;
+    u32 line;
+    u32 tag;
+    u64 size;
+    u64 frame;
+    f64 timestamp;
 };
 
 static const char* memoryTagsStrings[MEMORY_TAG_MAX_TAGS] = {
     "UNKNOWN    ",
     "LINEAR_ALLOC",
     "STACK_ALLOC",
+    "POOL_ALLOC ",
     "APPLICATION",
     "JOB        ",
     "TEXTURE    ",
@@ -30,59 +121,261 @@ static const char* memoryTagsStrings[MEMORY_TAG_MAX_TAGS] = {
 typedef struct memorySystemState
 {
     struct memoryStats stats;
-    u64 allocCount;
+    MemorySystemConfig config;
+    memoryPool pools[MEMORY_POOL_CLASS_COUNT];
+
+    // Capture ring buffer, written without locks. An entry being
+    // overwritten while dumped may come out torn.
+    memoryCaptureEntry* captures;
+    std::atomic<u64> captureWriteIndex;
+    std::atomic<u64> frame;
+    std::atomic<bool> captureEnabled;
 } memorySystemState;
 
 static memorySystemState* pState;
 
-void memorySystemInit(u64* memoryRequirements, void* state)
+// Set on shutdown of the pooled allocator. From then on a block may live
+// in a chunk already given back to the platform, its header can't be read.
+static bool poolChunksReleased = false;
+
+static void atomicMax(std::atomic<u64>& target, u64 value)
+{
+    u64 current = target.load(std::memory_order_relaxed);
+    while(current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        ;
+}
+
+static void poolLock(memoryPool* pool)
+{
+    while(pool->lock.test_and_set(std::memory_order_acquire))
+        ;
+}
+
+static void poolUnlock(memoryPool* pool)
+{
+    pool->lock.clear(std::memory_order_release);
+}
+
+static u8 poolClassFromSize(u64 size)
+{
+    u8 index = 0;
+    u64 blockSize = MEMORY_POOL_MIN_BLOCK_SIZE;
+    while(blockSize < size) {
+        blockSize <<= 1;
+        ++index;
+    }
+    return index;
+}
+
+static bool poolGrow(memoryPool* pool)
+{
+    u8* memory = (u8*)platformAllocateMemory(MEMORY_POOL_CHUNK_SIZE);
+    if(!memory) {
+        PFATAL("Memory pool could not get a new chunk from the platform.");
+        return false;
+    }
+
+    memoryChunk* chunk = (memoryChunk*)memory;
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+    pool->chunkCount++;
+    pState->stats.poolReserved.fetch_add(MEMORY_POOL_CHUNK_SIZE, std::memory_order_relaxed);
+
+    // Carve the chunk in blocks and push them to the free list.
+    u64 blockCount = (MEMORY_POOL_CHUNK_SIZE - sizeof(memoryChunk)) / pool->blockSize;
+    u8* block = memory + sizeof(memoryChunk);
+    for(u64 i = 0; i < blockCount; ++i)
+    {
+        memoryFreeBlock* freeBlock = (memoryFreeBlock*)block;
+        freeBlock->next = pool->freeList;
+        pool->freeList = freeBlock;
+        block += pool->blockSize;
+    }
+    return true;
+}
+
+static void* poolAllocate(memoryPool* pool)
+{
+    poolLock(pool);
+    if(!pool->freeList && !poolGrow(pool)) {
+        poolUnlock(pool);
+        return nullptr;
+    }
+
+    memoryFreeBlock* block = pool->freeList;
+    pool->freeList = block->next;
+    pool->blocksInUse++;
+    poolUnlock(pool);
+
+    pState->stats.poolUsed.fetch_add(pool->blockSize, std::memory_order_relaxed);
+    return block;
+}
+
+static void poolFree(memoryPool* pool, void* block)
+{
+    memoryFreeBlock* freeBlock = (memoryFreeBlock*)block;
+    poolLock(pool);
+    freeBlock->next = pool->freeList;
+    pool->freeList = freeBlock;
+    pool->blocksInUse--;
+    poolUnlock(pool);
+
+    pState->stats.poolUsed.fetch_sub(pool->blockSize, std::memory_order_relaxed);
+}
+
+static void captureAllocation(u64 size, memoryTag tag, const char* file, u32 line)
+{
+    u64 index = pState->captureWriteIndex.fetch_add(1, std::memory_order_relaxed);
+    memoryCaptureEntry* entry = &pState->captures[index % pState->config.captureCapacity];
+    entry->file         = file;
+    entry->line         = line;
+    entry->tag          = tag;
+    entry->size         = size;
+    entry->frame        = pState->frame.load(std::memory_order_relaxed);
+    entry->timestamp    = platformGetCurrentTime();
+}
+
+void memorySystemInit(u64* memoryRequirements, void* state, MemorySystemConfig config)
 {
-    *memoryRequirements = sizeof(memorySystemState);
+    u64 stateMemoryRequirement = sizeof(memorySystemState);
+    u64 captureMemoryRequirement = sizeof(memoryCaptureEntry) * config.captureCapacity;
+    *memoryRequirements = stateMemoryRequirement + captureMemoryRequirement;
     if(!state)
         return;
 
-    pState = static_cast<memorySystemState*>(state);
-    pState->allocCount = 0;
+    platformZeroMemory(state, *memoryRequirements);
+    pState = new (state) memorySystemState();
+    pState->config = config;
+    pState->captures = config.captureCapacity ? (memoryCaptureEntry*)((u8*)state + stateMemoryRequirement) : nullptr;
+    pState->captureWriteIndex.store(0);
+    pState->frame.store(0);
+    pState->captureEnabled.store(config.captureCapacity > 0);
 
-    platformZeroMemory(&pState->stats, sizeof(memoryStats));
+    for(u32 i = 0; i < MEMORY_POOL_CLASS_COUNT; ++i)
+    {
+        memoryPool* pool = &pState->pools[i];
+        pool->blockSize     = (u64)MEMORY_POOL_MIN_BLOCK_SIZE << i;
+        pool->freeList      = nullptr;
+        pool->chunks        = nullptr;
+        pool->chunkCount    = 0;
+        pool->blocksInUse   = 0;
+        pool->lock.clear();
+    }
 }
 
 void memorySystemShutdown(void* state)
 {
+    if(pState)
+    {
+        for(u32 i = 0; i < MEMORY_POOL_CLASS_COUNT; ++i)
+        {
+            memoryChunk* chunk = pState->pools[i].chunks;
+            while(chunk)
+            {
+                memoryChunk* next = chunk->next;
+                platformFreeMemory(chunk);
+                chunk = next;
+            }
+        }
+        if(pState->config.allocatorType == MEMORY_ALLOCATOR_POOLED)
+            poolChunksReleased = true;
+        pState->~memorySystemState();
+    }
     pState = nullptr;
 }
 
-void* memAllocate(u64 size, memoryTag tag)
+void* memAllocateAt(u64 size, memoryTag tag, const char* file, u32 line)
 {
     if(tag == MEMORY_TAG_UNKNOWN){
         PWARN("Memory tag is UNKNOWN.");
     }
 
+    u64 blockSize = size + sizeof(memoryBlockHeader);
+    u8 sizeClass = MEMORY_LARGE_CLASS;
+    memoryBlockHeader* header = nullptr;
+
+    if(pState && pState->config.allocatorType == MEMORY_ALLOCATOR_POOLED && blockSize <= MEMORY_POOL_MAX_BLOCK_SIZE)
+    {
+        sizeClass = poolClassFromSize(blockSize);
+        header = (memoryBlockHeader*)poolAllocate(&pState->pools[sizeClass]);
+    }
+    else
+    {
+        header = (memoryBlockHeader*)platformAllocateMemory(blockSize);
+    }
+
+    if(!header) {
+        PFATAL("memAllocate - could not allocate %llu bytes.", size);
+        return nullptr;
+    }
+
+    header->size        = size;
+    header->tag         = tag;
+    header->sizeClass   = sizeClass;
+    header->tracked     = pState != nullptr;
+    header->magic       = MEMORY_BLOCK_MAGIC;
+
     if(pState)
     {
-        pState->stats.totalAllocated += size;
-        pState->stats.taggedAllocations[tag] += size;
-        pState->allocCount++;
+        memoryStats* stats = &pState->stats;
+        u64 total = stats->totalAllocated.fetch_add(size, std::memory_order_relaxed) + size;
+        u64 tagged = stats->taggedAllocations[tag].fetch_add(size, std::memory_order_relaxed) + size;
+        stats->taggedCount[tag].fetch_add(1, std::memory_order_relaxed);
+        stats->taggedTotal[tag].fetch_add(1, std::memory_order_relaxed);
+        stats->liveAllocations.fetch_add(1, std::memory_order_relaxed);
+        stats->allocationCount.fetch_add(1, std::memory_order_relaxed);
+        if(sizeClass != MEMORY_LARGE_CLASS)
+            stats->poolRequested.fetch_add(size, std::memory_order_relaxed);
+
+        atomicMax(stats->peakAllocated, total);
+        atomicMax(stats->taggedPeak[tag], tagged);
+
+        if(pState->captureEnabled.load(std::memory_order_relaxed))
+            captureAllocation(size, tag, file, line);
     }
 
-    void* block = platformAllocateMemory(size);
-    return platformZeroMemory(block, sizeof(block));
+    return platformZeroMemory(header + 1, size);
 }
 
 void memFree(void* block, u64 size, memoryTag tag)
 {
-    if(tag == MEMORY_TAG_UNKNOWN)
+    if(!block)
+        return;
+
+    if(!pState && poolChunksReleased) {
+        PERROR("memFree - block freed after the memory system shutdown, it is leaked.");
+        return;
+    }
+
+    memoryBlockHeader* header = (memoryBlockHeader*)block - 1;
+    PASSERT_MSG(header->magic == MEMORY_BLOCK_MAGIC, "memFree - block was not allocated by memAllocate.")
+
+    if(header->tag != (u32)tag)
     {
-        PWARN("Memory tag is UNKNOWN.");
+        PWARN("memFree - block allocated as %s freed as %s.", memoryTagsStrings[header->tag], memoryTagsStrings[tag]);
     }
 
-    if(pState)
+    if(pState && header->tracked)
     {
-        pState->stats.totalAllocated -= size;
-        pState->stats.taggedAllocations[tag] -= size;
-        pState->allocCount--;
+        memoryStats* stats = &pState->stats;
+        stats->totalAllocated.fetch_sub(header->size, std::memory_order_relaxed);
+        stats->taggedAllocations[header->tag].fetch_sub(header->size, std::memory_order_relaxed);
+        stats->taggedCount[header->tag].fetch_sub(1, std::memory_order_relaxed);
+        stats->liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+        if(header->sizeClass != MEMORY_LARGE_CLASS)
+            stats->poolRequested.fetch_sub(header->size, std::memory_order_relaxed);
+    }
+
+    header->magic = 0;
+    if(header->sizeClass == MEMORY_LARGE_CLASS)
+    {
+        platformFreeMemory(header);
+    }
+    else
+    {
+        // Pooled blocks only exist while the system is alive, checked above.
+        poolFree(&pState->pools[header->sizeClass], header);
     }
-    platformFreeMemory(block);
 }
 
 void* memZero(void* block, u64 size)
@@ -100,41 +393,269 @@ void* memCopy(void* source, void* dest, u64 size)
     return platformCopyMemory(source, dest, size);
 }
 
-std::string getMemoryUsageStr()
+static std::string formatBytes(u64 bytes)
 {
     const u64 gib = 1024 * 1024 * 1024;
     const u64 mib = 1024 * 1024;
     const u64 kib = 1024;
+
+    float amount = 1.0f;
+    std::string unit = "XiB";
+    if(bytes > gib)
+    {
+        unit[0] = 'G';
+        amount = bytes / (float)gib;
+    }
+    else if(bytes > mib)
+    {
+        unit[0] = 'M';
+        amount = bytes / (float)mib;
+    }
+    else if(bytes > kib)
+    {
+        unit[0] = 'K';
+        amount = bytes / (float)kib;
+    }
+    else
+    {
+        unit = "B";
+        amount = (float)bytes;
+    }
+    std::string value = std::to_string(amount);
+    return value.substr(0, value.find('.') + 3) + " " + unit;
+}
+
+MemoryTagStats memoryGetStats(memoryTag tag)
+{
+    MemoryTagStats out = {};
+    if(!pState || tag >= MEMORY_TAG_MAX_TAGS)
+        return out;
+
+    const memoryStats& stats = pState->stats;
+    out.allocated   = stats.taggedAllocations[tag].load(std::memory_order_relaxed);
+    out.peak        = stats.taggedPeak[tag].load(std::memory_order_relaxed);
+    out.liveCount   = stats.taggedCount[tag].load(std::memory_order_relaxed);
+    out.totalCount  = stats.taggedTotal[tag].load(std::memory_order_relaxed);
+    return out;
+}
+
+MemoryTotalStats memoryGetTotalStats()
+{
+    MemoryTotalStats out = {};
+    if(!pState)
+        return out;
+
+    const memoryStats& stats = pState->stats;
+    out.allocated       = stats.totalAllocated.load(std::memory_order_relaxed);
+    out.peak            = stats.peakAllocated.load(std::memory_order_relaxed);
+    out.liveCount       = stats.liveAllocations.load(std::memory_order_relaxed);
+    out.totalCount      = stats.allocationCount.load(std::memory_order_relaxed);
+    out.poolReserved    = stats.poolReserved.load(std::memory_order_relaxed);
+    out.poolUsed        = stats.poolUsed.load(std::memory_order_relaxed);
+    out.poolRequested   = stats.poolRequested.load(std::memory_order_relaxed);
+    return out;
+}
+
+void memoryReportGpuStats(const MemoryGpuStats& gpu)
+{
+    if(!pState)
+        return;
+
+    memoryStats& stats = pState->stats;
+    stats.gpuBlockCount.store(gpu.blockCount, std::memory_order_relaxed);
+    stats.gpuReserved.store(gpu.reserved, std::memory_order_relaxed);
+    stats.gpuUsed.store(gpu.used, std::memory_order_relaxed);
+    stats.gpuFreeRanges.store(gpu.freeRanges, std::memory_order_relaxed);
+    stats.gpuLiveCount.store(gpu.liveCount, std::memory_order_relaxed);
+    stats.gpuTotalCount.store(gpu.totalCount, std::memory_order_relaxed);
+    stats.gpuMapCalls.store(gpu.mapCalls, std::memory_order_relaxed);
+}
+
+MemoryGpuStats memoryGetGpuStats()
+{
+    MemoryGpuStats out = {};
+    if(!pState)
+        return out;
+
+    const memoryStats& stats = pState->stats;
+    out.blockCount  = stats.gpuBlockCount.load(std::memory_order_relaxed);
+    out.reserved    = stats.gpuReserved.load(std::memory_order_relaxed);
+    out.used        = stats.gpuUsed.load(std::memory_order_relaxed);
+    out.freeRanges  = stats.gpuFreeRanges.load(std::memory_order_relaxed);
+    out.liveCount   = stats.gpuLiveCount.load(std::memory_order_relaxed);
+    out.totalCount  = stats.gpuTotalCount.load(std::memory_order_relaxed);
+    out.mapCalls    = stats.gpuMapCalls.load(std::memory_order_relaxed);
+    return out;
+}
+
+const char* memoryGetTagName(memoryTag tag)
+{
+    return tag < MEMORY_TAG_MAX_TAGS ? memoryTagsStrings[tag] : "INVALID    ";
+}
+
+std::string getMemoryUsageStr()
+{
     std::string title = "System memory use (tagged):\n";
     std::string str;
     for( u32 i = 0; i < MEMORY_TAG_MAX_TAGS; ++i )
     {
-        float amount = 1.0f;
-        std::string unit = "XiB";
-        if(pState->stats.taggedAllocations[i] > gib)
-        {
-            unit[0] = 'G';
-            amount = pState->stats.taggedAllocations[i] / (float)gib;
-        }
-        else if(pState->stats.taggedAllocations[i] > mib)
-        {
-            unit[0] = 'M';
-            amount = pState->stats.taggedAllocations[i] / (float)mib;
-
-        }
-        else if(pState->stats.taggedAllocations[i] > kib)
-        {
-            unit[0] = 'K';
-            amount = pState->stats.taggedAllocations[i] / (float)kib;
-        }
-        else
-        {
-            unit[0] = 'B';
-            unit[1] = unit[2] = '\0';
-            amount = (float)pState->stats.taggedAllocations[i];
-        }
+        MemoryTagStats tagStats = memoryGetStats((memoryTag)i);
         std::string aux = memoryTagsStrings[i];
-        str += "\t" + aux + " " + std::to_string(amount).substr(0, std::to_string(amount).find('.') + 3) + " " + unit + "\n";
+        str += "\t" + aux + " " + formatBytes(tagStats.allocated)
+            + " (" + std::to_string(tagStats.liveCount) + " live, peak "
+            + formatBytes(tagStats.peak) + ")\n";
+    }
+
+    MemoryTotalStats stats = memoryGetTotalStats();
+    str += "Total: " + formatBytes(stats.allocated) + ", peak " + formatBytes(stats.peak)
+        + ", " + std::to_string(stats.liveCount) + " live of "
+        + std::to_string(stats.totalCount) + " allocations.\n";
+
+    if(pState && pState->config.allocatorType == MEMORY_ALLOCATOR_POOLED && stats.poolReserved > 0)
+    {
+        // Internal: space lost rounding up to the size class.
+        // External: space reserved in chunks but sitting in free lists.
+        f32 internal = stats.poolUsed ? 1.0f - (f32)stats.poolRequested / (f32)stats.poolUsed : 0.0f;
+        f32 external = 1.0f - (f32)stats.poolUsed / (f32)stats.poolReserved;
+        str += "Pools: " + formatBytes(stats.poolUsed) + " used of " + formatBytes(stats.poolReserved)
+            + " reserved. Fragmentation internal " + std::to_string((i32)(internal * 100.0f))
+            + "%, external " + std::to_string((i32)(external * 100.0f)) + "%.\n";
+    }
+
+    MemoryGpuStats gpu = memoryGetGpuStats();
+    if(gpu.blockCount > 0)
+    {
+        str += "GPU: " + formatBytes(gpu.used) + " used of " + formatBytes(gpu.reserved)
+            + " in " + std::to_string(gpu.blockCount) + " blocks, "
+            + std::to_string(gpu.liveCount) + " live of " + std::to_string(gpu.totalCount)
+            + " allocations, " + std::to_string(gpu.freeRanges) + " free ranges.\n";
     }
     return title + str;
-} 
\ No newline at end of file
+}
+
+void memorySystemBeginFrame()
+{
+    if(pState)
+        pState->frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+void memoryCaptureSetEnabled(bool enabled)
+{
+    if(pState && pState->captures)
+        pState->captureEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+// Allocations of the same frame and call site added together.
+struct memoryCaptureSite
+{
+    u64 frame;
+    const char* file;
+    u32 line;
+    u32 tag;
+    u64 count;
+    u64 bytes;
+};
+
+static bool writeCaptureCsv(FileHandle* handle, const std::vector<memoryCaptureEntry>& entries)
+{
+    // Group by frame and call site. File names are string literals, so
+    // the same call site always has the same pointer.
+    std::vector<memoryCaptureEntry> sorted(entries);
+    std::sort(sorted.begin(), sorted.end(), [](const memoryCaptureEntry& a, const memoryCaptureEntry& b) {
+        if(a.frame != b.frame) return a.frame < b.frame;
+        if(a.file != b.file) return a.file < b.file;
+        return a.line < b.line;
+    });
+
+    std::vector<memoryCaptureSite> sites;
+    for(const memoryCaptureEntry& e : sorted)
+    {
+        if(!sites.empty() && sites.back().frame == e.frame && sites.back().file == e.file && sites.back().line == e.line) {
+            sites.back().count++;
+            sites.back().bytes += e.size;
+            continue;
+        }
+        memoryCaptureSite site = { e.frame, e.file, e.line, e.tag, 1, e.size };
+        sites.push_back(site);
+    }
+
+    // Biggest sites first inside each frame.
+    std::stable_sort(sites.begin(), sites.end(), [](const memoryCaptureSite& a, const memoryCaptureSite& b) {
+        if(a.frame != b.frame) return a.frame < b.frame;
+        return a.bytes > b.bytes;
+    });
+
+    std::string csv = "frame,file,line,tag,count,bytes\n";
+    for(const memoryCaptureSite& site : sites)
+    {
+        std::string tag = memoryTagsStrings[site.tag];
+        tag.erase(tag.find_last_not_of(' ') + 1);
+        csv += std::to_string(site.frame) + "," + (site.file ? site.file : "unknown") + ","
+            + std::to_string(site.line) + "," + tag + ","
+            + std::to_string(site.count) + "," + std::to_string(site.bytes) + "\n";
+    }
+    return filesystemWrite(handle, csv.size(), csv.data(), nullptr);
+}
+
+/**
+ * Binary layout: "PMEM", u32 version, u64 entry count and then per entry
+ * f64 timestamp, u64 frame, u64 size, u32 tag, u32 line, u16 file name
+ * length and the file name without terminator.
+ */
+static bool writeCaptureBinary(FileHandle* handle, const std::vector<memoryCaptureEntry>& entries)
+{
+    const u32 version = 1;
+    u64 count = entries.size();
+    bool result = filesystemWrite(handle, 4, "PMEM", nullptr);
+    result = result && filesystemWrite(handle, sizeof(u32), &version, nullptr);
+    result = result && filesystemWrite(handle, sizeof(u64), &count, nullptr);
+
+    for(u64 i = 0; i < count && result; ++i)
+    {
+        const memoryCaptureEntry& e = entries[i];
+        const char* file = e.file ? e.file : "";
+        u16 length = (u16)strlen(file);
+        result = filesystemWrite(handle, sizeof(f64), &e.timestamp, nullptr)
+            && filesystemWrite(handle, sizeof(u64), &e.frame, nullptr)
+            && filesystemWrite(handle, sizeof(u64), &e.size, nullptr)
+            && filesystemWrite(handle, sizeof(u32), &e.tag, nullptr)
+            && filesystemWrite(handle, sizeof(u32), &e.line, nullptr)
+            && filesystemWrite(handle, sizeof(u16), &length, nullptr)
+            && filesystemWrite(handle, length, file, nullptr);
+    }
+    return result;
+}
+
+bool memoryCaptureDump(const char* path, MemoryCaptureFormat format)
+{
+    if(!pState || !pState->captures) {
+        PWARN("memoryCaptureDump - memory system was configured without capture.");
+        return false;
+    }
+
+    // Copy the ring oldest first.
+    u64 capacity = pState->config.captureCapacity;
+    u64 end = pState->captureWriteIndex.load(std::memory_order_relaxed);
+    u64 begin = end > capacity ? end - capacity : 0;
+    std::vector<memoryCaptureEntry> entries;
+    entries.reserve(end - begin);
+    for(u64 i = begin; i < end; ++i)
+        entries.push_back(pState->captures[i % capacity]);
+
+    FileHandle handle;
+    bool binary = format == MEMORY_CAPTURE_FORMAT_BINARY;
+    if(!filesystemOpen(path, FILE_MODE_WRITE, binary, &handle)) {
+        PERROR("memoryCaptureDump - could not open '%s'.", path);
+        return false;
+    }
+
+    bool result = binary ? writeCaptureBinary(&handle, entries) : writeCaptureCsv(&handle, entries);
+    filesystemClose(&handle);
+    if(!result) {
+        PERROR("memoryCaptureDump - failed writing '%s'.", path);
+        return false;
+    }
+
+    PINFO("Memory capture with %llu allocations written to '%s'.", (u64)entries.size(), path);
+    return true;
+}
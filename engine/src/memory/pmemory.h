@@ -8,6 +8,7 @@ typedef enum memoryTag
     MEMORY_TAG_UNKNOWN,
     MEMORY_TAG_LINEAR_ALLOCATOR,
     MEMORY_TAG_STACK_ALLOCATOR,
+    MEMORY_TAG_POOL_ALLOCATOR,
     MEMORY_TAG_APPLICATION,
     MEMORY_TAG_JOB,
     MEMORY_TAG_TEXTURE,
@@ -24,15 +25,80 @@ typedef enum memoryTag
     MEMORY_TAG_MAX_TAGS
 } memoryTag;
 
+typedef enum MemoryAllocatorType
+{
+    // Every allocation goes straight to the platform allocator.
+    MEMORY_ALLOCATOR_SYSTEM,
+    // Small allocations come from segregated free lists per size class,
+    // big ones fall back to the platform allocator.
+    MEMORY_ALLOCATOR_POOLED
+} MemoryAllocatorType;
+
+typedef struct MemorySystemConfig
+{
+    MemoryAllocatorType allocatorType;
+    // Allocations kept by the capture ring buffer. 0 disables capture.
+    u32 captureCapacity;
+} MemorySystemConfig;
+
+/**
+ * Counters of a single memory tag. Read with memoryGetStats.
+ */
+typedef struct MemoryTagStats
+{
+    u64 allocated;      // Live bytes.
+    u64 peak;           // Highest value of allocated.
+    u64 liveCount;      // Live allocations.
+    u64 totalCount;     // Allocations since init.
+} MemoryTagStats;
+
+/**
+ * Counters of the whole memory system. Read with memoryGetTotalStats.
+ */
+typedef struct MemoryTotalStats
+{
+    u64 allocated;
+    u64 peak;
+    u64 liveCount;
+    u64 totalCount;
+    u64 poolReserved;   // Bytes requested to the platform for pool chunks.
+    u64 poolUsed;       // Bytes of pool blocks handed out, headers included.
+    u64 poolRequested;  // Bytes asked by callers served from pools.
+} MemoryTotalStats;
+
+/**
+ * Counters of the GPU memory. The renderer backend owns that memory and
+ * publishes them with memoryReportGpuStats. Read with memoryGetGpuStats.
+ */
+typedef struct MemoryGpuStats
+{
+    u64 blockCount;     // Device memory objects allocated.
+    u64 reserved;       // Bytes of those objects.
+    u64 used;           // Bytes handed out, alignment padding included.
+    u64 freeRanges;     // Free ranges inside the blocks, a measure of fragmentation.
+    u64 liveCount;      // Live allocations.
+    u64 totalCount;     // Allocations since init.
+    u64 mapCalls;       // vkMapMemory calls since init, host visible blocks are mapped once.
+} MemoryGpuStats;
+
+typedef enum MemoryCaptureFormat
+{
+    // Top allocating call sites per frame, one row per site.
+    MEMORY_CAPTURE_FORMAT_CSV,
+    // Every captured allocation as is.
+    MEMORY_CAPTURE_FORMAT_BINARY
+} MemoryCaptureFormat;
+
 /**
  * Initialize the memory system state given the memory requirements.
  * If state is nullptr, return the memory required, else initialize
  * the system.
  * @param u64* memoryRequirements
  * @param void* state
+ * @param MemorySystemConfig config
  * @return void
  */
-void memorySystemInit(u64* memoryRequirements, void* state);
+void memorySystemInit(u64* memoryRequirements, void* state, MemorySystemConfig config);
 
 /**
  * Shuts down the memory system state.
@@ -42,16 +108,22 @@ void memorySystemInit(u64* memoryRequirements, void* state);
 void memorySystemShutdown(void* state);
 
 /**
- * Allocates the size of memory of type tag.
+ * Allocates the size of memory of type tag. Use it through memAllocate
+ * so the call site is recorded when capture is enabled.
+ * Safe to call from any thread.
  * @param u64 size
  * @param memoryTag tag
+ * @param const char* file
+ * @param u32 line
  * @return void* block of memory allocated.
  */
-void* memAllocate(u64 size, memoryTag tag);
+void* memAllocateAt(u64 size, memoryTag tag, const char* file, u32 line);
+
+#define memAllocate(size, tag) memAllocateAt(size, tag, __FILE__, __LINE__)
 
 /**
- * Calls the platform to free a memory block. Size and tag is only
- * for stats purposes.
+ * Returns a memory block to its pool or to the platform. Stats use
+ * the size and tag recorded when the block was allocated.
  * @param void* block
  * @param u64 size
  * @param memoryTag tag
@@ -85,10 +157,56 @@ void* memSet(void* block, i32 value, u64 size);
 void* memCopy(void* source, void* dest, u64 size);
 
 /**
- * Gets the memory usage information of the application
- * and returns it in a string.
- * @param void
- * @return string
+ * Returns a snapshot of the counters of the given tag.
+ * @param memoryTag tag
+ * @return MemoryTagStats
+ */
+MemoryTagStats memoryGetStats(memoryTag tag);
+
+/**
+ * Returns a snapshot of the counters of all tags added together
+ * and of the pools backing small allocations.
+ * @return MemoryTotalStats
+ */
+MemoryTotalStats memoryGetTotalStats();
+
+const char* memoryGetTagName(memoryTag tag);
+
+/**
+ * Replaces the GPU counters. Called by the renderer backend whenever
+ * its device memory changes.
+ * @param const MemoryGpuStats& stats
+ */
+void memoryReportGpuStats(const MemoryGpuStats& stats);
+
+/**
+ * Returns the GPU counters last reported by the renderer backend.
+ * @return MemoryGpuStats
+ */
+MemoryGpuStats memoryGetGpuStats();
+
+/**
+ * Formats all the stats in a human readable string.
+ * Meant for logs, tools should use memoryGetStats instead.
  */
 std::string getMemoryUsageStr();
 
+/**
+ * Marks the beginning of a new frame for the captured allocations.
+ */
+void memorySystemBeginFrame();
+
+/**
+ * Starts or stops recording allocations in the capture ring buffer.
+ * Does nothing if the system was configured without capture.
+ * @param bool enabled
+ */
+void memoryCaptureSetEnabled(bool enabled);
+
+/**
+ * Writes the allocations still in the capture ring buffer to a file.
+ * @param const char* path
+ * @param MemoryCaptureFormat format
+ * @return bool false if there is no capture or the file can not be written.
+ */
+bool memoryCaptureDump(const char* path, MemoryCaptureFormat format);
@@ -0,0 +1,161 @@
+#include "poolAllocator.h"
+
+#include "pmemory.h"
+#include "core/logger.h"
+#include "core/assert.h"
+
+// Free blocks hold a pointer to the next free block.
+struct PoolFreeBlock
+{
+    PoolFreeBlock* next;
+};
+
+static u64 poolBlockSize(u64 blockSize)
+{
+    if(blockSize < sizeof(PoolFreeBlock))
+        blockSize = sizeof(PoolFreeBlock);
+    return (blockSize + 7) & ~(u64)7;
+}
+
+u64 poolAllocatorMemoryRequirement(u64 blockSize, u32 blockCount)
+{
+    return poolBlockSize(blockSize) * blockCount;
+}
+
+/**
+ * Creates a pool allocator of blockCount blocks of blockSize.
+ * @param u64 blockSize
+ * @param u32 blockCount
+ * @param void* memory Optional. At least poolAllocatorMemoryRequirement bytes.
+ * @param PoolAllocator* outAllocator
+ */
+void poolAllocatorCreate(u64 blockSize, u32 blockCount, void* memory, PoolAllocator* outAllocator)
+{
+    if(!outAllocator)
+    {
+        PWARN("No allocator to be created.");
+        return;
+    }
+
+    if(!blockSize || !blockCount)
+    {
+        PERROR("poolAllocatorCreate - blockSize and blockCount must be non-zero values.");
+        return;
+    }
+
+    outAllocator->blockSize     = poolBlockSize(blockSize);
+    outAllocator->blockCount    = blockCount;
+    outAllocator->ownsMemory    = memory == 0;
+    if(memory)
+    {
+        outAllocator->memory = memory;
+    }
+    else
+    {
+        outAllocator->memory = memAllocate(outAllocator->blockSize * blockCount, MEMORY_TAG_POOL_ALLOCATOR);
+    }
+
+    poolAllocatorFreeAll(outAllocator);
+}
+
+/**
+ * Receives the pool allocator to destroy.
+ * @param PoolAllocator* allocator
+ */
+void poolAllocatorDestroy(PoolAllocator* allocator)
+{
+    if(allocator)
+    {
+        if(allocator->ownsMemory && allocator->memory)
+        {
+            memFree(allocator->memory, allocator->blockSize * allocator->blockCount, MEMORY_TAG_POOL_ALLOCATOR);
+        }
+        allocator->memory       = nullptr;
+        allocator->freeList     = nullptr;
+        allocator->ownsMemory   = false;
+        allocator->blockCount   = 0;
+        allocator->usedCount    = 0;
+    }
+    else
+        PWARN("Allocator to be destroyed is empty!");
+}
+
+/**
+ * Takes the first free block of the pool.
+ * @param PoolAllocator* allocator
+ * @return void* block or nullptr if the pool is full.
+ */
+void* poolAllocatorAllocate(PoolAllocator* allocator)
+{
+    if(!allocator)
+    {
+        PERROR("No allocator provided. No memory has been allocated.");
+        return 0;
+    }
+
+    PoolFreeBlock* block = static_cast<PoolFreeBlock*>(allocator->freeList);
+    if(!block)
+    {
+        PERROR("Pool allocator is full. All %u blocks are in use.", allocator->blockCount);
+        return 0;
+    }
+
+    allocator->freeList = block->next;
+    allocator->usedCount++;
+    return memZero(block, allocator->blockSize);
+}
+
+/**
+ * Returns the block to the pool.
+ * @param PoolAllocator* allocator
+ * @param void* block
+ */
+void poolAllocatorFree(PoolAllocator* allocator, void* block)
+{
+    if(!allocator || !block)
+        return;
+
+    u64 offset = (u64)((u8*)block - static_cast<u8*>(allocator->memory));
+    PASSERT_MSG(offset < allocator->blockSize * allocator->blockCount, "Block does not belong to this pool allocator.")
+    PASSERT_MSG(offset % allocator->blockSize == 0, "Block is not aligned to a pool block boundary.")
+    PASSERT_MSG(allocator->usedCount > 0, "Freeing a block from an empty pool allocator.")
+
+    PoolFreeBlock* freeBlock = static_cast<PoolFreeBlock*>(block);
+    freeBlock->next = static_cast<PoolFreeBlock*>(allocator->freeList);
+    allocator->freeList = freeBlock;
+    allocator->usedCount--;
+}
+
+u32 poolAllocatorIndexOf(PoolAllocator* allocator, void* block)
+{
+    u64 offset = (u64)((u8*)block - static_cast<u8*>(allocator->memory));
+    PASSERT_MSG(offset < allocator->blockSize * allocator->blockCount, "Block does not belong to this pool allocator.")
+    return (u32)(offset / allocator->blockSize);
+}
+
+void* poolAllocatorBlockAt(PoolAllocator* allocator, u32 index)
+{
+    PASSERT_MSG(index < allocator->blockCount, "Pool allocator index out of range.")
+    return static_cast<u8*>(allocator->memory) + allocator->blockSize * index;
+}
+
+/**
+ * Links all blocks in the free list. Lower blocks are handed out first.
+ * @param PoolAllocator* allocator
+ */
+void poolAllocatorFreeAll(PoolAllocator* allocator)
+{
+    if(!allocator || !allocator->memory)
+        return;
+
+    u8* memory = static_cast<u8*>(allocator->memory);
+    PoolFreeBlock* next = nullptr;
+    for(u32 i = allocator->blockCount; i > 0; --i)
+    {
+        PoolFreeBlock* block = (PoolFreeBlock*)(memory + allocator->blockSize * (i - 1));
+        block->next = next;
+        next = block;
+    }
+    allocator->freeList     = next;
+    allocator->usedCount    = 0;
+}
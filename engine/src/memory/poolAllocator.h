@@ -0,0 +1,51 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * Pool allocator functions.
+ * Splits its memory in blocks of the same size. Free blocks are
+ * linked through their first bytes so allocating and freeing are
+ * O(1) and no extra bookkeeping memory is needed. Blocks keep a
+ * stable index, so the pool can back a slot table.
+ */
+
+typedef struct PoolAllocator
+{
+    u64 blockSize;
+    u32 blockCount;
+    u32 usedCount;
+    void* freeList;
+    void* memory;
+    bool ownsMemory;
+} PoolAllocator;
+
+/**
+ * Returns the bytes needed to hold blockCount blocks of blockSize.
+ * Blocks are rounded up to hold at least a pointer, 8 bytes aligned.
+ */
+u64 poolAllocatorMemoryRequirement(u64 blockSize, u32 blockCount);
+
+/**
+ * Creates the pool allocator. If memory is nullptr the allocator
+ * asks memAllocate for it under MEMORY_TAG_POOL_ALLOCATOR.
+ */
+void poolAllocatorCreate(u64 blockSize, u32 blockCount, void* memory, PoolAllocator* outAllocator);
+
+void poolAllocatorDestroy(PoolAllocator* allocator);
+
+void* poolAllocatorAllocate(PoolAllocator* allocator);
+
+void poolAllocatorFree(PoolAllocator* allocator, void* block);
+
+/**
+ * Returns the index of the block inside the pool.
+ */
+u32 poolAllocatorIndexOf(PoolAllocator* allocator, void* block);
+
+void* poolAllocatorBlockAt(PoolAllocator* allocator, u32 index);
+
+/**
+ * Puts all blocks back in the free list.
+ */
+void poolAllocatorFreeAll(PoolAllocator* allocator);
@@ -0,0 +1,170 @@
+#include "stackAllocator.h"
+
+#include "pmemory.h"
+#include "core/logger.h"
+#include "core/assert.h"
+
+// Stored right before every block.
+struct StackBlockHeader
+{
+    u64 previousTop;
+    u64 previousBlock;
+};
+
+/**
+ * Creates a stack allocator given the total size and an optional
+ * block of memory to work with.
+ * @param u64 size
+ * @param void* memory
+ * @param StackAllocator* outAllocator
+ */
+void stackAllocatorCreate(u64 size, void* memory, StackAllocator* outAllocator)
+{
+    if(outAllocator)
+    {
+        outAllocator->totalSize     = size;
+        outAllocator->top           = 0;
+        outAllocator->lastBlock     = INVALID_ID;
+        outAllocator->blockCount    = 0;
+        outAllocator->ownsMemory    = memory == 0;
+        if(memory)
+        {
+            outAllocator->memory = memory;
+        }
+        else
+        {
+            outAllocator->memory = memAllocate(size, MEMORY_TAG_STACK_ALLOCATOR);
+        }
+    }
+    else
+        PWARN("No allocator to be created.");
+}
+
+/**
+ * Receives the stack allocator to destroy.
+ * @param StackAllocator* allocator
+ */
+void stackAllocatorDestroy(StackAllocator* allocator)
+{
+    if(allocator)
+    {
+        PASSERT_MSG(allocator->blockCount == 0, "Stack allocator destroyed with blocks still pushed.")
+        if(allocator->ownsMemory && allocator->memory)
+        {
+            memFree(allocator->memory, allocator->totalSize, MEMORY_TAG_STACK_ALLOCATOR);
+        }
+        allocator->memory       = nullptr;
+        allocator->ownsMemory   = false;
+        allocator->totalSize    = 0;
+        allocator->top          = 0;
+        allocator->lastBlock    = INVALID_ID;
+    }
+    else
+        PWARN("Allocator to be destroyed is empty!");
+}
+
+/**
+ * Pushes a new block of the given size on top of the stack.
+ * @param StackAllocator* allocator
+ * @param u64 size
+ * @param u64 alignment Must be a power of two.
+ * @return void* block or nullptr if there is not enough space.
+ */
+void* stackAllocatorPush(StackAllocator* allocator, u64 size, u64 alignment)
+{
+    if(!allocator)
+    {
+        PERROR("No allocator provided. No memory has been allocated.");
+        return 0;
+    }
+
+    PASSERT_MSG(alignment && (alignment & (alignment - 1)) == 0, "Alignment must be a power of two.")
+
+    u8* base = static_cast<u8*>(allocator->memory);
+    u64 start = (u64)(base + allocator->top) + sizeof(StackBlockHeader);
+    u64 aligned = (start + alignment - 1) & ~(alignment - 1);
+    u64 blockOffset = aligned - (u64)base;
+
+    if(blockOffset + size > allocator->totalSize)
+    {
+        PERROR("Not enough available space to push. Asked for %llu but only %llu is available.",
+            size, allocator->totalSize - allocator->top);
+        return 0;
+    }
+
+    StackBlockHeader* header = (StackBlockHeader*)(aligned - sizeof(StackBlockHeader));
+    header->previousTop     = allocator->top;
+    header->previousBlock   = allocator->lastBlock;
+
+    allocator->top          = blockOffset + size;
+    allocator->lastBlock    = blockOffset;
+    allocator->blockCount++;
+    return (void*)aligned;
+}
+
+/**
+ * Releases the last pushed block.
+ * @param StackAllocator* allocator
+ * @param void* block
+ */
+void stackAllocatorPop(StackAllocator* allocator, void* block)
+{
+    if(!allocator || !block)
+        return;
+
+    u64 blockOffset = (u64)((u8*)block - static_cast<u8*>(allocator->memory));
+    PASSERT_MSG(allocator->blockCount > 0, "Popping from an empty stack allocator.")
+    PASSERT_MSG(blockOffset == allocator->lastBlock, "Stack allocator blocks must be popped in LIFO order.")
+
+    StackBlockHeader* header = (StackBlockHeader*)((u8*)block - sizeof(StackBlockHeader));
+    allocator->top          = header->previousTop;
+    allocator->lastBlock    = header->previousBlock;
+    allocator->blockCount--;
+}
+
+/**
+ * Returns a marker to roll back to the current top of the stack.
+ * @param StackAllocator* allocator
+ * @return u64 marker
+ */
+u64 stackAllocatorGetMarker(StackAllocator* allocator)
+{
+    return allocator ? allocator->top : 0;
+}
+
+/**
+ * Pops every block pushed after the marker was taken.
+ * @param StackAllocator* allocator
+ * @param u64 marker
+ */
+void stackAllocatorFreeToMarker(StackAllocator* allocator, u64 marker)
+{
+    if(!allocator)
+        return;
+
+    PASSERT_MSG(marker <= allocator->top, "Marker is above the top of the stack allocator.")
+
+    // Walk down the blocks so the LIFO chain stays consistent.
+    while(allocator->lastBlock != INVALID_ID && allocator->lastBlock > marker)
+    {
+        StackBlockHeader* header = (StackBlockHeader*)(static_cast<u8*>(allocator->memory) + allocator->lastBlock - sizeof(StackBlockHeader));
+        PASSERT_MSG(header->previousTop >= marker, "Marker does not match a block boundary.")
+        allocator->top          = header->previousTop;
+        allocator->lastBlock    = header->previousBlock;
+        allocator->blockCount--;
+    }
+}
+
+/**
+ * Frees all blocks in the stack allocator.
+ * @param StackAllocator* allocator
+ */
+void stackAllocatorFreeAll(StackAllocator* allocator)
+{
+    if(allocator)
+    {
+        allocator->top          = 0;
+        allocator->lastBlock    = INVALID_ID;
+        allocator->blockCount   = 0;
+    }
+}
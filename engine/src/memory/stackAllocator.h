@@ -0,0 +1,43 @@
+#pragma once
+
+#include "defines.h"
+
+/**
+ * Stack allocator functions.
+ * Works like a linear allocator but blocks can be released in
+ * LIFO order, either one by one with stackAllocatorPop or all
+ * the blocks allocated after a marker at once.
+ * Each block keeps a small header to check the order on pop.
+ */
+
+typedef struct StackAllocator
+{
+    u64 totalSize;
+    u64 top;            // Offset of the first free byte.
+    u64 lastBlock;      // Offset of the last pushed block, INVALID_ID if none.
+    u32 blockCount;
+    void* memory;
+    bool ownsMemory;
+} StackAllocator;
+
+/**
+ * Creates the stack allocator. If memory is nullptr the allocator
+ * asks memAllocate for it under MEMORY_TAG_STACK_ALLOCATOR.
+ */
+void stackAllocatorCreate(u64 size, void* memory, StackAllocator* outAllocator);
+
+void stackAllocatorDestroy(StackAllocator* allocator);
+
+void* stackAllocatorPush(StackAllocator* allocator, u64 size, u64 alignment);
+
+/**
+ * Releases the block on top of the stack. Popping any other
+ * block asserts.
+ */
+void stackAllocatorPop(StackAllocator* allocator, void* block);
+
+u64 stackAllocatorGetMarker(StackAllocator* allocator);
+
+void stackAllocatorFreeToMarker(StackAllocator* allocator, u64 marker);
+
+void stackAllocatorFreeAll(StackAllocator* allocator);
@@ -100,4 +100,23 @@ bool filesystemReadLine(
         }
     }
     return false;
+}
+
+bool filesystemWrite(
+    FileHandle* handle,
+    u64 dataSize,
+    const void* data,
+    u64* outBytesWritten)
+{
+    if(handle && handle->isValid && data)
+    {
+        u64 written = fwrite(data, 1, dataSize, handle->handle);
+        if(outBytesWritten)
+            *outBytesWritten = written;
+        if(written != dataSize)
+            return false;
+        fflush(handle->handle);
+        return true;
+    }
+    return false;
 }
\ No newline at end of file
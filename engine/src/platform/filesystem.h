@@ -27,4 +27,8 @@ bool filesystemReadLine(
     u64* outLength, 
     void* outData);
 
-// TODO bool filesystemWrite();
\ No newline at end of file
+bool filesystemWrite(
+    FileHandle* handle,
+    u64 dataSize,
+    const void* data,
+    u64* outBytesWritten);
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "frustumCulling.h"
+
+#include "systems/jobSystem.h"
+#include "memory/frameAllocator.h"
+#include "memory/pmemory.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRUSTUM_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+// Draws per job when culling in parallel.
+#define FRUSTUM_CULLING_GRAIN 1024
+
+// Bounds of meshes without vertices never get culled.
+#define FRUSTUM_CULLING_INFINITE 3.0e38f
+
+void frustumFromMatrix(const glm::mat4& m, Frustum* outFrustum)
+{
+    // glm matrices are column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    glm::vec4* planes = outFrustum->planes;
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row3 + row2;
+    planes[5] = row3 - row2;
+
+    for(u32 i = 0; i < 6; ++i)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+void meshComputeBounds(Mesh* mesh, u32 vertexCount, const Vertex* vertices)
+{
+    if(!vertexCount || !vertices) {
+        mesh->boundsMin = glm::vec3(0);
+        mesh->boundsMax = glm::vec3(0);
+        mesh->boundingSphere = glm::vec4(0);
+        return;
+    }
+
+    glm::vec3 boundsMin = vertices[0].position;
+    glm::vec3 boundsMax = vertices[0].position;
+    for(u32 i = 1; i < vertexCount; ++i) {
+        boundsMin = glm::min(boundsMin, vertices[i].position);
+        boundsMax = glm::max(boundsMax, vertices[i].position);
+    }
+
+    // Centered in the box, the radius reaches the farthest vertex.
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    f32 radius2 = 0.0f;
+    for(u32 i = 0; i < vertexCount; ++i) {
+        glm::vec3 d = vertices[i].position - center;
+        radius2 = glm::max(radius2, glm::dot(d, d));
+    }
+
+    mesh->boundsMin = boundsMin;
+    mesh->boundsMax = boundsMax;
+    mesh->boundingSphere = glm::vec4(center, glm::sqrt(radius2));
+}
+
+/**
+ * World space sphere and box of four draws, one array per component.
+ */
+struct CullingGroup
+{
+    alignas(16) f32 sphereX[4];
+    alignas(16) f32 sphereY[4];
+    alignas(16) f32 sphereZ[4];
+    alignas(16) f32 sphereR[4];
+    alignas(16) f32 boxX[4];
+    alignas(16) f32 boxY[4];
+    alignas(16) f32 boxZ[4];
+    alignas(16) f32 extentX[4];
+    alignas(16) f32 extentY[4];
+    alignas(16) f32 extentZ[4];
+};
+
+static void setWorldBounds(CullingGroup* group, u32 lane, const RenderMeshData& draw)
+{
+    const Mesh* mesh = draw.mesh;
+    if(!mesh || mesh->boundingSphere.w <= 0.0f)
+    {
+        group->sphereX[lane] = group->sphereY[lane] = group->sphereZ[lane] = 0.0f;
+        group->boxX[lane] = group->boxY[lane] = group->boxZ[lane] = 0.0f;
+        group->sphereR[lane] = FRUSTUM_CULLING_INFINITE;
+        group->extentX[lane] = group->extentY[lane] = group->extentZ[lane] = FRUSTUM_CULLING_INFINITE;
+        return;
+    }
+
+    const glm::mat4& m = draw.model;
+
+    glm::vec3 sphere = glm::vec3(m * glm::vec4(glm::vec3(mesh->boundingSphere), 1.0f));
+    f32 scale2 = glm::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])),
+        glm::max(glm::dot(glm::vec3(m[1]), glm::vec3(m[1])), glm::dot(glm::vec3(m[2]), glm::vec3(m[2]))));
+    group->sphereX[lane] = sphere.x;
+    group->sphereY[lane] = sphere.y;
+    group->sphereZ[lane] = sphere.z;
+    group->sphereR[lane] = mesh->boundingSphere.w * glm::sqrt(scale2);
+
+    // The world box holding the rotated local box.
+    glm::vec3 localCenter = (mesh->boundsMin + mesh->boundsMax) * 0.5f;
+    glm::vec3 localExtent = (mesh->boundsMax - mesh->boundsMin) * 0.5f;
+    glm::vec3 center = glm::vec3(m * glm::vec4(localCenter, 1.0f));
+    glm::vec3 extent = glm::abs(glm::vec3(m[0])) * localExtent.x
+        + glm::abs(glm::vec3(m[1])) * localExtent.y
+        + glm::abs(glm::vec3(m[2])) * localExtent.z;
+    group->boxX[lane] = center.x;
+    group->boxY[lane] = center.y;
+    group->boxZ[lane] = center.z;
+    group->extentX[lane] = extent.x;
+    group->extentY[lane] = extent.y;
+    group->extentZ[lane] = extent.z;
+}
+
+/**
+ * Returns a bit per lane set if the object is inside or intersecting,
+ * one object at a time.
+ */
+static u32 testGroupScalar(const Frustum* frustum, const CullingGroup* group)
+{
+    u32 mask = 0;
+    for(u32 lane = 0; lane < 4; ++lane)
+    {
+        bool inside = true;
+        for(u32 p = 0; p < 6 && inside; ++p)
+        {
+            const glm::vec4& plane = frustum->planes[p];
+            f32 d = group->sphereX[lane] * plane.x + group->sphereY[lane] * plane.y + group->sphereZ[lane] * plane.z + plane.w;
+            inside = d >= -group->sphereR[lane];
+        }
+        for(u32 p = 0; p < 6 && inside; ++p)
+        {
+            const glm::vec4& plane = frustum->planes[p];
+            f32 d = group->boxX[lane] * plane.x + group->boxY[lane] * plane.y + group->boxZ[lane] * plane.z + plane.w;
+            f32 r = group->extentX[lane] * glm::abs(plane.x) + group->extentY[lane] * glm::abs(plane.y) + group->extentZ[lane] * glm::abs(plane.z);
+            inside = d >= -r;
+        }
+        if(inside)
+            mask |= 1u << lane;
+    }
+    return mask;
+}
+
+/**
+ * Returns a bit per lane set if the object is inside or intersecting.
+ */
+static u32 testGroup(const Frustum* frustum, const CullingGroup* group)
+{
+#ifdef FRUSTUM_CULLING_SSE
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 sx = _mm_load_ps(group->sphereX);
+    __m128 sy = _mm_load_ps(group->sphereY);
+    __m128 sz = _mm_load_ps(group->sphereZ);
+    __m128 negR = _mm_xor_ps(_mm_load_ps(group->sphereR), signMask);
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for(u32 p = 0; p < 6; ++p)
+    {
+        const glm::vec4& plane = frustum->planes[p];
+        __m128 d = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(sx, _mm_set1_ps(plane.x)), _mm_mul_ps(sy, _mm_set1_ps(plane.y))),
+            _mm_add_ps(_mm_mul_ps(sz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+    }
+    if(_mm_movemask_ps(inside) == 0)
+        return 0;
+
+    // Spheres are loose, boxes of the survivors give a tighter answer.
+    __m128 bx = _mm_load_ps(group->boxX);
+    __m128 by = _mm_load_ps(group->boxY);
+    __m128 bz = _mm_load_ps(group->boxZ);
+    __m128 ex = _mm_load_ps(group->extentX);
+    __m128 ey = _mm_load_ps(group->extentY);
+    __m128 ez = _mm_load_ps(group->extentZ);
+    for(u32 p = 0; p < 6; ++p)
+    {
+        const glm::vec4& plane = frustum->planes[p];
+        __m128 d = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(bx, _mm_set1_ps(plane.x)), _mm_mul_ps(by, _mm_set1_ps(plane.y))),
+            _mm_add_ps(_mm_mul_ps(bz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+        __m128 r = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(glm::abs(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(glm::abs(plane.y)))),
+            _mm_mul_ps(ez, _mm_set1_ps(glm::abs(plane.z))));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_xor_ps(r, signMask)));
+    }
+    return (u32)_mm_movemask_ps(inside);
+#else
+    return testGroupScalar(frustum, group);
+#endif
+}
+
+/**
+ * Culls the draws in [begin, end), visible indices are written from out.
+ */
+static u32 cullRange(const Frustum* frustum, const RenderMeshData* draws, u32 begin, u32 end, u32* out,
+    u32 (*test)(const Frustum*, const CullingGroup*) = testGroup)
+{
+    u32 visible = 0;
+    CullingGroup group;
+    for(u32 i = begin; i < end; i += 4)
+    {
+        u32 lanes = end - i < 4 ? end - i : 4;
+        for(u32 lane = 0; lane < lanes; ++lane)
+            setWorldBounds(&group, lane, draws[i + lane]);
+        for(u32 lane = lanes; lane < 4; ++lane)
+            setWorldBounds(&group, lane, draws[i]);
+
+        u32 mask = test(frustum, &group) & ((1u << lanes) - 1);
+        for(u32 lane = 0; lane < lanes; ++lane) {
+            if(mask & (1u << lane))
+                out[visible++] = i + lane;
+        }
+    }
+    return visible;
+}
+
+u32 frustumCullDraws(const Frustum* frustum, const RenderMeshData* draws, u32 count, u32* outVisible)
+{
+    if(count == 0)
+        return 0;
+
+    u32 nRanges = (count + FRUSTUM_CULLING_GRAIN - 1) / FRUSTUM_CULLING_GRAIN;
+    u32* rangeCounts = nRanges > 1 && jobSystemThreadCount() > 1 ? frameAlloc<u32>(nRanges) : nullptr;
+    if(!rangeCounts)
+        return cullRange(frustum, draws, 0, count, outVisible);
+
+    // Each range writes its visible indices at its own offset...
+    parallelFor(0, nRanges, 1, [frustum, draws, count, outVisible, rangeCounts](u32 rangeBegin, u32 rangeEnd) {
+        for(u32 r = rangeBegin; r < rangeEnd; ++r) {
+            u32 begin = r * FRUSTUM_CULLING_GRAIN;
+            u32 end = begin + FRUSTUM_CULLING_GRAIN < count ? begin + FRUSTUM_CULLING_GRAIN : count;
+            rangeCounts[r] = cullRange(frustum, draws, begin, end, outVisible + begin);
+        }
+    });
+
+    // ... and they are packed together afterwards.
+    u32 visible = 0;
+    for(u32 r = 0; r < nRanges; ++r) {
+        memmove(outVisible + visible, outVisible + r * FRUSTUM_CULLING_GRAIN, sizeof(u32) * rangeCounts[r]);
+        visible += rangeCounts[r];
+    }
+    return visible;
+}
+
+u32 frustumCullDrawsSerial(const Frustum* frustum, const RenderMeshData* draws, u32 count, u32* outVisible, bool simd)
+{
+    return cullRange(frustum, draws, 0, count, outVisible, simd ? testGroup : testGroupScalar);
+}
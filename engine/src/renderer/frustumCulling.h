@@ -0,0 +1,50 @@
+#pragma once
+
+#include "renderTypes.h"
+
+/**
+ * Frustum culling of draws.
+ * Planes are extracted from the view projection matrix of the camera.
+ * Mesh bounds are moved to world space with the model matrix and tested
+ * four objects at a time with SSE, first the bounding spheres and then
+ * the boxes of the ones that pass. Visible indices are written compacted
+ * and in the same order they were given, so sorted draws stay sorted.
+ */
+
+typedef struct Frustum
+{
+    glm::vec4 planes[6]; // Normalized, pointing inside. left, right, bottom, top, near, far.
+} Frustum;
+
+/**
+ * Extracts the frustum planes from a view projection matrix.
+ * @param const glm::mat4& viewProjection
+ * @param Frustum* outFrustum
+ */
+void frustumFromMatrix(const glm::mat4& viewProjection, Frustum* outFrustum);
+
+/**
+ * Computes the local AABB and bounding sphere of a mesh from its vertices.
+ * @param Mesh* mesh
+ * @param u32 vertexCount
+ * @param const Vertex* vertices
+ */
+void meshComputeBounds(Mesh* mesh, u32 vertexCount, const Vertex* vertices);
+
+/**
+ * Culls the draws against the frustum. Runs as a parallel for over the
+ * job system when there are enough draws.
+ * @param const Frustum* frustum
+ * @param const RenderMeshData* draws
+ * @param u32 count
+ * @param u32* outVisible Indices of the visible draws, count elements.
+ * @return u32 number of visible draws.
+ */
+u32 frustumCullDraws(const Frustum* frustum, const RenderMeshData* draws, u32 count, u32* outVisible);
+
+/**
+ * Same as frustumCullDraws on the calling thread only. Without simd the
+ * objects are tested one at a time, the reference for the SSE path.
+ * @param bool simd
+ */
+u32 frustumCullDrawsSerial(const Frustum* frustum, const RenderMeshData* draws, u32 count, u32* outVisible, bool simd);
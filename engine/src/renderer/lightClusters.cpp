@@ -0,0 +1,226 @@
+#include "lightClusters.h"
+
+#include "memory/frameAllocator.h"
+#include "memory/pmemory.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define LIGHT_CLUSTERS_SSE
+#include <emmintrin.h>
+#endif
+
+/**
+ * Range of clusters touched by a light, inclusive. Empty if x0 > x1.
+ */
+struct ClusterRange
+{
+    u16 x0, x1;
+    u16 y0, y1;
+    u16 z0, z1;
+};
+
+void lightClusterViewInit(const glm::mat4& view, const glm::mat4& projection, f32 zmin, f32 zmax, LightClusterView* outView)
+{
+    outView->view       = view;
+    outView->projX      = projection[0][0];
+    outView->projY      = projection[1][1];
+    outView->zmin       = zmin;
+    outView->zmax       = zmax;
+    outView->sliceScale = (f32)LIGHT_CLUSTER_Z / glm::log(zmax / zmin);
+    outView->sliceBias  = -outView->sliceScale * glm::log(zmin);
+}
+
+static u16 depthSlice(const LightClusterView& view, f32 depth)
+{
+    f32 slice = glm::log(depth) * view.sliceScale + view.sliceBias;
+    if(slice <= 0.0f)
+        return 0;
+    return slice >= (f32)(LIGHT_CLUSTER_Z - 1) ? LIGHT_CLUSTER_Z - 1 : (u16)slice;
+}
+
+/**
+ * Tile ranges of four lights. Depth goes along -z in view space. The
+ * NDC rectangle bounds the view space box of the sphere clipped to the
+ * near plane, each side divided by the depth that pushes it further out.
+ * Lanes out of the depth range get x0 > x1.
+ */
+static void tileRanges(const LightClusterView& view, const glm::vec4* spheres, u32 lanes, ClusterRange* out)
+{
+    alignas(16) f32 px[4] = {}, py[4] = {}, pz[4] = {}, pr[4] = {};
+    for(u32 lane = 0; lane < lanes; ++lane)
+    {
+        px[lane] = spheres[lane].x;
+        py[lane] = spheres[lane].y;
+        pz[lane] = spheres[lane].z;
+        pr[lane] = spheres[lane].w;
+    }
+
+    alignas(16) f32 depthMin[4], depthMax[4];
+    alignas(16) i32 tx0[4], tx1[4], ty0[4], ty1[4];
+    const glm::mat4& m = view.view;
+#ifdef LIGHT_CLUSTERS_SSE
+    __m128 x = _mm_load_ps(px);
+    __m128 y = _mm_load_ps(py);
+    __m128 z = _mm_load_ps(pz);
+    __m128 r = _mm_load_ps(pr);
+
+    __m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m[0][0])), _mm_mul_ps(y, _mm_set1_ps(m[1][0]))),
+        _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m[2][0])), _mm_set1_ps(m[3][0])));
+    __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m[0][1])), _mm_mul_ps(y, _mm_set1_ps(m[1][1]))),
+        _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m[2][1])), _mm_set1_ps(m[3][1])));
+    __m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m[0][2])), _mm_mul_ps(y, _mm_set1_ps(m[1][2]))),
+        _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(m[2][2])), _mm_set1_ps(m[3][2])));
+
+    __m128 depth = _mm_sub_ps(_mm_setzero_ps(), vz);
+    __m128 zmin = _mm_set1_ps(view.zmin);
+    __m128 dMin = _mm_max_ps(_mm_sub_ps(depth, r), zmin);
+    __m128 dMax = _mm_max_ps(_mm_add_ps(depth, r), zmin);
+    _mm_store_ps(depthMin, _mm_sub_ps(depth, r));
+    _mm_store_ps(depthMax, _mm_add_ps(depth, r));
+
+    // A side away from the center line reaches furthest at the smallest depth,
+    // one across it at the largest.
+    const __m128 zero = _mm_setzero_ps();
+    __m128 xMin = _mm_sub_ps(vx, r);
+    __m128 xMax = _mm_add_ps(vx, r);
+    __m128 yMin = _mm_sub_ps(vy, r);
+    __m128 yMax = _mm_add_ps(vy, r);
+    __m128 nearMask;
+    nearMask = _mm_cmplt_ps(xMin, zero);
+    __m128 ndcX0 = _mm_div_ps(xMin, _mm_or_ps(_mm_and_ps(nearMask, dMin), _mm_andnot_ps(nearMask, dMax)));
+    nearMask = _mm_cmpgt_ps(xMax, zero);
+    __m128 ndcX1 = _mm_div_ps(xMax, _mm_or_ps(_mm_and_ps(nearMask, dMin), _mm_andnot_ps(nearMask, dMax)));
+    nearMask = _mm_cmplt_ps(yMin, zero);
+    __m128 ndcY0 = _mm_div_ps(yMin, _mm_or_ps(_mm_and_ps(nearMask, dMin), _mm_andnot_ps(nearMask, dMax)));
+    nearMask = _mm_cmpgt_ps(yMax, zero);
+    __m128 ndcY1 = _mm_div_ps(yMax, _mm_or_ps(_mm_and_ps(nearMask, dMin), _mm_andnot_ps(nearMask, dMax)));
+
+    // The projection may flip y, so the ends are sorted after scaling.
+    ndcX0 = _mm_mul_ps(ndcX0, _mm_set1_ps(view.projX));
+    ndcX1 = _mm_mul_ps(ndcX1, _mm_set1_ps(view.projX));
+    __m128 a = _mm_mul_ps(ndcY0, _mm_set1_ps(view.projY));
+    __m128 b = _mm_mul_ps(ndcY1, _mm_set1_ps(view.projY));
+    ndcY0 = _mm_min_ps(a, b);
+    ndcY1 = _mm_max_ps(a, b);
+
+    // NDC to tiles, clamped to the grid before truncating.
+    const __m128 maxX = _mm_set1_ps((f32)(LIGHT_CLUSTER_X - 1));
+    const __m128 maxY = _mm_set1_ps((f32)(LIGHT_CLUSTER_Y - 1));
+    const __m128 scaleX = _mm_set1_ps(0.5f * LIGHT_CLUSTER_X);
+    const __m128 scaleY = _mm_set1_ps(0.5f * LIGHT_CLUSTER_Y);
+    _mm_store_si128((__m128i*)tx0, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(ndcX0, scaleX), scaleX), zero), maxX)));
+    _mm_store_si128((__m128i*)tx1, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(ndcX1, scaleX), scaleX), zero), maxX)));
+    _mm_store_si128((__m128i*)ty0, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(ndcY0, scaleY), scaleY), zero), maxY)));
+    _mm_store_si128((__m128i*)ty1, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(ndcY1, scaleY), scaleY), zero), maxY)));
+#else
+    for(u32 lane = 0; lane < 4; ++lane)
+    {
+        glm::vec3 v = glm::vec3(m * glm::vec4(px[lane], py[lane], pz[lane], 1.0f));
+        f32 r = pr[lane];
+        f32 depth = -v.z;
+        depthMin[lane] = depth - r;
+        depthMax[lane] = depth + r;
+        f32 dMin = glm::max(depth - r, view.zmin);
+        f32 dMax = glm::max(depth + r, view.zmin);
+
+        f32 x0 = view.projX * (v.x - r) / (v.x - r < 0.0f ? dMin : dMax);
+        f32 x1 = view.projX * (v.x + r) / (v.x + r > 0.0f ? dMin : dMax);
+        f32 a = view.projY * (v.y - r) / (v.y - r < 0.0f ? dMin : dMax);
+        f32 b = view.projY * (v.y + r) / (v.y + r > 0.0f ? dMin : dMax);
+        f32 y0 = glm::min(a, b);
+        f32 y1 = glm::max(a, b);
+
+        tx0[lane] = (i32)glm::clamp((x0 * 0.5f + 0.5f) * LIGHT_CLUSTER_X, 0.0f, (f32)(LIGHT_CLUSTER_X - 1));
+        tx1[lane] = (i32)glm::clamp((x1 * 0.5f + 0.5f) * LIGHT_CLUSTER_X, 0.0f, (f32)(LIGHT_CLUSTER_X - 1));
+        ty0[lane] = (i32)glm::clamp((y0 * 0.5f + 0.5f) * LIGHT_CLUSTER_Y, 0.0f, (f32)(LIGHT_CLUSTER_Y - 1));
+        ty1[lane] = (i32)glm::clamp((y1 * 0.5f + 0.5f) * LIGHT_CLUSTER_Y, 0.0f, (f32)(LIGHT_CLUSTER_Y - 1));
+    }
+#endif
+
+    for(u32 lane = 0; lane < lanes; ++lane)
+    {
+        ClusterRange& range = out[lane];
+        if(depthMax[lane] < view.zmin || depthMin[lane] > view.zmax || pr[lane] <= 0.0f)
+        {
+            range.x0 = 1;
+            range.x1 = 0;
+            continue;
+        }
+        range.x0 = (u16)tx0[lane];
+        range.x1 = (u16)tx1[lane];
+        range.y0 = (u16)ty0[lane];
+        range.y1 = (u16)ty1[lane];
+        range.z0 = depthSlice(view, glm::max(depthMin[lane], view.zmin));
+        range.z1 = depthSlice(view, glm::min(depthMax[lane], view.zmax));
+    }
+}
+
+u32 lightClustersBuild(const LightClusterView& view, const glm::vec4* spheres, u32 count,
+    u32* outCells, u32* outIndices, u32 maxIndices)
+{
+    memZero(outCells, sizeof(u32) * LIGHT_CLUSTER_COUNT * 2);
+    if(count == 0)
+        return 0;
+
+    ClusterRange* ranges = frameAlloc<ClusterRange>(count);
+    if(!ranges)
+    {
+        PERROR("lightClustersBuild - not enough frame memory for %u lights.", count);
+        return 0;
+    }
+    for(u32 i = 0; i < count; i += 4)
+        tileRanges(view, spheres + i, count - i < 4 ? count - i : 4, ranges + i);
+
+    // Count the lights of each cluster in the second word of its cell.
+    for(u32 i = 0; i < count; ++i)
+    {
+        const ClusterRange& range = ranges[i];
+        if(range.x0 > range.x1)
+            continue;
+        for(u32 z = range.z0; z <= range.z1; ++z)
+            for(u32 y = range.y0; y <= range.y1; ++y)
+            {
+                u32* cell = outCells + ((z * LIGHT_CLUSTER_Y + y) * LIGHT_CLUSTER_X + range.x0) * 2;
+                for(u32 x = range.x0; x <= range.x1; ++x, cell += 2)
+                    cell[1]++;
+            }
+    }
+
+    // Offsets, clusters past the capacity keep fewer lights.
+    u32 total = 0;
+    bool full = false;
+    for(u32 c = 0; c < LIGHT_CLUSTER_COUNT; ++c)
+    {
+        u32 wanted = outCells[c * 2 + 1];
+        u32 room = maxIndices - total;
+        full |= wanted > room;
+        outCells[c * 2] = total;
+        outCells[c * 2 + 1] = 0;
+        total += wanted < room ? wanted : room;
+    }
+    if(full)
+        PERROR("lightClustersBuild - more than %u light indices, some lights are dropped.", maxIndices);
+
+    // Lights are visited in order, so each list comes out ascending.
+    for(u32 i = 0; i < count; ++i)
+    {
+        const ClusterRange& range = ranges[i];
+        if(range.x0 > range.x1)
+            continue;
+        for(u32 z = range.z0; z <= range.z1; ++z)
+            for(u32 y = range.y0; y <= range.y1; ++y)
+            {
+                u32 c = (z * LIGHT_CLUSTER_Y + y) * LIGHT_CLUSTER_X + range.x0;
+                for(u32 x = range.x0; x <= range.x1; ++x, ++c)
+                {
+                    u32 end = c + 1 < LIGHT_CLUSTER_COUNT ? outCells[(c + 1) * 2] : total;
+                    u32 slot = outCells[c * 2] + outCells[c * 2 + 1];
+                    if(slot < end)
+                    {
+                        outIndices[slot] = i;
+                        outCells[c * 2 + 1]++;
+                    }
+                }
+            }
+    }
+    return total;
+}
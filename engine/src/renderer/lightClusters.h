@@ -0,0 +1,55 @@
+#pragma once
+
+#include "renderTypes.h"
+
+/**
+ * Clustered light culling.
+ * The view frustum is split in a grid of froxels, tiles in normalized
+ * device coordinates and slices along the view depth, logarithmic so near
+ * clusters are thin. Each light is bounded by a sphere, its range of
+ * clusters is found four lights at a time with SSE and its index is
+ * appended to the list of every cluster in the range. The lighting pass
+ * finds the cluster of a pixel the same way and only evaluates its lights.
+ */
+
+#define LIGHT_CLUSTER_X         16
+#define LIGHT_CLUSTER_Y         9
+#define LIGHT_CLUSTER_Z         24
+#define LIGHT_CLUSTER_COUNT     (LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z)
+
+// Light indices of all the clusters together, the rest are dropped.
+#define LIGHT_CLUSTER_MAX_INDICES (128 * 1024)
+
+typedef struct LightClusterView
+{
+    glm::mat4 view;
+    f32 projX;          // projection[0][0], view x over depth to NDC.
+    f32 projY;          // projection[1][1]
+    f32 zmin;
+    f32 zmax;
+    f32 sliceScale;     // slice = log(depth) * sliceScale + sliceBias
+    f32 sliceBias;
+} LightClusterView;
+
+/**
+ * Grid of a perspective camera.
+ * @param const glm::mat4& view
+ * @param const glm::mat4& projection
+ * @param f32 zmin
+ * @param f32 zmax
+ * @param LightClusterView* outView
+ */
+void lightClusterViewInit(const glm::mat4& view, const glm::mat4& projection, f32 zmin, f32 zmax, LightClusterView* outView);
+
+/**
+ * Builds the light lists of every cluster.
+ * @param const LightClusterView& view
+ * @param const glm::vec4* spheres World space center and radius of each light.
+ * @param u32 count
+ * @param u32* outCells Offset and count in outIndices of each cluster, LIGHT_CLUSTER_COUNT * 2 elements.
+ * @param u32* outIndices Light indices, ascending inside each cluster.
+ * @param u32 maxIndices Capacity of outIndices.
+ * @return u32 number of indices written.
+ */
+u32 lightClustersBuild(const LightClusterView& view, const glm::vec4* spheres, u32 count,
+    u32* outCells, u32* outIndices, u32 maxIndices);
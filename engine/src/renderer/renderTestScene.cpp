@@ -0,0 +1,274 @@
+#include "renderTestScene.h"
+
+#include "systems/meshSystem.h"
+#include "systems/materialSystem.h"
+#include "systems/entity/entity.h"
+#include "systems/components/comp_transform.h"
+#include "systems/components/comp_render.h"
+#include "systems/components/comp_light_point.h"
+#include "core/pstring.h"
+#include "memory/pmemory.h"
+#include "platform/platform.h"
+#include "rendererFrontend.h"
+
+#include <vector>
+
+// Distance between the centers of two cubes of the grid.
+#define RENDER_TEST_SCENE_SPACING 3.0f
+
+// Side of the loaded textures, in pixels.
+#define RENDER_TEST_SCENE_TEXTURE_SIZE 256
+
+static std::vector<CHandle> entities;
+static u32 cubeCount = 0;
+static u32 seed = 1;
+static std::vector<Material*> materials;
+static Mesh* cube = nullptr;
+static std::vector<Mesh*> loadedMeshes;
+static std::vector<Texture*> loadedTextures;
+static RenderTestSceneLoadStats loadStats = {};
+
+static bool createResources(u32 materialCount)
+{
+    if(!cube)
+        cube = meshSystemGetCube();
+    if(!cube)
+    {
+        PERROR("renderTestSceneSpawnCubes - could not create the cube mesh.");
+        return false;
+    }
+
+    // The materials of earlier spawns are kept until the scene is cleared.
+    while(materials.size() < materialCount)
+    {
+        u32 index = (u32)materials.size();
+        MaterialData data = {};
+        stringFormat(data.name, "TestScene%u", index);
+        data.type = MATERIAL_TYPE_FORWARD;
+        data.diffuseColor = glm::vec4((index * 37 % 255) / 255.0f, (index * 91 % 255) / 255.0f, (index * 53 % 255) / 255.0f, 1.0f);
+        Material* m = materialSystemCreateFromData(data);
+        if(!m)
+            return false;
+        materials.push_back(m);
+    }
+    return true;
+}
+
+void renderTestSceneSpawnCubes(u32 count, u32 materialCount)
+{
+    if(materialCount == 0)
+        materialCount = 1;
+    if(!createResources(materialCount))
+        return;
+
+    u32 first = cubeCount;
+    cubeCount += count;
+    u32 side = (u32)glm::ceil(glm::sqrt((f32)cubeCount));
+    f32 offset = (side - 1) * RENDER_TEST_SCENE_SPACING * 0.5f;
+    for(u32 i = first; i < cubeCount; ++i)
+    {
+        CHandle hEntity = getObjectManager<CEntity>()->createHandle();
+        CHandle hTransform = getObjectManager<TCompTransform>()->createHandle();
+        CHandle hRender = getObjectManager<TCompRender>()->createHandle();
+        if(!hEntity.isValid() || !hTransform.isValid() || !hRender.isValid())
+        {
+            // A manager is full, the scene keeps the cubes made so far.
+            hEntity.destroy();
+            hTransform.destroy();
+            hRender.destroy();
+            cubeCount = i;
+            break;
+        }
+
+        CEntity* e = hEntity;
+        e->set(hTransform);
+        TCompTransform* cTransform = hTransform;
+        cTransform->setPosition(glm::vec3(
+            (i % side) * RENDER_TEST_SCENE_SPACING - offset,
+            0.0f,
+            (i / side) * RENDER_TEST_SCENE_SPACING - offset));
+
+        e->set(hRender);
+        TCompRender* cRender = hRender;
+        TCompRender::TDrawCall dc;
+        dc.mesh         = cube;
+        dc.material     = materials[i % materialCount];
+        dc.meshGroup    = 0;
+        cRender->drawCalls.push_back(dc);
+
+        e->onEntityCreated();
+        entities.push_back(hEntity);
+    }
+    PINFO("Test scene: %u cubes with %u materials.", cubeCount, materialCount);
+}
+
+void renderTestSceneSpawnLights(u32 count)
+{
+    auto random = []() {
+        seed = seed * 1664525u + 1013904223u;
+        return (f32)(seed >> 8) / (f32)(1u << 24);
+    };
+
+    // Over the grid of cubes, or the area 10k of them would take.
+    f32 size = glm::sqrt((f32)(cubeCount > 0 ? cubeCount : 10000)) * RENDER_TEST_SCENE_SPACING;
+    for(u32 i = 0; i < count; ++i)
+    {
+        CHandle hEntity = getObjectManager<CEntity>()->createHandle();
+        CHandle hTransform = getObjectManager<TCompTransform>()->createHandle();
+        CHandle hLight = getObjectManager<TCompLightPoint>()->createHandle();
+        if(!hEntity.isValid() || !hTransform.isValid() || !hLight.isValid())
+        {
+            hEntity.destroy();
+            hTransform.destroy();
+            hLight.destroy();
+            count = i;
+            break;
+        }
+
+        CEntity* e = hEntity;
+        e->set(hTransform);
+        TCompTransform* cTransform = hTransform;
+        cTransform->setPosition(glm::vec3((random() - 0.5f) * size, 1.0f + random() * 4.0f, (random() - 0.5f) * size));
+
+        e->set(hLight);
+        TCompLightPoint* cLight = hLight;
+        cLight->color       = glm::vec4(random(), random(), random(), 1.0f);
+        cLight->radius      = 4.0f + random() * 8.0f;
+        cLight->intensity   = 1.0f;
+        cLight->enabled     = true;
+
+        e->onEntityCreated();
+        entities.push_back(hEntity);
+    }
+    PINFO("Test scene: %u point lights added.", count);
+}
+
+/**
+ * Grid of side x side quads on the XZ plane, one unit wide.
+ */
+static u64 createGridMesh(u32 side)
+{
+    MeshData data = {};
+    data.vertexCount    = (side + 1) * (side + 1);
+    data.indexCount     = side * side * 6;
+    data.vertexSize     = sizeof(Vertex);
+    data.indexSize      = sizeof(u32);
+    data.vertices       = (Vertex*)memAllocate(sizeof(Vertex) * data.vertexCount, MEMORY_TAG_RENDERER);
+    data.indices        = (u32*)memAllocate(sizeof(u32) * data.indexCount, MEMORY_TAG_RENDERER);
+
+    for(u32 z = 0; z <= side; ++z)
+    {
+        for(u32 x = 0; x <= side; ++x)
+        {
+            Vertex& v   = data.vertices[z * (side + 1) + x];
+            v.uv        = glm::vec2((f32)x / side, (f32)z / side);
+            v.position  = glm::vec3(v.uv.x - 0.5f, 0.0f, v.uv.y - 0.5f);
+            v.color     = glm::vec4(1.0f);
+            v.normal    = glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+    u32* index = data.indices;
+    for(u32 z = 0; z < side; ++z)
+    {
+        for(u32 x = 0; x < side; ++x)
+        {
+            u32 corner = z * (side + 1) + x;
+            *index++ = corner;
+            *index++ = corner + side + 1;
+            *index++ = corner + 1;
+            *index++ = corner + 1;
+            *index++ = corner + side + 1;
+            *index++ = corner + side + 2;
+        }
+    }
+
+    Mesh* mesh = meshSystemCreateFromData(&data);
+    if(mesh)
+        loadedMeshes.push_back(mesh);
+
+    u64 bytes = sizeof(Vertex) * data.vertexCount + sizeof(u32) * data.indexCount;
+    memFree(data.vertices, sizeof(Vertex) * data.vertexCount, MEMORY_TAG_RENDERER);
+    memFree(data.indices, sizeof(u32) * data.indexCount, MEMORY_TAG_RENDERER);
+    return mesh ? bytes : 0;
+}
+
+void renderTestSceneLoad(u32 meshCount, u32 textureCount)
+{
+    loadStats = {};
+    loadStats.meshes    = meshCount;
+    loadStats.textures  = textureCount;
+
+    f64 start = platformGetCurrentTime();
+    for(u32 i = 0; i < meshCount; ++i)
+        loadStats.bytes += createGridMesh(8 + i % 57);
+    f64 meshesEnd = platformGetCurrentTime();
+
+    const u32 size = RENDER_TEST_SCENE_TEXTURE_SIZE;
+    u32* pixels = (u32*)memAllocate(sizeof(u32) * size * size, MEMORY_TAG_TEXTURE);
+    for(u32 i = 0; i < textureCount; ++i)
+    {
+        // Different content per texture, so nothing can be shared.
+        for(u32 p = 0; p < size * size; ++p)
+            pixels[p] = 0xff000000 | ((p * 2654435761u + i * 40503u) & 0x00ffffff);
+
+        Texture* t = (Texture*)memAllocate(sizeof(Texture), MEMORY_TAG_TEXTURE);
+        memZero(t, sizeof(Texture));
+        stringFormat(t->name, "TestScene%u", i);
+        t->width        = size;
+        t->height       = size;
+        t->channels     = 4;
+        t->id           = INVALID_ID;
+        t->generation   = INVALID_ID;
+        if(!renderCreateTexture(pixels, t)) {
+            memFree(t, sizeof(Texture), MEMORY_TAG_TEXTURE);
+            continue;
+        }
+        loadedTextures.push_back(t);
+        loadStats.bytes += sizeof(u32) * size * size;
+    }
+    memFree(pixels, sizeof(u32) * size * size, MEMORY_TAG_TEXTURE);
+    f64 texturesEnd = platformGetCurrentTime();
+
+    renderWaitUploads();
+    f64 end = platformGetCurrentTime();
+
+    loadStats.meshMs    = (f32)((meshesEnd - start) * 1000.0);
+    loadStats.textureMs = (f32)((texturesEnd - meshesEnd) * 1000.0);
+    loadStats.uploadMs  = (f32)((end - texturesEnd) * 1000.0);
+    PINFO("Test scene: %u meshes in %.3f ms, %u textures in %.3f ms, %.1f MB on the GPU %.3f ms later.",
+        meshCount, loadStats.meshMs, textureCount, loadStats.textureMs,
+        loadStats.bytes / (1024.0 * 1024.0), loadStats.uploadMs);
+}
+
+RenderTestSceneLoadStats renderTestSceneGetLoadStats()
+{
+    return loadStats;
+}
+
+void renderTestSceneClear()
+{
+    // Nothing may draw the resources below once they are destroyed.
+    for(CHandle h : entities)
+        h.destroy();
+    CHandleManager::destroyAllPendingObjects();
+    entities.clear();
+    cubeCount = 0;
+
+    for(Material* m : materials)
+        materialSystemDestroy(m);
+    materials.clear();
+    for(Mesh* mesh : loadedMeshes)
+        meshSystemDestroy(mesh);
+    loadedMeshes.clear();
+    for(Texture* t : loadedTextures)
+    {
+        renderDestroyTexture(t);
+        memFree(t, sizeof(Texture), MEMORY_TAG_TEXTURE);
+    }
+    loadedTextures.clear();
+}
+
+u32 renderTestSceneEntityCount()
+{
+    return (u32)entities.size();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "renderTypes.h"
+
+/**
+ * Stress scenes for the render stats readouts.
+ * Spawns grids of cube entities, with a transform and a render component,
+ * and point lights over them, so draw calls and CPU times can be read at
+ * a known object count. The cube mesh and the materials are created once
+ * and reused by every spawn. Batches of meshes and textures can be loaded
+ * too, to time loading.
+ */
+
+/**
+ * Adds count cubes on a grid centered at the origin, the materials
+ * given round robin.
+ * @param u32 count
+ * @param u32 materialCount Different materials, at least 1.
+ */
+void renderTestSceneSpawnCubes(u32 count, u32 materialCount);
+
+/**
+ * Adds count point lights at random over the area of the cubes.
+ * @param u32 count
+ */
+void renderTestSceneSpawnLights(u32 count);
+
+/**
+ * Creates meshCount grid meshes of 81 to 4225 vertices and textureCount
+ * 256x256 textures, then waits for their uploads. The times are logged
+ * and kept for renderTestSceneGetLoadStats.
+ * @param u32 meshCount
+ * @param u32 textureCount
+ */
+void renderTestSceneLoad(u32 meshCount, u32 textureCount);
+
+typedef struct RenderTestSceneLoadStats
+{
+    u32 meshes;
+    u32 textures;
+    u64 bytes;              // Vertices, indices and pixels uploaded.
+    f32 meshMs;             // Creating the meshes, their data is staged.
+    f32 textureMs;          // Creating the textures, their pixels are staged.
+    f32 uploadMs;           // Waiting for the uploads once everything was created.
+} RenderTestSceneLoadStats;
+
+/**
+ * Numbers of the last renderTestSceneLoad.
+ * @return RenderTestSceneLoadStats
+ */
+RenderTestSceneLoadStats renderTestSceneGetLoadStats();
+
+/**
+ * Destroys every entity spawned and every resource loaded by the test scene.
+ */
+void renderTestSceneClear();
+
+/**
+ * Entities spawned by the test scene and not cleared yet.
+ * @return u32
+ */
+u32 renderTestSceneEntityCount();
@@ -9,6 +9,36 @@ typedef enum DefaultRenderPasses
     RENDER_PASS_DEFERRED
 } DefaultRenderPasses;
 
+/**
+ * Targets written by the geometry pass of the deferred renderer.
+ */
+typedef enum RenderGbufferLayout
+{
+    RENDER_GBUFFER_CLASSIC,     // Position RGBA16F, normal RGBA32F and albedo RGBA8.
+    RENDER_GBUFFER_COMPACT      // Octahedral normal RG16, albedo RGBA8 and metallic roughness RG8, position from depth.
+} RenderGbufferLayout;
+
+/**
+ * How finished frames are shown. Fifo waits for vertical blank and is
+ * always there, the others fall back to it when not supported.
+ */
+typedef enum RenderPresentMode
+{
+    RENDER_PRESENT_FIFO,        // Vsync, the CPU blocks when the queue of images is full.
+    RENDER_PRESENT_MAILBOX,     // Vsync, newer frames replace the queued one.
+    RENDER_PRESENT_IMMEDIATE    // No vsync, may tear.
+} RenderPresentMode;
+
+/**
+ * Renderer options fixed at init.
+ */
+typedef struct RenderSystemConfig
+{
+    RenderGbufferLayout gbufferLayout;
+    RenderPresentMode presentMode;
+    u32 framesInFlight;         // Frames recorded while the GPU works on the previous ones, 2 or 3.
+} RenderSystemConfig;
+
 typedef struct RenderMeshData
 {
     glm::mat4 model;
@@ -16,6 +46,85 @@ typedef struct RenderMeshData
     Material* material;
 } RenderMeshData;
 
+/**
+ * Run of draws in a draw list sharing mesh and material, drawn as a
+ * single instanced draw.
+ */
+typedef struct RenderBatch
+{
+    u32 first;
+    u32 count;
+} RenderBatch;
+
+/**
+ * Draws are sorted by a packed 64-bit key so the ones sharing state
+ * are submitted together. From the most significant bit:
+ *  pass (2) | translucent (1) | pipeline (5) | material (16) | mesh (16) | depth (24)
+ * Opaque keys are built once by the render manager with depth 0, so
+ * opaque draws are only ordered by state and the ones sharing mesh and
+ * material stay together for instancing. Translucent ones must go back
+ * to front, so they are encoded again every frame with their inverted
+ * depth in the bits right after the translucent flag, the state fields
+ * moving down.
+ */
+#define RENDER_KEY_DEPTH_BITS       24
+#define RENDER_KEY_MESH_BITS        16
+#define RENDER_KEY_MATERIAL_BITS    16
+#define RENDER_KEY_PIPELINE_BITS    5
+#define RENDER_KEY_MAX_DEPTH        ((1u << RENDER_KEY_DEPTH_BITS) - 1)
+
+inline u64
+renderKeyEncode(u32 pass, bool translucent, u32 pipeline, u32 material, u32 mesh, u32 depth)
+{
+    u64 state = ((u64)(pipeline & ((1u << RENDER_KEY_PIPELINE_BITS) - 1)) << (RENDER_KEY_MATERIAL_BITS + RENDER_KEY_MESH_BITS))
+        | ((u64)(material & ((1u << RENDER_KEY_MATERIAL_BITS) - 1)) << RENDER_KEY_MESH_BITS)
+        | (u64)(mesh & ((1u << RENDER_KEY_MESH_BITS) - 1));
+    u64 depthBits = depth & RENDER_KEY_MAX_DEPTH;
+
+    u64 key = ((u64)(pass & 3) << 62) | ((u64)(translucent ? 1 : 0) << 61);
+    if(translucent)
+        key |= ((RENDER_KEY_MAX_DEPTH - depthBits) << 37) | state;
+    else
+        key |= (state << RENDER_KEY_DEPTH_BITS) | depthBits;
+    return key;
+}
+
+inline bool
+materialIsTranslucent(const Material* m)
+{
+    return m->diffuseColor.a < 1.0f
+        || (m->diffuseTexture && m->diffuseTexture->hasTransparency);
+}
+
+/**
+ * Bind and draw counters of the last frame.
+ */
+typedef struct RenderStats
+{
+    u32 drawCalls;
+    u32 instances;          // Meshes drawn, more than drawCalls when instanced.
+    u32 pipelineBinds;
+    u32 descriptorBinds;
+    u32 vertexBufferBinds;
+    u32 culledDraws;        // Filled by the frontend.
+    f32 cpuGeometryMs;      // Filled by the frontend. Culling, batching and recording the geometry pass.
+    u32 gpuDriven;          // Filled by the frontend. 1 when the geometry pass was culled on the GPU.
+    u32 lights;             // Packed in the light buffer.
+    f32 lightUploadMs;      // CPU time packing the lights in the uniform ring.
+    u32 mapCalls;           // vkMapMemory calls of the backend, ImGui maps its own buffers.
+    u32 lightIndices;       // In the cluster light lists.
+    f32 lightClusterMs;     // CPU time building the cluster light lists.
+    f32 cpuFrameMs;         // Between two frame begins.
+    f32 cpuWaitMs;          // Blocked on the frame fence and the swapchain image.
+    f32 uploadWaitMs;       // Blocked on the uploads of meshes and textures drawn for the first time.
+    f32 cpuSubmitMs;        // Recording the draw list and submitting the command buffers.
+    f32 cpuRecordMs;        // Recording the draw list, waiting for the recording threads included.
+    u32 recordBuffers;      // Secondary command buffers the draw list was recorded in.
+    f32 gpuGeometryMs;      // Geometry pass, frames in flight behind. Zero in the forward path.
+    f32 gpuLightMs;         // Deferred light or forward pass, frames in flight behind.
+    u32 presentMode;        // RenderPresentMode of the swapchain, fifo when the requested one is not supported.
+} RenderStats;
+
 struct LightData
 {
     glm::vec3 position;
@@ -13,17 +13,28 @@ bool rendererBackendInit(RenderBackendAPI api, RendererBackend* state)
         state->beginCommandBuffer = vulkanBeginCommandBuffer;
         state->beginRenderPass = vulkanBeginRenderPass;
         state->drawGeometry = vulkanDrawGeometry;
+        state->drawBatches = vulkanDrawBatches;
+        state->gpuCullingSupported = vulkanGpuCullingSupported;
+        state->setObjects = vulkanSetObjects;
+        state->setObjectModels = vulkanSetObjectModels;
+        state->cullObjects = vulkanCullObjects;
+        state->drawObjects = vulkanDrawObjects;
         state->endRenderPass = vulkanEndRenderPass;
         state->submitCommands = vulkanSubmitCommands;
         state->endFrame = vulkanEndFrame;
         state->onResize = vulkanBackendOnResize;
+        state->setPresentMode = vulkanSetPresentMode;
         state->updateGlobalState = vulkanForwardUpdateGlobalState;
         state->updateDeferredGlobalState = vulkanDeferredUpdateGlobaState;
         state->onCreateMesh = vulkanCreateMesh;
+        state->onDestroyMesh = vulkanDestroyMesh;
         state->onCreateTexture = vulkanCreateTexture;
         state->onDestroyTexture = vulkanDestroyTexture;
+        state->waitUploads = vulkanWaitUploads;
         state->onCreateMaterial = vulkanCreateMaterial;
+        state->onDestroyMaterial = vulkanDestroyMaterial;
         state->drawGui = vulkanImguiRender;
+        state->getStats = vulkanGetStats;
 
         return true;
     }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "renderTypes.h"
+#include "frustumCulling.h"
 
 typedef enum RenderBackendAPI
 {
@@ -11,23 +12,37 @@ typedef enum RenderBackendAPI
 
 typedef struct RendererBackend
 {
-    bool (*init)(const char* appName, void* winHandle);
+    bool (*init)(const char* appName, void* winHandle, const RenderSystemConfig& config);
     void (*shutdown)();
     bool (*beginFrame)(f32 delta);
     void (*beginCommandBuffer)(DefaultRenderPasses renderPass);
     bool (*beginRenderPass)(DefaultRenderPasses renderPass);
-    void (*drawGeometry)(DefaultRenderPasses renderPass, const RenderMeshData* mesh);
+    // Draws count instances of meshes[0].mesh with meshes[0].material, one per model matrix.
+    void (*drawGeometry)(DefaultRenderPasses renderPass, const RenderMeshData* meshes, u32 count);
+    // Draws every batch of the sorted draw list in order. Long lists are recorded on several threads.
+    void (*drawBatches)(DefaultRenderPasses renderPass, const RenderMeshData* draws, const RenderBatch* batches, u32 batchCount);
+    // GPU driven geometry pass. Objects are given when they change, then culled and drawn every frame by the GPU.
+    bool (*gpuCullingSupported)();
+    bool (*setObjects)(const RenderMeshData* objects, u32 count);
+    void (*setObjectModels)(const u32* indices, const glm::mat4* models, u32 count);   // Objects given by setObjects that moved.
+    void (*cullObjects)(const Frustum& frustum);    // Before beginRenderPass.
+    void (*drawObjects)();
     void (*endRenderPass)(DefaultRenderPasses renderPass);
     void (*submitCommands)(DefaultRenderPasses renderPass);
     void (*endFrame)();
     void (*onResize)(u32 width, u32 height);
+    void (*setPresentMode)(RenderPresentMode mode);    // Applied at the next frame begin.
     void (*updateGlobalState)(f32 dt);
     void (*updateDeferredGlobalState)(f32 dt);
     bool (*onCreateMesh)(Mesh* m, u32 vertexCount, Vertex* vertices, u32 indexCount, u32* indices);
+    void (*onDestroyMesh)(const Mesh* m);
     bool (*onCreateTexture)(void* data, Texture* texture);
     void (*onDestroyTexture)(Texture* t);
+    void (*waitUploads)();
     bool (*onCreateMaterial)(Material* m);
+    void (*onDestroyMaterial)(Material* m);
     void (*drawGui)(const RenderPacket& packet);
+    void (*getStats)(RenderStats* outStats);
 } RendererBackend;
 
 bool rendererBackendInit(RenderBackendAPI api, RendererBackend* state);
@@ -1,8 +1,15 @@
 #include "rendererFrontend.h"
 
 #include "rendererBackend.h"
+#include "frustumCulling.h"
+
+#include "memory/frameAllocator.h"
+#include "memory/pmemory.h"
+#include "containers/radixSort.h"
+#include "platform/platform.h"
 
 #include "systems/renderSystem.h"
+#include "systems/transformSystem.h"
 #include "systems/meshSystem.h"
 #include "systems/components/comp_camera.h"
 #include "systems/components/comp_render.h"
@@ -17,14 +24,40 @@ typedef struct RenderFrontendState
     f32 near;
     f32 far;
     Mesh* deferredQuad;
+    u32 culledDraws;
+    bool instancing;
+    f32 geometryCpuMs;
+    bool geometryGpuDriven;
+
+    // GPU driven geometry pass, objects are given again when keys change,
+    // only the moved ones when just transforms change.
+    bool gpuCulling;
+    u32 objectsKeyVersion;
+    u32 objectsTransformVersion;
+
+    // Objects of each transform, indexed by the external index of the
+    // transform. The first one is in transformObjects, the rest linked
+    // through objectNext.
+    u32 objectCount;
+    u32 objectCapacity;
+    u32* objectNext;
+    u32 transformCapacity;
+    u32* transformObjects;
+    CHandle* objectTransforms;  // Transform of the objects at each index, to skip reused ones.
 } RenderFrontendState;
 
 static RenderFrontendState* pState;
 
 static i16 w, h;
 static void activateMainCamera();
-
-bool renderSystemInit(u64* memoryRequirement, void* state, const char* appName, void* winHandle)
+static RenderMeshData* buildDrawList(DefaultRenderPasses pass, u32* outCount);
+static u32 countInstances(const RenderMeshData* drawList, u32 begin, u32 count);
+static RenderBatch* buildBatches(const RenderMeshData* drawList, u32 drawCount, u32* outCount);
+static bool updateObjects();
+static bool updateObjectModels(const CTransformSystem* transforms);
+static void cameraFrustum(Frustum* outFrustum);
+
+bool renderSystemInit(u64* memoryRequirement, void* state, const char* appName, void* winHandle, const RenderSystemConfig& config)
 {
     *memoryRequirement = sizeof(RenderFrontendState);
     if(!state)
@@ -32,16 +65,29 @@ bool renderSystemInit(u64* memoryRequirement, void* state, const char* appName,
 
     pState = static_cast<RenderFrontendState*>(state);
     pState->deferredQuad = 0;
+    pState->instancing = true;
+    pState->geometryCpuMs = 0.0f;
+    pState->geometryGpuDriven = false;
     
     rendererBackendInit(VULKAN_API, &pState->renderBackend);
 
-    if(!pState->renderBackend.init(appName, winHandle))
+    if(!pState->renderBackend.init(appName, winHandle, config))
     {
         PFATAL("Render Backend failed to initialize!");
         return false;
     }
     PINFO("Render Backend initialized!");
 
+    pState->gpuCulling = pState->renderBackend.gpuCullingSupported();
+    pState->objectsKeyVersion = INVALID_ID;
+    pState->objectsTransformVersion = INVALID_ID;
+    pState->objectCount = 0;
+    pState->objectCapacity = 0;
+    pState->objectNext = nullptr;
+    pState->transformCapacity = 0;
+    pState->transformObjects = nullptr;
+    pState->objectTransforms = nullptr;
+
     return true;
 }
 
@@ -50,6 +96,14 @@ void renderSystemShutdown(void* state)
     if(pState)
     {
         pState->renderBackend.shutdown();
+
+        if(pState->objectNext)
+            memFree(pState->objectNext, sizeof(u32) * pState->objectCapacity, MEMORY_TAG_RENDERER);
+        if(pState->transformObjects)
+        {
+            memFree(pState->transformObjects, sizeof(u32) * pState->transformCapacity, MEMORY_TAG_RENDERER);
+            memFree(pState->objectTransforms, sizeof(CHandle) * pState->transformCapacity, MEMORY_TAG_RENDERER);
+        }
     }
 }
 
@@ -70,12 +124,13 @@ bool renderDrawFrame(const RenderPacket& packet)
         // Update light descriptor
         pState->renderBackend.updateGlobalState((f32)packet.deltaTime);
 
-        for(auto& key : CRenderManager::Get()->keys){
-            TCompTransform* cTransform = key.hTransform;
-            PASSERT(cTransform)
-            RenderMeshData renderData = {cTransform->asMatrix(), key.mesh, key.material};
-            pState->renderBackend.drawGeometry(RENDER_PASS_FORWARD, &renderData);
-        }
+        CRenderManager::Get()->render();
+
+        u32 drawCount = 0;
+        RenderMeshData* drawList = buildDrawList(RENDER_PASS_FORWARD, &drawCount);
+        u32 batchCount = 0;
+        RenderBatch* batches = buildBatches(drawList, drawCount, &batchCount);
+        pState->renderBackend.drawBatches(RENDER_PASS_FORWARD, drawList, batches, batchCount);
 
         pState->renderBackend.drawGui(packet);
         pState->renderBackend.endRenderPass(RENDER_PASS_FORWARD);
@@ -94,30 +149,53 @@ bool renderDeferredFrame(const RenderPacket& packet)
     {
         // Begin command call
         pState->renderBackend.beginCommandBuffer(RENDER_PASS_GEOMETRY);
-        pState->renderBackend.beginRenderPass(RENDER_PASS_GEOMETRY);
 
         // TODO Update globals ... DeltaTime, ScreenWidth, ScreenHeight, ...
 
         activateMainCamera();
 
-        pState->renderBackend.updateDeferredGlobalState((f32)packet.deltaTime);
-
-        // TODO Get active camera and update its data ...
-
         /** TODO Deferred renderer ... 
         * - Draw into GBuffers
         * - Draw Decals
         * - Draw AO
         * ...
         */
-        CRenderManager::Get()->render();        
+        CRenderManager::Get()->render();
+
+        // With GPU culling the keys are only walked when they change, the
+        // objects are culled by a compute pass recorded before the geometry pass.
+        f64 geometryStart = platformGetCurrentTime();
+        bool gpuDriven = pState->gpuCulling && updateObjects();
+        if(gpuDriven)
+        {
+            Frustum frustum;
+            cameraFrustum(&frustum);
+            pState->renderBackend.cullObjects(frustum);
+        }
+        f64 geometryMs = (platformGetCurrentTime() - geometryStart) * 1000.0;
 
-        for(auto& key : CRenderManager::Get()->keys){
-            TCompTransform* cTransform = key.hTransform;
-            PASSERT(cTransform)
-            RenderMeshData renderData = {cTransform->asMatrix(), key.mesh, key.material};
-            pState->renderBackend.drawGeometry(RENDER_PASS_GEOMETRY, &renderData);
+        pState->renderBackend.beginRenderPass(RENDER_PASS_GEOMETRY);
+        pState->renderBackend.updateDeferredGlobalState((f32)packet.deltaTime);
+
+        // TODO Get active camera and update its data ...
+
+        geometryStart = platformGetCurrentTime();
+        if(gpuDriven)
+        {
+            pState->renderBackend.drawObjects();
+            pState->culledDraws = 0;
+        }
+        else
+        {
+            u32 drawCount = 0;
+            RenderMeshData* drawList = buildDrawList(RENDER_PASS_GEOMETRY, &drawCount);
+            u32 batchCount = 0;
+            RenderBatch* batches = buildBatches(drawList, drawCount, &batchCount);
+            pState->renderBackend.drawBatches(RENDER_PASS_GEOMETRY, drawList, batches, batchCount);
         }
+        geometryMs += (platformGetCurrentTime() - geometryStart) * 1000.0;
+        pState->geometryCpuMs = (f32)geometryMs;
+        pState->geometryGpuDriven = gpuDriven;
     
         pState->renderBackend.endRenderPass(RENDER_PASS_GEOMETRY);
         pState->renderBackend.submitCommands(RENDER_PASS_GEOMETRY);
@@ -138,7 +216,7 @@ bool renderDeferredFrame(const RenderPacket& packet)
         if(!pState->deferredQuad)
             pState->deferredQuad = meshSystemGetPlane(2, 2);
         RenderMeshData quadData = {glm::mat4(1), pState->deferredQuad, nullptr};
-        pState->renderBackend.drawGeometry(RENDER_PASS_DEFERRED, &quadData);
+        pState->renderBackend.drawGeometry(RENDER_PASS_DEFERRED, &quadData, 1);
         pState->renderBackend.drawGui(packet);
         pState->renderBackend.endRenderPass(RENDER_PASS_DEFERRED);
         pState->renderBackend.submitCommands(RENDER_PASS_DEFERRED);
@@ -159,9 +237,15 @@ void renderOnResize(u16 width, u16 height)
 
 bool renderCreateMesh(Mesh* m, u32 vertexCount, Vertex* vertices, u32 indexCount, u32* indices)
 {
+    meshComputeBounds(m, vertexCount, vertices);
     return pState->renderBackend.onCreateMesh(m, vertexCount, vertices, indexCount, indices);
 }
 
+void renderDestroyMesh(const Mesh* m)
+{
+    pState->renderBackend.onDestroyMesh(m);
+}
+
 bool renderCreateTexture(void* data, Texture* texture)
 {
     return pState->renderBackend.onCreateTexture(data, texture);
@@ -172,11 +256,61 @@ void renderDestroyTexture(Texture* t)
     pState->renderBackend.onDestroyTexture(t);
 }
 
+void renderWaitUploads()
+{
+    pState->renderBackend.waitUploads();
+}
+
 bool renderCreateMaterial(Material* m)
 {
     return pState->renderBackend.onCreateMaterial(m);
 }
 
+void renderDestroyMaterial(Material* m)
+{
+    pState->renderBackend.onDestroyMaterial(m);
+}
+
+void renderSetInstancing(bool enabled)
+{
+    pState->instancing = enabled;
+}
+
+bool renderGetInstancing()
+{
+    return pState->instancing;
+}
+
+void renderSetGpuCulling(bool enabled)
+{
+    enabled = enabled && pState->renderBackend.gpuCullingSupported();
+    if(enabled && !pState->gpuCulling)
+    {
+        // Keys and transforms may have changed on the CPU path.
+        pState->objectsKeyVersion = INVALID_ID;
+        pState->objectsTransformVersion = INVALID_ID;
+    }
+    pState->gpuCulling = enabled;
+}
+
+bool renderGetGpuCulling()
+{
+    return pState->gpuCulling;
+}
+
+void renderGetStats(RenderStats* outStats)
+{
+    pState->renderBackend.getStats(outStats);
+    outStats->culledDraws = pState->culledDraws;
+    outStats->cpuGeometryMs = pState->geometryCpuMs;
+    outStats->gpuDriven = pState->geometryGpuDriven ? 1 : 0;
+}
+
+void renderSetPresentMode(RenderPresentMode mode)
+{
+    pState->renderBackend.setPresentMode(mode);
+}
+
 static void activateMainCamera()
 {
     CEntity* eCamera = CRenderManager::Get()->getActiveCamera();
@@ -189,4 +323,297 @@ static void activateMainCamera()
         PASSERT(cCamera);
         cCamera->setAspectRatio((f32)w / (f32)h);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Resolves the render keys into a draw list living in frame memory,
+ * so no container grows while rendering. Keys come sorted by state from
+ * the render manager. Translucent ones are at the end and are sorted
+ * again back to front, as their depth changes every frame. Draws out of
+ * the camera frustum are removed at the end.
+ */
+static RenderMeshData* buildDrawList(DefaultRenderPasses pass, u32* outCount)
+{
+    *outCount = 0;
+
+    // Transforms edited after the entities update, from the editor for example.
+    CTransformSystem::Get()->update();
+
+    const CRenderManager* manager = CRenderManager::Get();
+    const auto& sortedKeys = manager->getSortedKeys();
+    if(sortedKeys.empty())
+        return nullptr;
+
+    const u32 count = (u32)sortedKeys.size();
+    RenderMeshData* drawList = frameAlloc<RenderMeshData>(count);
+    RenderMeshData* translucent = frameAlloc<RenderMeshData>(count);
+    u64* sortKeys   = frameAlloc<u64>(count);
+    u64* tmpKeys    = frameAlloc<u64>(count);
+    u32* indices    = frameAlloc<u32>(count);
+    u32* tmpIndices = frameAlloc<u32>(count);
+    if(!drawList || !translucent || !sortKeys || !tmpKeys || !indices || !tmpIndices)
+    {
+        PERROR("buildDrawList - not enough frame memory for %u draw calls.", count);
+        return nullptr;
+    }
+
+    // Depth is the distance along the camera forward, in buckets up to the far plane.
+    glm::vec3 eye(0.0f);
+    glm::vec3 forward(0.0f, 0.0f, -1.0f);
+    f32 farPlane = 1000.0f;
+    TCompCamera* cCamera = nullptr;
+    CEntity* eCamera = getEntityByName("camera");
+    if(eCamera)
+        cCamera = eCamera->get<TCompCamera>();
+    if(cCamera)
+    {
+        eye = cCamera->getEye();
+        forward = cCamera->getForward();
+        farPlane = cCamera->getFar();
+    }
+    const f32 depthScale = (f32)RENDER_KEY_MAX_DEPTH / farPlane;
+
+    u32 nOpaque = 0;
+    u32 nTranslucent = 0;
+    for(const auto& sk : sortedKeys){
+        if(!manager->isValid(sk))
+            continue;
+        const auto& key = manager->keys[sk.key];
+        TCompTransform* cTransform = key.hTransform;
+        PASSERT(cTransform)
+
+        bool isTranslucent = materialIsTranslucent(key.material);
+        RenderMeshData& renderData = isTranslucent ? translucent[nTranslucent] : drawList[nOpaque++];
+        renderData.model    = cTransform->getWorldMatrix();
+        renderData.mesh     = key.mesh;
+        renderData.material = key.material;
+        if(!isTranslucent)
+            continue;
+
+        f32 distance = glm::dot(cTransform->getWorldPosition() - eye, forward);
+        f32 bucket = distance * depthScale;
+        u32 depth = bucket <= 0.0f ? 0 : (bucket >= (f32)RENDER_KEY_MAX_DEPTH ? RENDER_KEY_MAX_DEPTH : (u32)bucket);
+        sortKeys[nTranslucent] = renderKeyEncode(pass, true, key.material->type,
+            key.material->rendererId, key.mesh->rendererId, depth);
+        indices[nTranslucent] = nTranslucent;
+        ++nTranslucent;
+    }
+
+    radixSort64(sortKeys, indices, tmpKeys, tmpIndices, nTranslucent);
+
+    for(u32 i = 0; i < nTranslucent; ++i)
+        drawList[nOpaque + i] = translucent[indices[i]];
+    u32 drawCount = nOpaque + nTranslucent;
+
+    // Drop the draws out of the camera, keeping the order.
+    pState->culledDraws = 0;
+    if(cCamera)
+    {
+        Frustum frustum;
+        frustumFromMatrix(cCamera->getViewProjection(), &frustum);
+        u32 visible = frustumCullDraws(&frustum, drawList, drawCount, indices);
+        for(u32 i = 0; i < visible; ++i)
+            drawList[i] = drawList[indices[i]];
+        pState->culledDraws = drawCount - visible;
+        drawCount = visible;
+    }
+
+    *outCount = drawCount;
+    return drawList;
+}
+
+/**
+ * Number of draws from begin on that share mesh and material, so they
+ * go to the backend as a single instanced draw. The draw list is sorted
+ * by state, translucent draws are only grouped while consecutive.
+ */
+static u32 countInstances(const RenderMeshData* drawList, u32 begin, u32 count)
+{
+    const RenderMeshData& first = drawList[begin];
+    u32 end = begin + 1;
+    while(end < count && drawList[end].mesh == first.mesh && drawList[end].material == first.material)
+        ++end;
+    return end - begin;
+}
+
+/**
+ * Splits the draw list in runs of instances, in frame memory.
+ */
+static RenderBatch* buildBatches(const RenderMeshData* drawList, u32 drawCount, u32* outCount)
+{
+    *outCount = 0;
+    if(drawCount == 0)
+        return nullptr;
+
+    RenderBatch* batches = frameAlloc<RenderBatch>(drawCount);
+    if(!batches)
+    {
+        PERROR("buildBatches - not enough frame memory for %u draw calls.", drawCount);
+        return nullptr;
+    }
+
+    u32 batchCount = 0;
+    for(u32 i = 0; i < drawCount; ){
+        u32 instanceCount = pState->instancing ? countInstances(drawList, i, drawCount) : 1;
+        batches[batchCount].first = i;
+        batches[batchCount].count = instanceCount;
+        ++batchCount;
+        i += instanceCount;
+    }
+
+    *outCount = batchCount;
+    return batches;
+}
+
+/**
+ * Grows the links between transforms and objects, their content is
+ * rebuilt with the objects.
+ */
+static void reserveObjectLinks(u32 objectCount, u32 transformCount)
+{
+    if(objectCount > pState->objectCapacity)
+    {
+        if(pState->objectNext)
+            memFree(pState->objectNext, sizeof(u32) * pState->objectCapacity, MEMORY_TAG_RENDERER);
+        pState->objectCapacity = objectCount + objectCount / 2;
+        pState->objectNext = (u32*)memAllocate(sizeof(u32) * pState->objectCapacity, MEMORY_TAG_RENDERER);
+    }
+    if(transformCount > pState->transformCapacity)
+    {
+        if(pState->transformObjects)
+        {
+            memFree(pState->transformObjects, sizeof(u32) * pState->transformCapacity, MEMORY_TAG_RENDERER);
+            memFree(pState->objectTransforms, sizeof(CHandle) * pState->transformCapacity, MEMORY_TAG_RENDERER);
+        }
+        pState->transformCapacity = transformCount;
+        pState->transformObjects = (u32*)memAllocate(sizeof(u32) * transformCount, MEMORY_TAG_RENDERER);
+        pState->objectTransforms = (CHandle*)memAllocate(sizeof(CHandle) * transformCount, MEMORY_TAG_RENDERER);
+    }
+    // INVALID_ID in every byte.
+    if(pState->transformObjects)
+        memSet(pState->transformObjects, 0xff, sizeof(u32) * pState->transformCapacity);
+}
+
+/**
+ * Gives the enabled keys to the backend as objects when keys changed
+ * since the last time. When only transforms changed, just the objects
+ * of the transforms the last update recomputed are given. Static scenes
+ * do no work per key. Returns false if the GPU path can not draw them
+ * this frame.
+ */
+static bool updateObjects()
+{
+    CTransformSystem* transforms = CTransformSystem::Get();
+    transforms->update();
+
+    const CRenderManager* manager = CRenderManager::Get();
+    const u32 transformVersion = transforms->getVersion();
+    if(manager->getVersion() == pState->objectsKeyVersion)
+    {
+        if(transformVersion == pState->objectsTransformVersion)
+            return true;
+
+        // The ranges only cover the last update, if there were more all the objects are given.
+        if(transformVersion == pState->objectsTransformVersion + 1
+            && !transforms->getUpdatedRanges().empty()
+            && updateObjectModels(transforms))
+        {
+            pState->objectsTransformVersion = transformVersion;
+            return true;
+        }
+    }
+
+    const auto& sortedKeys = manager->getSortedKeys();
+    const u32 count = (u32)sortedKeys.size();
+    RenderMeshData* objects = count > 0 ? frameAlloc<RenderMeshData>(count) : nullptr;
+    if(count > 0 && !objects)
+    {
+        PERROR("updateObjects - not enough frame memory for %u objects.", count);
+        return false;
+    }
+    reserveObjectLinks(count, getObjectManager<TCompTransform>()->capacity());
+
+    u32 nObjects = 0;
+    for(const auto& sk : sortedKeys){
+        if(!manager->isValid(sk))
+            continue;
+        const auto& key = manager->keys[sk.key];
+        TCompTransform* cTransform = key.hTransform;
+        PASSERT(cTransform)
+
+        u32 transform = key.hTransform.getIndex();
+        pState->objectNext[nObjects]            = pState->transformObjects[transform];
+        pState->transformObjects[transform]     = nObjects;
+        pState->objectTransforms[transform]     = key.hTransform;
+
+        RenderMeshData& object = objects[nObjects++];
+        object.model    = cTransform->getWorldMatrix();
+        object.mesh     = key.mesh;
+        object.material = key.material;
+    }
+
+    pState->objectCount = 0;
+    if(!pState->renderBackend.setObjects(objects, nObjects))
+        return false;
+    pState->objectCount = nObjects;
+    pState->objectsKeyVersion = manager->getVersion();
+    pState->objectsTransformVersion = transformVersion;
+    return true;
+}
+
+/**
+ * Gives the backend the models of the objects whose transform the last
+ * transform system update recomputed. Returns false if they could not be
+ * collected, all the objects have to be given then.
+ */
+static bool updateObjectModels(const CTransformSystem* transforms)
+{
+    if(pState->objectCount == 0)
+        return true;
+
+    u32* indices = frameAlloc<u32>(pState->objectCount);
+    glm::mat4* models = frameAlloc<glm::mat4>(pState->objectCount);
+    if(!indices || !models)
+        return false;
+
+    // Ranges do not overlap, each object is found once at most.
+    const std::vector<u32>& ranges = transforms->getUpdatedRanges();
+    u32 nMoved = 0;
+    for(u32 r = 0; r + 1 < (u32)ranges.size(); r += 2)
+    {
+        for(u32 position = ranges[r]; position < ranges[r + 1]; ++position)
+        {
+            CHandle hTransform = transforms->getTransformAt(position);
+            u32 transform = hTransform.getIndex();
+            if(transform >= pState->transformCapacity || pState->objectTransforms[transform] != hTransform)
+                continue;
+            for(u32 object = pState->transformObjects[transform]; object != INVALID_ID; object = pState->objectNext[object])
+            {
+                indices[nMoved] = object;
+                models[nMoved]  = transforms->getWorldAt(position);
+                ++nMoved;
+            }
+        }
+    }
+
+    if(nMoved > 0)
+        pState->renderBackend.setObjectModels(indices, models, nMoved);
+    return true;
+}
+
+/**
+ * Frustum of the main camera. Without one nothing is culled.
+ */
+static void cameraFrustum(Frustum* outFrustum)
+{
+    TCompCamera* cCamera = nullptr;
+    CEntity* eCamera = getEntityByName("camera");
+    if(eCamera)
+        cCamera = eCamera->get<TCompCamera>();
+    if(cCamera) {
+        frustumFromMatrix(cCamera->getViewProjection(), outFrustum);
+        return;
+    }
+    for(u32 i = 0; i < 6; ++i)
+        outFrustum->planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
@@ -2,7 +2,7 @@
 
 #include "renderTypes.h"
 
-bool renderSystemInit(u64* memoryRequirement, void* state, const char* appName, void* winHandle);
+bool renderSystemInit(u64* memoryRequirement, void* state, const char* appName, void* winHandle, const RenderSystemConfig& config);
 void renderSystemShutdown(void* state);
 
 bool renderDrawFrame(const RenderPacket& packet);
@@ -10,6 +10,40 @@ bool renderDeferredFrame(const RenderPacket& packet);
 void renderOnResize(u16 width, u16 height);
 
 bool renderCreateMesh(Mesh* m, u32 vertexCount, Vertex* vertices, u32 indexCount, u32* indices);
+void renderDestroyMesh(const Mesh* m);
 bool renderCreateTexture(void* data, Texture* texture);
 void renderDestroyTexture(Texture* t);
-bool renderCreateMaterial(Material* m);
\ No newline at end of file
+/**
+ * Blocks until the meshes and textures created so far are on the GPU.
+ * Frames already wait for the ones they draw, this is for loading screens
+ * and load time measurements.
+ */
+void renderWaitUploads();
+bool renderCreateMaterial(Material* m);
+void renderDestroyMaterial(Material* m);
+
+/**
+ * Bind and draw counters of the last frame rendered.
+ * @param RenderStats* outStats
+ */
+void renderGetStats(RenderStats* outStats);
+/**
+ * Recreates the swapchain with another present mode at the next frame,
+ * to compare the frame times of each. Falls back to fifo when not supported.
+ * @param RenderPresentMode mode
+ */
+void renderSetPresentMode(RenderPresentMode mode);
+/**
+ * Groups draws sharing mesh and material in one instanced draw. On by
+ * default, turned off every draw is its own draw call, to compare both.
+ * @param bool enabled
+ */
+void renderSetInstancing(bool enabled);
+bool renderGetInstancing();
+/**
+ * Culls and draws the geometry pass from the GPU when the backend supports
+ * it. On by default, turned off the CPU builds the draw list, to compare both.
+ * @param bool enabled
+ */
+void renderSetGpuCulling(bool enabled);
+bool renderGetGpuCulling();
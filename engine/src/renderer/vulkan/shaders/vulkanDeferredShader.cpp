@@ -9,10 +9,102 @@
 #include "../vulkanUtils.h"
 #include "../vulkanFramebuffer.h"
 #include "../vulkanBuffer.h"
+#include "../vulkanMemory.h"
+
+/**
+ * Half floats are the fallback for the compact normals, 16 bit unorm
+ * color attachments are optional.
+ */
+static VkFormat
+compactNormalFormat(const VulkanDevice& device)
+{
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(device.physicalDevice, VK_FORMAT_R16G16_UNORM, &properties);
+    if(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT)
+        return VK_FORMAT_R16G16_UNORM;
+    return VK_FORMAT_R16G16_SFLOAT;
+}
+
+static u32
+formatBytes(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8G8_UNORM:              return 2;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R16G16_UNORM:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:       return 4;
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    case VK_FORMAT_R16G16B16A16_SFLOAT:     return 8;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:     return 16;
+    default:                                return 0;
+    }
+}
 
+static void
+gbufferFormats(
+    const VulkanDevice& device,
+    RenderGbufferLayout layout,
+    VkFormat* outFormats)
+{
+    if(layout == RENDER_GBUFFER_COMPACT)
+    {
+        outFormats[0] = compactNormalFormat(device);
+        outFormats[1] = VK_FORMAT_R8G8B8A8_UNORM;
+        outFormats[2] = VK_FORMAT_R8G8_UNORM;
+    }
+    else
+    {
+        outFormats[0] = VK_FORMAT_R16G16B16A16_SFLOAT;
+        outFormats[1] = VK_FORMAT_R32G32B32A32_SFLOAT;
+        outFormats[2] = VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+/**
+ * Logs the G-buffer traffic of a frame for both layouts. Every target is
+ * written once by the geometry pass and read once by the light pass, the
+ * compact layout also stores and reads the depth. Overdraw and depth
+ * testing are not counted.
+ */
+static void
+logGbufferBandwidth(
+    const VulkanDevice& device,
+    VkFormat depthFormat,
+    RenderGbufferLayout selected,
+    u32 width,
+    u32 height)
+{
+    const char* names[2] = {"classic", "compact"};
+    for(u32 layout = RENDER_GBUFFER_CLASSIC; layout <= RENDER_GBUFFER_COMPACT; ++layout)
+    {
+        VkFormat formats[VULKAN_GBUFFER_TARGET_COUNT];
+        gbufferFormats(device, (RenderGbufferLayout)layout, formats);
+
+        u32 pixelBytes = 0;
+        for(u32 i = 0; i < VULKAN_GBUFFER_TARGET_COUNT; ++i)
+            pixelBytes += formatBytes(formats[i]);
+        if(layout == RENDER_GBUFFER_COMPACT)
+            pixelBytes += formatBytes(depthFormat);
+
+        f64 frameMB = (f64)pixelBytes * 2.0 * width * height / (1024.0 * 1024.0);
+        PINFO("G-buffer %s: %u bytes per pixel, about %.1f MB per frame at %ux%u%s.",
+            names[layout], pixelBytes, frameMB, width, height, layout == (u32)selected ? " (selected)" : "");
+    }
+}
+
+/**
+ * Creates the targets and the depth of every frame in flight. The depth is
+ * only sampled in the compact layout, it is per frame in both so the
+ * geometry pass of a frame never writes the depth of another.
+ */
 static void
 createGbuffers(
     const VulkanDevice& device,
+    VkFormat depthFormat,
+    RenderGbufferLayout layout,
     u32 width,
     u32 height,
     VulkanDeferredShader* shader)
@@ -30,30 +122,125 @@ createGbuffers(
     sampler.maxLod          = 1.0;
     sampler.borderColor     = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 
-    vulkanCreateAttachment(
-        device,
-        VK_FORMAT_R16G16B16A16_SFLOAT,
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-        width, height, &shader->gbuf.positonTxt
-    );
+    shader->gbuf.layout = layout;
+    gbufferFormats(device, layout, shader->gbuf.formats);
 
-    vulkanCreateAttachment(
-        device,
-        VK_FORMAT_R32G32B32A32_SFLOAT,
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-        width, height, &shader->gbuf.normalTxt
-    );
+    for(u32 frame = 0; frame < shader->frameCount; ++frame)
+    {
+        for(u32 i = 0; i < VULKAN_GBUFFER_TARGET_COUNT; ++i)
+        {
+            VulkanTexture* target = &shader->gbuf.targets[frame][i];
+            vulkanCreateAttachment(
+                device,
+                shader->gbuf.formats[i],
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                width, height, target
+            );
+            VK_CHECK(vkCreateSampler(device.handle, &sampler, nullptr, &target->sampler))
+        }
 
-    vulkanCreateAttachment(
-        device,
-        VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-        width, height, &shader->gbuf.albedoTxt
-    );
+        vulkanCreateAttachment(
+            device,
+            depthFormat,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            width, height, &shader->geometryDepth[frame]
+        );
+        VK_CHECK(vkCreateSampler(device.handle, &sampler, nullptr, &shader->geometryDepth[frame].sampler))
+    }
+}
 
-    VK_CHECK(vkCreateSampler(device.handle, &sampler, nullptr, &shader->gbuf.positonTxt.sampler))
-    VK_CHECK(vkCreateSampler(device.handle, &sampler, nullptr, &shader->gbuf.normalTxt.sampler))
-    VK_CHECK(vkCreateSampler(device.handle, &sampler, nullptr, &shader->gbuf.albedoTxt.sampler))
+/**
+ * The light pass draws straight into the swapchain images, one framebuffer per image.
+ */
+static void
+createLightFramebuffers(
+    const VulkanDevice& device,
+    const VulkanSwapchain& swapchain,
+    u32 width,
+    u32 height,
+    VulkanDeferredShader* shader)
+{
+    shader->lightFramebuffer.resize(swapchain.imageViews.size());
+    for(u32 i = 0; i < swapchain.imageViews.size(); ++i){
+
+        // TODO Make modular
+        std::vector<VkImageView> attachments = {swapchain.imageViews.at(i), swapchain.depthImage.view};
+
+        vulkanFramebufferCreate(
+            device,
+            &shader->lightRenderpass,
+            width, height,
+            static_cast<u32>(attachments.size()),
+            attachments,
+            &shader->lightFramebuffer[i]
+        );
+    }
+}
+
+static void
+destroyLightFramebuffers(
+    const VulkanDevice& device,
+    VulkanDeferredShader& shader)
+{
+    for(const Framebuffer& framebuffer : shader.lightFramebuffer) {
+        vkDestroyFramebuffer(device.handle, framebuffer.handle, nullptr);
+    }
+    shader.lightFramebuffer.clear();
+}
+
+static void
+destroyTexture(
+    const VulkanDevice& device,
+    VulkanTexture& texture)
+{
+    vulkanMemoryFree(device, texture.image.allocation);
+    vkDestroyImageView(device.handle, texture.image.view, nullptr);
+    vkDestroyImage(device.handle, texture.image.handle, nullptr);
+    vkDestroySampler(device.handle, texture.sampler, nullptr);
+}
+
+/**
+ * Points the light set of the frame to its G-buffer. Written once, the
+ * targets of a frame do not change.
+ */
+static void
+writeGbufferDescriptors(
+    const VulkanDevice& device,
+    u32 frame,
+    VulkanDeferredShader& shader)
+{
+    VkDescriptorImageInfo descInfos[VULKAN_GBUFFER_TARGET_COUNT];
+    for(u32 i = 0; i < VULKAN_GBUFFER_TARGET_COUNT; ++i)
+    {
+        descInfos[i].imageLayout    = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        descInfos[i].imageView      = shader.gbuf.targets[frame][i].image.view;
+        descInfos[i].sampler        = shader.gbuf.targets[frame][i].sampler;
+    }
+
+    VkWriteDescriptorSet gbufferWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    gbufferWrite.descriptorType    = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    gbufferWrite.descriptorCount   = VULKAN_GBUFFER_TARGET_COUNT;
+    gbufferWrite.dstBinding        = 0;
+    gbufferWrite.dstArrayElement   = 0;
+    gbufferWrite.pImageInfo        = descInfos;
+    gbufferWrite.dstSet            = shader.lightDescriptorSet[frame];
+
+    VkDescriptorImageInfo depthInfo;
+    depthInfo.imageLayout   = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthInfo.imageView     = shader.geometryDepth[frame].image.view;
+    depthInfo.sampler       = shader.geometryDepth[frame].sampler;
+
+    VkWriteDescriptorSet depthWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    depthWrite.descriptorType   = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    depthWrite.descriptorCount  = 1;
+    depthWrite.dstBinding       = 4;
+    depthWrite.dstArrayElement  = 0;
+    depthWrite.pImageInfo       = &depthInfo;
+    depthWrite.dstSet           = shader.lightDescriptorSet[frame];
+
+    VkWriteDescriptorSet writes[2] = {gbufferWrite, depthWrite};
+    u32 writeCount = shader.gbuf.layout == RENDER_GBUFFER_COMPACT ? 2 : 1;
+    vkUpdateDescriptorSets(device.handle, writeCount, writes, 0, nullptr);
 }
 
 
@@ -75,19 +262,22 @@ createGeometryRenderPass(
        attachmentDesc[i].finalLayout    = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
    }
 
-    attachmentDesc[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
-    attachmentDesc[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    attachmentDesc[2].format = VK_FORMAT_R8G8B8A8_UNORM;
+    attachmentDesc[0].format = outShader->gbuf.formats[0];
+    attachmentDesc[1].format = outShader->gbuf.formats[1];
+    attachmentDesc[2].format = outShader->gbuf.formats[2];
+
+    // The compact layout keeps the depth for the light pass.
+    const bool compact = outShader->gbuf.layout == RENDER_GBUFFER_COMPACT;
 
     VkAttachmentDescription depthAttachment = {};
     depthAttachment.format          = swapchain.depthFormat;
     depthAttachment.samples         = VK_SAMPLE_COUNT_1_BIT;
     depthAttachment.loadOp          = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp         = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.storeOp         = compact ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.stencilLoadOp   = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp  = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.initialLayout   = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout     = compact ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     attachmentDesc[3] = depthAttachment;
 
@@ -109,16 +299,16 @@ createGeometryRenderPass(
 	dependencies[0].srcSubpass		= VK_SUBPASS_EXTERNAL;
 	dependencies[0].dstSubpass		= 0;
 	dependencies[0].srcStageMask	= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	dependencies[0].dstStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[0].dstStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 	dependencies[0].srcAccessMask	= VK_ACCESS_MEMORY_READ_BIT;
-	dependencies[0].dstAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 	dependencies[1].srcSubpass		= 0;
 	dependencies[1].dstSubpass		= VK_SUBPASS_EXTERNAL;
-	dependencies[1].srcStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].srcStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 	dependencies[1].dstStageMask	= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	dependencies[1].srcAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].srcAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 	dependencies[1].dstAccessMask	= VK_ACCESS_MEMORY_READ_BIT;
 	dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
@@ -211,11 +401,16 @@ void
 vulkanDeferredShaderCreate(
     const VulkanDevice& device,
     const VulkanSwapchain& swapchain,
+    const VulkanRingBuffer& uniformRing,
+    const VulkanBindless* bindless,
+    RenderGbufferLayout gbufferLayout,
+    u32 frameCount,
     u32 width,
     u32 height,
     VulkanDeferredShader* outShader)
 {
-    vulkanCreateSemaphore(device, &outShader->geometrySemaphore);
+    PASSERT(frameCount <= VULKAN_MAX_FRAMES_IN_FLIGHT)
+    outShader->frameCount = frameCount;
 
     VkCommandPoolCreateInfo cmdPoolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
     cmdPoolInfo.queueFamilyIndex = device.graphicsQueueIndex;
@@ -227,31 +422,27 @@ vulkanDeferredShaderCreate(
     cmdAllocInfo.commandPool        = outShader->geometryCmdPool;
     cmdAllocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
-    VK_CHECK(vkAllocateCommandBuffers(device.handle, &cmdAllocInfo, &outShader->geometryCmdBuffer.handle));
+    // The geometry pass of each frame is submitted on its own, the light pass waits on its semaphore.
+    for(u32 frame = 0; frame < frameCount; ++frame)
+    {
+        vulkanCreateSemaphore(device, &outShader->geometrySemaphore[frame]);
+        VK_CHECK(vkAllocateCommandBuffers(device.handle, &cmdAllocInfo, &outShader->geometryCmdBuffer[frame].handle));
+    }
 
-    vulkanBufferCreate(
-        device, 
-        sizeof(ViewProjectionBuffer),
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &outShader->globalUbo);
+    // Bindless materials are read from the shared set, without it each material has a set and a ubo range.
+    if(!bindless)
+    {
+        u32 objectMaterialSize = sizeof(VulkanMaterialShaderUBO) * VULKAN_MAX_MATERIAL_COUNT;
+        vulkanBufferCreate(
+            device, 
+            objectMaterialSize, 
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+            &outShader->objectUbo);
+        outShader->objectData = outShader->objectUbo.allocation.mapped;
+    }
 
-    vulkanBufferCreate(
-        device,
-        sizeof(VulkanLightData) * MAX_LIGHTS,
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &outShader->lightUbo);
-
-    u32 objectMaterialSize = sizeof(VulkanMaterialShaderUBO) * VULKAN_MAX_MATERIAL_COUNT;
-    vulkanBufferCreate(
-        device, 
-        objectMaterialSize, 
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-        &outShader->objectUbo);
-
-    VkDescriptorPoolSize geometryPoolSize[3];
+    VkDescriptorPoolSize geometryPoolSize[4];
     geometryPoolSize[0].descriptorCount    = 1;
     geometryPoolSize[0].type             = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 
@@ -261,89 +452,94 @@ vulkanDeferredShaderCreate(
     geometryPoolSize[2].descriptorCount = 1;
     geometryPoolSize[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 
+    geometryPoolSize[3].descriptorCount = 1;
+    geometryPoolSize[3].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+
     VkDescriptorPoolCreateInfo geometryPoolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-    geometryPoolInfo.poolSizeCount  = 3;
+    geometryPoolInfo.poolSizeCount  = 4;
     geometryPoolInfo.pPoolSizes     = geometryPoolSize;
     geometryPoolInfo.maxSets        = VULKAN_MAX_MATERIAL_COUNT;
     geometryPoolInfo.flags          = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 
     VK_CHECK(vkCreateDescriptorPool(device.handle, &geometryPoolInfo, nullptr, &outShader->geometryDescriptorPool));
 
-    VkDescriptorSetLayoutBinding bindings[VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT];
+    if(!bindless)
+    {
+        VkDescriptorSetLayoutBinding bindings[VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT];
 
-    VkDescriptorType descriptorTypes[VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT] = {
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
-    };
+        VkDescriptorType descriptorTypes[VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT] = {
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+        };
 
-    memZero(bindings, sizeof(VkDescriptorSetLayoutBinding) * VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT);
-    for(u32 i = 0; i < VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT; ++i)
-    {
-        bindings[i].binding         = i;
-        bindings[i].descriptorCount = 1;
-        bindings[i].descriptorType  = descriptorTypes[i];
-        bindings[i].stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
-    }
+        memZero(bindings, sizeof(VkDescriptorSetLayoutBinding) * VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT);
+        for(u32 i = 0; i < VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT; ++i)
+        {
+            bindings[i].binding         = i;
+            bindings[i].descriptorCount = 1;
+            bindings[i].descriptorType  = descriptorTypes[i];
+            bindings[i].stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
 
-    VkDescriptorSetLayoutCreateInfo objectBindingInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
-    objectBindingInfo.bindingCount  = VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT;
-    objectBindingInfo.pBindings     = bindings;
+        VkDescriptorSetLayoutCreateInfo objectBindingInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        objectBindingInfo.bindingCount  = VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT;
+        objectBindingInfo.pBindings     = bindings;
 
-    VK_CHECK(vkCreateDescriptorSetLayout(device.handle, &objectBindingInfo, nullptr, &outShader->objectGeometryDescriptorSetLayout));
+        VK_CHECK(vkCreateDescriptorSetLayout(device.handle, &objectBindingInfo, nullptr, &outShader->objectGeometryDescriptorSetLayout));
+    }
 
-    createGbuffers(device, width, height, outShader);
+    const bool compact = gbufferLayout == RENDER_GBUFFER_COMPACT;
+    createGbuffers(device, swapchain.depthFormat, gbufferLayout, width, height, outShader);
+    logGbufferBandwidth(device, swapchain.depthFormat, gbufferLayout, width, height);
     createGeometryRenderPass(device, swapchain, outShader);
     createLightRenderPass(device, swapchain, outShader);
 
-    std::vector<VkImageView> geometryAttachments = {
-        outShader->gbuf.positonTxt.image.view, 
-        outShader->gbuf.normalTxt.image.view, 
-        outShader->gbuf.albedoTxt.image.view,
-        swapchain.depthImage.view};
-
-    vulkanFramebufferCreate(device,
-        &outShader->geometryRenderpass,
-        width,
-        height,
-        geometryAttachments.size(),
-        geometryAttachments,
-        &outShader->geometryFramebuffer);
-
-    for(u32 i = 0; i < swapchain.imageViews.size(); ++i){
-
-        // TODO Make modular
-        std::vector<VkImageView> attachments = {swapchain.imageViews.at(i), swapchain.depthImage.view};
-
-        vulkanFramebufferCreate(
-            device,
-            &outShader->lightRenderpass,
-            width, height,
-            static_cast<u32>(attachments.size()),
-            attachments,
-            &outShader->lightFramebuffer[i]
-        );
+    for(u32 frame = 0; frame < frameCount; ++frame)
+    {
+        std::vector<VkImageView> geometryAttachments = {
+            outShader->gbuf.targets[frame][0].image.view,
+            outShader->gbuf.targets[frame][1].image.view,
+            outShader->gbuf.targets[frame][2].image.view,
+            outShader->geometryDepth[frame].image.view};
+
+        vulkanFramebufferCreate(device,
+            &outShader->geometryRenderpass,
+            width,
+            height,
+            geometryAttachments.size(),
+            geometryAttachments,
+            &outShader->geometryFramebuffer[frame]);
     }
 
+    createLightFramebuffers(device, swapchain, width, height, outShader);
+
     // Shader modules
     // Compile hardcoded shaders
+    // Fragment shader variants for the material path and the G-buffer layout.
+    std::string gbufferDefine = compact ? " -DCOMPACT_GBUFFER" : "";
+    std::string gbufferSuffix = compact ? "_compact" : "";
+    std::string geometryFragmentPath = "./data/shaders/geometry" + std::string(bindless ? "_bindless" : "") + gbufferSuffix + ".frag.spv";
+    std::string lightFragmentPath = "./data/shaders/deferredLight" + gbufferSuffix + ".frag.spv";
+
     system("glslc ./data/shaders/geometry.vert -o ./data/shaders/geometry.vert.spv");
-    system("glslc ./data/shaders/geometry.frag -o ./data/shaders/geometry.frag.spv");
+    system(("glslc" + std::string(bindless ? " -DBINDLESS" : "") + gbufferDefine
+        + " ./data/shaders/geometry.frag -o " + geometryFragmentPath).c_str());
     system("glslc ./data/shaders/deferredLight.vert -o ./data/shaders/deferredLight.vert.spv");
-    system("glslc ./data/shaders/deferredLight.frag -o ./data/shaders/deferredLight.frag.spv");
+    system(("glslc" + gbufferDefine + " ./data/shaders/deferredLight.frag -o " + lightFragmentPath).c_str());
 
     std::vector<char> geometryVertex, geometryFragment, deferredVertex, deferredFragment;
     if(!readShaderFile("./data/shaders/geometry.vert.spv", geometryVertex)){
         PERROR("Could not read shader!");
     }
-    if(!readShaderFile("./data/shaders/geometry.frag.spv", geometryFragment)){
+    if(!readShaderFile(geometryFragmentPath.c_str(), geometryFragment)){
         PERROR("Could not read shader!");
     }
     if(!readShaderFile("./data/shaders/deferredLight.vert.spv", deferredVertex)){
         PERROR("Could not read shader!");
     }
-    if(!readShaderFile("./data/shaders/deferredLight.frag.spv", deferredFragment)){
+    if(!readShaderFile(lightFragmentPath.c_str(), deferredFragment)){
         PERROR("Could not read shader!");
     }
 
@@ -360,7 +556,7 @@ vulkanDeferredShaderCreate(
     VkDescriptorSetLayoutBinding globalGeometryBinding{};
     globalGeometryBinding.binding           = 0;
     globalGeometryBinding.descriptorCount   = 1;
-    globalGeometryBinding.descriptorType    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    globalGeometryBinding.descriptorType    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     globalGeometryBinding.stageFlags        = VK_SHADER_STAGE_VERTEX_BIT;
 
     VkDescriptorSetLayoutCreateInfo geometryLayoutInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
@@ -402,30 +598,30 @@ vulkanDeferredShaderCreate(
     scissors.extent = {width, height};
     scissors.offset = {0, 0};
 
-    VkPipelineColorBlendAttachmentState blendAttachments[3] = {};
-    blendAttachments[0].colorWriteMask = 0xf;
-    blendAttachments[0].blendEnable = VK_FALSE;
-    blendAttachments[1].colorWriteMask = 0xf;
-    blendAttachments[1].blendEnable = VK_FALSE;
-    blendAttachments[2].colorWriteMask = 0xf;
-    blendAttachments[2].blendEnable = VK_FALSE;
+    VkPipelineColorBlendAttachmentState blendAttachments[VULKAN_GBUFFER_TARGET_COUNT] = {};
+    for(u32 i = 0; i < VULKAN_GBUFFER_TARGET_COUNT; ++i)
+    {
+        blendAttachments[i].colorWriteMask  = 0xf;
+        blendAttachments[i].blendEnable     = VK_FALSE;
+    }
 
     const VertexDeclaration* vtx = getVertexDeclarationByName("PosColorUvN");
+    const VertexDeclaration* vtxInstanced = getVertexDeclarationByName("PosColorUvNInstanced");
     VkDescriptorSetLayout layouts[2] = {
         outShader->globalGeometryDescriptorSetLayout,
-        outShader->objectGeometryDescriptorSetLayout
+        bindless ? bindless->layout : outShader->objectGeometryDescriptorSetLayout
     };
 
     vulkanCreateGraphicsPipeline(
         device,
         &outShader->geometryRenderpass,
-        vtx->size,
-        vtx->layout,
+        vtxInstanced->size,
+        vtxInstanced->layout,
         geometryShaderStages.size(),
         geometryShaderStages.data(),
         2,
         layouts,
-        3,
+        VULKAN_GBUFFER_TARGET_COUNT,
         blendAttachments,
         VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
         viewport,
@@ -436,39 +632,56 @@ vulkanDeferredShaderCreate(
     );
 
     // Create light - Presenting pipeline
-    VkDescriptorPoolSize lightPoolSize;
-    lightPoolSize.type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    lightPoolSize.descriptorCount    = 3 * 3;
+    VkDescriptorPoolSize lightPoolSize[3];
+    lightPoolSize[0].type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    lightPoolSize[0].descriptorCount    = frameCount * (VULKAN_GBUFFER_TARGET_COUNT + 1);
+    lightPoolSize[1].type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    lightPoolSize[1].descriptorCount    = frameCount * 2;
+    lightPoolSize[2].type               = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    lightPoolSize[2].descriptorCount    = frameCount;
 
     VkDescriptorPoolCreateInfo lightPoolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-    lightPoolInfo.maxSets        = 3;
-    lightPoolInfo.poolSizeCount  = 1;
-    lightPoolInfo.pPoolSizes     = &lightPoolSize;
+    lightPoolInfo.maxSets        = frameCount;
+    lightPoolInfo.poolSizeCount  = 3;
+    lightPoolInfo.pPoolSizes     = lightPoolSize;
 
     VK_CHECK(vkCreateDescriptorPool(device.handle, &lightPoolInfo, nullptr, &outShader->lightDescriptorPool));
 
     VkDescriptorSetLayoutBinding gbufferBinding{};
     gbufferBinding.binding           = 0;
-    gbufferBinding.descriptorCount   = 3;
+    gbufferBinding.descriptorCount   = VULKAN_GBUFFER_TARGET_COUNT;
     gbufferBinding.descriptorType    = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     gbufferBinding.stageFlags        = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     VkDescriptorSetLayoutBinding lightsBinding{};
     lightsBinding.binding           = 1;
     lightsBinding.descriptorCount   = 1;
-    lightsBinding.descriptorType    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    lightsBinding.descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     lightsBinding.stageFlags        = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     VkDescriptorSetLayoutBinding cameraBinding{};
     cameraBinding.binding           = 2;
     cameraBinding.descriptorCount   = 1;
-    cameraBinding.descriptorType    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    cameraBinding.descriptorType    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     cameraBinding.stageFlags        = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    VkDescriptorSetLayoutBinding deferredBindings[3] = {gbufferBinding, lightsBinding, cameraBinding};
+    VkDescriptorSetLayoutBinding clustersBinding{};
+    clustersBinding.binding         = 3;
+    clustersBinding.descriptorCount = 1;
+    clustersBinding.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    clustersBinding.stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    // Compact layout only.
+    VkDescriptorSetLayoutBinding depthBinding{};
+    depthBinding.binding            = 4;
+    depthBinding.descriptorCount    = 1;
+    depthBinding.descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    depthBinding.stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding deferredBindings[5] = {gbufferBinding, lightsBinding, cameraBinding, clustersBinding, depthBinding};
 
     VkDescriptorSetLayoutCreateInfo lightLayoutInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
-    lightLayoutInfo.bindingCount = 3;
+    lightLayoutInfo.bindingCount = compact ? 5 : 4;
     lightLayoutInfo.pBindings    = deferredBindings;
     lightLayoutInfo.flags        = 0;
 
@@ -511,11 +724,9 @@ vulkanDeferredShaderCreate(
         &outShader->lightPipeline
     );
 
-    VkDescriptorSetLayout deferredLayouts[3] = {
-        outShader->lightDescriptorSetLayout,
-        outShader->lightDescriptorSetLayout,
-        outShader->lightDescriptorSetLayout
-    };
+    VkDescriptorSetLayout deferredLayouts[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    for(u32 frame = 0; frame < frameCount; ++frame)
+        deferredLayouts[frame] = outShader->lightDescriptorSetLayout;
 
     VkDescriptorSetAllocateInfo descSetAllocInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
     descSetAllocInfo.descriptorPool     = outShader->geometryDescriptorPool;
@@ -525,10 +736,68 @@ vulkanDeferredShaderCreate(
 
     VkDescriptorSetAllocateInfo descriptorSetAllocInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
     descriptorSetAllocInfo.descriptorPool       = outShader->lightDescriptorPool;
-    descriptorSetAllocInfo.descriptorSetCount   = static_cast<u32>(swapchain.images.size());
+    descriptorSetAllocInfo.descriptorSetCount   = frameCount;
     descriptorSetAllocInfo.pSetLayouts          = deferredLayouts;
     
     VK_CHECK(vkAllocateDescriptorSets(device.handle, &descriptorSetAllocInfo, outShader->lightDescriptorSet));
+
+    // Camera, lights and clusters live in the uniform ring. The sets are written once,
+    // the data of each frame is picked with dynamic offsets when binding.
+    VkDescriptorBufferInfo cameraInfo;
+    cameraInfo.buffer   = uniformRing.buffer.handle;
+    cameraInfo.offset   = 0;
+    cameraInfo.range    = sizeof(ViewProjectionBuffer);
+
+    VkDescriptorBufferInfo lightInfo;
+    lightInfo.buffer    = uniformRing.buffer.handle;
+    lightInfo.offset    = 0;
+    lightInfo.range     = VULKAN_LIGHT_BUFFER_SIZE;
+
+    VkDescriptorBufferInfo clustersInfo;
+    clustersInfo.buffer = uniformRing.buffer.handle;
+    clustersInfo.offset = 0;
+    clustersInfo.range  = VULKAN_LIGHT_CLUSTER_BUFFER_SIZE;
+
+    VkWriteDescriptorSet geometryCameraWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    geometryCameraWrite.descriptorCount   = 1;
+    geometryCameraWrite.descriptorType    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    geometryCameraWrite.dstArrayElement   = 0;
+    geometryCameraWrite.dstBinding        = 0;
+    geometryCameraWrite.dstSet            = outShader->globalGeometryDescriptorSet;
+    geometryCameraWrite.pBufferInfo       = &cameraInfo;
+    vkUpdateDescriptorSets(device.handle, 1, &geometryCameraWrite, 0, nullptr);
+
+    for(u32 i = 0; i < frameCount; ++i)
+    {
+        VkWriteDescriptorSet lightWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        lightWrite.descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        lightWrite.descriptorCount  = 1;
+        lightWrite.dstBinding       = 1;
+        lightWrite.dstArrayElement  = 0;
+        lightWrite.pBufferInfo      = &lightInfo;
+        lightWrite.dstSet           = outShader->lightDescriptorSet[i];
+
+        VkWriteDescriptorSet cameraWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        cameraWrite.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        cameraWrite.descriptorCount = 1;
+        cameraWrite.dstBinding      = 2;
+        cameraWrite.dstArrayElement = 0;
+        cameraWrite.pBufferInfo     = &cameraInfo;
+        cameraWrite.dstSet          = outShader->lightDescriptorSet[i];
+
+        VkWriteDescriptorSet clustersWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        clustersWrite.descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        clustersWrite.descriptorCount   = 1;
+        clustersWrite.dstBinding        = 3;
+        clustersWrite.dstArrayElement   = 0;
+        clustersWrite.pBufferInfo       = &clustersInfo;
+        clustersWrite.dstSet            = outShader->lightDescriptorSet[i];
+
+        VkWriteDescriptorSet writes[3] = {lightWrite, cameraWrite, clustersWrite};
+        vkUpdateDescriptorSets(device.handle, 3, writes, 0, nullptr);
+
+        writeGbufferDescriptors(device, i, *outShader);
+    }
 }
 
 void
@@ -536,23 +805,17 @@ vulkanDeferredShaderDestroy(
     const VulkanDevice& device,
     VulkanDeferredShader& shader)
 {
+    if(!device.bindless)
+        vulkanBufferDestroy(device, shader.objectUbo);
 
-    vulkanBufferDestroy(device, shader.globalUbo);
-    vulkanBufferDestroy(device, shader.objectUbo);
-    vulkanBufferDestroy(device, shader.lightUbo);
-
-    vkFreeMemory(device.handle, shader.gbuf.positonTxt.image.memory, nullptr);
-    vkFreeMemory(device.handle, shader.gbuf.normalTxt.image.memory, nullptr);
-    vkFreeMemory(device.handle, shader.gbuf.albedoTxt.image.memory, nullptr);
-    vkDestroyImageView(device.handle, shader.gbuf.positonTxt.image.view, nullptr);
-    vkDestroyImageView(device.handle, shader.gbuf.normalTxt.image.view, nullptr);
-    vkDestroyImageView(device.handle, shader.gbuf.albedoTxt.image.view, nullptr);
-    vkDestroyImage(device.handle, shader.gbuf.positonTxt.image.handle, nullptr);
-    vkDestroyImage(device.handle, shader.gbuf.normalTxt.image.handle, nullptr);
-    vkDestroyImage(device.handle, shader.gbuf.albedoTxt.image.handle, nullptr);
-    vkDestroySampler(device.handle, shader.gbuf.positonTxt.sampler, nullptr);
-    vkDestroySampler(device.handle, shader.gbuf.normalTxt.sampler, nullptr);
-    vkDestroySampler(device.handle, shader.gbuf.albedoTxt.sampler, nullptr);
+    for(u32 frame = 0; frame < shader.frameCount; ++frame)
+    {
+        for(u32 i = 0; i < VULKAN_GBUFFER_TARGET_COUNT; ++i)
+            destroyTexture(device, shader.gbuf.targets[frame][i]);
+        destroyTexture(device, shader.geometryDepth[frame]);
+        vkDestroySemaphore(device.handle, shader.geometrySemaphore[frame], nullptr);
+        vkDestroyFramebuffer(device.handle, shader.geometryFramebuffer[frame].handle, nullptr);
+    }
 
     // Geometry destruction
     vkDestroyShaderModule(device.handle, shader.shaderStages[0].shaderModule, nullptr);
@@ -566,8 +829,6 @@ vulkanDeferredShaderDestroy(
     vkDestroyDescriptorSetLayout(device.handle, shader.objectGeometryDescriptorSetLayout, nullptr);
     vkDestroyDescriptorSetLayout(device.handle, shader.lightDescriptorSetLayout, nullptr);
 
-    vkDestroySemaphore(device.handle, shader.geometrySemaphore, nullptr);
-
     vulkanDestroyGrapchisPipeline(device, &shader.geometryPipeline);
     vulkanDestroyGrapchisPipeline(device, &shader.lightPipeline);
 
@@ -575,103 +836,17 @@ vulkanDeferredShaderDestroy(
     vkDestroyRenderPass(device.handle, shader.lightRenderpass.handle, nullptr);
 
     vkDestroyCommandPool(device.handle, shader.geometryCmdPool, nullptr);
-    vkDestroyFramebuffer(device.handle, shader.geometryFramebuffer.handle, nullptr);
-    for(u32 i = 0; i < 3; ++i) {
-        vkDestroyFramebuffer(device.handle, shader.lightFramebuffer[i].handle, nullptr);
-    }
+    destroyLightFramebuffers(device, shader);
 }
 
 void
-vulkanDeferredUpdateGlobalData(
+vulkanDeferredShaderRecreateLightFramebuffers(
     const VulkanDevice& device,
+    const VulkanSwapchain& swapchain,
     VulkanDeferredShader& shader)
 {
-    VkDescriptorBufferInfo info;
-    info.buffer = shader.globalUbo.handle;
-    info.offset = 0;
-    info.range  = sizeof(ViewProjectionBuffer);
-
-    VkWriteDescriptorSet cameraWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-    cameraWrite.descriptorCount   = 1;
-    cameraWrite.descriptorType    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    cameraWrite.dstArrayElement   = 0;
-    cameraWrite.dstBinding        = 0;
-    cameraWrite.dstSet            = shader.globalGeometryDescriptorSet;
-    cameraWrite.pBufferInfo       = &info;
-
-    vkUpdateDescriptorSets(device.handle, 1, &cameraWrite, 0, nullptr);
-
-    vkCmdBindDescriptorSets(
-        shader.geometryCmdBuffer.handle, 
-        VK_PIPELINE_BIND_POINT_GRAPHICS, 
-        shader.geometryPipeline.layout, 
-        0, 
-        1, 
-        &shader.globalGeometryDescriptorSet, 
-        0, 
-        nullptr);
-};
-
-void
-vulkanDeferredUpdateGbuffers(
-    const VulkanDevice& device,
-    const u32 imageIndex,
-    VulkanDeferredShader& shader)
-{
-    VkDescriptorImageInfo textDescPosition;
-    textDescPosition.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    textDescPosition.imageView  = shader.gbuf.positonTxt.image.view;
-    textDescPosition.sampler    = shader.gbuf.positonTxt.sampler;
-
-    VkDescriptorImageInfo textDescNormal;
-    textDescNormal.imageLayout  = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    textDescNormal.imageView    = shader.gbuf.normalTxt.image.view;
-    textDescNormal.sampler      = shader.gbuf.normalTxt.sampler;
-
-    VkDescriptorImageInfo textDescAlbedo;
-    textDescAlbedo.imageLayout  = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    textDescAlbedo.imageView    = shader.gbuf.albedoTxt.image.view;
-    textDescAlbedo.sampler      = shader.gbuf.albedoTxt.sampler;
-
-    VkDescriptorImageInfo descInfos[3] = {textDescPosition, textDescNormal, textDescAlbedo};
-
-    VkWriteDescriptorSet gbufferWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-    gbufferWrite.descriptorType    = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    gbufferWrite.descriptorCount   = 3;
-    gbufferWrite.dstBinding        = 0;
-    gbufferWrite.dstArrayElement   = 0;
-    gbufferWrite.pImageInfo        = descInfos;
-    gbufferWrite.dstSet            = shader.lightDescriptorSet[imageIndex];
-
-    VkDescriptorBufferInfo lightBufferInfo;
-    lightBufferInfo.buffer  = shader.lightUbo.handle;
-    lightBufferInfo.offset  = 0;
-    lightBufferInfo.range   = sizeof(VulkanLightData) * MAX_LIGHTS;
-
-    VkWriteDescriptorSet lightWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-    lightWrite.descriptorType   = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    lightWrite.descriptorCount  = 1;
-    lightWrite.dstBinding       = 1;
-    lightWrite.dstArrayElement  = 0;
-    lightWrite.pBufferInfo      = &lightBufferInfo;
-    lightWrite.dstSet           = shader.lightDescriptorSet[imageIndex];
-
-    VkDescriptorBufferInfo cameraBufferInfo;
-    cameraBufferInfo.buffer = shader.globalUbo.handle;
-    cameraBufferInfo.offset = 0;
-    cameraBufferInfo.range = sizeof(ViewProjectionBuffer);
-
-    VkWriteDescriptorSet cameraWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-    cameraWrite.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    cameraWrite.descriptorCount = 1;
-    cameraWrite.dstBinding      = 2;
-    cameraWrite.dstArrayElement = 0;
-    cameraWrite.pBufferInfo     = &cameraBufferInfo;
-    cameraWrite.dstSet          = shader.lightDescriptorSet[imageIndex];
-
-    VkWriteDescriptorSet writes[3] = {gbufferWrite, lightWrite, cameraWrite};
-    
-    vkUpdateDescriptorSets(device.handle, 3, writes, 0, nullptr);
+    destroyLightFramebuffers(device, shader);
+    createLightFramebuffers(device, swapchain, swapchain.extent.width, swapchain.extent.height, &shader);
 }
 
 bool 
@@ -697,14 +872,12 @@ vulkanDeferredShaderGetMaterial(
     return true;
 }
 
-void
-vulkanDeferredShaderSetMaterial(
+VkDescriptorSet
+vulkanDeferredShaderUpdateMaterial(
     VulkanState* pState,
     VulkanDeferredShader* shader,
     Material* m)
 {
-    u32 index = pState->imageIndex;
-    
     // TODO make the number of writes as global value
     VkWriteDescriptorSet writes[4];
     u32 descriptorCount = 0;
@@ -714,7 +887,7 @@ vulkanDeferredShaderSetMaterial(
     u32 offset = range * m->rendererId;
     VulkanMaterialShaderUBO ubo{};
     ubo.diffuseColor = m->diffuseColor;
-    vulkanBufferLoadData(pState->device, shader->objectUbo, offset, range, 0, &ubo);
+    memCopy(&ubo, shader->objectData + offset, range);
 
     VulkanObjectDescriptor* descriptor = &shader->objectGeometryDescriptor[m->rendererId];
 
@@ -796,5 +969,5 @@ vulkanDeferredShaderSetMaterial(
     if(descriptorCount > 0)
         vkUpdateDescriptorSets(pState->device.handle, descriptorCount, writes, 0, nullptr);
 
-    vkCmdBindDescriptorSets(shader->geometryCmdBuffer.handle, VK_PIPELINE_BIND_POINT_GRAPHICS, shader->geometryPipeline.layout, 1, 1, &descriptor->descriptorSet, 0, nullptr);
+    return descriptor->descriptorSet;
 }
\ No newline at end of file
@@ -2,10 +2,22 @@
 
 #include "../vulkanTypes.h"
 
+/**
+ * Creates the geometry and light passes. With bindless the geometry
+ * pipeline takes its materials from the bindless set, else nullptr.
+ * The G-buffer layout picks the targets and the shader variants, the
+ * traffic of both layouts is logged. Each of the frameCount frames in
+ * flight gets its own G-buffer, light set, geometry command buffer and
+ * semaphore.
+ */
 void
 vulkanDeferredShaderCreate(
     const VulkanDevice& device,
     const VulkanSwapchain& swapchain,
+    const VulkanRingBuffer& uniformRing,
+    const VulkanBindless* bindless,
+    RenderGbufferLayout gbufferLayout,
+    u32 frameCount,
     u32 width,
     u32 height,
     VulkanDeferredShader* outShader);
@@ -15,15 +27,14 @@ vulkanDeferredShaderDestroy(
     const VulkanDevice& device,
     VulkanDeferredShader& shader);
 
+/**
+ * The light framebuffers point to the swapchain images, they are created
+ * again with the swapchain. The G-buffers keep their size.
+ */
 void
-vulkanDeferredUpdateGlobalData(
+vulkanDeferredShaderRecreateLightFramebuffers(
     const VulkanDevice& device,
-    VulkanDeferredShader& shader);
-
-void
-vulkanDeferredUpdateGbuffers(
-    const VulkanDevice& device,
-    const u32 imageIndex,
+    const VulkanSwapchain& swapchain,
     VulkanDeferredShader& shader);
 
 bool 
@@ -32,8 +43,13 @@ vulkanDeferredShaderGetMaterial(
     VulkanDeferredShader* shader,
     Material* m);
 
-void
-vulkanDeferredShaderSetMaterial(
+/**
+ * Uploads the material data and writes its descriptors when they changed.
+ * Returns the descriptor set of the material to bind at set 1. Not thread
+ * safe, called on the main thread before recording the draws.
+ */
+VkDescriptorSet
+vulkanDeferredShaderUpdateMaterial(
     VulkanState* pState,
     VulkanDeferredShader* shader,
     Material* m);
\ No newline at end of file
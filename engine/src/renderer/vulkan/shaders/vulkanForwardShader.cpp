@@ -16,24 +16,15 @@ bool vulkanCreateForwardShader(
     VulkanState* pState,
     VulkanForwardShader* outShader)
 {
-    // Create the buffer holding the data to upload to the GPU
-    vulkanBufferCreate(
-        pState->device, 
-        sizeof(ViewProjectionBuffer),
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &outShader->globalUbo);
-
-    vulkanBufferCreate(
-        pState->device,
-        sizeof(VulkanLightData) * MAX_LIGHTS,
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &outShader->lightUbo);
-
     // Compile hardcoded shaders
+    // The bindless variant reads the material from the bindless set.
+    const bool bindless = pState->device.bindless;
     system("glslc ./data/shaders/shader.vert -o ./data/shaders/vert.spv");
-    system("glslc ./data/shaders/shader.frag -o ./data/shaders/frag.spv");
+    if(bindless) {
+        system("glslc -DBINDLESS ./data/shaders/shader.frag -o ./data/shaders/frag_bindless.spv");
+    } else {
+        system("glslc ./data/shaders/shader.frag -o ./data/shaders/frag.spv");
+    }
 
     // Shader modules creation
     std::vector<char> vertexBuffer;
@@ -42,7 +33,7 @@ bool vulkanCreateForwardShader(
     }
 
     std::vector<char> fragBuffer;
-    if(!readShaderFile("./data/shaders/frag.spv", fragBuffer)){
+    if(!readShaderFile(bindless ? "./data/shaders/frag_bindless.spv" : "./data/shaders/frag.spv", fragBuffer)){
         return false;
     }
 
@@ -55,27 +46,29 @@ bool vulkanCreateForwardShader(
     outShader->samplerUses[2] = TEXTURE_USE_METALLIC_ROUGHNESS;
 
     // Create global descriptor pool
-    VkDescriptorPoolSize descriptorPoolSize;
-    descriptorPoolSize.descriptorCount  = static_cast<u32>(pState->swapchain.images.size()) * 4;
-    descriptorPoolSize.type             = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    VkDescriptorPoolSize descriptorPoolSize[2];
+    descriptorPoolSize[0].descriptorCount   = pState->framesInFlight;
+    descriptorPoolSize[0].type              = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorPoolSize[1].descriptorCount   = pState->framesInFlight;
+    descriptorPoolSize[1].type              = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
 
     VkDescriptorPoolCreateInfo descriptorPoolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-    descriptorPoolInfo.poolSizeCount    = 1;
-    descriptorPoolInfo.pPoolSizes       = &descriptorPoolSize;
-    descriptorPoolInfo.maxSets          = static_cast<u32>(pState->swapchain.images.size());
+    descriptorPoolInfo.poolSizeCount    = 2;
+    descriptorPoolInfo.pPoolSizes       = descriptorPoolSize;
+    descriptorPoolInfo.maxSets          = pState->framesInFlight;
 
     VK_CHECK(vkCreateDescriptorPool(pState->device.handle, &descriptorPoolInfo, nullptr, &outShader->globalDescriptorPool));
 
     VkDescriptorSetLayoutBinding cameraBinding{};
     cameraBinding.binding         = 0;
     cameraBinding.descriptorCount = 1;
-    cameraBinding.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    cameraBinding.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     cameraBinding.stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
 
     VkDescriptorSetLayoutBinding lightBinding{};
     lightBinding.binding            = 1;
     lightBinding.descriptorCount    = 1;
-    lightBinding.descriptorType     = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    lightBinding.descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     lightBinding.stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     VkDescriptorSetLayoutBinding globalBindings[2] = {cameraBinding, lightBinding};
@@ -86,54 +79,59 @@ bool vulkanCreateForwardShader(
 
     VK_CHECK(vkCreateDescriptorSetLayout(pState->device.handle, &info, nullptr, &outShader->globalDescriptorSetLayout));
 
-    // Objects descriptor pool and layout
-    // Also creates the buffer holding all possible object materials.
-
-    u32 objectMaterialSize = sizeof(VulkanMaterialShaderUBO) * VULKAN_MAX_MATERIAL_COUNT;
-    vulkanBufferCreate(
-        pState->device, 
-        objectMaterialSize, 
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-        &outShader->meshInstanceBuffer);
-
-    VkDescriptorPoolSize objectDescriptorPoolSize[2];
-    objectDescriptorPoolSize[0].descriptorCount    = VULKAN_MAX_MATERIAL_COUNT;
-    objectDescriptorPoolSize[0].type               = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    objectDescriptorPoolSize[1].descriptorCount    = VULKAN_FORWARD_MATERIAL_SAMPLER_COUNT * VULKAN_MAX_MATERIAL_COUNT;
-    objectDescriptorPoolSize[1].type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-
-    VkDescriptorPoolCreateInfo objectDescriptorPoolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
-    objectDescriptorPoolInfo.poolSizeCount  = 2;
-    objectDescriptorPoolInfo.pPoolSizes     = objectDescriptorPoolSize;
-    objectDescriptorPoolInfo.maxSets        = VULKAN_MAX_MATERIAL_COUNT;
-    objectDescriptorPoolInfo.flags          = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-
-    VK_CHECK(vkCreateDescriptorPool(pState->device.handle, &objectDescriptorPoolInfo, nullptr, &outShader->meshInstanceDescriptorPool));
-
-    VkDescriptorSetLayoutBinding bindings[VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT];
-
-    VkDescriptorType descriptorTypes[VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT] = {
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
-    };
-
-    memZero(bindings, sizeof(VkDescriptorSetLayoutBinding) * VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT);
-    for(u32 i = 0; i < VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT; ++i)
+    // Objects descriptor pool and layout, one set per material.
+    // Bindless materials share the set of the backend instead.
+    if(!bindless)
     {
-        bindings[i].binding = i;
-        bindings[i].descriptorCount = 1;
-        bindings[i].descriptorType = descriptorTypes[i];
-        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    }
+        // Also creates the buffer holding all possible object materials.
+
+        u32 objectMaterialSize = sizeof(VulkanMaterialShaderUBO) * VULKAN_MAX_MATERIAL_COUNT;
+        vulkanBufferCreate(
+            pState->device, 
+            objectMaterialSize, 
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+            &outShader->meshInstanceBuffer);
+        outShader->meshInstanceData = outShader->meshInstanceBuffer.allocation.mapped;
+
+        VkDescriptorPoolSize objectDescriptorPoolSize[2];
+        objectDescriptorPoolSize[0].descriptorCount    = VULKAN_MAX_MATERIAL_COUNT;
+        objectDescriptorPoolSize[0].type               = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        objectDescriptorPoolSize[1].descriptorCount    = VULKAN_FORWARD_MATERIAL_SAMPLER_COUNT * VULKAN_MAX_MATERIAL_COUNT;
+        objectDescriptorPoolSize[1].type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+        VkDescriptorPoolCreateInfo objectDescriptorPoolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        objectDescriptorPoolInfo.poolSizeCount  = 2;
+        objectDescriptorPoolInfo.pPoolSizes     = objectDescriptorPoolSize;
+        objectDescriptorPoolInfo.maxSets        = VULKAN_MAX_MATERIAL_COUNT;
+        objectDescriptorPoolInfo.flags          = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+        VK_CHECK(vkCreateDescriptorPool(pState->device.handle, &objectDescriptorPoolInfo, nullptr, &outShader->meshInstanceDescriptorPool));
+
+        VkDescriptorSetLayoutBinding bindings[VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT];
+
+        VkDescriptorType descriptorTypes[VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT] = {
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+        };
+
+        memZero(bindings, sizeof(VkDescriptorSetLayoutBinding) * VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT);
+        for(u32 i = 0; i < VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT; ++i)
+        {
+            bindings[i].binding = i;
+            bindings[i].descriptorCount = 1;
+            bindings[i].descriptorType = descriptorTypes[i];
+            bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
 
-    VkDescriptorSetLayoutCreateInfo objectBindingInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
-    objectBindingInfo.bindingCount  = VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT;
-    objectBindingInfo.pBindings     = bindings;
+        VkDescriptorSetLayoutCreateInfo objectBindingInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        objectBindingInfo.bindingCount  = VULKAN_FORWARD_MATERIAL_DESCRIPTOR_COUNT;
+        objectBindingInfo.pBindings     = bindings;
 
-    VK_CHECK(vkCreateDescriptorSetLayout(pState->device.handle, &objectBindingInfo, nullptr, &outShader->meshInstanceDescriptorSetLayout));
+        VK_CHECK(vkCreateDescriptorSetLayout(pState->device.handle, &objectBindingInfo, nullptr, &outShader->meshInstanceDescriptorSetLayout));
+    }
 
     std::vector<VkPipelineShaderStageCreateInfo> shaderStages(2);
 
@@ -164,14 +162,14 @@ bool vulkanCreateForwardShader(
     const i32 descriptorSetLayoutCount = 2;
     VkDescriptorSetLayout layouts[descriptorSetLayoutCount] = {
         outShader->globalDescriptorSetLayout,
-        outShader->meshInstanceDescriptorSetLayout
+        bindless ? pState->bindless.layout : outShader->meshInstanceDescriptorSetLayout
     };
 
     VkPipelineColorBlendAttachmentState colorBlendAttachment{};
     colorBlendAttachment.blendEnable = VK_FALSE;
     colorBlendAttachment.colorWriteMask = 0xf;
 
-    const VertexDeclaration* vtx = getVertexDeclarationByName("PosColorUvN");
+    const VertexDeclaration* vtx = getVertexDeclarationByName("PosColorUvNInstanced");
 
     vulkanCreateGraphicsPipeline(
         pState->device,
@@ -200,19 +198,52 @@ bool vulkanCreateForwardShader(
 
     VkDescriptorSetAllocateInfo descriptorSetAllocInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
     descriptorSetAllocInfo.descriptorPool       = outShader->globalDescriptorPool;
-    descriptorSetAllocInfo.descriptorSetCount   = static_cast<u32>(pState->swapchain.images.size());
+    descriptorSetAllocInfo.descriptorSetCount   = pState->framesInFlight;
     descriptorSetAllocInfo.pSetLayouts          = globalLayouts;
     
     VK_CHECK(vkAllocateDescriptorSets(pState->device.handle, &descriptorSetAllocInfo, outShader->globalDescriptorSet));
+
+    // Camera and lights live in the uniform ring. The sets are written once,
+    // the data of each frame is picked with dynamic offsets when binding.
+    VkDescriptorBufferInfo cameraInfo{};
+    cameraInfo.buffer   = pState->uniformRing.buffer.handle;
+    cameraInfo.offset   = 0;
+    cameraInfo.range    = sizeof(ViewProjectionBuffer);
+
+    VkDescriptorBufferInfo lightInfo{};
+    lightInfo.buffer    = pState->uniformRing.buffer.handle;
+    lightInfo.offset    = 0;
+    lightInfo.range     = VULKAN_LIGHT_BUFFER_SIZE;
+
+    for(u32 i = 0; i < pState->framesInFlight; ++i)
+    {
+        VkWriteDescriptorSet cameraWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        cameraWrite.dstBinding        = 0;
+        cameraWrite.dstArrayElement   = 0;
+        cameraWrite.descriptorCount   = 1;
+        cameraWrite.descriptorType    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        cameraWrite.pBufferInfo       = &cameraInfo;
+        cameraWrite.dstSet            = outShader->globalDescriptorSet[i];
+
+        VkWriteDescriptorSet lightWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        lightWrite.dstBinding       = 1;
+        lightWrite.dstArrayElement  = 0;
+        lightWrite.descriptorCount  = 1;
+        lightWrite.descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        lightWrite.pBufferInfo      = &lightInfo;
+        lightWrite.dstSet           = outShader->globalDescriptorSet[i];
+
+        VkWriteDescriptorSet writes[2] = {cameraWrite, lightWrite};
+        vkUpdateDescriptorSets(pState->device.handle, 2, writes, 0, nullptr);
+    }
     return true;
 }
 
 void
 vulkanDestroyForwardShader(VulkanState* pState)
 {
-    vulkanBufferDestroy(pState->device, pState->forwardShader.globalUbo);
-    vulkanBufferDestroy(pState->device, pState->forwardShader.lightUbo);
-    vulkanBufferDestroy(pState->device, pState->forwardShader.meshInstanceBuffer);
+    if(!pState->device.bindless)
+        vulkanBufferDestroy(pState->device, pState->forwardShader.meshInstanceBuffer);
 
     vkDestroyShaderModule(pState->device.handle, pState->forwardShader.shaderStages[0].shaderModule, nullptr);
     vkDestroyShaderModule(pState->device.handle, pState->forwardShader.shaderStages[1].shaderModule, nullptr);
@@ -229,51 +260,6 @@ vulkanDestroyForwardShader(VulkanState* pState)
     vkDestroyPipelineLayout(pState->device.handle, pState->forwardShader.pipeline.layout, nullptr);
 }
 
-void 
-vulkanForwardShaderUpdateGlobalData(VulkanState* pState)
-{
-    VkDescriptorBufferInfo globalUboInfo{};
-    globalUboInfo.buffer    = pState->forwardShader.globalUbo.handle;
-    globalUboInfo.offset    = 0;
-    globalUboInfo.range     = sizeof(ViewProjectionBuffer);
-
-    // Write global shader descriptor
-    VkWriteDescriptorSet cameraWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-    cameraWrite.dstBinding        = 0;
-    cameraWrite.dstArrayElement   = 0;
-    cameraWrite.descriptorCount   = 1;
-    cameraWrite.descriptorType    = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    cameraWrite.pBufferInfo       = &globalUboInfo;
-    cameraWrite.dstSet            = pState->forwardShader.globalDescriptorSet[pState->imageIndex];
-
-    VkDescriptorBufferInfo lightUboInfo{};
-    lightUboInfo.buffer    = pState->forwardShader.lightUbo.handle;
-    lightUboInfo.offset    = 0;
-    lightUboInfo.range     = sizeof(VulkanLightData) * MAX_LIGHTS;
-
-    VkWriteDescriptorSet lightWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-    lightWrite.dstBinding       = 1;
-    lightWrite.dstArrayElement  = 0;
-    lightWrite.descriptorCount  = 1;
-    lightWrite.descriptorType   = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    lightWrite.pBufferInfo      = &lightUboInfo;
-    lightWrite.dstSet           = pState->forwardShader.globalDescriptorSet[pState->imageIndex];
-
-    VkWriteDescriptorSet writes[2] = {cameraWrite, lightWrite};
-
-    vkUpdateDescriptorSets(pState->device.handle, 2, writes, 0, nullptr);
-
-    VkDeviceSize offset = {0};
-    vkCmdBindDescriptorSets(
-        pState->commandBuffers[pState->imageIndex].handle, 
-        VK_PIPELINE_BIND_POINT_GRAPHICS, 
-        pState->forwardShader.pipeline.layout,
-        0,
-        1,
-        &pState->forwardShader.globalDescriptorSet[pState->imageIndex],
-        0, nullptr);
-}
-
 bool vulkanForwardShaderGetMaterial(
     VulkanState* pState,
     VulkanForwardShader* shader,
@@ -306,15 +292,14 @@ bool vulkanForwardShaderGetMaterial(
     return true;
 }
 
-void
-vulkanForwardShaderSetMaterial(
+VkDescriptorSet
+vulkanForwardShaderUpdateMaterial(
     VulkanState* pState,
     VulkanForwardShader* shader,
     Material* m)
 {
-    // Helpers for the index and the command buffer to write to.
-    u32 index = pState->imageIndex;
-    VkCommandBuffer cmd = pState->commandBuffers[index].handle;
+    // Helper for the index of the descriptor set to write to, the GPU may still read the other frames.
+    u32 index = pState->currentFrame;
 
     // Material data
     VulkanMaterialInstance* materialInstance = &shader->materialInstances[m->rendererId];
@@ -334,7 +319,7 @@ vulkanForwardShaderSetMaterial(
     // Upload the data to the ubo.
     VulkanMaterialShaderUBO ubo{};
     ubo.diffuseColor = m->diffuseColor;
-    vulkanBufferLoadData(pState->device, shader->meshInstanceBuffer, offset, range, 0, &ubo);
+    memCopy(&ubo, shader->meshInstanceData + offset, range);
 
     // If descriptor has not been updated, generate the writes.
     if(materialInstance->descriptorState[descriptorIndex].generations[index] == INVALID_ID || 
@@ -416,5 +401,5 @@ vulkanForwardShaderSetMaterial(
     if(descriptorCount > 0)
         vkUpdateDescriptorSets(pState->device.handle, descriptorCount, writes, 0, nullptr);
 
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shader->pipeline.layout, 1, 1, &descriptorSet, 0, nullptr);
+    return descriptorSet;
 }
\ No newline at end of file
@@ -11,17 +11,19 @@ vulkanCreateForwardShader(
 void
 vulkanDestroyForwardShader(VulkanState* pState);
 
-void 
-vulkanForwardShaderUpdateGlobalData(VulkanState* pState);
-
 bool 
 vulkanForwardShaderGetMaterial(
     VulkanState* pState,
     VulkanForwardShader* shader,
     Material* m);
 
-void
-vulkanForwardShaderSetMaterial(
+/**
+ * Uploads the material data and writes its descriptors when they changed.
+ * Returns the descriptor set of the material to bind at set 1. Not thread
+ * safe, called on the main thread before recording the draws.
+ */
+VkDescriptorSet
+vulkanForwardShaderUpdateMaterial(
     VulkanState* pState,
     VulkanForwardShader* shader,
     Material* m);
\ No newline at end of file
@@ -8,6 +8,10 @@
 #include "vulkanBuffer.h"
 #include "vulkanCommandBuffer.h"
 #include "vulkanImage.h"
+#include "vulkanBindless.h"
+#include "vulkanIndirect.h"
+#include "vulkanMemory.h"
+#include "vulkanUpload.h"
 #include "vulkanUtils.h"
 #include "vulkanImgui.h"
 #include "vulkanPlatform.h"
@@ -20,10 +24,14 @@
 //#include "systems/entitySystemComponent.h"
 #include "systems/components/comp_transform.h"
 #include "systems/components/comp_light_point.h"
+#include "systems/components/comp_light_spot.h"
 #include "systems/components/comp_name.h"
 #include "systems/components/comp_camera.h"
 
 #include "memory/pmemory.h"
+#include "memory/frameAllocator.h"
+#include "platform/platform.h"
+#include "systems/jobSystem.h"
 
 #define internal static
 
@@ -96,82 +104,188 @@ void vulkanRegenerateFramebuffers(
 
 bool recreateSwapchain();
 
-// TODO review to function per shader pass.
-void vulkanForwardUpdateGlobalState(f32 dt)
+static RenderPresentMode renderPresentMode(VkPresentModeKHR mode)
 {
-    gameTime += dt;
+    switch (mode)
+    {
+    case VK_PRESENT_MODE_MAILBOX_KHR:   return RENDER_PRESENT_MAILBOX;
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return RENDER_PRESENT_IMMEDIATE;
+    default:                            return RENDER_PRESENT_FIFO;
+    }
+}
 
+/**
+ * Writes the camera of the frame to the uniform ring.
+ * Returns its dynamic offset.
+ */
+static u32 pushCamera()
+{
+    // TODO at the moment
     CEntity* hcamera = getEntityByName("camera");
     TCompCamera* cCamera = hcamera->get<TCompCamera>();
 
-    state.forwardShader.globalUboData.view        = cCamera->getView();
-    state.forwardShader.globalUboData.projection  = cCamera->getProjection();
-    state.forwardShader.globalUboData.position    = cCamera->getEye();
+    ViewProjectionBuffer data;
+    data.view                   = cCamera->getView();
+    data.projection             = cCamera->getProjection();
+    data.viewProjection         = data.projection * data.view;
+    data.inverseViewProjection  = glm::inverse(data.viewProjection);
+    data.position               = cCamera->getEye();
+    data.dummy                  = 0.0f;
+
+    u32 offset = 0;
+    void* memory = vulkanRingBufferAllocate(state.uniformRing, sizeof(ViewProjectionBuffer), &offset);
+    if(memory)
+        memCopy(&data, memory, sizeof(ViewProjectionBuffer));
+    return offset;
+}
 
-    vulkanBufferLoadData(state.device, state.forwardShader.globalUbo, 0, sizeof(ViewProjectionBuffer), 0, &state.forwardShader.globalUboData);
+/**
+ * Bounding sphere of a spot light cone. Narrow cones are bounded by the
+ * sphere through the tip and the rim, wide ones by the one around the rim.
+ */
+static glm::vec4 spotLightSphere(glm::vec3 position, glm::vec3 forward, f32 radius, f32 cosineCutoff)
+{
+    if(cosineCutoff > 0.70710678f)
+    {
+        f32 sphereRadius = radius / (2.0f * cosineCutoff);
+        return glm::vec4(position + forward * sphereRadius, sphereRadius);
+    }
+    f32 sineCutoff = glm::sqrt(glm::max(1.0f - cosineCutoff * cosineCutoff, 0.0f));
+    return glm::vec4(position + forward * (radius * cosineCutoff), radius * sineCutoff);
+}
 
-    TCompLightPoint* lightsAddress = getObjectManager<TCompLightPoint>()->getAddress();
-    for(u32 i = 0; i < getObjectManager<TCompLightPoint>()->size(); ++i)
+/**
+ * Packs the enabled point and spot lights of the frame in the uniform ring
+ * with a single sequential write. Returns the dynamic offset of the light
+ * buffer. If outSpheres is given it gets the world bounding sphere of each
+ * packed light, MAX_LIGHTS elements, and outCount their number.
+ */
+static u32 pushLights(glm::vec4* outSpheres = nullptr, u32* outCount = nullptr)
+{
+    f64 start = platformGetCurrentTime();
+    u32 offset = 0;
+    u32 count = 0;
+    u8* memory = (u8*)vulkanRingBufferAllocate(state.uniformRing, VULKAN_LIGHT_BUFFER_SIZE, &offset);
+    if(!memory)
     {
-        TCompLightPoint* l = &lightsAddress[i];
-        if(l->enabled == false)
-            return;
-
-        state.forwardShader.lightData.color     = l->color;
-        state.forwardShader.lightData.intensity = l->intensity;
-        state.forwardShader.lightData.position  = l->getPosition();
-        state.forwardShader.lightData.radius    = l->radius;
-        state.forwardShader.lightData.enabled   = l->enabled;
-        vulkanBufferLoadData(
-            state.device,
-            state.forwardShader.lightUbo,
-            sizeof(VulkanLightData) * i,
-            sizeof(VulkanLightData),
-            0,
-            &state.forwardShader.lightData);
+        if(outCount)
+            *outCount = 0;
+        return offset;
+    }
+
+    VulkanLightData* lights = (VulkanLightData*)(memory + sizeof(VulkanLightHeader));
+
+    auto pointManager = getObjectManager<TCompLightPoint>();
+    for(u32 i = 0; i < pointManager->size() && count < MAX_LIGHTS; ++i)
+    {
+        TCompLightPoint* l = pointManager->getAddressAt(i);
+        if(!l->enabled)
+            continue;
+
+        VulkanLightData data = {};
+        data.position   = l->getPosition();
+        data.intensity  = l->intensity;
+        data.color      = glm::vec3(l->color);
+        data.radius     = l->radius;
+        data.enabled    = 1;
+        data.type       = VULKAN_LIGHT_TYPE_POINT;
+        if(outSpheres)
+            outSpheres[count] = glm::vec4(data.position, data.radius);
+        lights[count++] = data;
+    }
+
+    auto spotManager = getObjectManager<TCompLightSpot>();
+    for(u32 i = 0; i < spotManager->size() && count < MAX_LIGHTS; ++i)
+    {
+        TCompLightSpot* l = spotManager->getAddressAt(i);
+        if(!l->enabled)
+            continue;
+
+        VulkanLightData data = {};
+        data.position       = l->getPosition();
+        data.intensity      = l->intensity;
+        data.color          = glm::vec3(l->color);
+        data.radius         = l->radius;
+        data.forward        = l->getForward();
+        data.cosineCutoff   = l->cosineCutoff;
+        data.spotExponent   = l->spotExponent;
+        data.enabled        = 1;
+        data.type           = VULKAN_LIGHT_TYPE_SPOT;
+        if(outSpheres)
+            outSpheres[count] = spotLightSphere(data.position, data.forward, data.radius, data.cosineCutoff);
+        lights[count++] = data;
     }
 
-    vulkanForwardShaderUpdateGlobalData(&state);
+    VulkanLightHeader header = {};
+    header.count = count;
+    memCopy(&header, memory, sizeof(VulkanLightHeader));
+    if(outCount)
+        *outCount = count;
+    state.frameStats.lightUploadMs += (f32)((platformGetCurrentTime() - start) * 1000.0);
+    return offset;
 }
 
-void
-vulkanDeferredUpdateGlobaState(f32 dt)
+/**
+ * Builds the light lists of the camera clusters and writes them to the
+ * uniform ring. Returns the dynamic offset of the cluster buffer.
+ */
+static u32 pushLightClusters(const glm::vec4* spheres, u32 count)
 {
-    gameTime += dt;
+    u32 offset = 0;
+    u8* memory = (u8*)vulkanRingBufferAllocate(state.uniformRing, VULKAN_LIGHT_CLUSTER_BUFFER_SIZE, &offset);
+    if(!memory)
+        return offset;
 
-    // TODO at the moment
     CEntity* hcamera = getEntityByName("camera");
     TCompCamera* cCamera = hcamera->get<TCompCamera>();
 
-    state.deferredShader.globalUboData.view        = cCamera->getView();
-    state.deferredShader.globalUboData.projection  = cCamera->getProjection();
-    state.deferredShader.globalUboData.position    = cCamera->getEye();
-
-    vulkanBufferLoadData(state.device, state.deferredShader.globalUbo, 0, sizeof(ViewProjectionBuffer), 0, &state.deferredShader.globalUboData);
+    LightClusterView view;
+    lightClusterViewInit(cCamera->getView(), cCamera->getProjection(), cCamera->getNear(), cCamera->getFar(), &view);
 
-    TCompLightPoint* lightsAddress = getObjectManager<TCompLightPoint>()->getAddress();
-    for(u32 i = 0; i < getObjectManager<TCompLightPoint>()->size(); ++i)
-    {
-        TCompLightPoint* l = &lightsAddress[i];
+    // Built in frame memory, the ring is written sequentially once.
+    u32* cells = (u32*)(memory + sizeof(VulkanLightClusterHeader));
+    u32* indices = frameAlloc<u32>(LIGHT_CLUSTER_MAX_INDICES);
+    f64 start = platformGetCurrentTime();
+    u32 indexCount = indices ? lightClustersBuild(view, spheres, count, cells, indices, LIGHT_CLUSTER_MAX_INDICES) : 0;
+    if(!indices)
+        memZero(cells, sizeof(u32) * LIGHT_CLUSTER_COUNT * 2);
+    else
+        memCopy(indices, cells + LIGHT_CLUSTER_COUNT * 2, sizeof(u32) * indexCount);
+
+    state.frameStats.lights         = count;
+    state.frameStats.lightIndices   = indexCount;
+    state.frameStats.lightClusterMs = (f32)((platformGetCurrentTime() - start) * 1000.0);
+
+    VulkanLightClusterHeader header = {};
+    header.dims[0]      = LIGHT_CLUSTER_X;
+    header.dims[1]      = LIGHT_CLUSTER_Y;
+    header.dims[2]      = LIGHT_CLUSTER_Z;
+    header.dims[3]      = indexCount;
+    header.projX        = view.projX;
+    header.projY        = view.projY;
+    header.sliceScale   = view.sliceScale;
+    header.sliceBias    = view.sliceBias;
+    memCopy(&header, memory, sizeof(VulkanLightClusterHeader));
+    return offset;
+}
 
-        if (l->enabled == false)
-            return;
+void vulkanForwardUpdateGlobalState(f32 dt)
+{
+    gameTime += dt;
+    state.forwardShader.cameraOffset = pushCamera();
+    state.forwardShader.lightsOffset = pushLights();
+}
 
-        state.deferredShader.lightData.color = l->color;
-        state.deferredShader.lightData.intensity = l->intensity;
-        state.deferredShader.lightData.position = l->getPosition();
-        state.deferredShader.lightData.radius = l->radius;
-        state.deferredShader.lightData.enabled = l->enabled;
-        vulkanBufferLoadData(
-            state.device,
-            state.deferredShader.lightUbo,
-            sizeof(VulkanLightData) * i,
-            sizeof(VulkanLightData),
-            0,
-            &state.deferredShader.lightData);
-    }
+void
+vulkanDeferredUpdateGlobaState(f32 dt)
+{
+    gameTime += dt;
+    state.deferredShader.cameraOffset = pushCamera();
 
-    vulkanDeferredUpdateGlobalData(state.device, state.deferredShader);
+    glm::vec4* spheres = frameAlloc<glm::vec4>(MAX_LIGHTS);
+    u32 lightCount = 0;
+    state.deferredShader.lightsOffset = pushLights(spheres, &lightCount);
+    state.deferredShader.clustersOffset = pushLightClusters(spheres, spheres ? lightCount : 0);
 }
 
 bool vulkanCreateMesh(Mesh* mesh, u32 vertexCount, Vertex* vertices, u32 indexCount, u32* indices)
@@ -211,24 +325,49 @@ bool vulkanCreateMesh(Mesh* mesh, u32 vertexCount, Vertex* vertices, u32 indexCo
         return false;
     }
 
+    // Ranges of the shared buffers, draws use the offsets as vertexOffset and firstIndex.
     renderMesh->vertexCount   = vertexCount;
-    renderMesh->vertexOffset  = 0;
     renderMesh->vertexSize    = sizeof(VulkanVertex);
-    u64 totalVertexSize = renderMesh->vertexCount * renderMesh->vertexSize;
-
-    u32 flags = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    vulkanBufferCreate(state.device, totalVertexSize, flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &renderMesh->vertexBuffer);
-    vulkanUploadDataToGPU(state.device, renderMesh->vertexBuffer, 0, totalVertexSize, vertices);
+    renderMesh->indexCount    = 0;
+    renderMesh->indexOffset   = 0;
+    renderMesh->uploadTicket  = 0;
+    if(!vulkanGeometryBufferAllocate(state.device, state.vertexBuffer, vertexCount, &renderMesh->vertexOffset))
+    {
+        PERROR("vulkanCreateMesh - no space for %u vertices.", vertexCount);
+        renderMesh->id = INVALID_ID;
+        mesh->rendererId = INVALID_ID;
+        return false;
+    }
+    renderMesh->uploadTicket = vulkanUploadBuffer(
+        state.device,
+        state.vertexBuffer.buffer.handle,
+        renderMesh->vertexOffset * renderMesh->vertexSize,
+        vertices,
+        (u64)vertexCount * renderMesh->vertexSize);
 
     if(indexCount > 0 && indices)
     {
-        u64 indexSize = indexCount * sizeof(u32);
-        u32 indexFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        if(!vulkanGeometryBufferAllocate(state.device, state.indexBuffer, indexCount, &renderMesh->indexOffset))
+        {
+            PERROR("vulkanCreateMesh - no space for %u indices.", indexCount);
+            vulkanGeometryBufferFree(state.vertexBuffer, renderMesh->vertexOffset, vertexCount);
+            renderMesh->id = INVALID_ID;
+            mesh->rendererId = INVALID_ID;
+            return false;
+        }
         renderMesh->indexCount = indexCount;
-        vulkanBufferCreate(state.device, indexSize, indexFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &renderMesh->indexBuffer);
-        vulkanUploadDataToGPU(state.device, renderMesh->indexBuffer, 0, indexSize, indices);
+        // Tickets grow, the index one covers the vertices too.
+        renderMesh->uploadTicket = vulkanUploadBuffer(
+            state.device,
+            state.indexBuffer.buffer.handle,
+            renderMesh->indexOffset * sizeof(u32),
+            indices,
+            (u64)indexCount * sizeof(u32));
     }
 
+    if(state.device.gpuDriven)
+        vulkanIndirectSetMesh(state.indirect, mesh->rendererId, renderMesh);
+
     return true;
 }
 
@@ -238,21 +377,19 @@ void vulkanDestroyMesh(const Mesh* mesh)
         return;
     }
 
-    for(u32 i = 0;
-        i < VULKAN_MAX_MESHES;
-        ++i)
-    {
-        if(state.vulkanMeshes[i].id == mesh->id)
-        {
-            vulkanBufferDestroy(state.device, state.vulkanMeshes[i].vertexBuffer);
-            if(state.vulkanMeshes[i].indexBuffer.handle)
-            {
-                vulkanBufferDestroy(state.device, state.vulkanMeshes[i].indexBuffer);
-            }
-            state.vulkanMeshes[i].id = INVALID_ID;
-            break;
-        }
+    // The slot index is the renderer id, see vulkanCreateMesh.
+    u32 id = mesh->rendererId;
+    if(id >= VULKAN_MAX_MESHES || state.vulkanMeshes[id].id == INVALID_ID) {
+        return;
     }
+
+    // Frames in flight may still draw it, the ranges are retired until their fences signal.
+    VulkanMesh& geometry = state.vulkanMeshes[id];
+    vulkanGeometryBufferFree(state.vertexBuffer, geometry.vertexOffset, geometry.vertexCount);
+    vulkanGeometryBufferFree(state.indexBuffer, geometry.indexOffset, geometry.indexCount);
+    if(state.device.gpuDriven)
+        vulkanIndirectSetMesh(state.indirect, id, nullptr);
+    geometry.id = INVALID_ID;
 }
 
 bool vulkanCreateTexture(void* pixels, Texture* texture)
@@ -269,14 +406,6 @@ bool vulkanCreateTexture(void* pixels, Texture* texture)
     // ! Assume 8 bit per channel
     VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
 
-    // Staging buffer, load data into it.
-    VkBufferUsageFlags usageFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    VkMemoryPropertyFlags memPropsFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-    VulkanBuffer staging;
-    vulkanBufferCreate(state.device, textureSize, usageFlags, memPropsFlags, &staging);
-    vulkanBufferLoadData(state.device, staging, 0, textureSize, 0, pixels);
-
     vulkanCreateImage(
         state.device,
         VK_IMAGE_TYPE_2D,
@@ -291,41 +420,8 @@ bool vulkanCreateTexture(void* pixels, Texture* texture)
         &data->image
     );
 
-    VkCommandBuffer temporalCommand;
-    vulkanCommandBufferAllocateAndBeginSingleUse(
-        state.device, 
-        state.device.commandPool, 
-        temporalCommand);
-
-    vulkanImageTransitionLayout(
-        state.device, 
-        &data->image, 
-        format, 
-        VK_IMAGE_LAYOUT_UNDEFINED, 
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-        temporalCommand);
-
-    vulkanBufferCopyToImage(
-        state.device,
-        &staging, 
-        &data->image, 
-        temporalCommand);
-    
-    vulkanImageTransitionLayout(
-        state.device, 
-        &data->image, 
-        format, 
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
-        temporalCommand);
-
-    vulkanCommandBufferEndSingleUse(
-        state.device, 
-        state.device.commandPool, 
-        state.device.graphicsQueue, 
-        temporalCommand);
-
-    vulkanBufferDestroy(state.device, staging);
+    // Goes in the next upload batch, the first frame using it waits for the ticket.
+    data->uploadTicket = vulkanUploadImage(state.device, &data->image, pixels, textureSize);
 
     VkSamplerCreateInfo samplerInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
     samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -345,6 +441,11 @@ bool vulkanCreateTexture(void* pixels, Texture* texture)
     samplerInfo.maxLod = 0.0f;
 
     VK_CHECK(vkCreateSampler(state.device.handle, &samplerInfo, nullptr, &data->sampler));
+
+    data->bindlessIndex = INVALID_ID;
+    if(state.device.bindless)
+        vulkanBindlessAddTexture(state.device, state.bindless, data);
+
     texture->generation++;
     return true;
 }
@@ -356,15 +457,23 @@ void vulkanDestroyTexture(Texture* texture)
     VulkanTexture* data = (VulkanTexture*)texture->data;
     if(data)
     {
-        vkFreeMemory(state.device.handle, data->image.memory, nullptr);
+        vulkanMemoryFree(state.device, data->image.allocation);
         vkDestroyImage(state.device.handle, data->image.handle, nullptr);
         vkDestroyImageView(state.device.handle, data->image.view, nullptr);
         vkDestroySampler(state.device.handle, data->sampler, nullptr);
-        memZero(&data->image, sizeof(VulkanTexture));
+        if(state.device.bindless)
+            vulkanBindlessRemoveTexture(state.bindless, data);
+        memFree(data, sizeof(VulkanTexture), MEMORY_TAG_TEXTURE);
     }
     memZero(texture, sizeof(Texture));
 }
 
+void vulkanWaitUploads()
+{
+    // Any ticket past the last one flushes and waits every batch.
+    vulkanUploadWait(state.device, UINT64_MAX);
+}
+
 bool vulkanCreateMaterial(Material* m)
 {
     if(m)
@@ -372,6 +481,15 @@ bool vulkanCreateMaterial(Material* m)
         switch (m->type)
         {
         case MATERIAL_TYPE_FORWARD:
+            // Bindless materials are an index shared by both passes.
+            if(state.device.bindless)
+            {
+                if(!vulkanBindlessCreateMaterial(state.bindless, m))
+                {
+                    PERROR("vulkanCreateMaterial - could not create material '%s'.", m->name);
+                }
+                break;
+            }
             if(!vulkanForwardShaderGetMaterial(&state, &state.forwardShader, m))
             {
                 PERROR("vulkanCreateMaterial - could not create material '%s'.", m->name);
@@ -391,17 +509,32 @@ bool vulkanCreateMaterial(Material* m)
     return false;
 }
 
+void vulkanDestroyMaterial(Material* m)
+{
+    // Without bindless the shaders keep the descriptor sets of the material.
+    if(m && m->type == MATERIAL_TYPE_FORWARD && state.device.bindless)
+        vulkanBindlessDestroyMaterial(state.bindless, m);
+}
+
 /**
  * @brief Initialize all vulkan render system.
  * @param const char* application name.
  * @return bool if succeded initialization.
  */
-bool vulkanBackendInit(const char* appName, void* winHandle)
+bool vulkanBackendInit(const char* appName, void* winHandle, const RenderSystemConfig& config)
 {
     applicationGetFramebufferSize(&state.clientWidth, &state.clientHeight);
 
     state.windowHandle = winHandle;
 
+    // Per frame resources are created for this many frames, swapchain images are counted apart.
+    state.framesInFlight = config.framesInFlight;
+    if(state.framesInFlight < VULKAN_MIN_FRAMES_IN_FLIGHT)
+        state.framesInFlight = VULKAN_MIN_FRAMES_IN_FLIGHT;
+    if(state.framesInFlight > VULKAN_MAX_FRAMES_IN_FLIGHT)
+        state.framesInFlight = VULKAN_MAX_FRAMES_IN_FLIGHT;
+    state.presentMode = config.presentMode;
+
     VkApplicationInfo appInfo = {};
     appInfo.sType               = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     appInfo.pApplicationName    = appName;
@@ -522,11 +655,11 @@ bool vulkanBackendInit(const char* appName, void* winHandle)
     createCommandBuffers();
 
     // Sync objects
-    state.imageAvailableSemaphores.resize(state.swapchain.maxImageInFlight);
-    state.renderFinishedSemaphores.resize(state.swapchain.maxImageInFlight);
-    state.frameInFlightFences.resize(state.swapchain.maxImageInFlight);
+    state.imageAvailableSemaphores.resize(state.framesInFlight);
+    state.renderFinishedSemaphores.resize(state.framesInFlight);
+    state.frameInFlightFences.resize(state.framesInFlight);
 
-    for(u32 i = 0; i < state.swapchain.maxImageInFlight; ++i)
+    for(u32 i = 0; i < state.framesInFlight; ++i)
     {
         if(!vulkanCreateSemaphore(state.device, &state.imageAvailableSemaphores.at(i))){
             return false;
@@ -539,13 +672,82 @@ bool vulkanBackendInit(const char* appName, void* winHandle)
         }
     }
 
+    // GPU time of the passes of each frame, read back when its fence is waited.
+    state.timestamps = state.device.properties.limits.timestampComputeAndGraphics;
+    memZero(state.timestampMask, sizeof(state.timestampMask));
+    if(state.timestamps)
+    {
+        VkQueryPoolCreateInfo queryInfo = {VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        queryInfo.queryType     = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount    = VULKAN_FRAME_TIMESTAMPS * state.framesInFlight;
+        VK_CHECK(vkCreateQueryPool(state.device.handle, &queryInfo, nullptr, &state.timestampPool));
+    }
+    else
+    {
+        PWARN("The graphics queue has no timestamps, GPU pass times are not measured.");
+    }
+    state.frameBeginTime = 0.0;
+
+    // Model matrices of the instanced draws, written every frame so it stays mapped.
+    u32 instanceBufferSize = sizeof(glm::mat4) * VULKAN_MAX_INSTANCES * state.framesInFlight;
+    if(!vulkanBufferCreate(
+        state.device,
+        instanceBufferSize,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &state.instanceBuffer)){
+        return false;
+    }
+    state.instanceData = (glm::mat4*)state.instanceBuffer.allocation.mapped;
+    state.instanceCount = 0;
+
+    // Secondary command pools, one per job system thread and frame in flight.
+    state.threadCount = jobSystemThreadCount();
+    state.threadCommandPools.resize(state.threadCount * state.framesInFlight);
+    for(VulkanThreadCommandPool& pool : state.threadCommandPools)
+    {
+        VkCommandPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+        poolInfo.flags              = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex   = state.device.graphicsQueueIndex;
+        VK_CHECK(vkCreateCommandPool(state.device.handle, &poolInfo, nullptr, &pool.handle));
+        pool.used = 0;
+    }
+
     state.vulkanMeshes = (VulkanMesh*)memAllocate(sizeof(VulkanMesh) * VULKAN_MAX_MESHES, MEMORY_TAG_RENDERER);
     for(u32 i = 0; i < VULKAN_MAX_MESHES; ++i) {
         state.vulkanMeshes[i].id = INVALID_ID;
     }
+    if(!vulkanGeometryBufferCreate(state.device, sizeof(VulkanVertex), VULKAN_GEOMETRY_VERTEX_CAPACITY,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &state.vertexBuffer)){
+        return false;
+    }
+    if(!vulkanGeometryBufferCreate(state.device, sizeof(u32), VULKAN_GEOMETRY_INDEX_CAPACITY,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &state.indexBuffer)){
+        return false;
+    }
+
+    // Camera and lights of every frame, the shader descriptors point to it.
+    if(!vulkanRingBufferCreate(
+        state.device,
+        VULKAN_UNIFORM_RING_FRAME_SIZE,
+        state.framesInFlight,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        &state.uniformRing)){
+        return false;
+    }
+
+    // Materials and textures of both passes, when descriptor indexing is there.
+    if(state.device.bindless && !vulkanBindlessCreate(state.device, state.framesInFlight, &state.bindless)){
+        return false;
+    }
 
     vulkanCreateForwardShader(&state, &state.forwardShader);
-    vulkanDeferredShaderCreate(state.device, state.swapchain, state.swapchain.extent.width, state.swapchain.extent.height, &state.deferredShader);
+    vulkanDeferredShaderCreate(state.device, state.swapchain, state.uniformRing, state.device.bindless ? &state.bindless : nullptr,
+        config.gbufferLayout, state.framesInFlight, state.swapchain.extent.width, state.swapchain.extent.height, &state.deferredShader);
+    if(state.device.gpuDriven && !vulkanIndirectCreate(state.device, state.deferredShader, state.bindless,
+        state.framesInFlight, state.swapchain.extent.width, state.swapchain.extent.height, &state.indirect)){
+        return false;
+    }
     imguiInit(&state, &state.renderpass);
 
     return true;
@@ -565,6 +767,18 @@ void vulkanBackendOnResize(u32 width, u32 height)
     state.clientHeight  = height;
 }
 
+/**
+ * Swapchain recreated with the new present mode at the next frame begin,
+ * through the resize path.
+ */
+void vulkanSetPresentMode(RenderPresentMode mode)
+{
+    if(mode == state.presentMode)
+        return;
+    state.presentMode   = mode;
+    state.resized       = true;
+}
+
 /**
  * @brief Shutdown and destroy all modules and components from
  * the vulkan backend. Usually when shutting down the renderer module.
@@ -588,26 +802,32 @@ void vulkanBackendShutdown(void)
     {
         vulkanDestroyFence(state.device, fence);
     }
+    if(state.timestamps)
+        vkDestroyQueryPool(state.device.handle, state.timestampPool, nullptr);
 
-    // Destroy all buffers from loaded meshes
-    for(u32 i = 0;
-        i < VULKAN_MAX_MESHES;
-        ++i)
+    // Loaded meshes only hold ranges of the shared buffers.
+    vulkanGeometryBufferDestroy(state.device, state.vertexBuffer);
+    vulkanGeometryBufferDestroy(state.device, state.indexBuffer);
+
+    // Destroying the pools frees their command buffers.
+    for(VulkanThreadCommandPool& pool : state.threadCommandPools)
     {
-        if(state.vulkanMeshes[i].id != INVALID_ID)
-        {
-            vulkanBufferDestroy(state.device, state.vulkanMeshes[i].vertexBuffer);
-            if(state.vulkanMeshes[i].indexBuffer.handle){
-                vulkanBufferDestroy(state.device, state.vulkanMeshes[i].indexBuffer);
-            }
-        }
+        vkDestroyCommandPool(state.device.handle, pool.handle, nullptr);
     }
+    state.threadCommandPools.clear();
+
+    vulkanBufferDestroy(state.device, state.instanceBuffer);
+    vulkanRingBufferDestroy(state.device, state.uniformRing);
 
     imguiDestroy();
 
     PDEBUG("Destroying Vulkan Shaders ...");
+    if(state.device.gpuDriven)
+        vulkanIndirectDestroy(state.device, state.indirect);
     vulkanDestroyForwardShader(&state);
     vulkanDeferredShaderDestroy(state.device, state.deferredShader);
+    if(state.device.bindless)
+        vulkanBindlessDestroy(state.device, state.bindless);
 
     PDEBUG("Destroying Vulkan Render passes ...");
     vkDestroyRenderPass(state.device.handle, state.renderpass.handle, nullptr);
@@ -641,6 +861,65 @@ void vulkanBackendShutdown(void)
     vkDestroyInstance(state.instance, nullptr);
 }
 
+/**
+ * Primary command buffer of the pass in the current frame. The forward
+ * and light passes share one, the geometry pass is submitted on its own.
+ */
+static VkCommandBuffer frameCommandBuffer(DefaultRenderPasses renderPass)
+{
+    if(renderPass == RENDER_PASS_GEOMETRY)
+        return state.deferredShader.geometryCmdBuffer[state.currentFrame].handle;
+    return state.commandBuffers[state.currentFrame].handle;
+}
+
+/**
+ * Writes the begin or end timestamp of the pass, outside of a render pass.
+ * The geometry pass takes the first two queries of the frame, the forward
+ * or light pass the last two.
+ */
+static void writeTimestamp(VkCommandBuffer cmd, DefaultRenderPasses renderPass, bool end)
+{
+    if(!state.timestamps)
+        return;
+
+    u32 local = (renderPass == RENDER_PASS_GEOMETRY ? 0 : 2) + (end ? 1 : 0);
+    u32 query = state.currentFrame * VULKAN_FRAME_TIMESTAMPS + local;
+    if(!end)
+        vkCmdResetQueryPool(cmd, state.timestampPool, query, 2);
+    vkCmdWriteTimestamp(cmd, end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        state.timestampPool, query);
+    state.timestampMask[state.currentFrame] |= 1 << local;
+}
+
+/**
+ * Reads the pass times of the frame that last used the current slot, its
+ * fence must be signaled. They go to the stats of this frame.
+ */
+static void readTimestamps()
+{
+    u32 mask = state.timestampMask[state.currentFrame];
+    state.timestampMask[state.currentFrame] = 0;
+    if(!state.timestamps || mask == 0)
+        return;
+
+    f64 tickMs = state.device.properties.limits.timestampPeriod / 1000000.0;
+    f32* passMs[2] = {&state.frameStats.gpuGeometryMs, &state.frameStats.gpuLightMs};
+    for(u32 pass = 0; pass < 2; ++pass)
+    {
+        u32 bits = 3u << (pass * 2);
+        if((mask & bits) != bits)
+            continue;
+
+        u64 ticks[2];
+        u32 first = state.currentFrame * VULKAN_FRAME_TIMESTAMPS + pass * 2;
+        if(vkGetQueryPoolResults(state.device.handle, state.timestampPool, first, 2,
+            sizeof(ticks), ticks, sizeof(u64), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+        {
+            *passMs[pass] = (f32)((ticks[1] - ticks[0]) * tickMs);
+        }
+    }
+}
+
 /**
  * @brief Do necessary preparation to begin the frame rendering.
  * If failed, vulkanDraw won't be called and rendering pass won't perform.
@@ -672,48 +951,76 @@ bool vulkanBeginFrame(f32 delta)
         return false;
     }
 
-    // Wait for the previous frame to finish.
-    vulkanWaitFence(
-        state.device, 
-        &state.frameInFlightFences[state.currentFrame]);
-    vulkanResetFence(state.device, &state.frameInFlightFences[state.currentFrame]);
-
-    // Acquire next image index.
-    vkAcquireNextImageKHR(
+    // The previous frame ends here, its CPU time includes the work outside the renderer.
+    f64 beginTime = platformGetCurrentTime();
+    if(state.frameBeginTime > 0.0)
+        state.frameStats.cpuFrameMs = (f32)((beginTime - state.frameBeginTime) * 1000.0);
+    state.frameBeginTime = beginTime;
+    u64 mapCalls = memoryGetGpuStats().mapCalls;
+    state.frameStats.mapCalls = (u32)(mapCalls - state.frameBeginMapCalls);
+    state.frameBeginMapCalls = mapCalls;
+
+    state.lastFrameStats = state.frameStats;
+    memZero(&state.frameStats, sizeof(RenderStats));
+    state.frameStats.presentMode = renderPresentMode(state.swapchain.presentMode);
+
+    // Wait for the frame that last used this slot, framesInFlight frames ago.
+    VulkanFence* frameFence = &state.frameInFlightFences[state.currentFrame];
+    vulkanWaitFence(state.device, frameFence);
+    readTimestamps();
+
+    // Blocks only when the presentation engine holds every image, the swapchain has one more than the frames in flight.
+    VkResult result = vkAcquireNextImageKHR(
         state.device.handle, 
         state.swapchain.handle, 
         UINT64_MAX, 
         state.imageAvailableSemaphores.at(state.currentFrame),
         0, 
         &state.imageIndex);
+    if(result == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        // The fence is still signaled, the slot is used again next frame.
+        state.resized = true;
+        return false;
+    }
+    if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+    {
+        PERROR("vkAcquireNextImageKHR failed!");
+        return false;
+    }
 
-    return true;
-}
-
-void
-vulkanBeginCommandBuffer(DefaultRenderPasses renderPassid)
-{
-    // TODO Solve synchronization
-    vkDeviceWaitIdle(state.device.handle);
-    VkCommandBuffer cmd;
-    switch (renderPassid)
+    // The image may still be rendered by the frame of another slot.
+    VulkanFence* imageFence = state.imagesInFlight[state.imageIndex];
+    if(imageFence && imageFence != frameFence)
+        vulkanWaitFence(state.device, imageFence);
+    state.imagesInFlight[state.imageIndex] = frameFence;
+
+    state.frameStats.cpuWaitMs = (f32)((platformGetCurrentTime() - beginTime) * 1000.0);
+    vulkanResetFence(state.device, frameFence);
+
+    // Reuse the staging space of the finished uploads.
+    vulkanUploadUpdate(state.device);
+
+    // The GPU is done with the uniforms, instances, secondaries, retired geometry and materials of this frame slot.
+    vulkanRingBufferBeginFrame(state.uniformRing, state.currentFrame);
+    vulkanGeometryBufferBeginFrame(state.device, state.vertexBuffer, state.currentFrame);
+    vulkanGeometryBufferBeginFrame(state.device, state.indexBuffer, state.currentFrame);
+    if(state.device.bindless)
+        vulkanBindlessBeginFrame(state.bindless, state.currentFrame);
+    state.instanceCount = 0;
+    for(u32 i = 0; i < state.threadCount; ++i)
     {
-    case 0:
-        cmd = state.commandBuffers[state.imageIndex].handle;
-        break;
-    case 1:
-        cmd = state.deferredShader.geometryCmdBuffer.handle;
-        break;
-    case 2:
-        cmd = state.commandBuffers[state.imageIndex].handle;
-        break;        
-    default:
-        break;
+        VulkanThreadCommandPool& pool = state.threadCommandPools[state.currentFrame * state.threadCount + i];
+        if(pool.used > 0)
+            VK_CHECK(vkResetCommandPool(state.device.handle, pool.handle, 0));
+        pool.used = 0;
     }
 
-    VkCommandBufferBeginInfo cmdBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-    VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+    return true;
+}
 
+static void setViewportAndScissor(VkCommandBuffer cmd)
+{
     VkViewport viewport;
     viewport.x          = 0.0f;
     viewport.y          = state.clientHeight;
@@ -732,8 +1039,110 @@ vulkanBeginCommandBuffer(DefaultRenderPasses renderPassid)
     vkCmdSetScissor(cmd, 0, 1, &scissor);
 }
 
+static void resetDrawContext(VulkanDrawContext* ctx, VkCommandBuffer cmd)
+{
+    memZero(ctx, sizeof(VulkanDrawContext));
+    ctx->cmd        = cmd;
+}
+
+static void addStats(RenderStats* total, const RenderStats& stats)
+{
+    total->drawCalls            += stats.drawCalls;
+    total->instances            += stats.instances;
+    total->pipelineBinds        += stats.pipelineBinds;
+    total->descriptorBinds      += stats.descriptorBinds;
+    total->vertexBufferBinds    += stats.vertexBufferBinds;
+}
+
+/**
+ * Begins a secondary command buffer from the pool of the given thread,
+ * continuing the render pass being recorded. Dynamic state is not
+ * inherited from the primary, so viewport and scissor are set again.
+ * @param u32 thread Job system index of the calling thread.
+ * @return VkCommandBuffer
+ */
+static VkCommandBuffer beginSecondary(u32 thread)
+{
+    PASSERT(thread < state.threadCount)
+    VulkanThreadCommandPool& pool = state.threadCommandPools[state.currentFrame * state.threadCount + thread];
+    if(pool.used == pool.buffers.size())
+    {
+        VkCommandBufferAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocInfo.commandBufferCount    = 1;
+        allocInfo.commandPool           = pool.handle;
+        allocInfo.level                 = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+        VkCommandBuffer buffer;
+        VK_CHECK(vkAllocateCommandBuffers(state.device.handle, &allocInfo, &buffer));
+        pool.buffers.push_back(buffer);
+    }
+    VkCommandBuffer cmd = pool.buffers[pool.used++];
+
+    VkCommandBufferInheritanceInfo inheritance = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritance.subpass = 0;
+    if(state.currentPass == RENDER_PASS_GEOMETRY) {
+        inheritance.renderPass  = state.deferredShader.geometryRenderpass.handle;
+        inheritance.framebuffer = state.deferredShader.geometryFramebuffer[state.currentFrame].handle;
+    } else {
+        inheritance.renderPass  = state.renderpass.handle;
+        inheritance.framebuffer = state.swapchain.framebuffers[state.imageIndex].handle;
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags             = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo  = &inheritance;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+    setViewportAndScissor(cmd);
+    return cmd;
+}
+
+/**
+ * Context for the draws recorded on the main thread. In passes made of
+ * secondary command buffers it opens one, executed after the ones
+ * already queued in the pass.
+ */
+static VulkanDrawContext* mainDrawContext()
+{
+    if(state.mainContext.cmd == VK_NULL_HANDLE)
+    {
+        resetDrawContext(&state.mainContext, beginSecondary(0));
+        state.passSecondaries.push_back(state.mainContext.cmd);
+    }
+    return &state.mainContext;
+}
+
+static void closeMainDrawContext()
+{
+    if(state.mainContext.cmd == VK_NULL_HANDLE)
+        return;
+    if(state.currentPass != RENDER_PASS_DEFERRED)
+        VK_CHECK(vkEndCommandBuffer(state.mainContext.cmd));
+    addStats(&state.frameStats, state.mainContext.stats);
+    state.mainContext.cmd = VK_NULL_HANDLE;
+}
+
+void
+vulkanBeginCommandBuffer(DefaultRenderPasses renderPassid)
+{
+    // The frame fence waited in vulkanBeginFrame covers the buffers of this frame.
+    VkCommandBuffer cmd = frameCommandBuffer(renderPassid);
+
+    VkCommandBufferBeginInfo cmdBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+    writeTimestamp(cmd, renderPassid, false);
+    setViewportAndScissor(cmd);
+}
+
 bool vulkanBeginRenderPass(DefaultRenderPasses renderPassid)
 {
+    // Nothing is bound at the start of a pass.
+    state.currentPass = renderPassid;
+    state.passSecondaries.clear();
+    resetDrawContext(&state.mainContext, VK_NULL_HANDLE);
+
     // TODO Abstract render pass creation.
     switch(renderPassid)
     {
@@ -753,7 +1162,7 @@ bool vulkanBeginRenderPass(DefaultRenderPasses renderPassid)
             info.clearValueCount    = 2;
             info.pClearValues       = clearColors;
             
-            vkCmdBeginRenderPass(state.commandBuffers.at(state.imageIndex).handle, &info, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBeginRenderPass(frameCommandBuffer(RENDER_PASS_FORWARD), &info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
             return true;
             break;
         }
@@ -768,13 +1177,13 @@ bool vulkanBeginRenderPass(DefaultRenderPasses renderPassid)
 
             VkRenderPassBeginInfo info = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
             info.renderPass         = state.deferredShader.geometryRenderpass.handle;
-            info.framebuffer        = state.deferredShader.geometryFramebuffer.handle;
+            info.framebuffer        = state.deferredShader.geometryFramebuffer[state.currentFrame].handle;
             info.renderArea.offset  = {0, 0};
             info.renderArea.extent  = state.swapchain.extent;
             info.clearValueCount    = 4;
             info.pClearValues       = clearColors;
 
-            vkCmdBeginRenderPass(state.deferredShader.geometryCmdBuffer.handle, &info, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBeginRenderPass(frameCommandBuffer(RENDER_PASS_GEOMETRY), &info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
             return true;
             break;
         }
@@ -793,7 +1202,8 @@ bool vulkanBeginRenderPass(DefaultRenderPasses renderPassid)
             info.clearValueCount    = 2;
             info.pClearValues       = clearColors;
 
-            vkCmdBeginRenderPass(state.commandBuffers.at(state.imageIndex).handle, &info, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBeginRenderPass(frameCommandBuffer(RENDER_PASS_DEFERRED), &info, VK_SUBPASS_CONTENTS_INLINE);
+            resetDrawContext(&state.mainContext, frameCommandBuffer(RENDER_PASS_DEFERRED));
             return true;
             break;
         }
@@ -803,147 +1213,444 @@ bool vulkanBeginRenderPass(DefaultRenderPasses renderPassid)
     }
 }
 
-void vulkanDrawGeometry(DefaultRenderPasses renderPassID, const RenderMeshData* data)
+/**
+ * Binds the pipeline of the pass and its global descriptor set if it is
+ * not the bound one. Changing the pipeline invalidates the bound material
+ * and mesh.
+ */
+static void bindPipeline(VulkanDrawContext* ctx, DefaultRenderPasses renderPassID)
 {
-    // TODO make material specify the type to render
-    Material* m = data->material;
-    if(!m){
-        Material mat;
-        mat.diffuseColor = glm::vec4(1);
-        m = &mat;
-    }
-
-    VkCommandBuffer cmd;
+    // Dynamic offsets of the frame data in the uniform ring, in binding order.
+    const VulkanPipeline* pipeline;
+    VkDescriptorSet globalSet;
+    u32 offsets[3];
+    u32 offsetCount = 0;
     switch (renderPassID)
     {
     case 0:
-        cmd = state.commandBuffers[state.imageIndex].handle;
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, state.forwardShader.pipeline.pipeline);
-        vulkanForwardShaderSetMaterial(&state, &state.forwardShader, m);
-        vkCmdPushConstants(cmd, state.forwardShader.pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &data->model);
+        pipeline = &state.forwardShader.pipeline;
+        globalSet = state.forwardShader.globalDescriptorSet[state.currentFrame];
+        offsets[offsetCount++] = state.forwardShader.cameraOffset;
+        offsets[offsetCount++] = state.forwardShader.lightsOffset;
         break;
     case 1:
-        cmd = state.deferredShader.geometryCmdBuffer.handle;
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, state.deferredShader.geometryPipeline.pipeline);
-        vulkanDeferredShaderSetMaterial(&state, &state.deferredShader, m);
-        vkCmdPushConstants(cmd, state.deferredShader.geometryPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &data->model);
+        pipeline = &state.deferredShader.geometryPipeline;
+        globalSet = state.deferredShader.globalGeometryDescriptorSet;
+        offsets[offsetCount++] = state.deferredShader.cameraOffset;
         break;
-    case 2:
-        cmd = state.commandBuffers[state.imageIndex].handle;
-        vulkanDeferredUpdateGbuffers(state.device, state.imageIndex, state.deferredShader);
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, state.deferredShader.lightPipeline.pipeline);
-        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, state.deferredShader.lightPipeline.layout, 0, 1, &state.deferredShader.lightDescriptorSet[state.imageIndex], 0, nullptr);
-        break;        
     default:
+        pipeline = &state.deferredShader.lightPipeline;
+        globalSet = state.deferredShader.lightDescriptorSet[state.currentFrame];
+        offsets[offsetCount++] = state.deferredShader.lightsOffset;
+        offsets[offsetCount++] = state.deferredShader.cameraOffset;
+        offsets[offsetCount++] = state.deferredShader.clustersOffset;
         break;
     }
 
-    VulkanMesh* geometry = &state.vulkanMeshes[data->mesh->rendererId];
+    if(ctx->boundPipeline == pipeline->pipeline)
+        return;
+    vkCmdBindPipeline(ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+
+    // Bindless materials go with the global set, the draws only push their index.
+    VkDescriptorSet sets[2] = {globalSet, state.bindless.sets[state.currentFrame]};
+    u32 setCount = state.device.bindless && renderPassID != RENDER_PASS_DEFERRED ? 2 : 1;
+    vkCmdBindDescriptorSets(ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->layout, 0, setCount, sets, offsetCount, offsets);
+    ctx->boundPipeline = pipeline->pipeline;
+    ctx->boundMaterial = VK_NULL_HANDLE;
+    ctx->boundMaterialIndex = INVALID_ID;
+    ctx->stats.pipelineBinds++;
+    ctx->stats.descriptorBinds++;
+}
 
+/**
+ * Waits for an upload the first time a frame uses what it uploads. Loads
+ * are flushed together, one wait usually covers all of them.
+ * Submits to the graphics queue, call it before recording.
+ */
+static void waitUpload(u64 ticket)
+{
+    if(vulkanUploadIsComplete(state.device, ticket))
+        return;
+    f64 start = platformGetCurrentTime();
+    vulkanUploadWait(state.device, ticket);
+    state.frameStats.uploadWaitMs += (f32)((platformGetCurrentTime() - start) * 1000.0);
+}
+
+static void waitMeshUpload(const Mesh* mesh)
+{
+    waitUpload(state.vulkanMeshes[mesh->rendererId].uploadTicket);
+}
+
+static void waitMaterialUploads(const Material* m)
+{
+    const Texture* textures[] = { m->diffuseTexture, m->normalTexture, m->metallicRoughnessTexture };
+    for(const Texture* t : textures) {
+        if(t && t->data)
+            waitUpload(((const VulkanTexture*)t->data)->uploadTicket);
+    }
+}
+
+/**
+ * Uploads the material of a draw and returns the descriptor set to bind,
+ * VK_NULL_HANDLE for bindless materials.
+ * Descriptor writes are not thread safe, this runs before recording.
+ */
+static VkDescriptorSet updateMaterial(DefaultRenderPasses renderPassID, Material* m)
+{
+    PASSERT(m)
+    waitMaterialUploads(m);
+    if(state.device.bindless)
+    {
+        vulkanBindlessUpdateMaterial(state.bindless, m);
+        return VK_NULL_HANDLE;
+    }
+    switch (renderPassID)
+    {
+    case 0:
+        return vulkanForwardShaderUpdateMaterial(&state, &state.forwardShader, m);
+    case 1:
+        return vulkanDeferredShaderUpdateMaterial(&state, &state.deferredShader, m);
+    default:
+        return VK_NULL_HANDLE;
+    }
+}
+
+/**
+ * Copies the model matrices of the draws to the region of the current
+ * frame in the instance buffer. Returns the first instance of the draws.
+ */
+static u32 pushInstances(const RenderMeshData* data, u32 count)
+{
+    u32 firstInstance = state.instanceCount;
+    glm::mat4* models = state.instanceData + VULKAN_MAX_INSTANCES * state.currentFrame + firstInstance;
+    for(u32 i = 0; i < count; ++i)
+        models[i] = data[i].model;
+    state.instanceCount += count;
+    return firstInstance;
+}
+
+/**
+ * Every mesh lives in the shared buffers, they are bound once.
+ */
+static void bindGeometry(VulkanDrawContext* ctx)
+{
+    if(ctx->boundGeometry)
+        return;
     VkDeviceSize offset = 0;
-    vkCmdBindVertexBuffers(cmd, 0, 1, &geometry->vertexBuffer.handle, &offset);
+    vkCmdBindVertexBuffers(ctx->cmd, 0, 1, &state.vertexBuffer.buffer.handle, &offset);
+    vkCmdBindIndexBuffer(ctx->cmd, state.indexBuffer.buffer.handle, offset, VK_INDEX_TYPE_UINT32);
+    ctx->boundGeometry = true;
+    ctx->stats.vertexBufferBinds++;
+}
+
+/**
+ * Records count instances of data->mesh, from firstInstance in the instance
+ * buffer. Only touches the context, so any thread can record its own.
+ */
+static void recordDraw(
+    VulkanDrawContext* ctx,
+    DefaultRenderPasses renderPassID,
+    const RenderMeshData* data,
+    VkDescriptorSet material,
+    u32 count,
+    u32 firstInstance)
+{
+    VkCommandBuffer cmd = ctx->cmd;
+
+    // Draws come sorted by state, so binds are only done when it changes.
+    bindPipeline(ctx, renderPassID);
+    if(material != VK_NULL_HANDLE && ctx->boundMaterial != material)
+    {
+        VkPipelineLayout layout = renderPassID == RENDER_PASS_FORWARD ? 
+            state.forwardShader.pipeline.layout : state.deferredShader.geometryPipeline.layout;
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &material, 0, nullptr);
+        ctx->boundMaterial = material;
+        ctx->stats.descriptorBinds++;
+    }
+    if(state.device.bindless && renderPassID != RENDER_PASS_DEFERRED && ctx->boundMaterialIndex != data->material->rendererId)
+    {
+        u32 materialIndex = data->material->rendererId;
+        VkPipelineLayout layout = renderPassID == RENDER_PASS_FORWARD ? 
+            state.forwardShader.pipeline.layout : state.deferredShader.geometryPipeline.layout;
+        vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(u32), &materialIndex);
+        ctx->boundMaterialIndex = materialIndex;
+    }
+    if(renderPassID != RENDER_PASS_DEFERRED && !ctx->boundInstances)
+    {
+        VkDeviceSize offset = sizeof(glm::mat4) * VULKAN_MAX_INSTANCES * state.currentFrame;
+        vkCmdBindVertexBuffers(cmd, 1, 1, &state.instanceBuffer.handle, &offset);
+        ctx->boundInstances = true;
+        ctx->stats.vertexBufferBinds++;
+    }
+
+    bindGeometry(ctx);
+
+    const VulkanMesh* geometry = &state.vulkanMeshes[data->mesh->rendererId];
     //vkCmdSetPrimitiveTopology(cmd, VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
     if(geometry->indexCount > 0)
     {
-        vkCmdBindIndexBuffer(cmd, geometry->indexBuffer.handle, offset, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(cmd, geometry->indexCount, 1, 0, 0, 0);
+        vkCmdDrawIndexed(cmd, geometry->indexCount, count, geometry->indexOffset, (i32)geometry->vertexOffset, firstInstance);
     }
     else
     {
-        vkCmdDraw(cmd, geometry->vertexCount, 1, 0, 0);
+        vkCmdDraw(cmd, geometry->vertexCount, count, geometry->vertexOffset, firstInstance);
     }
+    ctx->stats.drawCalls++;
+    ctx->stats.instances += count;
 }
 
-void vulkanEndRenderPass(DefaultRenderPasses renderPass)
+void vulkanDrawGeometry(DefaultRenderPasses renderPassID, const RenderMeshData* data, u32 count)
 {
-    // TODO end the given render pass
-    switch (renderPass)
+    if(count == 0)
+        return;
+
+    // Draws past the capacity of the instance buffer are dropped.
+    if(renderPassID != RENDER_PASS_DEFERRED && state.instanceCount + count > VULKAN_MAX_INSTANCES)
     {
-    case 0:
-        vkCmdEndRenderPass(state.commandBuffers[state.imageIndex].handle);
-        break;
-    case 1:
-        vkCmdEndRenderPass(state.deferredShader.geometryCmdBuffer.handle);
-        break;
-    case 2:
-        vkCmdEndRenderPass(state.commandBuffers[state.imageIndex].handle);
-        break;
-    default:
-        break;
+        PERROR("vulkanDrawGeometry - instance buffer full, %u instances not drawn.", count);
+        return;
+    }
+
+    waitMeshUpload(data->mesh);
+
+    // TODO make material specify the type to render
+    VkDescriptorSet material = VK_NULL_HANDLE;
+    u32 firstInstance = 0;
+    if(renderPassID != RENDER_PASS_DEFERRED) {
+        material = updateMaterial(renderPassID, data->material);
+        firstInstance = pushInstances(data, count);
+    }
+
+    recordDraw(mainDrawContext(), renderPassID, data, material, count, firstInstance);
+}
+
+static void recordBatches(DefaultRenderPasses renderPassID, const RenderMeshData* draws, const RenderBatch* batches, u32 batchCount)
+{
+    if(batchCount == 0)
+        return;
+    if(renderPassID == RENDER_PASS_DEFERRED) {
+        for(u32 i = 0; i < batchCount; ++i)
+            vulkanDrawGeometry(renderPassID, &draws[batches[i].first], batches[i].count);
+        return;
+    }
+
+    const RenderBatch& lastBatch = batches[batchCount - 1];
+    u32 drawCount = lastBatch.first + lastBatch.count;
+    if(state.instanceCount + drawCount > VULKAN_MAX_INSTANCES)
+    {
+        PERROR("vulkanDrawBatches - instance buffer full, %u instances not drawn.", drawCount);
+        return;
+    }
+
+    // Materials and instances are written here, recording only reads them.
+    VkDescriptorSet* materials = frameAlloc<VkDescriptorSet>(batchCount);
+    if(!materials)
+    {
+        PERROR("vulkanDrawBatches - not enough frame memory for %u batches.", batchCount);
+        return;
+    }
+    Material* lastMaterial = nullptr;
+    for(u32 i = 0; i < batchCount; ++i)
+    {
+        waitMeshUpload(draws[batches[i].first].mesh);
+        Material* m = draws[batches[i].first].material;
+        if(m != lastMaterial) {
+            materials[i] = updateMaterial(renderPassID, m);
+            lastMaterial = m;
+        } else {
+            materials[i] = materials[i - 1];
+        }
     }
+    u32 firstInstance = pushInstances(draws, drawCount);
+
+    u32 rangeCount = batchCount / VULKAN_RECORD_BATCHES_PER_BUFFER;
+    if(rangeCount > state.threadCount * 2)
+        rangeCount = state.threadCount * 2;
+
+    if(state.threadCount <= 1 || rangeCount <= 1)
+    {
+        VulkanDrawContext* ctx = mainDrawContext();
+        for(u32 i = 0; i < batchCount; ++i)
+            recordDraw(ctx, renderPassID, &draws[batches[i].first], materials[i], batches[i].count, firstInstance + batches[i].first);
+        state.frameStats.recordBuffers++;
+        return;
+    }
+
+    // Each range goes to a secondary command buffer of the thread recording
+    // it. They are executed in range order, so the sort order is kept.
+    closeMainDrawContext();
+    VkCommandBuffer* buffers = frameAlloc<VkCommandBuffer>(rangeCount);
+    RenderStats* stats = frameAlloc<RenderStats>(rangeCount);
+    PASSERT(buffers && stats)
+    u32 batchesPerRange = (batchCount + rangeCount - 1) / rangeCount;
+    parallelFor(0, rangeCount, 1, [&](u32 begin, u32 end) {
+        for(u32 range = begin; range < end; ++range)
+        {
+            VulkanDrawContext ctx;
+            resetDrawContext(&ctx, beginSecondary(jobSystemThreadIndex()));
+            u32 rangeBegin = range * batchesPerRange;
+            u32 rangeEnd = rangeBegin + batchesPerRange < batchCount ? rangeBegin + batchesPerRange : batchCount;
+            for(u32 i = rangeBegin; i < rangeEnd; ++i)
+                recordDraw(&ctx, renderPassID, &draws[batches[i].first], materials[i], batches[i].count, firstInstance + batches[i].first);
+            VK_CHECK(vkEndCommandBuffer(ctx.cmd));
+            buffers[range] = ctx.cmd;
+            stats[range] = ctx.stats;
+        }
+    });
+
+    for(u32 range = 0; range < rangeCount; ++range)
+    {
+        state.passSecondaries.push_back(buffers[range]);
+        addStats(&state.frameStats, stats[range]);
+    }
+    state.frameStats.recordBuffers += rangeCount;
+}
+
+void vulkanDrawBatches(DefaultRenderPasses renderPassID, const RenderMeshData* draws, const RenderBatch* batches, u32 batchCount)
+{
+    f64 start = platformGetCurrentTime();
+    recordBatches(renderPassID, draws, batches, batchCount);
+    f32 elapsedMs = (f32)((platformGetCurrentTime() - start) * 1000.0);
+    state.frameStats.cpuRecordMs += elapsedMs;
+    state.frameStats.cpuSubmitMs += elapsedMs;
+}
+
+bool vulkanGpuCullingSupported()
+{
+    return state.device.gpuDriven;
+}
+
+bool vulkanSetObjects(const RenderMeshData* objects, u32 count)
+{
+    PASSERT(state.device.gpuDriven)
+    for(u32 i = 0; i < count; ++i)
+        waitMeshUpload(objects[i].mesh);
+    return vulkanIndirectSetObjects(state.indirect, objects, count);
+}
+
+void vulkanSetObjectModels(const u32* indices, const glm::mat4* models, u32 count)
+{
+    PASSERT(state.device.gpuDriven)
+    vulkanIndirectSetObjectModels(state.indirect, indices, models, count);
+}
+
+void vulkanCullObjects(const Frustum& frustum)
+{
+    PASSERT(state.device.gpuDriven)
+
+    // Materials of the objects are read from the bindless buffer, written on changes only.
+    for(Material* m : state.indirect.materials) {
+        waitMaterialUploads(m);
+        vulkanBindlessUpdateMaterial(state.bindless, m);
+    }
+
+    vulkanIndirectCull(state.indirect, frameCommandBuffer(RENDER_PASS_GEOMETRY), state.currentFrame, frustum);
+}
+
+void vulkanDrawObjects()
+{
+    PASSERT(state.device.gpuDriven && state.currentPass == RENDER_PASS_GEOMETRY)
+    VulkanDrawContext* ctx = mainDrawContext();
+
+    // Same global and material sets as the instanced pipeline, the objects go at set 2.
+    const VulkanPipeline& pipeline = state.indirect.pipeline;
+    if(ctx->boundPipeline != pipeline.pipeline)
+    {
+        VkDescriptorSet sets[2] = {state.deferredShader.globalGeometryDescriptorSet, state.bindless.sets[state.currentFrame]};
+        vkCmdBindPipeline(ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+        vkCmdBindDescriptorSets(ctx->cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout, 0, 2, sets, 1, &state.deferredShader.cameraOffset);
+        ctx->boundPipeline = pipeline.pipeline;
+        ctx->boundMaterial = VK_NULL_HANDLE;
+        ctx->boundMaterialIndex = INVALID_ID;
+        ctx->stats.pipelineBinds++;
+        ctx->stats.descriptorBinds++;
+    }
+    bindGeometry(ctx);
+
+    // The visible count stays on the GPU, instances are not counted.
+    vulkanIndirectDraw(state.indirect, ctx->cmd, state.currentFrame);
+    ctx->stats.drawCalls++;
+    ctx->stats.descriptorBinds++;
+}
+
+void vulkanEndRenderPass(DefaultRenderPasses renderPass)
+{
+    closeMainDrawContext();
+
+    VkCommandBuffer cmd = frameCommandBuffer(renderPass);
+    if(renderPass != RENDER_PASS_DEFERRED && !state.passSecondaries.empty())
+        vkCmdExecuteCommands(cmd, (u32)state.passSecondaries.size(), state.passSecondaries.data());
+    state.passSecondaries.clear();
+    vkCmdEndRenderPass(cmd);
 }
 
 void
 vulkanSubmitCommands(DefaultRenderPasses renderPass)
 {
+    f64 start = platformGetCurrentTime();
+
+    // Copies queued while recording go before the frame using them.
+    vulkanUploadFlush(state.device);
+
+    VkCommandBuffer cmd = frameCommandBuffer(renderPass);
+    writeTimestamp(cmd, renderPass, true);
+    VK_CHECK(vkEndCommandBuffer(cmd));
+
+    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &cmd;
     switch(renderPass)
     {
-        case 0:
+        case RENDER_PASS_FORWARD:
         {
-            VK_CHECK(vkEndCommandBuffer(state.commandBuffers[state.imageIndex].handle));
-
             VkPipelineStageFlags pipelineStage[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-
-            VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-            submitInfo.commandBufferCount   = 1;
-            submitInfo.pCommandBuffers      = &state.commandBuffers[state.imageIndex].handle;
             submitInfo.waitSemaphoreCount   = 1;
             submitInfo.pWaitSemaphores      = &state.imageAvailableSemaphores[state.currentFrame];
+            submitInfo.pWaitDstStageMask    = pipelineStage;
             submitInfo.signalSemaphoreCount = 1;
             submitInfo.pSignalSemaphores    = &state.renderFinishedSemaphores[state.currentFrame];
-            submitInfo.pWaitDstStageMask    = pipelineStage;
-
-            //vulkanWaitFence(state.device, &state.frameInFlightFences[state.currentFrame]);
-            //vulkanResetFence(state.device, &state.frameInFlightFences[state.currentFrame]);
 
             if(vkQueueSubmit(state.device.graphicsQueue, 1, &submitInfo, state.frameInFlightFences[state.currentFrame].handle) != VK_SUCCESS){
                 PERROR("Queue wasn't submitted.");
             }
-        }
             break;
-        case 1:
+        }
+        case RENDER_PASS_GEOMETRY:
         {
-            VK_CHECK(vkEndCommandBuffer(state.deferredShader.geometryCmdBuffer.handle));
-
-            VkPipelineStageFlags pipelineStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-            submitInfo.commandBufferCount   = 1;
-            submitInfo.pCommandBuffers      = &state.deferredShader.geometryCmdBuffer.handle;
-            submitInfo.waitSemaphoreCount   = 1;
-            submitInfo.pWaitSemaphores      = &state.imageAvailableSemaphores[state.currentFrame];
+            // Only writes targets of this frame, it does not wait for the swapchain image
+            // and may run while the light pass of the previous frame does.
             submitInfo.signalSemaphoreCount = 1;
-            submitInfo.pSignalSemaphores    = &state.deferredShader.geometrySemaphore;
-            submitInfo.pWaitDstStageMask    = &pipelineStage;
+            submitInfo.pSignalSemaphores    = &state.deferredShader.geometrySemaphore[state.currentFrame];
 
-            //vulkanWaitFence(state.device, &state.frameInFlightFences[state.currentFrame]);
-            //vulkanResetFence(state.device, &state.frameInFlightFences[state.currentFrame]);
             if(vkQueueSubmit(state.device.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS){
                 PERROR("Queue wasn't submitted.");
             }
             break;
         }
-        case 2:
+        case RENDER_PASS_DEFERRED:
         {
-            VK_CHECK(vkEndCommandBuffer(state.commandBuffers[state.imageIndex].handle));
-
-            VkPipelineStageFlags pipelineStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-            submitInfo.commandBufferCount   = 1;
-            submitInfo.pCommandBuffers      = &state.commandBuffers[state.imageIndex].handle;
-            submitInfo.waitSemaphoreCount   = 1;
-            submitInfo.pWaitSemaphores      = &state.deferredShader.geometrySemaphore;
+            // The G-buffer is sampled by the fragment shader, the swapchain image written after it.
+            VkSemaphore waitSemaphores[2] = {
+                state.deferredShader.geometrySemaphore[state.currentFrame],
+                state.imageAvailableSemaphores[state.currentFrame]};
+            VkPipelineStageFlags pipelineStages[2] = {
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+            submitInfo.waitSemaphoreCount   = 2;
+            submitInfo.pWaitSemaphores      = waitSemaphores;
+            submitInfo.pWaitDstStageMask    = pipelineStages;
             submitInfo.signalSemaphoreCount = 1;
             submitInfo.pSignalSemaphores    = &state.renderFinishedSemaphores[state.currentFrame];
-            submitInfo.pWaitDstStageMask    = &pipelineStage;
 
             if(vkQueueSubmit(state.device.graphicsQueue, 1, &submitInfo, state.frameInFlightFences[state.currentFrame].handle) != VK_SUCCESS){
                 PERROR("Queue wasn't submitted.");
             }
-        }
             break;
+        }
         default:
             break;
     }
+    state.frameStats.cpuSubmitMs += (f32)((platformGetCurrentTime() - start) * 1000.0);
 }
 
 /**
@@ -962,8 +1669,10 @@ void vulkanEndFrame(void)
     presentInfo.waitSemaphoreCount  = 1;
     presentInfo.pWaitSemaphores     = &state.renderFinishedSemaphores[state.currentFrame];
     
-    vkQueuePresentKHR(state.device.presentQueue, &presentInfo);
-    state.currentFrame = (state.currentFrame + 1) % state.swapchain.maxImageInFlight;
+    VkResult result = vkQueuePresentKHR(state.device.presentQueue, &presentInfo);
+    if(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+        state.resized = true;
+    state.currentFrame = (state.currentFrame + 1) % state.framesInFlight;
 }
 
 /**
@@ -993,13 +1702,14 @@ void vulkanRegenerateFramebuffers(
 }
 
 /**
- * @brief Function to create main command buffers for main rendering.
+ * @brief Function to create main command buffers for main rendering,
+ * one per frame in flight.
  * @param void
  * @return void
  */
 void createCommandBuffers()
 {
-    state.commandBuffers.resize(state.swapchain.imageCount);
+    state.commandBuffers.resize(state.framesInFlight);
     for(CommandBuffer& cmd : state.commandBuffers)
     {
         VkCommandBufferAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
@@ -1036,11 +1746,6 @@ bool recreateSwapchain()
         PERROR("Failed to recreate swapchain.");
         return false;
     }
-    
-    for(const auto& cmd : state.commandBuffers){
-        vkFreeCommandBuffers(state.device.handle, state.device.commandPool, 1, &cmd.handle);
-    }
-    state.commandBuffers.clear();
 
     for(const auto& framebuffer : state.swapchain.framebuffers){
         vkDestroyFramebuffer(state.device.handle, framebuffer.handle, nullptr);
@@ -1049,13 +1754,25 @@ bool recreateSwapchain()
     vulkanRegenerateFramebuffers(
         &state.swapchain,
         &state.renderpass);
-    
-    createCommandBuffers();
+    vulkanDeferredShaderRecreateLightFramebuffers(state.device, state.swapchain, state.deferredShader);
+
     state.recreatingSwapchain = false;
     return true;
 }
 
+void vulkanGetStats(RenderStats* outStats)
+{
+    *outStats = state.lastFrameStats;
+}
+
 void vulkanImguiRender(const RenderPacket& packet)
 {
-    imguiRender(state.commandBuffers[state.imageIndex].handle, packet);
+    VulkanDrawContext* ctx = mainDrawContext();
+    imguiRender(ctx->cmd, packet);
+
+    // ImGui binds its own pipeline and buffers.
+    ctx->boundPipeline  = VK_NULL_HANDLE;
+    ctx->boundMaterial  = VK_NULL_HANDLE;
+    ctx->boundGeometry  = false;
+    ctx->boundInstances = false;
 }
\ No newline at end of file
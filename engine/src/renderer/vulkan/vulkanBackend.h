@@ -1,27 +1,38 @@
 #pragma once
 
 #include "renderer/renderTypes.h"
+#include "renderer/frustumCulling.h"
 
 struct Scene;
 
-bool vulkanBackendInit(const char* appName, void* winHandle);
+bool vulkanBackendInit(const char* appName, void* winHandle, const RenderSystemConfig& config);
 void vulkanBackendShutdown();
 
 void vulkanBackendOnResize(u32 width, u32 height);
+void vulkanSetPresentMode(RenderPresentMode mode);
 
 bool vulkanBeginFrame(f32 delta);
 void vulkanBeginCommandBuffer(DefaultRenderPasses renderPassid);
 bool vulkanBeginRenderPass(DefaultRenderPasses renderPassID);
 void vulkanForwardUpdateGlobalState(f32 dt);
 void vulkanDeferredUpdateGlobaState(f32 dt);
-void vulkanDrawGeometry(DefaultRenderPasses renderPassID, const RenderMeshData* mesh);
+void vulkanDrawGeometry(DefaultRenderPasses renderPassID, const RenderMeshData* meshes, u32 count);
+void vulkanDrawBatches(DefaultRenderPasses renderPassID, const RenderMeshData* draws, const RenderBatch* batches, u32 batchCount);
+bool vulkanGpuCullingSupported();
+bool vulkanSetObjects(const RenderMeshData* objects, u32 count);
+void vulkanSetObjectModels(const u32* indices, const glm::mat4* models, u32 count);
+void vulkanCullObjects(const Frustum& frustum);
+void vulkanDrawObjects();
 void vulkanEndRenderPass(DefaultRenderPasses renderPassID);
 void vulkanSubmitCommands(DefaultRenderPasses renderPassID);
 void vulkanEndFrame();
 void vulkanImguiRender(const RenderPacket& packet);
+void vulkanGetStats(RenderStats* outStats);
 
 bool vulkanCreateMesh(Mesh* mesh, u32 vertexCount, Vertex* vertices, u32 indexCount, u32* indices);
 void vulkanDestroyMesh(const Mesh* mesh);
 bool vulkanCreateTexture(void* data, Texture* texture);
 void vulkanDestroyTexture(Texture* texture);
-bool vulkanCreateMaterial(Material* m);
\ No newline at end of file
+void vulkanWaitUploads();
+bool vulkanCreateMaterial(Material* m);
+void vulkanDestroyMaterial(Material* m);
\ No newline at end of file
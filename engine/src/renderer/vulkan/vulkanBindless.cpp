@@ -0,0 +1,255 @@
+#include "vulkanBindless.h"
+
+#include "vulkanBuffer.h"
+#include "memory/pmemory.h"
+
+#include <cstring>
+
+bool vulkanBindlessCreate(
+    const VulkanDevice& device,
+    u32 frameCount,
+    VulkanBindless* outBindless)
+{
+    PASSERT(device.bindless && frameCount <= VULKAN_MAX_FRAMES_IN_FLIGHT)
+
+    // Textures are added and removed while frames are in flight, their
+    // binding is updatable and may have unwritten slots.
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding         = 0;
+    bindings[0].descriptorCount = 1;
+    bindings[0].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[0].stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    bindings[1].binding         = 1;
+    bindings[1].descriptorCount = VULKAN_MAX_TEXTURES;
+    bindings[1].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorBindingFlags bindingFlags[2] = {
+        0,
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+            | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+    };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    bindingFlagsInfo.bindingCount   = 2;
+    bindingFlagsInfo.pBindingFlags  = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.pNext        = &bindingFlagsInfo;
+    layoutInfo.flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings    = bindings;
+    VK_CHECK(vkCreateDescriptorSetLayout(device.handle, &layoutInfo, nullptr, &outBindless->layout));
+
+    VkDescriptorPoolSize poolSizes[2];
+    poolSizes[0].type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount    = frameCount;
+    poolSizes[1].type               = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount    = VULKAN_MAX_TEXTURES * frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.flags          = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets        = frameCount;
+    poolInfo.poolSizeCount  = 2;
+    poolInfo.pPoolSizes     = poolSizes;
+    VK_CHECK(vkCreateDescriptorPool(device.handle, &poolInfo, nullptr, &outBindless->pool));
+
+    VkDescriptorSetLayout layouts[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    for(u32 i = 0; i < frameCount; ++i)
+        layouts[i] = outBindless->layout;
+    VkDescriptorSetAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool        = outBindless->pool;
+    allocInfo.descriptorSetCount    = frameCount;
+    allocInfo.pSetLayouts           = layouts;
+    VK_CHECK(vkAllocateDescriptorSets(device.handle, &allocInfo, outBindless->sets));
+
+    const VkDeviceSize regionSize = sizeof(VulkanMaterialData) * VULKAN_BINDLESS_MATERIAL_COUNT;
+    PASSERT(regionSize % device.properties.limits.minStorageBufferOffsetAlignment == 0)
+    if(!vulkanBufferCreate(
+        device,
+        regionSize * frameCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &outBindless->materialBuffer)){
+        PERROR("vulkanBindlessCreate - could not create the material buffer.");
+        return false;
+    }
+    outBindless->materialData   = (VulkanMaterialData*)outBindless->materialBuffer.allocation.mapped;
+    outBindless->frame          = 0;
+    outBindless->frameCount     = frameCount;
+    outBindless->materials.assign(VULKAN_BINDLESS_MATERIAL_COUNT, VulkanMaterialData{});
+    memZero(outBindless->materialData, regionSize * frameCount);
+
+    for(u32 i = 0; i < frameCount; ++i)
+    {
+        VkDescriptorBufferInfo materialInfo;
+        materialInfo.buffer = outBindless->materialBuffer.handle;
+        materialInfo.offset = regionSize * i;
+        materialInfo.range  = regionSize;
+
+        VkWriteDescriptorSet materialWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        materialWrite.dstSet            = outBindless->sets[i];
+        materialWrite.dstBinding        = 0;
+        materialWrite.dstArrayElement   = 0;
+        materialWrite.descriptorCount   = 1;
+        materialWrite.descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        materialWrite.pBufferInfo       = &materialInfo;
+        vkUpdateDescriptorSets(device.handle, 1, &materialWrite, 0, nullptr);
+    }
+
+    // Lowest slots are handed out first.
+    outBindless->freeTextures.resize(VULKAN_MAX_TEXTURES);
+    for(u32 i = 0; i < VULKAN_MAX_TEXTURES; ++i)
+        outBindless->freeTextures[i] = VULKAN_MAX_TEXTURES - 1 - i;
+    outBindless->freeMaterials.resize(VULKAN_BINDLESS_MATERIAL_COUNT);
+    for(u32 i = 0; i < VULKAN_BINDLESS_MATERIAL_COUNT; ++i)
+        outBindless->freeMaterials[i] = VULKAN_BINDLESS_MATERIAL_COUNT - 1 - i;
+
+    PINFO("Bindless material set created, %u textures and %u materials.", VULKAN_MAX_TEXTURES, VULKAN_BINDLESS_MATERIAL_COUNT);
+    return true;
+}
+
+void vulkanBindlessDestroy(
+    const VulkanDevice& device,
+    VulkanBindless& bindless)
+{
+    vulkanBufferDestroy(device, bindless.materialBuffer);
+    bindless.materialData = nullptr;
+    bindless.materials.clear();
+    for(u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        bindless.staleMaterials[i].clear();
+        bindless.retiredMaterials[i].clear();
+    }
+    bindless.freeMaterials.clear();
+
+    // Destroying the pool frees the sets.
+    vkDestroyDescriptorPool(device.handle, bindless.pool, nullptr);
+    vkDestroyDescriptorSetLayout(device.handle, bindless.layout, nullptr);
+    bindless.freeTextures.clear();
+}
+
+bool vulkanBindlessAddTexture(
+    const VulkanDevice& device,
+    VulkanBindless& bindless,
+    VulkanTexture* texture)
+{
+    if(bindless.freeTextures.empty())
+    {
+        PERROR("vulkanBindlessAddTexture - all the %u texture slots are in use.", VULKAN_MAX_TEXTURES);
+        texture->bindlessIndex = INVALID_ID;
+        return false;
+    }
+    texture->bindlessIndex = bindless.freeTextures.back();
+    bindless.freeTextures.pop_back();
+
+    VkDescriptorImageInfo imageInfo;
+    imageInfo.imageLayout   = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView     = texture->image.view;
+    imageInfo.sampler       = texture->sampler;
+
+    VkWriteDescriptorSet textureWrites[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    for(u32 i = 0; i < bindless.frameCount; ++i)
+    {
+        VkWriteDescriptorSet& textureWrite = textureWrites[i];
+        textureWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        textureWrite.dstSet             = bindless.sets[i];
+        textureWrite.dstBinding         = 1;
+        textureWrite.dstArrayElement    = texture->bindlessIndex;
+        textureWrite.descriptorCount    = 1;
+        textureWrite.descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        textureWrite.pImageInfo         = &imageInfo;
+    }
+    vkUpdateDescriptorSets(device.handle, bindless.frameCount, textureWrites, 0, nullptr);
+    return true;
+}
+
+void vulkanBindlessRemoveTexture(
+    VulkanBindless& bindless,
+    VulkanTexture* texture)
+{
+    if(texture->bindlessIndex == INVALID_ID)
+        return;
+    bindless.freeTextures.push_back(texture->bindlessIndex);
+    texture->bindlessIndex = INVALID_ID;
+}
+
+bool vulkanBindlessCreateMaterial(
+    VulkanBindless& bindless,
+    Material* m)
+{
+    if(bindless.freeMaterials.empty())
+    {
+        PERROR("vulkanBindlessCreateMaterial - material buffer full, %u materials.", VULKAN_BINDLESS_MATERIAL_COUNT);
+        m->rendererId = INVALID_ID;
+        return false;
+    }
+    m->rendererId = bindless.freeMaterials.back();
+    bindless.freeMaterials.pop_back();
+
+    // No frame in flight reads a free slot, every region is written now.
+    VulkanMaterialData empty = {};
+    bindless.materials[m->rendererId] = empty;
+    for(u32 i = 0; i < bindless.frameCount; ++i)
+        bindless.materialData[i * VULKAN_BINDLESS_MATERIAL_COUNT + m->rendererId] = empty;
+    return true;
+}
+
+void vulkanBindlessDestroyMaterial(
+    VulkanBindless& bindless,
+    Material* m)
+{
+    if(m->rendererId == INVALID_ID)
+        return;
+    bindless.retiredMaterials[bindless.frame].push_back(m->rendererId);
+    m->rendererId = INVALID_ID;
+}
+
+void vulkanBindlessBeginFrame(
+    VulkanBindless& bindless,
+    u32 frame)
+{
+    VulkanMaterialData* region = bindless.materialData + frame * VULKAN_BINDLESS_MATERIAL_COUNT;
+    for(u32 id : bindless.staleMaterials[frame])
+        region[id] = bindless.materials[id];
+    bindless.staleMaterials[frame].clear();
+
+    for(u32 id : bindless.retiredMaterials[frame])
+        bindless.freeMaterials.push_back(id);
+    bindless.retiredMaterials[frame].clear();
+
+    bindless.frame = frame;
+}
+
+static u32 textureSlot(const Texture* t)
+{
+    if(!t || !t->data)
+        return INVALID_ID;
+    return ((const VulkanTexture*)t->data)->bindlessIndex;
+}
+
+void vulkanBindlessUpdateMaterial(
+    VulkanBindless& bindless,
+    const Material* m)
+{
+    VulkanMaterialData data;
+    data.diffuseColor               = m->diffuseColor;
+    data.diffuseTexture             = textureSlot(m->diffuseTexture);
+    data.normalTexture              = textureSlot(m->normalTexture);
+    data.metallicRoughnessTexture   = textureSlot(m->metallicRoughnessTexture);
+    data.padding                    = 0;
+    if(m->rendererId == INVALID_ID)
+        return;
+
+    // Only the region of the frame being recorded is written, frames in
+    // flight read theirs. The others are written when their frame begins.
+    u32 id = m->rendererId;
+    if(memcmp(&bindless.materials[id], &data, sizeof(VulkanMaterialData)) == 0)
+        return;
+    bindless.materials[id] = data;
+    bindless.materialData[bindless.frame * VULKAN_BINDLESS_MATERIAL_COUNT + id] = data;
+    for(u32 i = 0; i < bindless.frameCount; ++i) {
+        if(i != bindless.frame)
+            bindless.staleMaterials[i].push_back(id);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "vulkanTypes.h"
+
+/**
+ * Bindless materials.
+ * Every texture takes a slot of one big sampled image array and every
+ * material a VulkanMaterialData of one storage buffer, both in a single
+ * descriptor set. The forward and geometry pipelines bind it once at set 1
+ * and read the material of the draw pushed at offset 0, so changing the
+ * material costs a push constant instead of a descriptor set bind.
+ * Only used when device.bindless is set, else each material keeps its
+ * descriptor set in the shaders.
+ */
+
+/**
+ * Creates the sets and the material buffer, one of each per frame in flight.
+ */
+bool vulkanBindlessCreate(
+    const VulkanDevice& device,
+    u32 frameCount,
+    VulkanBindless* outBindless);
+
+void vulkanBindlessDestroy(
+    const VulkanDevice& device,
+    VulkanBindless& bindless);
+
+/**
+ * Writes the texture to a free slot of the array of every set and stores
+ * the slot in texture->bindlessIndex. The slot is not used by any frame in
+ * flight, so it can be written while they execute.
+ */
+bool vulkanBindlessAddTexture(
+    const VulkanDevice& device,
+    VulkanBindless& bindless,
+    VulkanTexture* texture);
+
+/**
+ * Gives the slot back. Call once no frame in flight samples the texture.
+ */
+void vulkanBindlessRemoveTexture(
+    VulkanBindless& bindless,
+    VulkanTexture* texture);
+
+/**
+ * Assigns the material a free index in the material buffer, m->rendererId.
+ */
+bool vulkanBindlessCreateMaterial(
+    VulkanBindless& bindless,
+    Material* m);
+
+/**
+ * Retires the index of the material, it is handed out again once the
+ * frames in flight are done with it.
+ */
+void vulkanBindlessDestroyMaterial(
+    VulkanBindless& bindless,
+    Material* m);
+
+/**
+ * Brings the region of the frame up to date and frees the indices retired
+ * in it. Call once the fence of that frame has been waited.
+ */
+void vulkanBindlessBeginFrame(
+    VulkanBindless& bindless,
+    u32 frame);
+
+/**
+ * Writes the color and texture slots of the material when they changed,
+ * to the region of the frame being recorded. The regions of the frames in
+ * flight get them when their frame begins again.
+ * Not thread safe, called on the main thread before recording the draws.
+ */
+void vulkanBindlessUpdateMaterial(
+    VulkanBindless& bindless,
+    const Material* m);
@@ -1,6 +1,8 @@
 #include "vulkanBuffer.h"
 
 #include "vulkanCommandBuffer.h"
+#include "vulkanMemory.h"
+#include "vulkanUpload.h"
 #include "vulkanUtils.h"
 
 bool vulkanBufferCreate(
@@ -20,23 +22,19 @@ bool vulkanBufferCreate(
     VkMemoryRequirements requirements;
     vkGetBufferMemoryRequirements(device.handle, buffer->handle, &requirements);
 
-    i32 index = findMemoryIndex(device, requirements.memoryTypeBits, memFlags);
-    if(index == -1){
-        PERROR("Could not find a valid memory index.");
+    if(!vulkanMemoryAllocate(device, requirements, memFlags, true, &buffer->allocation)){
+        vkDestroyBuffer(device.handle, buffer->handle, nullptr);
+        buffer->handle = VK_NULL_HANDLE;
         return false;
     }
-
-    VkMemoryAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    allocInfo.allocationSize    = requirements.size;
-    allocInfo.memoryTypeIndex   = index;
-    VK_CHECK(vkAllocateMemory(device.handle, &allocInfo, nullptr, &buffer->memory));
-    VK_CHECK(vkBindBufferMemory(device.handle, buffer->handle, buffer->memory, 0));
+    VK_CHECK(vkBindBufferMemory(device.handle, buffer->handle, buffer->allocation.memory, buffer->allocation.offset));
 
     return true;
 }
 
 /**
- * Upload data to the given buffer by mapping it.
+ * Upload data to the given host visible buffer. Its block is mapped
+ * while it lives, so this is a plain copy.
  */
 void vulkanBufferLoadData(
     const VulkanDevice& device,
@@ -46,10 +44,72 @@ void vulkanBufferLoadData(
     VkMemoryMapFlags flags,
     const void* data)
 {
-    void* targetData;
-    vkMapMemory(device.handle, buffer.memory, offset, size, flags, &targetData);
-    std::memcpy(targetData, data, size);
-    vkUnmapMemory(device.handle, buffer.memory);
+    PASSERT(buffer.allocation.mapped)
+    std::memcpy(buffer.allocation.mapped + offset, data, size);
+}
+
+bool vulkanRingBufferCreate(
+    const VulkanDevice& device,
+    u32 frameSize,
+    u32 frameCount,
+    u32 usageFlags,
+    VulkanRingBuffer* ring)
+{
+    // Every dynamic offset and region start must honor the device alignment.
+    const VkPhysicalDeviceLimits& limits = device.properties.limits;
+    u32 alignment = (u32)limits.minUniformBufferOffsetAlignment;
+    if(limits.minStorageBufferOffsetAlignment > alignment)
+        alignment = (u32)limits.minStorageBufferOffsetAlignment;
+
+    ring->alignment     = alignment;
+    ring->frameSize     = (frameSize + alignment - 1) & ~(alignment - 1);
+    ring->frameOffset   = 0;
+    ring->used          = 0;
+
+    if(!vulkanBufferCreate(
+        device,
+        ring->frameSize * frameCount,
+        usageFlags,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &ring->buffer))
+    {
+        return false;
+    }
+    ring->data = ring->buffer.allocation.mapped;
+    return true;
+}
+
+void vulkanRingBufferDestroy(
+    const VulkanDevice& device,
+    VulkanRingBuffer& ring)
+{
+    vulkanBufferDestroy(device, ring.buffer);
+    ring.data = nullptr;
+}
+
+void vulkanRingBufferBeginFrame(
+    VulkanRingBuffer& ring,
+    u32 frame)
+{
+    ring.frameOffset    = ring.frameSize * frame;
+    ring.used           = 0;
+}
+
+void* vulkanRingBufferAllocate(
+    VulkanRingBuffer& ring,
+    u32 size,
+    u32* outOffset)
+{
+    u32 start = (ring.used + ring.alignment - 1) & ~(ring.alignment - 1);
+    if(start + size > ring.frameSize)
+    {
+        PERROR("vulkanRingBufferAllocate - region full, %u bytes not allocated.", size);
+        return nullptr;
+    }
+
+    ring.used   = start + size;
+    *outOffset  = ring.frameOffset + start;
+    return ring.data + *outOffset;
 }
 
 /**
@@ -62,10 +122,7 @@ void vulkanBufferDestroy(
     const VulkanDevice& device,
     VulkanBuffer& buffer)
 {
-    vkFreeMemory(
-        device.handle, 
-        buffer.memory, 
-        nullptr);
+    vulkanMemoryFree(device, buffer.allocation);
 
     vkDestroyBuffer(
         device.handle, 
@@ -73,61 +130,226 @@ void vulkanBufferDestroy(
         nullptr);
 }
 
+bool vulkanGeometryBufferCreate(
+    const VulkanDevice& device,
+    u32 elementSize,
+    u32 capacity,
+    u32 usageFlags,
+    VulkanGeometryBuffer* geometry)
+{
+    // Growing copies the old contents, so the buffer is also a transfer source.
+    geometry->usage         = usageFlags | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    geometry->elementSize   = elementSize;
+    geometry->capacity      = capacity;
+    geometry->used          = 0;
+    geometry->frame         = 0;
+    geometry->freeRanges.clear();
+    geometry->freeRanges.push_back({0, capacity});
+
+    if(!vulkanBufferCreate(
+        device,
+        elementSize * capacity,
+        geometry->usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &geometry->buffer))
+    {
+        return false;
+    }
+    vulkanMemorySetUserData(device, geometry->buffer.allocation, geometry);
+    return true;
+}
+
+void vulkanGeometryBufferDestroy(
+    const VulkanDevice& device,
+    VulkanGeometryBuffer& geometry)
+{
+    vulkanBufferDestroy(device, geometry.buffer);
+    for(u32 i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; ++i) {
+        for(VulkanBuffer& retired : geometry.retiredBuffers[i])
+            vulkanBufferDestroy(device, retired);
+        geometry.retiredBuffers[i].clear();
+        geometry.retiredRanges[i].clear();
+    }
+    geometry.freeRanges.clear();
+    geometry.capacity   = 0;
+    geometry.used       = 0;
+}
+
 /**
- * @brief Transfer the buffer info from source buffer to destination buffer.
- * @param VkBuffer src The source of the data to be transferred.
- * @param VkBuffer dst The destination of the data.
- * @param VkDeviceSize size of the data to be transferred.
- * @return void
+ * Copies the contents to replacement, at least as big, and uses it from now on.
+ * Queued uploads target the old buffer, they are flushed and waited first.
+ * Their ranges end owned by the graphics family, so the copy goes on the
+ * graphics queue. Frames in flight may still read the old buffer, it is
+ * retired with the current frame.
  */
-void vulkanTransferBuffer(
+static void geometryBufferReplace(
     const VulkanDevice& device,
-    VkBuffer& src,
-    VkBuffer& dst,
-    VkDeviceSize size)
+    VulkanGeometryBuffer& geometry,
+    const VulkanBuffer& replacement)
 {
-    VkCommandBuffer cmd;
-    vulkanCommandBufferAllocateAndBeginSingleUse(
-        device, 
-        device.transferCmdPool, 
-        cmd);
+    // Any ticket past the last one flushes and waits every batch.
+    vulkanUploadWait(device, UINT64_MAX);
 
+    VkCommandBuffer cmd;
+    vulkanCommandBufferAllocateAndBeginSingleUse(device, device.commandPool, cmd);
+    VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
     VkBufferCopy region;
     region.srcOffset    = 0;
     region.dstOffset    = 0;
-    region.size         = size;
-    vkCmdCopyBuffer(cmd, src, dst, 1, &region);
+    region.size         = geometry.elementSize * geometry.capacity;
+    vkCmdCopyBuffer(cmd, geometry.buffer.handle, replacement.handle, 1, &region);
+    vulkanCommandBufferEndSingleUse(device, device.commandPool, device.graphicsQueue, cmd);
 
-    vulkanCommandBufferEndSingleUse(
-        device, 
-        device.transferCmdPool, 
-        device.transferQueue, 
-        cmd);
+    // A retired buffer is not moved anymore, the replacement can be.
+    vulkanMemorySetUserData(device, geometry.buffer.allocation, nullptr);
+    geometry.retiredBuffers[geometry.frame].push_back(geometry.buffer);
+    geometry.buffer = replacement;
+    vulkanMemorySetUserData(device, geometry.buffer.allocation, &geometry);
 }
 
 /**
- * @brief Upload data to the GPU through a staging buffer.
+ * Moves the contents to a buffer big enough for extra more elements.
  */
-void vulkanUploadDataToGPU(
+static bool geometryBufferGrow(
     const VulkanDevice& device,
-    VulkanBuffer& buffer, 
-    u32 offset, 
-    u64 size, 
-    const void* data)
+    VulkanGeometryBuffer& geometry,
+    u32 extra)
 {
-    VulkanBuffer stagingBuffer;
+    u32 capacity = geometry.capacity * 2;
+    while(capacity - geometry.capacity < extra)
+        capacity *= 2;
 
-    vulkanBufferCreate(
-        device,
-        size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &stagingBuffer
-    );
+    VulkanBuffer grown;
+    if(!vulkanBufferCreate(device, geometry.elementSize * capacity, geometry.usage,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &grown)){
+        PERROR("vulkanGeometryBufferAllocate - unable to grow to %u elements.", capacity);
+        return false;
+    }
+
+    geometryBufferReplace(device, geometry, grown);
+
+    // The new space joins the last free range if it reaches the end.
+    u32 added = capacity - geometry.capacity;
+    if(!geometry.freeRanges.empty()
+        && geometry.freeRanges.back().offset + geometry.freeRanges.back().count == geometry.capacity) {
+        geometry.freeRanges.back().count += added;
+    } else {
+        geometry.freeRanges.push_back({geometry.capacity, added});
+    }
+    PINFO("Geometry buffer grown to %u elements.", capacity);
+    geometry.capacity = capacity;
+    return true;
+}
+
+bool vulkanGeometryBufferAllocate(
+    const VulkanDevice& device,
+    VulkanGeometryBuffer& geometry,
+    u32 count,
+    u32* outOffset)
+{
+    for(u32 attempt = 0; attempt < 2; ++attempt)
+    {
+        // First fit, meshes are loaded in bulk and freed rarely.
+        for(u32 i = 0; i < geometry.freeRanges.size(); ++i)
+        {
+            VulkanRange& range = geometry.freeRanges[i];
+            if(range.count < count)
+                continue;
+
+            *outOffset      = range.offset;
+            range.offset    += count;
+            range.count     -= count;
+            if(range.count == 0)
+                geometry.freeRanges.erase(geometry.freeRanges.begin() + i);
+            geometry.used += count;
+            return true;
+        }
+        if(attempt == 0 && !geometryBufferGrow(device, geometry, count))
+            return false;
+    }
+    return false;
+}
+
+/**
+ * Inserts the range sorted and merges it with its neighbours.
+ */
+static void releaseRange(
+    VulkanGeometryBuffer& geometry,
+    u32 offset,
+    u32 count)
+{
+    u32 i = 0;
+    while(i < geometry.freeRanges.size() && geometry.freeRanges[i].offset < offset)
+        ++i;
+    geometry.freeRanges.insert(geometry.freeRanges.begin() + i, {offset, count});
 
-    vulkanBufferLoadData(device, stagingBuffer, 0, size, 0, data);
-    vulkanTransferBuffer(device, stagingBuffer.handle, buffer.handle, size);
-    vulkanBufferDestroy(device, stagingBuffer);
+    if(i + 1 < geometry.freeRanges.size()
+        && offset + count == geometry.freeRanges[i + 1].offset) {
+        geometry.freeRanges[i].count += geometry.freeRanges[i + 1].count;
+        geometry.freeRanges.erase(geometry.freeRanges.begin() + i + 1);
+    }
+    if(i > 0 && geometry.freeRanges[i - 1].offset + geometry.freeRanges[i - 1].count == offset) {
+        geometry.freeRanges[i - 1].count += geometry.freeRanges[i].count;
+        geometry.freeRanges.erase(geometry.freeRanges.begin() + i);
+    }
+    geometry.used -= count;
+}
+
+void vulkanGeometryBufferFree(
+    VulkanGeometryBuffer& geometry,
+    u32 offset,
+    u32 count)
+{
+    if(count == 0)
+        return;
+    geometry.retiredRanges[geometry.frame].push_back({offset, count});
+}
+
+void vulkanGeometryBufferBeginFrame(
+    const VulkanDevice& device,
+    VulkanGeometryBuffer& geometry,
+    u32 frame)
+{
+    for(const VulkanRange& range : geometry.retiredRanges[frame])
+        releaseRange(geometry, range.offset, range.count);
+    geometry.retiredRanges[frame].clear();
+
+    for(VulkanBuffer& retired : geometry.retiredBuffers[frame])
+        vulkanBufferDestroy(device, retired);
+    geometry.retiredBuffers[frame].clear();
+
+    geometry.frame = frame;
+}
+
+bool vulkanGeometryBufferMove(
+    void* user,
+    void* userData,
+    const VulkanAllocation& from,
+    const VulkanAllocation& to)
+{
+    const VulkanDevice& device = *static_cast<const VulkanDevice*>(user);
+    VulkanGeometryBuffer& geometry = *static_cast<VulkanGeometryBuffer*>(userData);
+    if(geometry.buffer.allocation.node != from.node)
+        return false;
+
+    VkBufferCreateInfo info{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    info.size           = geometry.elementSize * geometry.capacity;
+    info.sharingMode    = VK_SHARING_MODE_EXCLUSIVE;
+    info.usage          = geometry.usage;
+
+    VulkanBuffer moved;
+    if(vkCreateBuffer(device.handle, &info, nullptr, &moved.handle) != VK_SUCCESS)
+        return false;
+    moved.allocation = to;
+    VK_CHECK(vkBindBufferMemory(device.handle, moved.handle, to.memory, to.offset));
+
+    // The old buffer, and from with it, is freed with the retired ones.
+    geometryBufferReplace(device, geometry, moved);
+    return true;
 }
 
 /**
@@ -13,11 +13,38 @@ void vulkanBufferDestroy(
     const VulkanDevice& device,
     VulkanBuffer& buffer);
 
-void vulkanTransferBuffer(
+/**
+ * Creates a host visible ring buffer with frameCount regions of frameSize
+ * bytes and maps it until destroyed.
+ */
+bool vulkanRingBufferCreate(
     const VulkanDevice& device,
-    VkBuffer &src,
-    VkBuffer &dst,
-    VkDeviceSize size);
+    u32 frameSize,
+    u32 frameCount,
+    u32 usageFlags,
+    VulkanRingBuffer* ring);
+
+void vulkanRingBufferDestroy(
+    const VulkanDevice& device,
+    VulkanRingBuffer& ring);
+
+/**
+ * Moves to the region of the given frame and resets it. Call once the
+ * fence of that frame has been waited.
+ */
+void vulkanRingBufferBeginFrame(
+    VulkanRingBuffer& ring,
+    u32 frame);
+
+/**
+ * Hands out size bytes from the region of the current frame.
+ * @param u32* outOffset Dynamic offset of the allocation.
+ * @return void* mapped memory to write to, or nullptr if the region is full.
+ */
+void* vulkanRingBufferAllocate(
+    VulkanRingBuffer& ring,
+    u32 size,
+    u32* outOffset);
 
 void vulkanBufferLoadData(
     const VulkanDevice& device,
@@ -27,12 +54,58 @@ void vulkanBufferLoadData(
     VkMemoryMapFlags flags,
     const void* data);
 
-void vulkanUploadDataToGPU(
+/**
+ * Creates a shared buffer of capacity elements of elementSize bytes.
+ */
+bool vulkanGeometryBufferCreate(
     const VulkanDevice& device,
-    VulkanBuffer& buffer,
+    u32 elementSize,
+    u32 capacity,
+    u32 usageFlags,
+    VulkanGeometryBuffer* geometry);
+
+void vulkanGeometryBufferDestroy(
+    const VulkanDevice& device,
+    VulkanGeometryBuffer& geometry);
+
+/**
+ * Takes a range of count elements, growing the buffer if none is free.
+ * Growing replaces the VkBuffer, so rebind it after loading meshes.
+ * @param u32* outOffset First element of the range.
+ */
+bool vulkanGeometryBufferAllocate(
+    const VulkanDevice& device,
+    VulkanGeometryBuffer& geometry,
+    u32 count,
+    u32* outOffset);
+
+/**
+ * Retires a range, it is reused once the fence of the current frame is signaled.
+ */
+void vulkanGeometryBufferFree(
+    VulkanGeometryBuffer& geometry,
     u32 offset,
-    u64 size,
-    const void* data);
+    u32 count);
+
+/**
+ * Gives back what was retired in the given frame and makes it the current
+ * one. Call once the fence of that frame has been waited.
+ */
+void vulkanGeometryBufferBeginFrame(
+    const VulkanDevice& device,
+    VulkanGeometryBuffer& geometry,
+    u32 frame);
+
+/**
+ * Defragmentation hook of geometry buffers, they mark themselves movable.
+ * user is the VulkanDevice, userData the VulkanGeometryBuffer. Its contents
+ * are copied to a buffer at to, the old one is retired with the frame.
+ */
+bool vulkanGeometryBufferMove(
+    void* user,
+    void* userData,
+    const VulkanAllocation& from,
+    const VulkanAllocation& to);
 
 void vulkanBufferCopyToImage(
     const VulkanDevice& device,
@@ -1,4 +1,6 @@
 #include "vulkanDevice.h"
+#include "vulkanMemory.h"
+#include "vulkanUpload.h"
 #include "memory\pmemory.h"
 
 typedef struct PhysicalDeviceRequirements
@@ -436,6 +438,65 @@ bool createLogicalDevice(VulkanState* state)
 
     std::vector<const char*> extensionNames = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+    // Bindless materials need descriptor indexing, core since 1.2. Without it
+    // every material keeps its own descriptor set. The 1.2 features are
+    // queried and enabled together, so draw indirect count goes in the same struct.
+    VkPhysicalDeviceVulkan12Features features12 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    state->device.bindless = false;
+    state->device.gpuDriven = false;
+    if(state->device.properties.apiVersion >= VK_API_VERSION_1_2)
+    {
+        VkPhysicalDeviceFeatures2 features2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+        features2.pNext = &features12;
+        vkGetPhysicalDeviceFeatures2(state->device.physicalDevice, &features2);
+
+        VkPhysicalDeviceDescriptorIndexingProperties indexingProperties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES};
+        VkPhysicalDeviceProperties2 properties2 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+        properties2.pNext = &indexingProperties;
+        vkGetPhysicalDeviceProperties2(state->device.physicalDevice, &properties2);
+
+        state->device.bindless = features12.runtimeDescriptorArray
+            && features12.descriptorBindingPartiallyBound
+            && features12.descriptorBindingSampledImageUpdateAfterBind
+            && features12.descriptorBindingUpdateUnusedWhilePending
+            && features12.shaderSampledImageArrayNonUniformIndexing
+            && indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages >= VULKAN_MAX_TEXTURES
+            && indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages >= VULKAN_MAX_TEXTURES;
+
+        // The culling shader runs on the graphics queue and writes one draw
+        // per object, picking the object with firstInstance. Objects read
+        // their material from the bindless buffer.
+        u32 familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(state->device.physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(state->device.physicalDevice, &familyCount, families.data());
+
+        state->device.gpuDriven = state->device.bindless
+            && features12.drawIndirectCount
+            && state->device.features.multiDrawIndirect
+            && state->device.features.drawIndirectFirstInstance
+            && (families[state->device.graphicsQueueIndex].queueFlags & VK_QUEUE_COMPUTE_BIT);
+    }
+    if(state->device.bindless)
+    {
+        // Enable only what the bindless set and the indirect draws use.
+        VkPhysicalDeviceVulkan12Features supported = features12;
+        features12 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+        features12.runtimeDescriptorArray                       = supported.runtimeDescriptorArray;
+        features12.descriptorBindingPartiallyBound              = supported.descriptorBindingPartiallyBound;
+        features12.descriptorBindingSampledImageUpdateAfterBind = supported.descriptorBindingSampledImageUpdateAfterBind;
+        features12.descriptorBindingUpdateUnusedWhilePending    = supported.descriptorBindingUpdateUnusedWhilePending;
+        features12.shaderSampledImageArrayNonUniformIndexing    = supported.shaderSampledImageArrayNonUniformIndexing;
+        if(state->device.gpuDriven)
+        {
+            features12.drawIndirectCount                = VK_TRUE;
+            deviceFeatures.multiDrawIndirect            = VK_TRUE;
+            deviceFeatures.drawIndirectFirstInstance    = VK_TRUE;
+        }
+    }
+    PINFO("Bindless materials %s.", state->device.bindless ? "enabled" : "not supported, using a descriptor set per material");
+    PINFO("GPU culling %s.", state->device.gpuDriven ? "enabled" : "not supported, culling on the CPU");
+
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.sType                      = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceCreateInfo.queueCreateInfoCount       = queueCreateInfo.size();
@@ -444,6 +505,8 @@ bool createLogicalDevice(VulkanState* state)
     deviceCreateInfo.enabledExtensionCount      = extensionNames.size();
     deviceCreateInfo.ppEnabledExtensionNames    = extensionNames.data();
     //deviceCreateInfo.pNext = &extendedDynamicStateFeatures;
+    if(state->device.bindless)
+        deviceCreateInfo.pNext = &features12;
 
     VK_CHECK(vkCreateDevice(
         state->device.physicalDevice,
@@ -482,6 +545,14 @@ bool createLogicalDevice(VulkanState* state)
     VK_CHECK(vkCreateCommandPool(state->device.handle, &cmdPoolInfo, nullptr, &state->device.transferCmdPool));
     PINFO("Transfer command pool created");
 
+    if(!vulkanMemoryCreate(&state->device)){
+        return false;
+    }
+
+    if(!vulkanUploadCreate(&state->device)){
+        return false;
+    }
+
     return true;
 }
 
@@ -505,6 +576,8 @@ void destroyLogicalDevice(VulkanState& pState)
         nullptr);
 
     vkDeviceWaitIdle(pState.device.handle);
+    vulkanUploadDestroy(&pState.device);
+    vulkanMemoryDestroy(&pState.device);
     vkDestroyDevice(pState.device.handle, nullptr);
 }
 
@@ -1,6 +1,8 @@
 #include "vulkanImGui.h"
 #include "vulkanTypes.h"
 #include "vulkanCommandBuffer.h"
+#include "vulkanBuffer.h"
+#include "vulkanMemory.h"
 
 #include <external/imgui/imgui_impl_win32.h>
 #include <external/imgui/imgui_impl_vulkan.h>
@@ -9,6 +11,8 @@
 #include "systems/components/comp_name.h"
 #include "systems/components/comp_light_point.h"
 #include "systems/components/comp_parent.h"
+#include "systems/components/comp_render.h"
+#include "systems/entity/entity.h"
 #include "systems/modules/module_manager.h"
 
 // TODO Should be done through a module manager
@@ -16,6 +20,9 @@
 #include "systems/modules/module_entities.h"
 
 #include "memory/pmemory.h"
+#include "renderer/rendererFrontend.h"
+#include "renderer/renderTestScene.h"
+#include "systems/jobSystem.h"
 
 struct imguiState
 {
@@ -23,6 +30,7 @@ struct imguiState
     const VulkanRenderpass* renderPass;
     const VulkanDevice* device;
     const VulkanSwapchain* swapchain;
+    const RenderStats* stats;
 };
 
 static imguiState* imgui = nullptr;
@@ -38,6 +46,7 @@ imguiInit(
     ImGui::CreateContext();
 
     imgui->device = &state->device;
+    imgui->stats = &state->lastFrameStats;
     imgui->renderPass = renderpass;
     imgui->swapchain = &state->swapchain;
 
@@ -79,6 +88,364 @@ imguiInit(
     ImGui_ImplVulkan_DestroyFontUploadObjects();
 }
 
+static void
+imguiRenderMemoryStats()
+{
+    if(ImGui::TreeNode("Memory ..."))
+    {
+        MemoryTotalStats total = memoryGetTotalStats();
+        ImGui::Text("Total %.2f MiB, peak %.2f MiB, %llu live allocations",
+            total.allocated / (1024.0f * 1024.0f), total.peak / (1024.0f * 1024.0f), total.liveCount);
+
+        MemoryGpuStats gpu = memoryGetGpuStats();
+        ImGui::Text("GPU %.2f MiB used of %.2f MiB in %llu blocks, %llu live allocations, %llu free ranges",
+            gpu.used / (1024.0f * 1024.0f), gpu.reserved / (1024.0f * 1024.0f), gpu.blockCount, gpu.liveCount, gpu.freeRanges);
+
+        for(u32 i = 0; i < MEMORY_TAG_MAX_TAGS; ++i)
+        {
+            MemoryTagStats stats = memoryGetStats((memoryTag)i);
+            if(stats.totalCount == 0)
+                continue;
+            ImGui::Text("%s %10.2f KiB  peak %10.2f KiB  %llu live",
+                memoryGetTagName((memoryTag)i), stats.allocated / 1024.0f, stats.peak / 1024.0f, stats.liveCount);
+        }
+
+        if(ImGui::Button("Dump allocations"))
+            memoryCaptureDump("memory_capture.csv", MEMORY_CAPTURE_FORMAT_CSV);
+        ImGui::SameLine();
+        // Geometry buffers are the movable allocations, the blocks they leave are released.
+        if(ImGui::Button("Defragment GPU memory"))
+        {
+            u32 moved = vulkanMemoryDefragment(*imgui->device, 16, vulkanGeometryBufferMove, (void*)imgui->device);
+            PINFO("GPU memory: %u allocations moved.", moved);
+        }
+        ImGui::TreePop();
+    }
+}
+
+/**
+ * Record time at every thread count, a thread count every few frames.
+ * Results go to the log.
+ */
+struct RecordSweep
+{
+    u32 threads;        // 0 when not running.
+    u32 frame;
+    f64 totalMs;
+};
+static RecordSweep recordSweep = {};
+
+// Frames skipped after changing the thread count, then frames averaged.
+#define RECORD_SWEEP_WARMUP 8
+#define RECORD_SWEEP_FRAMES 64
+
+static void
+recordSweepStart()
+{
+    recordSweep.threads = 1;
+    recordSweep.frame   = 0;
+    recordSweep.totalMs = 0.0;
+    jobSystemSetActiveThreads(1);
+}
+
+static void
+recordSweepUpdate()
+{
+    if(recordSweep.threads == 0)
+        return;
+
+    const RenderStats* stats = imgui->stats;
+    if(recordSweep.frame++ >= RECORD_SWEEP_WARMUP)
+        recordSweep.totalMs += stats->cpuRecordMs;
+    if(recordSweep.frame < RECORD_SWEEP_WARMUP + RECORD_SWEEP_FRAMES)
+        return;
+
+    PINFO("Record: %u draw calls, %u threads, %.3f ms per frame in %u buffers.",
+        stats->drawCalls, recordSweep.threads, recordSweep.totalMs / RECORD_SWEEP_FRAMES, stats->recordBuffers);
+    recordSweep.frame   = 0;
+    recordSweep.totalMs = 0.0;
+    if(++recordSweep.threads > jobSystemThreadCount()) {
+        recordSweep.threads = 0;
+        jobSystemSetActiveThreads(0);
+        return;
+    }
+    jobSystemSetActiveThreads(recordSweep.threads);
+}
+
+/**
+ * Geometry pass CPU time on the GPU driven path, then on the CPU path,
+ * with the same test cubes. Results go to the log.
+ */
+struct GeometrySweep
+{
+    u32 step;           // 0 when not running, 1 GPU driven, 2 CPU.
+    u32 frame;
+    u32 objects;        // Cubes spawned, may be less than asked for.
+    f64 totalMs;
+    f64 gpuDrivenMs;
+    bool gpuCulling;    // Restored at the end.
+};
+static GeometrySweep geometrySweep = {};
+
+#define GEOMETRY_SWEEP_OBJECTS 50000
+
+/**
+ * Cubes the sweep can spawn. Each one takes an entity, a transform and a
+ * render handle, and both paths have to fit all of them in one frame.
+ */
+static u32
+geometrySweepObjectCount()
+{
+    u32 used = getObjectManager<CEntity>()->size();
+    if(getObjectManager<TCompTransform>()->size() > used)
+        used = getObjectManager<TCompTransform>()->size();
+    if(getObjectManager<TCompRender>()->size() > used)
+        used = getObjectManager<TCompRender>()->size();
+    // Managers can not reach the full index range, see CHandleManager::init.
+    u32 room = CHandleManager::maxCapacity() - 1 > used ? CHandleManager::maxCapacity() - 1 - used : 0;
+
+    u32 count = GEOMETRY_SWEEP_OBJECTS;
+    if(count > room)
+        count = room;
+    if(count > VULKAN_MAX_INSTANCES)
+        count = VULKAN_MAX_INSTANCES;
+    if(count > VULKAN_MAX_INDIRECT_OBJECTS)
+        count = VULKAN_MAX_INDIRECT_OBJECTS;
+    return count;
+}
+
+static void
+geometrySweepStart()
+{
+    geometrySweep.gpuCulling = renderGetGpuCulling();
+    renderTestSceneClear();
+    u32 objects = geometrySweepObjectCount();
+    if(objects < GEOMETRY_SWEEP_OBJECTS)
+        PINFO("Geometry: only room for %u of %u objects.", objects, GEOMETRY_SWEEP_OBJECTS);
+    renderTestSceneSpawnCubes(objects, 1);
+    geometrySweep.objects = renderTestSceneEntityCount();
+    if(geometrySweep.objects == 0) {
+        PERROR("Geometry: no test cubes could be spawned.");
+        return;
+    }
+    renderSetGpuCulling(true);
+    geometrySweep.step        = renderGetGpuCulling() ? 1 : 2;
+    geometrySweep.frame       = 0;
+    geometrySweep.totalMs     = 0.0;
+    geometrySweep.gpuDrivenMs = 0.0;
+    if(geometrySweep.step == 2) {
+        PINFO("Geometry: GPU culling not supported, measuring the CPU path only.");
+        renderSetGpuCulling(false);
+    }
+}
+
+static void
+geometrySweepUpdate()
+{
+    if(geometrySweep.step == 0)
+        return;
+
+    RenderStats stats;
+    renderGetStats(&stats);
+
+    // A frame on the wrong path or without the cubes would time nothing.
+    // The deferred light quad is one of the draws and instances.
+    bool drawn = geometrySweep.step == 1
+        ? stats.gpuDriven == 1 && stats.drawCalls > 1
+        : stats.gpuDriven == 0 && stats.instances > 1;
+    if(geometrySweep.frame >= RECORD_SWEEP_WARMUP && !drawn) {
+        PERROR("Geometry: the %s path drew nothing, sweep stopped.", geometrySweep.step == 1 ? "GPU driven" : "CPU");
+        geometrySweep.step = 0;
+        renderSetGpuCulling(geometrySweep.gpuCulling);
+        return;
+    }
+
+    if(geometrySweep.frame++ >= RECORD_SWEEP_WARMUP)
+        geometrySweep.totalMs += stats.cpuGeometryMs;
+    if(geometrySweep.frame < RECORD_SWEEP_WARMUP + RECORD_SWEEP_FRAMES)
+        return;
+
+    f64 ms = geometrySweep.totalMs / RECORD_SWEEP_FRAMES;
+    geometrySweep.frame   = 0;
+    geometrySweep.totalMs = 0.0;
+    if(geometrySweep.step == 1) {
+        geometrySweep.gpuDrivenMs = ms;
+        geometrySweep.step = 2;
+        renderSetGpuCulling(false);
+        return;
+    }
+
+    PINFO("Geometry: %u objects, %.3f ms per frame GPU driven, %.3f ms per frame on the CPU path.",
+        geometrySweep.objects, geometrySweep.gpuDrivenMs, ms);
+    geometrySweep.step = 0;
+    renderSetGpuCulling(geometrySweep.gpuCulling);
+}
+
+/**
+ * Frame times with each present mode, the swapchain is recreated between
+ * them. Results go to the log.
+ */
+struct PresentSweep
+{
+    u32 mode;           // Measured mode plus one, 0 when not running.
+    u32 frame;
+    f64 frameMs;
+    f64 waitMs;
+    f64 gpuMs;
+    u32 restoreMode;
+};
+static PresentSweep presentSweep = {};
+
+static const char* presentModeNames[] = { "fifo", "mailbox", "immediate" };
+#define PRESENT_MODE_COUNT 3
+
+static void
+presentSweepStart()
+{
+    presentSweep.restoreMode = imgui->stats->presentMode;
+    presentSweep.mode    = 1;
+    presentSweep.frame   = 0;
+    presentSweep.frameMs = 0.0;
+    presentSweep.waitMs  = 0.0;
+    presentSweep.gpuMs   = 0.0;
+    renderSetPresentMode(RENDER_PRESENT_FIFO);
+}
+
+static void
+presentSweepUpdate()
+{
+    if(presentSweep.mode == 0)
+        return;
+
+    const RenderStats* stats = imgui->stats;
+    if(presentSweep.frame++ >= RECORD_SWEEP_WARMUP) {
+        presentSweep.frameMs += stats->cpuFrameMs;
+        presentSweep.waitMs  += stats->cpuWaitMs;
+        presentSweep.gpuMs   += stats->gpuGeometryMs + stats->gpuLightMs;
+    }
+    if(presentSweep.frame < RECORD_SWEEP_WARMUP + RECORD_SWEEP_FRAMES)
+        return;
+
+    u32 mode = presentSweep.mode - 1;
+    PINFO("Present %s%s: %.3f ms frame, %.3f ms wait, %.3f ms GPU per frame.",
+        presentModeNames[mode], stats->presentMode != mode ? " (not supported, fifo)" : "",
+        presentSweep.frameMs / RECORD_SWEEP_FRAMES, presentSweep.waitMs / RECORD_SWEEP_FRAMES,
+        presentSweep.gpuMs / RECORD_SWEEP_FRAMES);
+    presentSweep.frame   = 0;
+    presentSweep.frameMs = 0.0;
+    presentSweep.waitMs  = 0.0;
+    presentSweep.gpuMs   = 0.0;
+    if(++presentSweep.mode > PRESENT_MODE_COUNT) {
+        presentSweep.mode = 0;
+        renderSetPresentMode((RenderPresentMode)presentSweep.restoreMode);
+        return;
+    }
+    renderSetPresentMode((RenderPresentMode)(presentSweep.mode - 1));
+}
+
+static void
+imguiRenderStats()
+{
+    if(ImGui::TreeNode("Render stats ..."))
+    {
+        const RenderStats* stats = imgui->stats;
+        ImGui::Text("Draw calls          %u", stats->drawCalls);
+        ImGui::Text("Instances           %u", stats->instances);
+        ImGui::Text("Pipeline binds      %u", stats->pipelineBinds);
+        ImGui::Text("Descriptor binds    %u", stats->descriptorBinds);
+        ImGui::Text("Vertex buffer binds %u", stats->vertexBufferBinds);
+        ImGui::Text("Lights              %u", stats->lights);
+        ImGui::Text("Light upload        %.3f ms", stats->lightUploadMs);
+        ImGui::Text("Map calls           %u", stats->mapCalls);
+        ImGui::Text("Cluster indices     %u", stats->lightIndices);
+        ImGui::Text("Cluster build       %.3f ms", stats->lightClusterMs);
+
+        // GPU times are from the frame that last used the slot, frames in flight behind.
+        f32 cpuMs = stats->cpuFrameMs - stats->cpuWaitMs;
+        f32 gpuMs = stats->gpuGeometryMs + stats->gpuLightMs;
+        ImGui::Text("CPU frame           %.3f ms", stats->cpuFrameMs);
+        ImGui::Text("CPU wait            %.3f ms", stats->cpuWaitMs);
+        ImGui::Text("Upload wait         %.3f ms", stats->uploadWaitMs);
+        ImGui::Text("CPU submit          %.3f ms", stats->cpuSubmitMs);
+        ImGui::Text("CPU record          %.3f ms in %u buffers", stats->cpuRecordMs, stats->recordBuffers);
+
+        // Threads of the job system, recording included.
+        i32 threads = (i32)jobSystemActiveThreads();
+        if(ImGui::SliderInt("Threads", &threads, 1, (i32)jobSystemThreadCount()))
+            jobSystemSetActiveThreads((u32)threads);
+        if(ImGui::Button("Measure record scaling"))
+            recordSweepStart();
+        ImGui::Text("GPU geometry        %.3f ms", stats->gpuGeometryMs);
+        ImGui::Text("GPU light           %.3f ms", stats->gpuLightMs);
+        ImGui::Text("Bound               %s", gpuMs > cpuMs ? "GPU" : "CPU");
+
+        // Last frame time seen with each present mode, switch to fill them all.
+        static f32 presentFrameMs[PRESENT_MODE_COUNT] = {};
+        static f32 presentWaitMs[PRESENT_MODE_COUNT] = {};
+        PASSERT(stats->presentMode < PRESENT_MODE_COUNT)
+        presentFrameMs[stats->presentMode] = stats->cpuFrameMs;
+        presentWaitMs[stats->presentMode] = stats->cpuWaitMs;
+        i32 presentMode = (i32)stats->presentMode;
+        if(ImGui::Combo("Present mode", &presentMode, presentModeNames, PRESENT_MODE_COUNT))
+            renderSetPresentMode((RenderPresentMode)presentMode);
+        for(u32 i = 0; i < PRESENT_MODE_COUNT; ++i)
+            ImGui::Text("Frame %-13s %.3f ms, %.3f ms wait", presentModeNames[i], presentFrameMs[i], presentWaitMs[i]);
+        if(ImGui::Button("Measure present modes"))
+            presentSweepStart();
+
+        bool instancing = renderGetInstancing();
+        if(ImGui::Checkbox("Instancing", &instancing))
+            renderSetInstancing(instancing);
+
+        // Last time measured on each path, toggle to fill both.
+        static f32 geometryMs[2] = {};
+        RenderStats frontend;
+        renderGetStats(&frontend);
+        geometryMs[frontend.gpuDriven] = frontend.cpuGeometryMs;
+        bool gpuCulling = renderGetGpuCulling();
+        if(ImGui::Checkbox("GPU culling", &gpuCulling))
+            renderSetGpuCulling(gpuCulling);
+        ImGui::Text("Culled draws        %u", frontend.culledDraws);
+        ImGui::Text("CPU geometry        %.3f ms GPU driven, %.3f ms CPU path", geometryMs[1], geometryMs[0]);
+        if(ImGui::Button("Compare geometry paths at 50k cubes"))
+            geometrySweepStart();
+
+        // Known object counts to read the numbers above at.
+        static i32 cubeCount = 10000;
+        static i32 materialCount = 1;
+        ImGui::InputInt("Cubes", &cubeCount, 1000, 10000);
+        ImGui::InputInt("Materials", &materialCount);
+        if(ImGui::Button("Spawn cubes") && cubeCount > 0)
+            renderTestSceneSpawnCubes((u32)cubeCount, materialCount > 0 ? (u32)materialCount : 1);
+        ImGui::SameLine();
+        // Descriptor binds when the sorted draws change material 500 times.
+        if(ImGui::Button("Spawn with 500 materials") && cubeCount > 0)
+        {
+            renderTestSceneClear();
+            renderTestSceneSpawnCubes((u32)cubeCount, 500);
+        }
+        static i32 lightCount = 1000;
+        ImGui::InputInt("Lights", &lightCount, 100, 1000);
+        if(ImGui::Button("Spawn lights") && lightCount > 0)
+            renderTestSceneSpawnLights((u32)lightCount);
+        ImGui::SameLine();
+        if(ImGui::Button("Clear test scene"))
+            renderTestSceneClear();
+        ImGui::Text("Test scene entities %u", renderTestSceneEntityCount());
+        static i32 loadMeshCount = 500;
+        static i32 loadTextureCount = 200;
+        ImGui::InputInt("Meshes", &loadMeshCount, 100, 500);
+        ImGui::InputInt("Textures", &loadTextureCount, 50, 200);
+        if(ImGui::Button("Load resources"))
+            renderTestSceneLoad(loadMeshCount > 0 ? (u32)loadMeshCount : 0, loadTextureCount > 0 ? (u32)loadTextureCount : 0);
+        RenderTestSceneLoadStats load = renderTestSceneGetLoadStats();
+        ImGui::Text("Mesh load           %.3f ms for %u", load.meshMs, load.meshes);
+        ImGui::Text("Texture load        %.3f ms for %u", load.textureMs, load.textures);
+        ImGui::Text("Upload              %.3f ms for %.1f MB", load.uploadMs, load.bytes / (1024.0 * 1024.0));
+        ImGui::TreePop();
+    }
+}
+
 void
 imguiRender(
     VkCommandBuffer& cmd,
@@ -93,6 +460,11 @@ imguiRender(
     {
         app->moduleManager->renderInMenu();
     }
+    recordSweepUpdate();
+    geometrySweepUpdate();
+    presentSweepUpdate();
+    imguiRenderMemoryStats();
+    imguiRenderStats();
 
     ImGui::Render();
     ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
@@ -1,5 +1,6 @@
 #include "vulkanImage.h"
 
+#include "vulkanMemory.h"
 #include "vulkanUtils.h"
 
 void vulkanCreateImage(
@@ -43,13 +44,19 @@ void vulkanCreateImage(
         outImage->handle, 
         &memoryRequirements);
 
-    VkMemoryAllocateInfo memoryAllocateInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-    memoryAllocateInfo.allocationSize = memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex = findMemoryIndex(device, memoryRequirements.memoryTypeBits, memoryProperties);
-
-    VK_CHECK(vkAllocateMemory(device.handle, &memoryAllocateInfo, nullptr, &outImage->memory));
+    // Optimal images get blocks apart from buffers, see vulkanMemory.h.
+    if(!vulkanMemoryAllocate(
+        device,
+        memoryRequirements,
+        memoryProperties,
+        tiling == VK_IMAGE_TILING_LINEAR,
+        &outImage->allocation))
+    {
+        PERROR("vulkanCreateImage - failed to allocate memory for a %ux%u image.", width, height);
+        return;
+    }
 
-    VK_CHECK(vkBindImageMemory(device.handle, outImage->handle, outImage->memory, 0));
+    VK_CHECK(vkBindImageMemory(device.handle, outImage->handle, outImage->allocation.memory, outImage->allocation.offset));
 
     if(createView)
     {
@@ -0,0 +1,489 @@
+#include "vulkanIndirect.h"
+
+#include "vulkanBuffer.h"
+#include "vulkanPipeline.h"
+#include "vulkanShaderModule.h"
+#include "vulkanVertexDeclaration.h"
+#include "memory/pmemory.h"
+
+#include <algorithm>
+
+// Invocations per workgroup of the culling shader.
+#define VULKAN_CULL_GROUP_SIZE 64
+
+#define VULKAN_INDIRECT_OBJECT_REGION (sizeof(VulkanObjectData) * VULKAN_MAX_INDIRECT_OBJECTS)
+#define VULKAN_INDIRECT_MESH_REGION (sizeof(VulkanMeshDrawData) * VULKAN_MAX_MESHES)
+#define VULKAN_INDIRECT_DRAW_REGION (sizeof(VkDrawIndexedIndirectCommand) * VULKAN_MAX_INDIRECT_OBJECTS)
+
+struct VulkanCullConstants
+{
+    glm::vec4 planes[6];
+    u32 objectCount;
+};
+
+/**
+ * Bounding sphere to world space, the radius grows with the largest scale.
+ */
+static glm::vec4 worldSphere(const glm::mat4& m, const glm::vec4& local)
+{
+    f32 scale = glm::max(glm::length(glm::vec3(m[0])), glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+    return glm::vec4(glm::vec3(m * glm::vec4(glm::vec3(local), 1.0f)), local.w * scale);
+}
+
+static bool createBuffers(
+    const VulkanDevice& device,
+    u32 frameCount,
+    VulkanIndirect* outIndirect)
+{
+    // Each count takes its own dynamic offset.
+    u32 alignment = (u32)device.properties.limits.minStorageBufferOffsetAlignment;
+    outIndirect->countStride = alignment > sizeof(u32) ? alignment : sizeof(u32);
+
+    if(!vulkanBufferCreate(
+        device,
+        VULKAN_INDIRECT_OBJECT_REGION * frameCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &outIndirect->objectBuffer)){
+        return false;
+    }
+    if(!vulkanBufferCreate(
+        device,
+        VULKAN_INDIRECT_MESH_REGION * frameCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &outIndirect->meshBuffer)){
+        return false;
+    }
+    if(!vulkanBufferCreate(
+        device,
+        VULKAN_INDIRECT_DRAW_REGION * frameCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &outIndirect->drawBuffer)){
+        return false;
+    }
+    if(!vulkanBufferCreate(
+        device,
+        outIndirect->countStride * frameCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        &outIndirect->countBuffer)){
+        return false;
+    }
+
+    outIndirect->objectData = outIndirect->objectBuffer.allocation.mapped;
+    outIndirect->meshData   = outIndirect->meshBuffer.allocation.mapped;
+    memZero(outIndirect->meshData, VULKAN_INDIRECT_MESH_REGION * frameCount);
+    return true;
+}
+
+static void createDescriptorSet(
+    const VulkanDevice& device,
+    VulkanIndirect* outIndirect)
+{
+    // Objects, meshes, draws and counts have a region per frame, picked with dynamic offsets.
+    VkDescriptorSetLayoutBinding bindings[4] = {};
+    for(u32 i = 0; i < 4; ++i)
+    {
+        bindings[i].binding         = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    // The geometry pass reads the model and material of its object.
+    bindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = 4;
+    layoutInfo.pBindings    = bindings;
+    VK_CHECK(vkCreateDescriptorSetLayout(device.handle, &layoutInfo, nullptr, &outIndirect->layout));
+
+    VkDescriptorPoolSize poolSize;
+    poolSize.type               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSize.descriptorCount    = 4;
+
+    VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.maxSets        = 1;
+    poolInfo.poolSizeCount  = 1;
+    poolInfo.pPoolSizes     = &poolSize;
+    VK_CHECK(vkCreateDescriptorPool(device.handle, &poolInfo, nullptr, &outIndirect->pool));
+
+    VkDescriptorSetAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool        = outIndirect->pool;
+    allocInfo.descriptorSetCount    = 1;
+    allocInfo.pSetLayouts           = &outIndirect->layout;
+    VK_CHECK(vkAllocateDescriptorSets(device.handle, &allocInfo, &outIndirect->set));
+
+    VkDescriptorBufferInfo bufferInfos[4];
+    bufferInfos[0] = {outIndirect->objectBuffer.handle, 0, VULKAN_INDIRECT_OBJECT_REGION};
+    bufferInfos[1] = {outIndirect->meshBuffer.handle, 0, VULKAN_INDIRECT_MESH_REGION};
+    bufferInfos[2] = {outIndirect->drawBuffer.handle, 0, VULKAN_INDIRECT_DRAW_REGION};
+    bufferInfos[3] = {outIndirect->countBuffer.handle, 0, sizeof(u32)};
+
+    VkWriteDescriptorSet writes[4];
+    for(u32 i = 0; i < 4; ++i)
+    {
+        writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+        writes[i].dstSet            = outIndirect->set;
+        writes[i].dstBinding        = i;
+        writes[i].dstArrayElement   = 0;
+        writes[i].descriptorCount   = 1;
+        writes[i].descriptorType    = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        writes[i].pBufferInfo       = &bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(device.handle, 4, writes, 0, nullptr);
+}
+
+static bool createPipelines(
+    const VulkanDevice& device,
+    const VulkanDeferredShader& deferredShader,
+    const VulkanBindless& bindless,
+    u32 width,
+    u32 height,
+    VulkanIndirect* outIndirect)
+{
+    system("glslc ./data/shaders/cull.comp -o ./data/shaders/cull.comp.spv");
+    system("glslc -DINDIRECT ./data/shaders/geometry.vert -o ./data/shaders/geometry_indirect.vert.spv");
+    // Writes the same G-buffer layout as the deferred geometry pipeline.
+    const bool compact = deferredShader.gbuf.layout == RENDER_GBUFFER_COMPACT;
+    std::string fragmentPath = compact ? "./data/shaders/geometry_indirect_compact.frag.spv" : "./data/shaders/geometry_indirect.frag.spv";
+    system(("glslc -DBINDLESS -DINDIRECT" + std::string(compact ? " -DCOMPACT_GBUFFER" : "")
+        + " ./data/shaders/geometry.frag -o " + fragmentPath).c_str());
+
+    std::vector<char> cullCode, vertexCode, fragmentCode;
+    if(!readShaderFile("./data/shaders/cull.comp.spv", cullCode)
+        || !readShaderFile("./data/shaders/geometry_indirect.vert.spv", vertexCode)
+        || !readShaderFile(fragmentPath.c_str(), fragmentCode)){
+        PERROR("vulkanIndirectCreate - could not read the shaders.");
+        return false;
+    }
+    vulkanCreateShaderModule(device, cullCode, &outIndirect->cullShader);
+    vulkanCreateShaderModule(device, vertexCode, &outIndirect->shaderStages[0].shaderModule);
+    vulkanCreateShaderModule(device, fragmentCode, &outIndirect->shaderStages[1].shaderModule);
+
+    // Culling
+    VkPushConstantRange cullConstants;
+    cullConstants.stageFlags    = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullConstants.offset        = 0;
+    cullConstants.size          = sizeof(VulkanCullConstants);
+
+    VkPipelineLayoutCreateInfo cullLayoutInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    cullLayoutInfo.setLayoutCount           = 1;
+    cullLayoutInfo.pSetLayouts              = &outIndirect->layout;
+    cullLayoutInfo.pushConstantRangeCount   = 1;
+    cullLayoutInfo.pPushConstantRanges      = &cullConstants;
+    VK_CHECK(vkCreatePipelineLayout(device.handle, &cullLayoutInfo, nullptr, &outIndirect->cullLayout));
+
+    VkComputePipelineCreateInfo cullInfo = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    cullInfo.stage.sType    = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    cullInfo.stage.stage    = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullInfo.stage.module   = outIndirect->cullShader;
+    cullInfo.stage.pName    = "main";
+    cullInfo.layout         = outIndirect->cullLayout;
+    VK_CHECK(vkCreateComputePipelines(device.handle, VK_NULL_HANDLE, 1, &cullInfo, nullptr, &outIndirect->cullPipeline));
+
+    // Geometry pass, same state as the instanced one without the instance attributes.
+    VkPipelineShaderStageCreateInfo stages[2] = {};
+    stages[0].sType     = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].module    = outIndirect->shaderStages[0].shaderModule;
+    stages[0].pName     = "main";
+    stages[0].stage     = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[1].sType     = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].module    = outIndirect->shaderStages[1].shaderModule;
+    stages[1].pName     = "main";
+    stages[1].stage     = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkViewport viewport;
+    viewport.x          = 0;
+    viewport.y          = height;
+    viewport.width      = width;
+    viewport.height     = -(f32)height;
+    viewport.maxDepth   = 1;
+    viewport.minDepth   = 0;
+
+    VkRect2D scissors;
+    scissors.extent = {width, height};
+    scissors.offset = {0, 0};
+
+    VkPipelineColorBlendAttachmentState blendAttachments[VULKAN_GBUFFER_TARGET_COUNT] = {};
+    for(u32 i = 0; i < VULKAN_GBUFFER_TARGET_COUNT; ++i)
+    {
+        blendAttachments[i].colorWriteMask  = 0xf;
+        blendAttachments[i].blendEnable     = VK_FALSE;
+    }
+
+    VkDescriptorSetLayout layouts[3] = {
+        deferredShader.globalGeometryDescriptorSetLayout,
+        bindless.layout,
+        outIndirect->layout
+    };
+
+    const VertexDeclaration* vtx = getVertexDeclarationByName("PosColorUvN");
+    vulkanCreateGraphicsPipeline(
+        device,
+        (VulkanRenderpass*)&deferredShader.geometryRenderpass,
+        vtx->size,
+        vtx->layout,
+        2,
+        stages,
+        3,
+        layouts,
+        VULKAN_GBUFFER_TARGET_COUNT,
+        blendAttachments,
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        viewport,
+        scissors,
+        false,
+        true,
+        &outIndirect->pipeline
+    );
+    return true;
+}
+
+bool vulkanIndirectCreate(
+    const VulkanDevice& device,
+    const VulkanDeferredShader& deferredShader,
+    const VulkanBindless& bindless,
+    u32 frameCount,
+    u32 width,
+    u32 height,
+    VulkanIndirect* outIndirect)
+{
+    PASSERT(device.gpuDriven)
+
+    if(!createBuffers(device, frameCount, outIndirect)){
+        PERROR("vulkanIndirectCreate - could not create the buffers.");
+        return false;
+    }
+    createDescriptorSet(device, outIndirect);
+    if(!createPipelines(device, deferredShader, bindless, width, height, outIndirect))
+        return false;
+
+    outIndirect->objects.clear();
+    outIndirect->spheres.clear();
+    outIndirect->materials.clear();
+    outIndirect->version = 0;
+    outIndirect->frameVersions.assign(frameCount, 0);
+    outIndirect->frameMovedObjects.assign(frameCount, std::vector<u32>());
+    outIndirect->meshes.assign(VULKAN_MAX_MESHES, VulkanMeshDrawData{});
+    outIndirect->meshVersion = 0;
+    outIndirect->frameMeshVersions.assign(frameCount, 0);
+
+    PINFO("GPU driven geometry pass created, up to %u objects.", VULKAN_MAX_INDIRECT_OBJECTS);
+    return true;
+}
+
+void vulkanIndirectDestroy(
+    const VulkanDevice& device,
+    VulkanIndirect& indirect)
+{
+    vulkanDestroyGrapchisPipeline(device, &indirect.pipeline);
+    vkDestroyPipeline(device.handle, indirect.cullPipeline, nullptr);
+    vkDestroyPipelineLayout(device.handle, indirect.cullLayout, nullptr);
+    vkDestroyShaderModule(device.handle, indirect.cullShader, nullptr);
+    vkDestroyShaderModule(device.handle, indirect.shaderStages[0].shaderModule, nullptr);
+    vkDestroyShaderModule(device.handle, indirect.shaderStages[1].shaderModule, nullptr);
+
+    // Destroying the pool frees the set.
+    vkDestroyDescriptorPool(device.handle, indirect.pool, nullptr);
+    vkDestroyDescriptorSetLayout(device.handle, indirect.layout, nullptr);
+
+    vulkanBufferDestroy(device, indirect.objectBuffer);
+    vulkanBufferDestroy(device, indirect.meshBuffer);
+    vulkanBufferDestroy(device, indirect.drawBuffer);
+    vulkanBufferDestroy(device, indirect.countBuffer);
+    indirect.objectData = nullptr;
+    indirect.meshData   = nullptr;
+
+    indirect.objects.clear();
+    indirect.spheres.clear();
+    indirect.materials.clear();
+    indirect.frameVersions.clear();
+    indirect.frameMovedObjects.clear();
+    indirect.meshes.clear();
+    indirect.frameMeshVersions.clear();
+}
+
+void vulkanIndirectSetMesh(
+    VulkanIndirect& indirect,
+    u32 meshId,
+    const VulkanMesh* mesh)
+{
+    PASSERT(meshId < VULKAN_MAX_MESHES)
+    VulkanMeshDrawData data = {};
+    if(mesh)
+    {
+        data.indexCount     = mesh->indexCount;
+        data.firstIndex     = mesh->indexOffset;
+        data.vertexOffset   = (i32)mesh->vertexOffset;
+    }
+    indirect.meshes[meshId] = data;
+    indirect.meshVersion++;
+}
+
+bool vulkanIndirectSetObjects(
+    VulkanIndirect& indirect,
+    const RenderMeshData* objects,
+    u32 count)
+{
+    if(count > VULKAN_MAX_INDIRECT_OBJECTS)
+    {
+        PERROR("vulkanIndirectSetObjects - %u objects, the GPU driven pass takes up to %u.", count, VULKAN_MAX_INDIRECT_OBJECTS);
+        return false;
+    }
+
+    indirect.objects.resize(count);
+    indirect.spheres.resize(count);
+    indirect.materials.clear();
+    Material* lastMaterial = nullptr;
+    for(u32 i = 0; i < count; ++i)
+    {
+        const RenderMeshData& object = objects[i];
+
+        VulkanObjectData& data = indirect.objects[i];
+        indirect.spheres[i] = object.mesh->boundingSphere;
+        data.model      = object.model;
+        data.sphere     = worldSphere(object.model, indirect.spheres[i]);
+        data.mesh       = object.mesh->rendererId;
+        data.material   = object.material->rendererId;
+        data.padding[0] = 0;
+        data.padding[1] = 0;
+
+        // Objects come sorted by state, the same material is consecutive.
+        if(object.material != lastMaterial)
+        {
+            if(std::find(indirect.materials.begin(), indirect.materials.end(), object.material) == indirect.materials.end())
+                indirect.materials.push_back(object.material);
+            lastMaterial = object.material;
+        }
+    }
+    // Every region is copied whole, the moved objects of the old ones do not matter.
+    indirect.version++;
+    for(std::vector<u32>& moved : indirect.frameMovedObjects)
+        moved.clear();
+    return true;
+}
+
+void vulkanIndirectSetObjectModels(
+    VulkanIndirect& indirect,
+    const u32* indices,
+    const glm::mat4* models,
+    u32 count)
+{
+    const u32 objectCount = (u32)indirect.objects.size();
+    for(u32 i = 0; i < count; ++i)
+    {
+        PASSERT(indices[i] < objectCount)
+        VulkanObjectData& data = indirect.objects[indices[i]];
+        data.model  = models[i];
+        data.sphere = worldSphere(models[i], indirect.spheres[indices[i]]);
+    }
+
+    // Regions of an older version are copied whole anyway. When most of the
+    // objects moved, copying them all at once is cheaper than one by one.
+    for(u32 frame = 0; frame < (u32)indirect.frameVersions.size(); ++frame)
+    {
+        if(indirect.frameVersions[frame] != indirect.version)
+            continue;
+        std::vector<u32>& moved = indirect.frameMovedObjects[frame];
+        if(moved.size() + count > objectCount / 2) {
+            indirect.frameVersions[frame] = indirect.version - 1;
+            moved.clear();
+            continue;
+        }
+        moved.insert(moved.end(), indices, indices + count);
+    }
+}
+
+void vulkanIndirectCull(
+    VulkanIndirect& indirect,
+    VkCommandBuffer cmd,
+    u32 frame,
+    const Frustum& frustum)
+{
+    PASSERT(frame < indirect.frameVersions.size())
+    u32 objectCount = (u32)indirect.objects.size();
+
+    // The frame fence is signaled, its region is not read anymore.
+    u8* objectRegion = indirect.objectData + VULKAN_INDIRECT_OBJECT_REGION * frame;
+    std::vector<u32>& moved = indirect.frameMovedObjects[frame];
+    if(indirect.frameVersions[frame] != indirect.version)
+    {
+        if(objectCount > 0)
+            memCopy(indirect.objects.data(), objectRegion, sizeof(VulkanObjectData) * objectCount);
+        indirect.frameVersions[frame] = indirect.version;
+    }
+    else
+    {
+        for(u32 index : moved)
+            memCopy(&indirect.objects[index], objectRegion + sizeof(VulkanObjectData) * index, sizeof(VulkanObjectData));
+    }
+    moved.clear();
+    if(indirect.frameMeshVersions[frame] != indirect.meshVersion)
+    {
+        memCopy(indirect.meshes.data(), indirect.meshData + VULKAN_INDIRECT_MESH_REGION * frame, VULKAN_INDIRECT_MESH_REGION);
+        indirect.frameMeshVersions[frame] = indirect.meshVersion;
+    }
+
+    VkDeviceSize countOffset = (VkDeviceSize)indirect.countStride * frame;
+    vkCmdFillBuffer(cmd, indirect.countBuffer.handle, countOffset, sizeof(u32), 0);
+
+    VkMemoryBarrier clearBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    if(objectCount > 0)
+    {
+        VulkanCullConstants constants;
+        memCopy(frustum.planes, constants.planes, sizeof(constants.planes));
+        constants.objectCount = objectCount;
+
+        u32 offsets[4] = {
+            (u32)(VULKAN_INDIRECT_OBJECT_REGION * frame),
+            (u32)(VULKAN_INDIRECT_MESH_REGION * frame),
+            (u32)(VULKAN_INDIRECT_DRAW_REGION * frame),
+            (u32)countOffset
+        };
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, indirect.cullPipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, indirect.cullLayout, 0, 1, &indirect.set, 4, offsets);
+        vkCmdPushConstants(cmd, indirect.cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(VulkanCullConstants), &constants);
+        vkCmdDispatch(cmd, (objectCount + VULKAN_CULL_GROUP_SIZE - 1) / VULKAN_CULL_GROUP_SIZE, 1, 1);
+    }
+
+    // Draws and count are read by the indirect draw, objects by the vertex shader.
+    VkMemoryBarrier drawBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+        1, &drawBarrier, 0, nullptr, 0, nullptr);
+}
+
+void vulkanIndirectDraw(
+    const VulkanIndirect& indirect,
+    VkCommandBuffer cmd,
+    u32 frame)
+{
+    u32 objectCount = (u32)indirect.objects.size();
+    if(objectCount == 0)
+        return;
+
+    VkDeviceSize countOffset = (VkDeviceSize)indirect.countStride * frame;
+    u32 offsets[4] = {
+        (u32)(VULKAN_INDIRECT_OBJECT_REGION * frame),
+        (u32)(VULKAN_INDIRECT_MESH_REGION * frame),
+        (u32)(VULKAN_INDIRECT_DRAW_REGION * frame),
+        (u32)countOffset
+    };
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, indirect.pipeline.layout, 2, 1, &indirect.set, 4, offsets);
+    vkCmdDrawIndexedIndirectCount(
+        cmd,
+        indirect.drawBuffer.handle,
+        VULKAN_INDIRECT_DRAW_REGION * frame,
+        indirect.countBuffer.handle,
+        countOffset,
+        objectCount,
+        sizeof(VkDrawIndexedIndirectCommand));
+}
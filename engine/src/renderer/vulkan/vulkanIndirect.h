@@ -0,0 +1,76 @@
+#pragma once
+
+#include "vulkanTypes.h"
+#include "renderer/frustumCulling.h"
+
+/**
+ * GPU driven geometry pass.
+ * The frontend gives the objects only when they change. Each frame a
+ * compute shader culls them against the frustum and writes the draws of
+ * the visible ones and their count, then the geometry pass draws them all
+ * with one vkCmdDrawIndexedIndirectCount. No per object work is left on
+ * the CPU. Only used when device.gpuDriven is set, materials are bindless.
+ */
+
+bool vulkanIndirectCreate(
+    const VulkanDevice& device,
+    const VulkanDeferredShader& deferredShader,
+    const VulkanBindless& bindless,
+    u32 frameCount,
+    u32 width,
+    u32 height,
+    VulkanIndirect* outIndirect);
+
+void vulkanIndirectDestroy(
+    const VulkanDevice& device,
+    VulkanIndirect& indirect);
+
+/**
+ * Sets the ranges of the mesh in the shared buffers, read by the culling
+ * shader. Each frame region gets the table the next time its frame culls.
+ * A null mesh clears the entry.
+ */
+void vulkanIndirectSetMesh(
+    VulkanIndirect& indirect,
+    u32 meshId,
+    const VulkanMesh* mesh);
+
+/**
+ * Keeps a copy of the objects, each frame region gets it the next time
+ * its frame culls. Returns false if there are more than
+ * VULKAN_MAX_INDIRECT_OBJECTS, the objects are not changed then.
+ */
+bool vulkanIndirectSetObjects(
+    VulkanIndirect& indirect,
+    const RenderMeshData* objects,
+    u32 count);
+
+/**
+ * Changes the model matrices of some of the objects of the last
+ * vulkanIndirectSetObjects. Only those are copied to the frame regions
+ * that already hold the objects.
+ */
+void vulkanIndirectSetObjectModels(
+    VulkanIndirect& indirect,
+    const u32* indices,
+    const glm::mat4* models,
+    u32 count);
+
+/**
+ * Records the culling of the objects of the frame, outside of a render
+ * pass. The draws are ready for the indirect stage when it returns.
+ */
+void vulkanIndirectCull(
+    VulkanIndirect& indirect,
+    VkCommandBuffer cmd,
+    u32 frame,
+    const Frustum& frustum);
+
+/**
+ * Records the draws written by vulkanIndirectCull. The pipeline, sets 0
+ * and 1 and the shared geometry buffers must be bound.
+ */
+void vulkanIndirectDraw(
+    const VulkanIndirect& indirect,
+    VkCommandBuffer cmd,
+    u32 frame);
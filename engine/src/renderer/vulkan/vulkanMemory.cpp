@@ -0,0 +1,634 @@
+#include "vulkanMemory.h"
+
+#include "vulkanUtils.h"
+#include "memory/pmemory.h"
+
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// TLSF lists: one first level per power of two, split in SL_COUNT second levels.
+#define VULKAN_MEMORY_SL_BITS 3
+#define VULKAN_MEMORY_SL_COUNT (1 << VULKAN_MEMORY_SL_BITS)
+#define VULKAN_MEMORY_FL_COUNT (64 - VULKAN_MEMORY_SL_BITS + 1)
+
+// Leftovers smaller than this stay with the allocation instead of becoming a free range.
+#define VULKAN_MEMORY_MIN_RANGE 256
+
+/**
+ * A range of a block, used or free. Ranges of a block are linked by
+ * offset, free ranges are also linked in the list of their size class.
+ * Two free ranges are never neighbours, they are merged on free.
+ */
+struct VulkanMemoryNode
+{
+    VkDeviceSize offset;
+    VkDeviceSize size;          // Whole range, padding before the next range included.
+    VkDeviceSize requested;     // Size and alignment asked for, to move it.
+    VkDeviceSize alignment;
+    u32 block;
+    u32 prevPhysical;
+    u32 nextPhysical;
+    u32 prevFree;               // Size class list, or node free list when unused.
+    u32 nextFree;
+    void* userData;             // Set when the allocation may be moved.
+    bool free;
+};
+
+struct VulkanMemoryBlock
+{
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    VkDeviceSize used;
+    u8* mapped;
+    u32 pool;
+    u32 firstNode;              // Range at offset 0, it is never merged away.
+    u32 allocationCount;
+    bool dedicated;             // Holds a single allocation too big to share a block.
+    bool alive;
+
+    u64 flBitmap;
+    u32 slBitmap[VULKAN_MEMORY_FL_COUNT];
+    u32 freeHeads[VULKAN_MEMORY_FL_COUNT][VULKAN_MEMORY_SL_COUNT];
+};
+
+struct VulkanMemoryAllocator
+{
+    std::mutex mutex;
+    VkDeviceSize blockSizes[VK_MAX_MEMORY_TYPES];
+    // Blocks of each memory type, linear resources at type * 2, optimal images at type * 2 + 1.
+    std::vector<u32> pools[VK_MAX_MEMORY_TYPES * 2];
+    std::vector<VulkanMemoryBlock> blocks;
+    std::vector<VulkanMemoryNode> nodes;
+    u32 firstFreeNode;
+    u32 maxBlockCount;
+    MemoryGpuStats stats;
+};
+
+static u32 highestBit(u64 value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (u32)index;
+#else
+    return 63 - (u32)__builtin_clzll(value);
+#endif
+}
+
+static u32 lowestBit(u64 value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctzll(value);
+#endif
+}
+
+/**
+ * Size class of a range. Sizes under SL_COUNT go linearly in the first
+ * list, the rest by power of two and then by its SL_COUNT subdivisions.
+ */
+static void sizeClass(VkDeviceSize size, u32* outFl, u32* outSl)
+{
+    if(size < VULKAN_MEMORY_SL_COUNT) {
+        *outFl = 0;
+        *outSl = (u32)size;
+        return;
+    }
+    u32 bit = highestBit(size);
+    *outFl = bit - VULKAN_MEMORY_SL_BITS + 1;
+    *outSl = (u32)(size >> (bit - VULKAN_MEMORY_SL_BITS)) & (VULKAN_MEMORY_SL_COUNT - 1);
+}
+
+static u32 nodeCreate(VulkanMemoryAllocator* a)
+{
+    u32 id = a->firstFreeNode;
+    if(id != INVALID_ID) {
+        a->firstFreeNode = a->nodes[id].nextFree;
+    } else {
+        id = (u32)a->nodes.size();
+        a->nodes.emplace_back();
+    }
+    VulkanMemoryNode& node = a->nodes[id];
+    node.prevPhysical   = INVALID_ID;
+    node.nextPhysical   = INVALID_ID;
+    node.prevFree       = INVALID_ID;
+    node.nextFree       = INVALID_ID;
+    node.userData       = nullptr;
+    node.requested      = 0;
+    node.alignment      = 1;
+    node.free           = false;
+    return id;
+}
+
+static void nodeRelease(VulkanMemoryAllocator* a, u32 id)
+{
+    a->nodes[id].block      = INVALID_ID;
+    a->nodes[id].nextFree   = a->firstFreeNode;
+    a->firstFreeNode        = id;
+}
+
+static void insertFree(VulkanMemoryAllocator* a, u32 id)
+{
+    VulkanMemoryNode& node = a->nodes[id];
+    VulkanMemoryBlock& block = a->blocks[node.block];
+    u32 fl, sl;
+    sizeClass(node.size, &fl, &sl);
+
+    node.free       = true;
+    node.userData   = nullptr;
+    node.prevFree   = INVALID_ID;
+    node.nextFree   = block.freeHeads[fl][sl];
+    if(node.nextFree != INVALID_ID)
+        a->nodes[node.nextFree].prevFree = id;
+    block.freeHeads[fl][sl] = id;
+    block.slBitmap[fl] |= 1u << sl;
+    block.flBitmap |= 1ull << fl;
+    a->stats.freeRanges++;
+}
+
+static void removeFree(VulkanMemoryAllocator* a, u32 id)
+{
+    VulkanMemoryNode& node = a->nodes[id];
+    VulkanMemoryBlock& block = a->blocks[node.block];
+    u32 fl, sl;
+    sizeClass(node.size, &fl, &sl);
+
+    if(node.prevFree != INVALID_ID)
+        a->nodes[node.prevFree].nextFree = node.nextFree;
+    else
+        block.freeHeads[fl][sl] = node.nextFree;
+    if(node.nextFree != INVALID_ID)
+        a->nodes[node.nextFree].prevFree = node.prevFree;
+
+    if(block.freeHeads[fl][sl] == INVALID_ID) {
+        block.slBitmap[fl] &= ~(1u << sl);
+        if(block.slBitmap[fl] == 0)
+            block.flBitmap &= ~(1ull << fl);
+    }
+    node.free = false;
+    a->stats.freeRanges--;
+}
+
+/**
+ * Free range of the block of at least size bytes, INVALID_ID if there is none.
+ * The size is rounded up to the next class so any range of it fits.
+ */
+static u32 findFree(VulkanMemoryAllocator* a, u32 blockId, VkDeviceSize size)
+{
+    const VulkanMemoryBlock& block = a->blocks[blockId];
+    if(size >= VULKAN_MEMORY_SL_COUNT)
+        size += ((VkDeviceSize)1 << (highestBit(size) - VULKAN_MEMORY_SL_BITS)) - 1;
+
+    u32 fl, sl;
+    sizeClass(size, &fl, &sl);
+    if(fl >= VULKAN_MEMORY_FL_COUNT)
+        return INVALID_ID;
+
+    u32 slMap = block.slBitmap[fl] & (~0u << sl);
+    if(slMap == 0) {
+        u64 flMap = fl + 1 < VULKAN_MEMORY_FL_COUNT ? block.flBitmap & (~0ull << (fl + 1)) : 0;
+        if(flMap == 0)
+            return INVALID_ID;
+        fl = lowestBit(flMap);
+        slMap = block.slBitmap[fl];
+    }
+    return block.freeHeads[fl][lowestBit(slMap)];
+}
+
+static void reportStats(VulkanMemoryAllocator* a)
+{
+    memoryReportGpuStats(a->stats);
+}
+
+static u32 createBlock(
+    const VulkanDevice& device,
+    u32 memoryType,
+    u32 pool,
+    VkDeviceSize size,
+    bool dedicated)
+{
+    VulkanMemoryAllocator* a = device.allocator;
+    if(a->stats.blockCount >= a->maxBlockCount) {
+        PERROR("vulkanMemoryAllocate - maxMemoryAllocationCount of %u reached.", a->maxBlockCount);
+        return INVALID_ID;
+    }
+
+    VkMemoryAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocInfo.allocationSize    = size;
+    allocInfo.memoryTypeIndex   = memoryType;
+    VkDeviceMemory memory;
+    if(vkAllocateMemory(device.handle, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        PERROR("vulkanMemoryAllocate - out of memory allocating a block of %llu bytes.", (unsigned long long)size);
+        return INVALID_ID;
+    }
+
+    u8* mapped = nullptr;
+    if(device.memory.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        VK_CHECK(vkMapMemory(device.handle, memory, 0, VK_WHOLE_SIZE, 0, (void**)&mapped));
+        a->stats.mapCalls++;
+    }
+
+    u32 id = 0;
+    while(id < a->blocks.size() && a->blocks[id].alive)
+        ++id;
+    if(id == a->blocks.size())
+        a->blocks.emplace_back();
+
+    VulkanMemoryBlock& block = a->blocks[id];
+    memSet(&block, 0xFF, sizeof(VulkanMemoryBlock));
+    block.memory            = memory;
+    block.size              = size;
+    block.used              = 0;
+    block.mapped            = mapped;
+    block.pool              = pool;
+    block.allocationCount   = 0;
+    block.dedicated         = dedicated;
+    block.alive             = true;
+    block.flBitmap          = 0;
+    memZero(block.slBitmap, sizeof(block.slBitmap));
+
+    u32 node = nodeCreate(a);
+    a->nodes[node].offset   = 0;
+    a->nodes[node].size     = size;
+    a->nodes[node].block    = id;
+    block.firstNode         = node;
+    insertFree(a, node);
+
+    a->pools[pool].push_back(id);
+    a->stats.blockCount++;
+    a->stats.reserved += size;
+    return id;
+}
+
+static void releaseBlock(const VulkanDevice& device, u32 id)
+{
+    VulkanMemoryAllocator* a = device.allocator;
+    VulkanMemoryBlock& block = a->blocks[id];
+    PASSERT(block.allocationCount == 0)
+
+    removeFree(a, block.firstNode);
+    nodeRelease(a, block.firstNode);
+
+    if(block.mapped)
+        vkUnmapMemory(device.handle, block.memory);
+    vkFreeMemory(device.handle, block.memory, nullptr);
+
+    std::vector<u32>& pool = a->pools[block.pool];
+    for(u32 i = 0; i < pool.size(); ++i) {
+        if(pool[i] == id) {
+            pool[i] = pool.back();
+            pool.pop_back();
+            break;
+        }
+    }
+
+    a->stats.blockCount--;
+    a->stats.reserved -= block.size;
+    block.alive = false;
+}
+
+static void fillAllocation(VulkanMemoryAllocator* a, u32 id, VulkanAllocation* out)
+{
+    const VulkanMemoryNode& node = a->nodes[id];
+    const VulkanMemoryBlock& block = a->blocks[node.block];
+    out->memory = block.memory;
+    out->offset = node.offset;
+    out->size   = node.requested;
+    out->mapped = block.mapped ? block.mapped + node.offset : nullptr;
+    out->node   = id;
+}
+
+static bool allocateFromBlock(
+    VulkanMemoryAllocator* a,
+    u32 blockId,
+    VkDeviceSize size,
+    VkDeviceSize alignment,
+    VulkanAllocation* out)
+{
+    // A dedicated block is the exact size, the search would round it up
+    // past it. Its range starts at offset 0 so it is aligned anyway.
+    u32 id = a->blocks[blockId].dedicated ? a->blocks[blockId].firstNode : findFree(a, blockId, size + alignment - 1);
+    if(id == INVALID_ID)
+        return false;
+
+    removeFree(a, id);
+    VkDeviceSize offset = a->nodes[id].offset;
+    VkDeviceSize padding = ((offset + alignment - 1) & ~(alignment - 1)) - offset;
+    if(padding > 0)
+    {
+        // Offset 0 is always aligned, so there is a previous range and it is used.
+        u32 prev = a->nodes[id].prevPhysical;
+        a->nodes[prev].size     += padding;
+        a->nodes[id].offset     += padding;
+        a->nodes[id].size       -= padding;
+        a->blocks[blockId].used += padding;
+        a->stats.used           += padding;
+    }
+
+    if(a->nodes[id].size - size >= VULKAN_MEMORY_MIN_RANGE)
+    {
+        u32 tail = nodeCreate(a);
+        VulkanMemoryNode& node = a->nodes[id];
+        VulkanMemoryNode& rest = a->nodes[tail];
+        rest.offset         = node.offset + size;
+        rest.size           = node.size - size;
+        rest.block          = blockId;
+        rest.prevPhysical   = id;
+        rest.nextPhysical   = node.nextPhysical;
+        if(node.nextPhysical != INVALID_ID)
+            a->nodes[node.nextPhysical].prevPhysical = tail;
+        node.nextPhysical   = tail;
+        node.size           = size;
+        insertFree(a, tail);
+    }
+
+    VulkanMemoryNode& node = a->nodes[id];
+    node.requested  = size;
+    node.alignment  = alignment;
+    node.userData   = nullptr;
+
+    VulkanMemoryBlock& block = a->blocks[blockId];
+    block.used += node.size;
+    block.allocationCount++;
+    a->stats.used += node.size;
+    a->stats.liveCount++;
+    a->stats.totalCount++;
+
+    fillAllocation(a, id, out);
+    return true;
+}
+
+static void freeNode(const VulkanDevice& device, u32 id)
+{
+    VulkanMemoryAllocator* a = device.allocator;
+    u32 blockId = a->nodes[id].block;
+    VulkanMemoryBlock& block = a->blocks[blockId];
+    block.used -= a->nodes[id].size;
+    block.allocationCount--;
+    a->stats.used -= a->nodes[id].size;
+    a->stats.liveCount--;
+
+    u32 next = a->nodes[id].nextPhysical;
+    if(next != INVALID_ID && a->nodes[next].free)
+    {
+        removeFree(a, next);
+        a->nodes[id].size += a->nodes[next].size;
+        a->nodes[id].nextPhysical = a->nodes[next].nextPhysical;
+        if(a->nodes[id].nextPhysical != INVALID_ID)
+            a->nodes[a->nodes[id].nextPhysical].prevPhysical = id;
+        nodeRelease(a, next);
+    }
+
+    u32 prev = a->nodes[id].prevPhysical;
+    if(prev != INVALID_ID && a->nodes[prev].free)
+    {
+        removeFree(a, prev);
+        a->nodes[prev].size += a->nodes[id].size;
+        a->nodes[prev].nextPhysical = a->nodes[id].nextPhysical;
+        if(a->nodes[prev].nextPhysical != INVALID_ID)
+            a->nodes[a->nodes[prev].nextPhysical].prevPhysical = prev;
+        nodeRelease(a, id);
+        id = prev;
+    }
+    insertFree(a, id);
+
+    if(block.allocationCount > 0)
+        return;
+
+    // Keep one empty block per pool so a load and unload loop does not
+    // allocate and free device memory each time.
+    bool keep = !block.dedicated;
+    if(keep) {
+        for(u32 other : a->pools[block.pool]) {
+            if(other != blockId && a->blocks[other].allocationCount == 0 && !a->blocks[other].dedicated) {
+                keep = false;
+                break;
+            }
+        }
+    }
+    if(!keep)
+        releaseBlock(device, blockId);
+}
+
+bool vulkanMemoryCreate(VulkanDevice* device)
+{
+    void* memory = memAllocate(sizeof(VulkanMemoryAllocator), MEMORY_TAG_RENDERER);
+    VulkanMemoryAllocator* a = new (memory) VulkanMemoryAllocator();
+    a->firstFreeNode    = INVALID_ID;
+    a->maxBlockCount    = device->properties.limits.maxMemoryAllocationCount;
+    a->stats            = {};
+
+    // Small heaps, like the host visible one of some discrete GPUs, get smaller blocks.
+    for(u32 i = 0; i < device->memory.memoryTypeCount; ++i)
+    {
+        VkDeviceSize heapSize = device->memory.memoryHeaps[device->memory.memoryTypes[i].heapIndex].size;
+        a->blockSizes[i] = heapSize / 8 < VULKAN_MEMORY_BLOCK_SIZE ? heapSize / 8 : VULKAN_MEMORY_BLOCK_SIZE;
+    }
+
+    device->allocator = a;
+    reportStats(a);
+    PINFO("Vulkan memory allocator created.");
+    return true;
+}
+
+void vulkanMemoryDestroy(VulkanDevice* device)
+{
+    VulkanMemoryAllocator* a = device->allocator;
+    if(!a)
+        return;
+
+    for(VulkanMemoryBlock& block : a->blocks)
+    {
+        if(!block.alive)
+            continue;
+        if(block.allocationCount > 0)
+            PWARN("vulkanMemoryDestroy - %u allocations leaked in a block of %llu bytes.",
+                block.allocationCount, (unsigned long long)block.size);
+        if(block.mapped)
+            vkUnmapMemory(device->handle, block.memory);
+        vkFreeMemory(device->handle, block.memory, nullptr);
+    }
+
+    a->stats = {};
+    reportStats(a);
+    a->~VulkanMemoryAllocator();
+    memFree(a, sizeof(VulkanMemoryAllocator), MEMORY_TAG_RENDERER);
+    device->allocator = nullptr;
+}
+
+bool vulkanMemoryAllocate(
+    const VulkanDevice& device,
+    const VkMemoryRequirements& requirements,
+    VkMemoryPropertyFlags memFlags,
+    bool linear,
+    VulkanAllocation* outAllocation)
+{
+    VulkanMemoryAllocator* a = device.allocator;
+    outAllocation->memory   = VK_NULL_HANDLE;
+    outAllocation->mapped   = nullptr;
+    outAllocation->node     = INVALID_ID;
+
+    i32 type = findMemoryIndex(device, requirements.memoryTypeBits, memFlags);
+    if(type == -1) {
+        PERROR("Could not find a valid memory index.");
+        return false;
+    }
+
+    u32 pool = (u32)type * 2 + (linear ? 0 : 1);
+    VkDeviceSize alignment = requirements.alignment > 0 ? requirements.alignment : 1;
+
+    std::lock_guard<std::mutex> lock(a->mutex);
+    bool allocated = false;
+    if(requirements.size > a->blockSizes[type] / 2)
+    {
+        u32 block = createBlock(device, type, pool, requirements.size, true);
+        allocated = block != INVALID_ID
+            && allocateFromBlock(a, block, requirements.size, alignment, outAllocation);
+    }
+    else
+    {
+        for(u32 block : a->pools[pool]) {
+            if(!a->blocks[block].dedicated
+                && allocateFromBlock(a, block, requirements.size, alignment, outAllocation)) {
+                allocated = true;
+                break;
+            }
+        }
+        if(!allocated) {
+            u32 block = createBlock(device, type, pool, a->blockSizes[type], false);
+            allocated = block != INVALID_ID
+                && allocateFromBlock(a, block, requirements.size, alignment, outAllocation);
+        }
+    }
+
+    reportStats(a);
+    return allocated;
+}
+
+void vulkanMemoryFree(
+    const VulkanDevice& device,
+    VulkanAllocation& allocation)
+{
+    if(allocation.node == INVALID_ID)
+        return;
+
+    VulkanMemoryAllocator* a = device.allocator;
+    {
+        std::lock_guard<std::mutex> lock(a->mutex);
+        PASSERT(a->nodes[allocation.node].block != INVALID_ID && !a->nodes[allocation.node].free)
+        freeNode(device, allocation.node);
+        reportStats(a);
+    }
+
+    allocation.memory   = VK_NULL_HANDLE;
+    allocation.mapped   = nullptr;
+    allocation.node     = INVALID_ID;
+}
+
+void vulkanMemorySetUserData(
+    const VulkanDevice& device,
+    const VulkanAllocation& allocation,
+    void* userData)
+{
+    if(allocation.node == INVALID_ID)
+        return;
+
+    VulkanMemoryAllocator* a = device.allocator;
+    std::lock_guard<std::mutex> lock(a->mutex);
+    a->nodes[allocation.node].userData = userData;
+}
+
+u32 vulkanMemoryDefragment(
+    const VulkanDevice& device,
+    u32 maxMoves,
+    VulkanMemoryMoveFn move,
+    void* user)
+{
+    VulkanMemoryAllocator* a = device.allocator;
+    u32 moved = 0;
+    std::vector<u32> candidates;
+
+    std::unique_lock<std::mutex> lock(a->mutex);
+    for(u32 pool = 0; pool < VK_MAX_MEMORY_TYPES * 2 && moved < maxMoves; ++pool)
+    {
+        // Empty the least used shared block into the others.
+        u32 source = INVALID_ID;
+        u32 sharedCount = 0;
+        for(u32 block : a->pools[pool]) {
+            if(a->blocks[block].dedicated)
+                continue;
+            ++sharedCount;
+            if(source == INVALID_ID || a->blocks[block].used < a->blocks[source].used)
+                source = block;
+        }
+        if(sharedCount < 2)
+            continue;
+
+        candidates.clear();
+        for(u32 id = a->blocks[source].firstNode; id != INVALID_ID; id = a->nodes[id].nextPhysical) {
+            if(!a->nodes[id].free && a->nodes[id].userData)
+                candidates.push_back(id);
+        }
+
+        for(u32 id : candidates)
+        {
+            if(moved >= maxMoves)
+                break;
+            // Freed or pinned by its owner while the lock was released for a hook.
+            if(a->nodes[id].block != source || a->nodes[id].free || !a->nodes[id].userData)
+                continue;
+
+            VulkanAllocation from;
+            fillAllocation(a, id, &from);
+            VkDeviceSize size = a->nodes[id].requested;
+            VkDeviceSize alignment = a->nodes[id].alignment;
+
+            VulkanAllocation to;
+            bool placed = false;
+            for(u32 block : a->pools[pool]) {
+                if(block != source && !a->blocks[block].dedicated
+                    && allocateFromBlock(a, block, size, alignment, &to)) {
+                    placed = true;
+                    break;
+                }
+            }
+            if(!placed)
+                break;
+
+            // The resource keeps being movable from its new place.
+            void* userData = a->nodes[id].userData;
+            a->nodes[to.node].userData = userData;
+            a->nodes[id].userData = nullptr;
+
+            lock.unlock();
+            bool accepted = move(user, userData, from, to);
+            lock.lock();
+
+            if(accepted) {
+                ++moved;
+            } else {
+                freeNode(device, to.node);
+                if(a->nodes[id].block == source && !a->nodes[id].free)
+                    a->nodes[id].userData = userData;
+            }
+        }
+    }
+
+    reportStats(a);
+    return moved;
+}
+
+MemoryGpuStats vulkanMemoryGetStats(const VulkanDevice& device)
+{
+    VulkanMemoryAllocator* a = device.allocator;
+    std::lock_guard<std::mutex> lock(a->mutex);
+    return a->stats;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "vulkanTypes.h"
+#include "memory/pmemory.h"
+
+/**
+ * Device memory allocator.
+ * Memory is allocated in big blocks per memory type and every buffer and
+ * image gets a range of one of them, so the number of vkAllocateMemory
+ * calls stays far below maxMemoryAllocationCount. Free ranges of a block
+ * are kept in TLSF lists, finding one and giving it back is constant time.
+ * Linear resources (buffers, linear images) and optimal images use
+ * different blocks, so bufferImageGranularity never applies between two
+ * neighbour ranges. Host visible blocks are mapped while they live.
+ * Safe to call from any thread.
+ */
+
+// Block size of the memory types whose heap is big enough.
+#define VULKAN_MEMORY_BLOCK_SIZE (64 * 1024 * 1024)
+
+/**
+ * Defragmentation hook. The resource of userData lives in from and has to
+ * be recreated on to, copying its contents. Returning true the hook owns
+ * from and frees it once the GPU is done with it, the source block is
+ * released with its last range. Returning false leaves the resource where
+ * it was.
+ */
+typedef bool (*VulkanMemoryMoveFn)(
+    void* user,
+    void* userData,
+    const VulkanAllocation& from,
+    const VulkanAllocation& to);
+
+/**
+ * Creates the allocator of the device, call once the logical device exists.
+ */
+bool vulkanMemoryCreate(VulkanDevice* device);
+
+/**
+ * Frees every block. Allocations still alive are reported as leaks.
+ */
+void vulkanMemoryDestroy(VulkanDevice* device);
+
+/**
+ * Finds a range fitting the requirements in a memory type with the given flags.
+ * @param bool linear True for buffers and linear images, false for optimal images.
+ * @return bool false if there is no such memory type or the device is out of memory.
+ */
+bool vulkanMemoryAllocate(
+    const VulkanDevice& device,
+    const VkMemoryRequirements& requirements,
+    VkMemoryPropertyFlags memFlags,
+    bool linear,
+    VulkanAllocation* outAllocation);
+
+void vulkanMemoryFree(
+    const VulkanDevice& device,
+    VulkanAllocation& allocation);
+
+/**
+ * Marks the allocation as movable by vulkanMemoryDefragment, userData is
+ * passed to the hook to find the resource. nullptr pins it again.
+ */
+void vulkanMemorySetUserData(
+    const VulkanDevice& device,
+    const VulkanAllocation& allocation,
+    void* userData);
+
+/**
+ * Moves movable allocations out of the least used shared block of every
+ * memory type into the other blocks, so the emptied blocks can be released.
+ * @param u32 maxMoves Upper bound of accepted moves.
+ * @return u32 allocations moved.
+ */
+u32 vulkanMemoryDefragment(
+    const VulkanDevice& device,
+    u32 maxMoves,
+    VulkanMemoryMoveFn move,
+    void* user);
+
+/**
+ * Counters of the allocator, the same ones reported to memoryReportGpuStats.
+ */
+MemoryGpuStats vulkanMemoryGetStats(const VulkanDevice& device);
@@ -19,16 +19,28 @@ void vulkanCreateGraphicsPipeline(
     VulkanPipeline* outPipeline)
 {
     // Vertex Info
-    VkVertexInputBindingDescription vertexBinding = {};
-    vertexBinding.binding   = 0;
-    vertexBinding.stride    = sizeof(VulkanVertex);
-    vertexBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    VkVertexInputBindingDescription vertexBindings[2] = {};
+    vertexBindings[0].binding   = 0;
+    vertexBindings[0].stride    = sizeof(VulkanVertex);
+    vertexBindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    // Attributes of binding 1 come from the model matrix of each instance.
+    u32 bindingCount = 1;
+    for(u32 i = 0; i < attributeCount; ++i) {
+        if(attributeDescription[i].binding == 1) {
+            vertexBindings[1].binding   = 1;
+            vertexBindings[1].stride    = sizeof(glm::mat4);
+            vertexBindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+            bindingCount = 2;
+            break;
+        }
+    }
 
     VkPipelineVertexInputStateCreateInfo vertexInputStateInfo   = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
     vertexInputStateInfo.vertexAttributeDescriptionCount        = attributeCount;
     vertexInputStateInfo.pVertexAttributeDescriptions           = attributeDescription;
-    vertexInputStateInfo.vertexBindingDescriptionCount          = 1;
-    vertexInputStateInfo.pVertexBindingDescriptions             = &vertexBinding;
+    vertexInputStateInfo.vertexBindingDescriptionCount          = bindingCount;
+    vertexInputStateInfo.pVertexBindingDescriptions             = vertexBindings;
 
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
     inputAssemblyInfo.topology                  = (VkPrimitiveTopology)stride;
@@ -76,11 +88,11 @@ void vulkanCreateGraphicsPipeline(
     dynamicStateInfo.dynamicStateCount                  = static_cast<u32>(dynamicStates.size());
     dynamicStateInfo.pDynamicStates                     = dynamicStates.data();
 
-    // Push constant to upload model matrix for each geometry.
+    // Push constants of the draw, the bindless material index is at offset 0.
     VkPushConstantRange pushConstantRange{};
     pushConstantRange.size          = sizeof(glm::mat4);
     pushConstantRange.offset        = 0;
-    pushConstantRange.stageFlags    = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.stageFlags    = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
     VkPipelineLayoutCreateInfo layoutInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
     layoutInfo.pushConstantRangeCount   = 1;
@@ -2,10 +2,33 @@
 
 #include "vulkanDevice.h"
 #include "vulkanImage.h"
+#include "vulkanMemory.h"
 
 static bool create(VulkanState* pState, u32 width, u32 height);
 static void destroy(VulkanState* pState);
 
+static VkPresentModeKHR
+presentMode(RenderPresentMode mode)
+{
+    switch (mode)
+    {
+    case RENDER_PRESENT_MAILBOX:    return VK_PRESENT_MODE_MAILBOX_KHR;
+    case RENDER_PRESENT_IMMEDIATE:  return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    default:                        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+}
+
+static const char*
+presentModeName(VkPresentModeKHR mode)
+{
+    switch (mode)
+    {
+    case VK_PRESENT_MODE_MAILBOX_KHR:   return "mailbox";
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    default:                            return "fifo";
+    }
+}
+
 VkExtent2D 
 getSwapchainExtent(VulkanState* pState)
 {
@@ -64,19 +87,26 @@ create(
             }
     }
 
-    // Choose present mode.
+    // Choose present mode, fifo is always supported.
     pState->swapchain.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    VkPresentModeKHR requested = presentMode(pState->presentMode);
     for(u32 i = 0; i < pState->swapchainSupport.presentModeCount; ++i)
     {
-        if(pState->swapchainSupport.presentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR){
-            pState->swapchain.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        if(pState->swapchainSupport.presentModes[i] == requested){
+            pState->swapchain.presentMode = requested;
             break;
         }
     }
+    if(pState->swapchain.presentMode != requested)
+        PWARN("Present mode %s not supported, using fifo.", presentModeName(requested));
 
-    pState->swapchain.imageCount        = pState->swapchainSupport.capabilities.minImageCount + 1;
-    pState->swapchain.maxImageInFlight  = pState->swapchain.imageCount;
-    pState->swapchain.framebuffers.resize(pState->swapchain.imageCount);
+    // One image more than the frames in flight, so acquiring does not wait for the presentation engine.
+    const VkSurfaceCapabilitiesKHR& capabilities = pState->swapchainSupport.capabilities;
+    pState->swapchain.imageCount = capabilities.minImageCount + 1;
+    if(pState->swapchain.imageCount < pState->framesInFlight + 1)
+        pState->swapchain.imageCount = pState->framesInFlight + 1;
+    if(capabilities.maxImageCount > 0 && pState->swapchain.imageCount > capabilities.maxImageCount)
+        pState->swapchain.imageCount = capabilities.maxImageCount;
 
     VkSwapchainCreateInfoKHR swapchainInfo = {VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR};
     swapchainInfo.surface           = pState->surface;
@@ -116,6 +146,8 @@ create(
     VK_CHECK(vkGetSwapchainImagesKHR(pState->device.handle, pState->swapchain.handle, &pState->swapchain.imageCount, nullptr));
     pState->swapchain.images.resize(pState->swapchain.imageCount);
     pState->swapchain.imageViews.resize(pState->swapchain.imageCount);
+    pState->swapchain.framebuffers.resize(pState->swapchain.imageCount);
+    pState->imagesInFlight.assign(pState->swapchain.imageCount, nullptr);
     VK_CHECK(vkGetSwapchainImagesKHR(pState->device.handle, pState->swapchain.handle, &pState->swapchain.imageCount, pState->swapchain.images.data()));
 
     for(u32 i = 0; i < pState->swapchain.imageCount; ++i)
@@ -150,7 +182,8 @@ create(
         VK_IMAGE_ASPECT_DEPTH_BIT,
         &pState->swapchain.depthImage);
 
-    PINFO("Swapchain created successfully.");
+    PINFO("Swapchain created successfully, %u images presented with %s.",
+        pState->swapchain.imageCount, presentModeName(pState->swapchain.presentMode));
     return true;
 };
 
@@ -168,7 +201,7 @@ destroy(VulkanState *pState)
         vkDestroyImageView(pState->device.handle, image, nullptr);
     }
 
-    vkFreeMemory(pState->device.handle, pState->swapchain.depthImage.memory, nullptr);
+    vulkanMemoryFree(pState->device, pState->swapchain.depthImage.allocation);
     vkDestroyImage(pState->device.handle, pState->swapchain.depthImage.handle, nullptr);
     vkDestroyImageView(pState->device.handle, pState->swapchain.depthImage.view, nullptr);
 
@@ -6,10 +6,23 @@
 
 // TEMP
 #include "resources/resourcesTypes.h"
+#include "renderer/renderTypes.h"
+#include "renderer/lightClusters.h"
 
 #define VK_CHECK(x) { PASSERT(x == VK_SUCCESS); }
 
-#define MAX_LIGHTS 16
+// Lights packed in the light storage buffer each frame.
+#define MAX_LIGHTS 4096
+
+// Frames recorded ahead of the GPU, RenderSystemConfig::framesInFlight is clamped to it.
+#define VULKAN_MIN_FRAMES_IN_FLIGHT 2
+#define VULKAN_MAX_FRAMES_IN_FLIGHT 3
+
+// GPU timestamps of each frame: geometry begin and end, light begin and end.
+#define VULKAN_FRAME_TIMESTAMPS 4
+
+struct VulkanMemoryAllocator;
+struct VulkanUploadQueue;
 
 typedef struct VulkanDevice
 { 
@@ -33,6 +46,18 @@ typedef struct VulkanDevice
     VkCommandPool commandPool;
     VkCommandPool transferCmdPool;
 
+    // Sub-allocates buffers and images from big memory blocks, see vulkanMemory.h.
+    VulkanMemoryAllocator* allocator;
+
+    // Batched staging uploads on the transfer queue, see vulkanUpload.h.
+    VulkanUploadQueue* uploads;
+
+    // Descriptor indexing is supported and enabled, materials are bindless. See vulkanBindless.h.
+    bool bindless;
+
+    // Objects are culled by a compute shader and drawn with indirect count draws. See vulkanIndirect.h.
+    bool gpuDriven;
+
 } VulkanDevice;
 
 typedef struct VulkanSwapchainSupport
@@ -74,12 +99,70 @@ typedef struct VulkanFence
     bool signaled;
 } VulkanFance;
 
+/**
+ * Range of a device memory block handed out by vulkanMemoryAllocate.
+ */
+typedef struct VulkanAllocation
+{
+    VkDeviceMemory memory;  // Block the range lives in, shared with other allocations.
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    u8* mapped;             // Start of the range if the block is host visible, else nullptr.
+    u32 node;               // Allocator bookkeeping.
+} VulkanAllocation;
+
 typedef struct VulkanBuffer
 {
     VkBuffer handle;
-    VkDeviceMemory memory;
+    VulkanAllocation allocation;
 } VulkanBuffer;
 
+/**
+ * Persistently mapped buffer split in one region per frame in flight.
+ * Per frame data is suballocated linearly from the region of the current
+ * frame and bound with dynamic offsets, so descriptors are written once.
+ * A region is reused when the fence of its frame is signaled.
+ */
+typedef struct VulkanRingBuffer
+{
+    VulkanBuffer buffer;
+    u8* data;           // Mapped while the buffer lives.
+    u32 frameSize;      // Bytes of each region.
+    u32 alignment;      // Dynamic offsets are multiple of it.
+    u32 frameOffset;    // Start of the region of the current frame.
+    u32 used;           // Bytes handed out from the current region.
+} VulkanRingBuffer;
+
+typedef struct VulkanRange
+{
+    u32 offset;
+    u32 count;
+} VulkanRange;
+
+/**
+ * Device local buffer shared by all the meshes, each one takes a range
+ * of elements (vertices or indices). Free ranges are kept sorted by
+ * offset and merged with their neighbours. It doubles its capacity when
+ * a range does not fit, offsets handed out stay valid.
+ * Freed ranges and replaced buffers may still be read by frames in flight,
+ * they wait in the lists of the current frame until its fence is signaled.
+ */
+typedef struct VulkanGeometryBuffer
+{
+    VulkanBuffer buffer;
+    u32 usage;
+    u32 elementSize;
+    u32 capacity;                       // Elements.
+    u32 used;                           // Elements handed out or retired.
+    u32 frame;                          // Frame whose lists take what is retired now.
+    std::vector<VulkanRange> freeRanges;
+    std::vector<VulkanRange> retiredRanges[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    std::vector<VulkanBuffer> retiredBuffers[VULKAN_MAX_FRAMES_IN_FLIGHT];
+} VulkanGeometryBuffer;
+
+// Bytes of the uniform ring region of each frame in flight.
+#define VULKAN_UNIFORM_RING_FRAME_SIZE (2 * 1024 * 1024)
+
 typedef struct VulkanVertex
 {
     glm::vec3 position;
@@ -97,11 +180,36 @@ struct VulkanLightData
     glm::vec3 forward;
     f32 cosineCutoff;
     f32 spotExponent;
-    bool enabled;
-    int type;
+    u32 enabled;        // 4 bytes like a bool in the shaders.
+    int type;           // VULKAN_LIGHT_TYPE_*
     f32 dummyValue;
 };
 
+#define VULKAN_LIGHT_TYPE_POINT 0
+#define VULKAN_LIGHT_TYPE_SPOT  1
+
+// Start of the light storage buffer, the light array follows it.
+struct VulkanLightHeader
+{
+    u32 count;
+    u32 padding[3];     // The array is 16 bytes aligned.
+};
+
+#define VULKAN_LIGHT_BUFFER_SIZE (sizeof(VulkanLightHeader) + sizeof(VulkanLightData) * MAX_LIGHTS)
+
+// Start of the light cluster storage buffer. The offset and count of each
+// cluster follow it, then the light indices.
+struct VulkanLightClusterHeader
+{
+    u32 dims[4];        // x, y and z clusters, light index count.
+    f32 projX;
+    f32 projY;
+    f32 sliceScale;
+    f32 sliceBias;
+};
+
+#define VULKAN_LIGHT_CLUSTER_BUFFER_SIZE (sizeof(VulkanLightClusterHeader) + sizeof(u32) * (LIGHT_CLUSTER_COUNT * 2 + LIGHT_CLUSTER_MAX_INDICES))
+
 typedef struct ViewProjectionBuffer
 {
     glm::mat4 view;
@@ -115,7 +223,7 @@ typedef struct ViewProjectionBuffer
 typedef struct VulkanImage
 {
     VkImage handle;
-    VkDeviceMemory memory;
+    VulkanAllocation allocation;
     VkImageView view;
     u32 width;
     u32 height;
@@ -128,11 +236,22 @@ typedef struct VulkanTexture
 {
     VulkanImage image;
     VkSampler sampler;
+    u32 bindlessIndex;      // Slot in the bindless texture array, INVALID_ID without one.
+    u64 uploadTicket;       // Pixels are uploaded once it completes, see vulkanUpload.h.
 } VulkanTexture;
 
 // TODO make configurable
-#define VULKAN_MAX_MESHES 512
+#define VULKAN_MAX_MESHES 1024
+
+// Model matrices per frame in flight for instanced draws.
+#define VULKAN_MAX_INSTANCES 65536
 
+// Batches under this amount are recorded on the calling thread.
+#define VULKAN_RECORD_BATCHES_PER_BUFFER 128
+
+/**
+ * Ranges of a mesh in the shared vertex and index buffers, in elements.
+ */
 typedef struct VulkanMesh
 {
     u32 id;
@@ -141,10 +260,13 @@ typedef struct VulkanMesh
     u32 vertexOffset;
     u32 indexCount;
     u32 indexOffset;
-    VulkanBuffer vertexBuffer;
-    VulkanBuffer indexBuffer;
+    u64 uploadTicket;       // Vertices and indices are uploaded once it completes.
 } VulkanMesh;
 
+// Initial capacity of the shared geometry buffers, in elements.
+#define VULKAN_GEOMETRY_VERTEX_CAPACITY (256 * 1024)
+#define VULKAN_GEOMETRY_INDEX_CAPACITY (1024 * 1024)
+
 #define VULKAN_MAX_SHADER_STAGES 2
 
 typedef struct VulkanShaderObject
@@ -196,6 +318,119 @@ struct VulkanMaterialShaderUBO{
     glm::mat4 matReserved03; // 64 bytes
 };
 
+// Materials of the bindless material buffer.
+#define VULKAN_BINDLESS_MATERIAL_COUNT 4096
+
+/**
+ * Material of the bindless model, std430 in the shaders. Textures are
+ * slots of the bindless texture array, INVALID_ID when the material has none.
+ */
+struct VulkanMaterialData
+{
+    glm::vec4 diffuseColor;
+    u32 diffuseTexture;
+    u32 normalTexture;
+    u32 metallicRoughnessTexture;
+    u32 padding;
+};
+
+/**
+ * Descriptor set shared by every material when descriptor indexing is
+ * available: the material buffer at binding 0 and an array of every
+ * texture at binding 1. It is bound once per pipeline at set 1, draws
+ * pick their material with a push constant.
+ * Each frame in flight has its own set and region of the material buffer,
+ * a material changed now reaches the region of another frame once that
+ * frame's fence is signaled.
+ */
+typedef struct VulkanBindless
+{
+    VkDescriptorPool pool;
+    VkDescriptorSetLayout layout;
+    VkDescriptorSet sets[VULKAN_MAX_FRAMES_IN_FLIGHT];
+
+    VulkanBuffer materialBuffer;        // VULKAN_BINDLESS_MATERIAL_COUNT materials per frame.
+    VulkanMaterialData* materialData;   // Mapped while the buffer lives.
+    u32 frame;                          // Frame being recorded.
+    u32 frameCount;
+
+    std::vector<VulkanMaterialData> materials;  // Last data of each material, the regions catch up with it.
+    std::vector<u32> staleMaterials[VULKAN_MAX_FRAMES_IN_FLIGHT];   // Changed since the region of the frame was written.
+    std::vector<u32> retiredMaterials[VULKAN_MAX_FRAMES_IN_FLIGHT]; // Destroyed while the frame was recorded.
+    std::vector<u32> freeMaterials;     // Free slots of the material buffer.
+    std::vector<u32> freeTextures;      // Free slots of the texture array.
+} VulkanBindless;
+
+// Objects culled and drawn by the GPU per frame.
+#define VULKAN_MAX_INDIRECT_OBJECTS 65536
+
+/**
+ * Object of the GPU driven path, std430 in the shaders. The sphere is in
+ * world space, mesh and material are their renderer ids.
+ */
+struct VulkanObjectData
+{
+    glm::mat4 model;
+    glm::vec4 sphere;
+    u32 mesh;
+    u32 material;
+    u32 padding[2];
+};
+
+/**
+ * Ranges of a mesh in the shared buffers, read by the culling shader to
+ * fill the draws. Meshes without indices have indexCount 0 and are skipped.
+ */
+struct VulkanMeshDrawData
+{
+    u32 indexCount;
+    u32 firstIndex;
+    i32 vertexOffset;
+    u32 padding;
+};
+
+/**
+ * GPU driven geometry pass. Objects are copied to their region of the
+ * frame when they change, the culling shader writes a
+ * VkDrawIndexedIndirectCommand per visible object and the draw count,
+ * and the geometry pass draws them with a single indirect count draw.
+ */
+typedef struct VulkanIndirect
+{
+    VkDescriptorPool pool;
+    VkDescriptorSetLayout layout;   // Compute set 0 and graphics set 2.
+    VkDescriptorSet set;
+
+    VulkanBuffer objectBuffer;      // Host visible, a region per frame in flight.
+    VulkanBuffer meshBuffer;        // Host visible, VULKAN_MAX_MESHES entries per frame in flight.
+    VulkanBuffer drawBuffer;        // Device local, a region per frame in flight.
+    VulkanBuffer countBuffer;       // Device local, a count per frame in flight.
+    u8* objectData;
+    u8* meshData;
+    u32 countStride;
+
+    VkShaderModule cullShader;
+    VkPipelineLayout cullLayout;
+    VkPipeline cullPipeline;
+
+    VulkanShaderObject shaderStages[2];
+    VulkanPipeline pipeline;        // Geometry pass, models and materials come from the objects.
+
+    // Last objects given, copied to the region of a frame when its version is older.
+    // Objects moved since then are copied alone to the regions already up to date.
+    std::vector<VulkanObjectData> objects;
+    std::vector<glm::vec4> spheres;     // Bounding spheres of the meshes of the objects, in model space.
+    std::vector<Material*> materials;   // Different materials of the objects.
+    u32 version;
+    std::vector<u32> frameVersions;
+    std::vector<std::vector<u32>> frameMovedObjects;
+
+    // Same for the mesh ranges, a frame in flight may still cull with the old ones.
+    std::vector<VulkanMeshDrawData> meshes;
+    u32 meshVersion;
+    std::vector<u32> frameMeshVersions;
+} VulkanIndirect;
+
 /** Vulkan Material Shader
  * This object should hold all information related to
  * the shader pass.
@@ -211,16 +446,13 @@ typedef struct VulkanForwardShader
     // global descriptors will be allocated from this pool
     VkDescriptorPool globalDescriptorPool;
 
-     // One DescriptorSet per each buffer from the triple buffer
-    VkDescriptorSet globalDescriptorSet[3];
+     // One DescriptorSet per frame in flight
+    VkDescriptorSet globalDescriptorSet[VULKAN_MAX_FRAMES_IN_FLIGHT];
     VkDescriptorSetLayout globalDescriptorSetLayout;
 
-    // Struct to be loaded into global Ubo buffer.
-    ViewProjectionBuffer globalUboData;
-    // Buffer holding the data from globalUboData to be uploaded to the gpu.
-    VulkanBuffer globalUbo;
-    VulkanLightData lightData;
-    VulkanBuffer lightUbo;
+    // Dynamic offsets of the camera and lights of the frame in the uniform ring.
+    u32 cameraOffset;
+    u32 lightsOffset;
 
     // Mesh instance objects
     VkDescriptorPool meshInstanceDescriptorPool;
@@ -231,6 +463,7 @@ typedef struct VulkanForwardShader
     VulkanMaterialShaderUBO objectMaterialData;
     u32 meshInstanceBufferIndex;
     VulkanBuffer meshInstanceBuffer;
+    u8* meshInstanceData;   // Mapped while the buffer lives.
 
     TextureUse samplerUses [VULKAN_FORWARD_MATERIAL_SAMPLER_COUNT];
 
@@ -239,11 +472,21 @@ typedef struct VulkanForwardShader
     VulkanPipeline pipeline;
 } VulkanForwardShader;
 
+#define VULKAN_GBUFFER_TARGET_COUNT 3
+
+/**
+ * Color targets of the geometry pass, sampled by the light pass in order.
+ * Classic: position and metallic, normal and roughness, albedo.
+ * Compact: octahedral normal, albedo, metallic and roughness. The light
+ * pass rebuilds the position from the geometry depth.
+ * Each frame in flight has its own targets, so the geometry pass of a
+ * frame does not wait for the light pass of the previous one.
+ */
 struct gbuffers
 {
-    VulkanTexture positonTxt;
-    VulkanTexture normalTxt;
-    VulkanTexture albedoTxt;
+    RenderGbufferLayout layout;
+    VkFormat formats[VULKAN_GBUFFER_TARGET_COUNT];
+    VulkanTexture targets[VULKAN_MAX_FRAMES_IN_FLIGHT][VULKAN_GBUFFER_TARGET_COUNT];
 };
 
 struct VulkanDeferredShader
@@ -264,30 +507,32 @@ struct VulkanDeferredShader
     VulkanObjectDescriptor objectGeometryDescriptor[VULKAN_MAX_MATERIAL_COUNT];
     VkDescriptorSetLayout objectGeometryDescriptorSetLayout;
     
-    ViewProjectionBuffer    globalUboData;
-    VulkanBuffer            globalUbo;
-    VulkanLightData         lightData;
-    VulkanBuffer            lightUbo;
+    // Dynamic offsets of the camera, lights and light clusters of the frame in the uniform ring.
+    u32 cameraOffset;
+    u32 lightsOffset;
+    u32 clustersOffset;
 
     u32 objectBufferIndex = 0;
     VulkanBuffer objectUbo;
+    u8* objectData;         // Mapped while the buffer lives.
 
     TextureUse samplerUses [VULKAN_FORWARD_MATERIAL_SAMPLER_COUNT];
 
-    // Deferred pass
-    VkDescriptorSet lightDescriptorSet[3];
+    // Deferred pass, one set per frame in flight pointing to its G-buffer.
+    VkDescriptorSet lightDescriptorSet[VULKAN_MAX_FRAMES_IN_FLIGHT];
     VkDescriptorSetLayout lightDescriptorSetLayout;
 
+    // Geometry pass resources of each frame in flight.
+    u32 frameCount;
     gbuffers gbuf;
-    VulkanTexture geometryDepth;
-
-    VkSemaphore geometrySemaphore;
-
-    Framebuffer geometryFramebuffer;
-    Framebuffer lightFramebuffer[3];
-
+    VulkanTexture geometryDepth[VULKAN_MAX_FRAMES_IN_FLIGHT];  // Sampled by the light pass in the compact layout.
+    VkSemaphore geometrySemaphore[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    Framebuffer geometryFramebuffer[VULKAN_MAX_FRAMES_IN_FLIGHT];
     VkCommandPool geometryCmdPool;
-    CommandBuffer geometryCmdBuffer;
+    CommandBuffer geometryCmdBuffer[VULKAN_MAX_FRAMES_IN_FLIGHT];
+
+    // One per swapchain image.
+    std::vector<Framebuffer> lightFramebuffer;
 
     VulkanPipeline      geometryPipeline;
     VulkanRenderpass    geometryRenderpass;
@@ -302,7 +547,6 @@ typedef struct VulkanSwapchain
     VkPresentModeKHR    presentMode;
     VkExtent2D          extent;
     u32                 imageCount; // Number of images in the swapchain.
-    u32                 maxImageInFlight; // Number of images in flight.
 
     VkFormat depthFormat;
     VulkanImage depthImage;
@@ -312,6 +556,33 @@ typedef struct VulkanSwapchain
     std::vector<Framebuffer>    framebuffers;
 } VulkanSwapchain;
 
+/**
+ * Command buffer being recorded and the state bound in it, to skip
+ * redundant binds. Each recording thread has its own.
+ */
+typedef struct VulkanDrawContext
+{
+    VkCommandBuffer cmd;
+    VkPipeline boundPipeline;
+    VkDescriptorSet boundMaterial;
+    u32 boundMaterialIndex;     // Pushed bindless material.
+    bool boundGeometry;
+    bool boundInstances;
+    RenderStats stats;
+} VulkanDrawContext;
+
+/**
+ * Secondary command buffers recorded by one thread for one frame in
+ * flight. The pool is reset once the frame fence is signaled and the
+ * buffers are recorded again, never freed.
+ */
+typedef struct VulkanThreadCommandPool
+{
+    VkCommandPool handle;
+    std::vector<VkCommandBuffer> buffers;
+    u32 used;
+} VulkanThreadCommandPool;
+
 typedef struct VulkanState
 {
     VkInstance      instance;
@@ -322,13 +593,24 @@ typedef struct VulkanState
     VkSurfaceKHR    surface;
 
     u32 imageIndex; // Index to the swapchain image to paint.
-    u32 currentFrame; // The actual index frame.
+    u32 currentFrame; // The actual index frame, below framesInFlight.
+    u32 framesInFlight;
+    RenderPresentMode presentMode; // Requested, the swapchain falls back to fifo.
 
     // TODO implement own allocator for vulkan
     // VkAllocationCallbacks* allocator;
 
     // TODO Temporal variables
     VulkanMesh* vulkanMeshes;
+    // Vertices and indices of every mesh, bound once per command buffer.
+    VulkanGeometryBuffer vertexBuffer;
+    VulkanGeometryBuffer indexBuffer;
+
+    // Material buffer and texture array, only with device.bindless.
+    VulkanBindless bindless;
+
+    // Compute culling and indirect draws of the geometry pass, only with device.gpuDriven.
+    VulkanIndirect indirect;
 
     // Forward rendering
     VulkanForwardShader forwardShader;
@@ -346,9 +628,43 @@ typedef struct VulkanState
 
     VulkanRenderpass renderpass;
 
+    // Primary command buffers and sync objects of each frame in flight.
     std::vector<CommandBuffer> commandBuffers;
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
     std::vector<VulkanFence> frameInFlightFences;
+
+    // Fence of the frame rendering to each swapchain image, nullptr if none.
+    std::vector<VulkanFence*> imagesInFlight;
+
+    // VULKAN_FRAME_TIMESTAMPS queries per frame in flight, written bits in timestampMask.
+    VkQueryPool timestampPool;
+    u32 timestampMask[VULKAN_MAX_FRAMES_IN_FLIGHT];
+    bool timestamps;            // The graphics queue supports them.
+    f64 frameBeginTime;
+    u64 frameBeginMapCalls;     // Map calls of the allocator when the frame began.
+
+    // Camera and lights of each frame, bound with dynamic offsets.
+    VulkanRingBuffer uniformRing;
+
+    // Model matrices of the instanced draws. Mapped while the backend lives,
+    // each frame in flight writes its own VULKAN_MAX_INSTANCES region.
+    VulkanBuffer instanceBuffer;
+    glm::mat4* instanceData;
+    u32 instanceCount;          // Used in the current frame.
+
+    // Forward and geometry passes are recorded in secondary command buffers,
+    // executed in order by the primary when the pass ends. The deferred pass
+    // is recorded inline.
+    DefaultRenderPasses currentPass;
+    VulkanDrawContext mainContext;          // Draws recorded from the main thread.
+    std::vector<VkCommandBuffer> passSecondaries;
+
+    // framesInFlight * threadCount pools, indexed by frame then job system thread.
+    std::vector<VulkanThreadCommandPool> threadCommandPools;
+    u32 threadCount;
+
+    RenderStats frameStats;     // Being counted.
+    RenderStats lastFrameStats; // Complete, shown in the debug menu.
 } VulkanState;
\ No newline at end of file
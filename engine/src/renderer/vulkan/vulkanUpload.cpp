@@ -0,0 +1,416 @@
+#include "vulkanUpload.h"
+
+#include "vulkanBuffer.h"
+#include "vulkanUtils.h"
+#include "memory/pmemory.h"
+
+#include <new>
+#include <vector>
+
+struct VulkanUploadBufferCopy
+{
+    VkBuffer src;
+    VkBuffer dst;
+    VkDeviceSize srcOffset;
+    VkDeviceSize dstOffset;
+    VkDeviceSize size;
+};
+
+struct VulkanUploadImageCopy
+{
+    VkBuffer src;
+    VkImage dst;
+    VkDeviceSize srcOffset;
+    u32 width;
+    u32 height;
+};
+
+struct VulkanUploadBatch
+{
+    VkCommandBuffer transferCmd;
+    VkCommandBuffer acquireCmd;         // Only with separate queue families.
+    VulkanFence fence;
+    VkSemaphore released;               // Transfer to acquire submission.
+    u64 ticket;
+    std::vector<VulkanBuffer> ownStaging;
+    bool inFlight;
+};
+
+struct VulkanUploadQueue
+{
+    VulkanBuffer staging;
+    VkDeviceSize stagingHead;
+    VkDeviceSize stagingAlignment;
+
+    VkCommandPool transferPool;
+    VkCommandPool graphicsPool;
+    VulkanUploadBatch batches[VULKAN_UPLOAD_MAX_BATCHES];
+    u32 nextBatch;
+
+    // Queued since the last flush.
+    std::vector<VulkanUploadBufferCopy> bufferCopies;
+    std::vector<VulkanUploadImageCopy> imageCopies;
+    std::vector<VulkanBuffer> ownStaging;
+
+    u64 submitted;
+    u64 completed;
+    bool separateFamilies;
+};
+
+static void retireBatch(const VulkanDevice& device, VulkanUploadBatch& batch)
+{
+    VulkanUploadQueue* q = device.uploads;
+    for(VulkanBuffer& buffer : batch.ownStaging)
+        vulkanBufferDestroy(device, buffer);
+    batch.ownStaging.clear();
+
+    vulkanResetFence(device, &batch.fence);
+    batch.inFlight = false;
+
+    // Fences are polled out of order, a ticket completes once no older batch is in flight.
+    u64 completed = q->submitted;
+    for(const VulkanUploadBatch& other : q->batches) {
+        if(other.inFlight && other.ticket <= completed)
+            completed = other.ticket - 1;
+    }
+    q->completed = completed;
+}
+
+static void waitBatch(const VulkanDevice& device, VulkanUploadBatch& batch)
+{
+    if(!batch.inFlight)
+        return;
+    vulkanWaitFence(device, &batch.fence);
+    retireBatch(device, batch);
+}
+
+/**
+ * Copies the data to staging memory.
+ * @return VkBuffer the data is in, at outOffset.
+ */
+static VkBuffer stage(
+    const VulkanDevice& device,
+    const void* data,
+    VkDeviceSize size,
+    VkDeviceSize* outOffset)
+{
+    VulkanUploadQueue* q = device.uploads;
+    if(size > VULKAN_UPLOAD_STAGING_SIZE)
+    {
+        VulkanBuffer own;
+        if(!vulkanBufferCreate(device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &own)){
+            return VK_NULL_HANDLE;
+        }
+        vulkanBufferLoadData(device, own, 0, size, 0, data);
+        q->ownStaging.push_back(own);
+        *outOffset = 0;
+        return own.handle;
+    }
+
+    VkDeviceSize offset = (q->stagingHead + q->stagingAlignment - 1) & ~(q->stagingAlignment - 1);
+    if(offset + size > VULKAN_UPLOAD_STAGING_SIZE)
+    {
+        // Wrap around once every batch using the staging buffer is done.
+        vulkanUploadFlush(device);
+        for(VulkanUploadBatch& batch : q->batches)
+            waitBatch(device, batch);
+        offset = 0;
+    }
+
+    vulkanBufferLoadData(device, q->staging, offset, size, 0, data);
+    q->stagingHead = offset + size;
+    *outOffset = offset;
+    return q->staging.handle;
+}
+
+bool vulkanUploadCreate(VulkanDevice* device)
+{
+    void* memory = memAllocate(sizeof(VulkanUploadQueue), MEMORY_TAG_RENDERER);
+    VulkanUploadQueue* q = new (memory) VulkanUploadQueue();
+    device->uploads = q;
+
+    q->separateFamilies = device->transferQueueIndex != device->graphicsQueueIndex;
+    q->stagingHead      = 0;
+    q->submitted        = 0;
+    q->completed        = 0;
+    q->nextBatch        = 0;
+
+    // Image copies need offsets multiple of the texel size and of optimalBufferCopyOffsetAlignment.
+    q->stagingAlignment = device->properties.limits.optimalBufferCopyOffsetAlignment;
+    if(q->stagingAlignment < 16)
+        q->stagingAlignment = 16;
+
+    if(!vulkanBufferCreate(*device, VULKAN_UPLOAD_STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &q->staging)){
+        PERROR("vulkanUploadCreate - failed to create the staging buffer.");
+        return false;
+    }
+
+    VkCommandPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    poolInfo.flags              = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex   = device->transferQueueIndex;
+    VK_CHECK(vkCreateCommandPool(device->handle, &poolInfo, nullptr, &q->transferPool));
+    poolInfo.queueFamilyIndex   = device->graphicsQueueIndex;
+    VK_CHECK(vkCreateCommandPool(device->handle, &poolInfo, nullptr, &q->graphicsPool));
+
+    for(VulkanUploadBatch& batch : q->batches)
+    {
+        VkCommandBufferAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocInfo.level                 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount    = 1;
+        allocInfo.commandPool           = q->transferPool;
+        VK_CHECK(vkAllocateCommandBuffers(device->handle, &allocInfo, &batch.transferCmd));
+        allocInfo.commandPool           = q->graphicsPool;
+        VK_CHECK(vkAllocateCommandBuffers(device->handle, &allocInfo, &batch.acquireCmd));
+
+        if(!vulkanCreateFence(*device, &batch.fence, false)
+            || !vulkanCreateSemaphore(*device, &batch.released)){
+            return false;
+        }
+        batch.ticket    = 0;
+        batch.inFlight  = false;
+    }
+
+    PINFO("Vulkan upload queue created, %s queue families.", q->separateFamilies ? "separate" : "shared");
+    return true;
+}
+
+void vulkanUploadDestroy(VulkanDevice* device)
+{
+    VulkanUploadQueue* q = device->uploads;
+    if(!q)
+        return;
+
+    for(VulkanUploadBatch& batch : q->batches)
+    {
+        waitBatch(*device, batch);
+        vulkanDestroyFence(*device, batch.fence);
+        vulkanDestroySemaphore(*device, batch.released);
+    }
+    for(VulkanBuffer& buffer : q->ownStaging)
+        vulkanBufferDestroy(*device, buffer);
+
+    // Destroying the pools frees their command buffers.
+    vkDestroyCommandPool(device->handle, q->transferPool, nullptr);
+    vkDestroyCommandPool(device->handle, q->graphicsPool, nullptr);
+    vulkanBufferDestroy(*device, q->staging);
+
+    q->~VulkanUploadQueue();
+    memFree(q, sizeof(VulkanUploadQueue), MEMORY_TAG_RENDERER);
+    device->uploads = nullptr;
+}
+
+u64 vulkanUploadBuffer(
+    const VulkanDevice& device,
+    VkBuffer dst,
+    VkDeviceSize dstOffset,
+    const void* data,
+    VkDeviceSize size)
+{
+    VulkanUploadQueue* q = device.uploads;
+    VulkanUploadBufferCopy copy;
+    copy.src = stage(device, data, size, &copy.srcOffset);
+    if(copy.src == VK_NULL_HANDLE)
+        return 0;
+
+    copy.dst        = dst;
+    copy.dstOffset  = dstOffset;
+    copy.size       = size;
+    q->bufferCopies.push_back(copy);
+    return q->submitted + 1;
+}
+
+u64 vulkanUploadImage(
+    const VulkanDevice& device,
+    VulkanImage* image,
+    const void* pixels,
+    VkDeviceSize size)
+{
+    VulkanUploadQueue* q = device.uploads;
+    VulkanUploadImageCopy copy;
+    copy.src = stage(device, pixels, size, &copy.srcOffset);
+    if(copy.src == VK_NULL_HANDLE)
+        return 0;
+
+    copy.dst    = image->handle;
+    copy.width  = image->width;
+    copy.height = image->height;
+    q->imageCopies.push_back(copy);
+    return q->submitted + 1;
+}
+
+static VkImageMemoryBarrier imageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+    VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    barrier.image                           = image;
+    barrier.oldLayout                       = oldLayout;
+    barrier.newLayout                       = newLayout;
+    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel   = 0;
+    barrier.subresourceRange.levelCount     = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount     = 1;
+    return barrier;
+}
+
+void vulkanUploadFlush(const VulkanDevice& device)
+{
+    VulkanUploadQueue* q = device.uploads;
+    if(q->bufferCopies.empty() && q->imageCopies.empty())
+        return;
+
+    VulkanUploadBatch& batch = q->batches[q->nextBatch];
+    waitBatch(device, batch);
+    q->nextBatch = (q->nextBatch + 1) % VULKAN_UPLOAD_MAX_BATCHES;
+
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(batch.transferCmd, &beginInfo));
+
+    // New images, their old contents are discarded.
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    imageBarriers.reserve(q->imageCopies.size());
+    for(const VulkanUploadImageCopy& copy : q->imageCopies) {
+        imageBarriers.push_back(imageBarrier(copy.dst, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+        imageBarriers.back().dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    }
+    if(!imageBarriers.empty()) {
+        vkCmdPipelineBarrier(batch.transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, (u32)imageBarriers.size(), imageBarriers.data());
+    }
+
+    for(const VulkanUploadBufferCopy& copy : q->bufferCopies) {
+        VkBufferCopy region = {copy.srcOffset, copy.dstOffset, copy.size};
+        vkCmdCopyBuffer(batch.transferCmd, copy.src, copy.dst, 1, &region);
+    }
+    for(const VulkanUploadImageCopy& copy : q->imageCopies) {
+        VkBufferImageCopy region = {};
+        region.bufferOffset                     = copy.srcOffset;
+        region.imageSubresource.aspectMask      = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount      = 1;
+        region.imageExtent                      = {copy.width, copy.height, 1};
+        vkCmdCopyBufferToImage(batch.transferCmd, copy.src, copy.dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+
+    // Ranges and images go to the graphics family in the shader read layout.
+    // With separate families the same barriers release here and acquire on
+    // the graphics queue, the layout transition happens once.
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    bufferBarriers.reserve(q->bufferCopies.size());
+    for(const VulkanUploadBufferCopy& copy : q->bufferCopies) {
+        VkBufferMemoryBarrier barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+        barrier.buffer  = copy.dst;
+        barrier.offset  = copy.dstOffset;
+        barrier.size    = copy.size;
+        bufferBarriers.push_back(barrier);
+    }
+    imageBarriers.clear();
+    for(const VulkanUploadImageCopy& copy : q->imageCopies)
+        imageBarriers.push_back(imageBarrier(copy.dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+
+    u32 srcFamily = q->separateFamilies ? device.transferQueueIndex : VK_QUEUE_FAMILY_IGNORED;
+    u32 dstFamily = q->separateFamilies ? device.graphicsQueueIndex : VK_QUEUE_FAMILY_IGNORED;
+    VkAccessFlags readAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    VkPipelineStageFlags readStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+        | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    for(VkBufferMemoryBarrier& barrier : bufferBarriers) {
+        barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask       = q->separateFamilies ? 0 : readAccess;
+        barrier.srcQueueFamilyIndex = srcFamily;
+        barrier.dstQueueFamilyIndex = dstFamily;
+    }
+    for(VkImageMemoryBarrier& barrier : imageBarriers) {
+        barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask       = q->separateFamilies ? 0 : readAccess;
+        barrier.srcQueueFamilyIndex = srcFamily;
+        barrier.dstQueueFamilyIndex = dstFamily;
+    }
+    vkCmdPipelineBarrier(batch.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        q->separateFamilies ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : readStages,
+        0, 0, nullptr, (u32)bufferBarriers.size(), bufferBarriers.data(), (u32)imageBarriers.size(), imageBarriers.data());
+    VK_CHECK(vkEndCommandBuffer(batch.transferCmd));
+
+    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.commandBufferCount   = 1;
+    submitInfo.pCommandBuffers      = &batch.transferCmd;
+    if(q->separateFamilies) {
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores    = &batch.released;
+    }
+    VK_CHECK(vkQueueSubmit(device.transferQueue, 1, &submitInfo, q->separateFamilies ? VK_NULL_HANDLE : batch.fence.handle));
+
+    if(q->separateFamilies)
+    {
+        VK_CHECK(vkBeginCommandBuffer(batch.acquireCmd, &beginInfo));
+        for(VkBufferMemoryBarrier& barrier : bufferBarriers) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = readAccess;
+        }
+        for(VkImageMemoryBarrier& barrier : imageBarriers) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = readAccess;
+        }
+        vkCmdPipelineBarrier(batch.acquireCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, readStages,
+            0, 0, nullptr, (u32)bufferBarriers.size(), bufferBarriers.data(), (u32)imageBarriers.size(), imageBarriers.data());
+        VK_CHECK(vkEndCommandBuffer(batch.acquireCmd));
+
+        // Frames are submitted after it to the same queue, so they see the acquired resources.
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        VkSubmitInfo acquireInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        acquireInfo.waitSemaphoreCount  = 1;
+        acquireInfo.pWaitSemaphores     = &batch.released;
+        acquireInfo.pWaitDstStageMask   = &waitStage;
+        acquireInfo.commandBufferCount  = 1;
+        acquireInfo.pCommandBuffers     = &batch.acquireCmd;
+        VK_CHECK(vkQueueSubmit(device.graphicsQueue, 1, &acquireInfo, batch.fence.handle));
+    }
+
+    batch.ticket    = ++q->submitted;
+    batch.inFlight  = true;
+    batch.ownStaging.swap(q->ownStaging);
+    q->bufferCopies.clear();
+    q->imageCopies.clear();
+}
+
+void vulkanUploadUpdate(const VulkanDevice& device)
+{
+    VulkanUploadQueue* q = device.uploads;
+    bool anyInFlight = false;
+    for(VulkanUploadBatch& batch : q->batches)
+    {
+        if(!batch.inFlight)
+            continue;
+        if(vkGetFenceStatus(device.handle, batch.fence.handle) == VK_SUCCESS)
+            retireBatch(device, batch);
+        else
+            anyInFlight = true;
+    }
+
+    // Nothing uses the staging buffer, start again from the beginning.
+    if(!anyInFlight && q->bufferCopies.empty() && q->imageCopies.empty())
+        q->stagingHead = 0;
+}
+
+bool vulkanUploadIsComplete(
+    const VulkanDevice& device,
+    u64 ticket)
+{
+    return ticket <= device.uploads->completed;
+}
+
+void vulkanUploadWait(
+    const VulkanDevice& device,
+    u64 ticket)
+{
+    VulkanUploadQueue* q = device.uploads;
+    if(ticket > q->submitted)
+        vulkanUploadFlush(device);
+    for(VulkanUploadBatch& batch : q->batches) {
+        if(batch.inFlight && batch.ticket <= ticket)
+            waitBatch(device, batch);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "vulkanTypes.h"
+
+/**
+ * Upload queue.
+ * Data is copied into a persistently mapped staging buffer and the copies
+ * are queued. A flush records all of them in one command buffer submitted
+ * to the transfer queue. When the transfer queue is of another family the
+ * copied buffer ranges and images are released to the graphics family and
+ * acquired by a small graphics submission waiting on the transfer one, so
+ * frames submitted later can use them without waiting on the CPU.
+ * Each flush is a batch with a fence. Uploads return the ticket of the
+ * batch they go in, resources are ready once that ticket completes.
+ * Submits to the graphics queue, call it from the thread rendering.
+ */
+
+// Bytes of the persistent staging buffer. Bigger uploads get a staging buffer of their own.
+#define VULKAN_UPLOAD_STAGING_SIZE (64 * 1024 * 1024)
+
+// Batches in flight. Flushing with all of them in use waits for the oldest.
+#define VULKAN_UPLOAD_MAX_BATCHES 8
+
+/**
+ * Creates the upload queue of the device, call once the allocator exists.
+ */
+bool vulkanUploadCreate(VulkanDevice* device);
+
+/**
+ * Waits for the batches in flight and destroys the queue.
+ */
+void vulkanUploadDestroy(VulkanDevice* device);
+
+/**
+ * Queues a copy of size bytes of data to dst at dstOffset. Data is copied
+ * right away, it can be freed on return. Vertex and index buffers only.
+ * @return u64 ticket of the batch the copy goes in.
+ */
+u64 vulkanUploadBuffer(
+    const VulkanDevice& device,
+    VkBuffer dst,
+    VkDeviceSize dstOffset,
+    const void* data,
+    VkDeviceSize size);
+
+/**
+ * Queues the pixels of the whole image. The image ends in the shader read
+ * only layout.
+ * @return u64 ticket of the batch the copy goes in.
+ */
+u64 vulkanUploadImage(
+    const VulkanDevice& device,
+    VulkanImage* image,
+    const void* pixels,
+    VkDeviceSize size);
+
+/**
+ * Submits the queued copies as one batch. Does nothing if there are none.
+ */
+void vulkanUploadFlush(const VulkanDevice& device);
+
+/**
+ * Retires the batches whose fence is signaled, their staging space is reused.
+ * Called once per frame.
+ */
+void vulkanUploadUpdate(const VulkanDevice& device);
+
+bool vulkanUploadIsComplete(
+    const VulkanDevice& device,
+    u64 ticket);
+
+/**
+ * Flushes if needed and waits on the CPU until the ticket completes.
+ */
+void vulkanUploadWait(
+    const VulkanDevice& device,
+    u64 ticket);
@@ -11,6 +11,22 @@ layoutPosColorUVsNorm[] =
 
 VertexDeclaration vtx_decl_pos_color_uvs_norm("PosColorUvN", layoutPosColorUVsNorm, 4);
 
+// Same vertex plus the model matrix per instance, one column per location.
+static VkVertexInputAttributeDescription 
+layoutPosColorUVsNormInstanced[] = 
+{
+    {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0},
+    {1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(f32) * 3},
+    {2, 0, VK_FORMAT_R32G32_SFLOAT, sizeof(f32) * 7},
+    {3, 0, VK_FORMAT_R32G32B32_SFLOAT, sizeof(f32) * 9},
+    {4, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 0},
+    {5, 1, VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(f32) * 4},
+    {6, 1, VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(f32) * 8},
+    {7, 1, VK_FORMAT_R32G32B32A32_SFLOAT, sizeof(f32) * 12}
+};
+
+VertexDeclaration vtx_decl_pos_color_uvs_norm_instanced("PosColorUvNInstanced", layoutPosColorUVsNormInstanced, 8);
+
 static VkVertexInputAttributeDescription
 layoutPos[] = { {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0} };
 
@@ -37,5 +53,7 @@ getVertexDeclarationByName(const std::string& name)
         return &vtx_decl_pos_uv;
     if(name == vtx_decl_pos_color_uvs_norm.name)
         return &vtx_decl_pos_color_uvs_norm;
+    if(name == vtx_decl_pos_color_uvs_norm_instanced.name)
+        return &vtx_decl_pos_color_uvs_norm_instanced;
     return nullptr;
 }
\ No newline at end of file
@@ -21,9 +21,11 @@ loadNode(const tinygltf::Model& tmodel, const tinygltf::Node& tnode, Node* paren
     if(tnode.children.size() > 0)
     {
         node->nChilds = tnode.children.size();
-        node->child = (Node*)memAllocate(sizeof(Node), MEMORY_TAG_ENTITY);
+        node->child = (Node*)memAllocate(sizeof(Node) * node->nChilds, MEMORY_TAG_ENTITY);
         for( size_t i = 0; i < tnode.children.size(); ++i){
-            node->child[i] = *loadNode(tmodel, tmodel.nodes[tnode.children[i]], node);
+            Node* child = loadNode(tmodel, tmodel.nodes[tnode.children[i]], node);
+            node->child[i] = *child;
+            memFree(child, sizeof(Node), MEMORY_TAG_ENTITY);
         }
     }
 
@@ -38,6 +40,12 @@ loadNode(const tinygltf::Model& tmodel, const tinygltf::Node& tnode, Node* paren
         {
             const tinygltf::Primitive& tprim = mesh.primitives[i];
 
+            // Only the last primitive is kept, release the previous one.
+            memFree(meshData.vertices, sizeof(Vertex) * meshData.vertexCount, MEMORY_TAG_ENTITY);
+            memFree(meshData.indices, sizeof(u32) * meshData.indexCount, MEMORY_TAG_ENTITY);
+            meshData.vertices = nullptr;
+            meshData.indices = nullptr;
+
             const f32* positionBuffer = nullptr;
             const f32* normalBuffer = nullptr;
             const f32* uvBuffer = nullptr;
@@ -105,6 +113,7 @@ loadNode(const tinygltf::Model& tmodel, const tinygltf::Node& tnode, Node* paren
                         {
                             meshData.indices[i] = buf[i];
                         }
+                        memFree(buf, meshData.indexSize * meshData.indexCount, MEMORY_TAG_ENTITY);
                         break;
                     }
                     case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
@@ -118,6 +127,7 @@ loadNode(const tinygltf::Model& tmodel, const tinygltf::Node& tnode, Node* paren
                         {
                             meshData.indices[i] = buf[i];
                         }
+                        memFree(buf, meshData.indexSize * meshData.indexCount, MEMORY_TAG_ENTITY);
                         break;
                     }
                     default:
@@ -138,6 +148,10 @@ loadNode(const tinygltf::Model& tmodel, const tinygltf::Node& tnode, Node* paren
         }
         node->mesh = meshSystemCreateFromData(&meshData);
         node->material = materialSystemCreateFromData(materialData);
+
+        // Data is already uploaded to the renderer.
+        memFree(meshData.vertices, sizeof(Vertex) * meshData.vertexCount, MEMORY_TAG_ENTITY);
+        memFree(meshData.indices, sizeof(u32) * meshData.indexCount, MEMORY_TAG_ENTITY);
     }
 
     return node;
@@ -98,6 +98,9 @@ typedef struct Mesh {
     u32 id;
     u32 rendererId;
     char name[MESH_MAX_LENGTH];
+    glm::vec3 boundsMin;        // Local space AABB, computed on creation.
+    glm::vec3 boundsMax;
+    glm::vec4 boundingSphere;   // Local space center and radius.
 } Mesh;
 
 typedef struct MeshData {
@@ -13,10 +13,8 @@ struct TCompBase {
 #define DECL_SIBILING_ACCESS()  \
     template<typename TComp>    \
     CHandle get() {             \
-        CEntity* e = CHandle(this).getOwner();  \
-        if(!e)                                  \
-            return CHandle();                   \
-        return e->get<TComp>();                 \
+        CHandle owner = CHandle(this).getOwner();       \
+        return getObjectManager<TComp>()->getComponentOf(owner); \
     }                                           \
     CEntity* getEntity() {                      \
         CEntity* e = CHandle(this).getOwner();  \
@@ -1,8 +1,43 @@
 #include "comp_light_spot.h"
+#include "comp_transform.h"
 
 DECL_OBJ_MANAGER("spot_light", TCompLightSpot)
 
+void TCompLightSpot::load(const json& j, TEntityParseContext& ctx)
+{
+    color           = loadColor(j, "color");
+    intensity       = j.value("intensity", intensity);
+    radius          = j.value("radius", radius);
+    enabled         = j.value("enabled", enabled);
+    spotExponent    = j.value("exponent", spotExponent);
+
+    // Half angle of the cone in degrees.
+    f32 angle       = j.value("angle", glm::degrees(glm::acos(cosineCutoff)));
+    cosineCutoff    = glm::cos(glm::radians(angle));
+}
+
 void TCompLightSpot::debugInMenu()
 {
-    
-}
\ No newline at end of file
+    ImGui::DragFloat3("Colour", &color.r, 1.0f, 0.0f, 1.0f);
+    ImGui::DragFloat("Radius", &radius, 0.1f, 0.0f);
+    ImGui::DragFloat("Intensity", &intensity, 1.0f, 0.0f);
+    f32 angle = glm::degrees(glm::acos(cosineCutoff));
+    if(ImGui::DragFloat("Angle", &angle, 0.5f, 0.0f, 89.0f))
+        cosineCutoff = glm::cos(glm::radians(angle));
+    ImGui::DragFloat("Exponent", &spotExponent, 0.1f, 0.0f);
+    ImGui::Checkbox("Enabled", &enabled);
+}
+
+glm::vec3 TCompLightSpot::getPosition()
+{
+    TCompTransform* t = get<TCompTransform>();
+    PASSERT(t)
+    return t->getWorldPosition();
+}
+
+glm::vec3 TCompLightSpot::getForward()
+{
+    TCompTransform* t = get<TCompTransform>();
+    PASSERT(t)
+    return glm::normalize(glm::vec3(t->getWorldMatrix()[2]));
+}
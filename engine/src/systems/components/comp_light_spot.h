@@ -1,14 +1,22 @@
 #pragma once
 
 #include "comp_base.h"
+#include "systems/entity/entity.h"
 
 struct TCompLightSpot : public TCompBase
 {
+    DECL_SIBILING_ACCESS();
+
     bool enabled = true;
     glm::vec4 color = glm::vec4(1.0f);
     f32 intensity = 1.0f;
-    f32 cosineCutoff;
-    f32 spotExponent;
-    
+    f32 radius = 1.0f;
+    f32 cosineCutoff = 0.9f;    // Cosine of the half angle of the cone.
+    f32 spotExponent = 1.0f;    // Falloff from the axis to the cone border.
+
+    void load(const json& j, TEntityParseContext& ctx);
     void debugInMenu();
-};
\ No newline at end of file
+
+    glm::vec3 getPosition();
+    glm::vec3 getForward();     // The cone points along the forward of the transform.
+};
@@ -1,44 +1,106 @@
 #include "comp_parent.h"
 
+#include "comp_transform.h"
+
 DECL_OBJ_MANAGER("parent", TCompParent)
 
-void TCompParent::addChild(const Entity& parent, const Entity& ent){
+TCompParent::~TCompParent()
+{
+    // Children stay where they are, they just lose the parent.
+    while(!children.empty())
+        delChild(children.back());
 
-/*     // Make sure child has no other parent, only one is valid.
-    if(EntitySystem::Get()->hasComponent<TCompParent>(ent)){
-        TCompParent* childParentComponent = &EntitySystem::Get()->getComponent<TCompParent>(ent);
-        if(childParentComponent->parent != 0){
-            TCompParent* parentComponent = &EntitySystem::Get()->getComponent<TCompParent>(childParentComponent->parent);
-            parentComponent->delChild(ent);
-        }
-        children.push_back(ent);
-        childParentComponent->parent = parent;
-        return;
+    CEntity* eParent = parent;
+    if(eParent) {
+        TCompParent* cParent = eParent->get<TCompParent>();
+        if(cParent)
+            cParent->delChild(CHandle(this).getOwner());
     }
-    
-    TCompParent parentComponent{};
-    parentComponent.parent = parent;
-    EntitySystem::Get()->addComponent<TCompParent>(ent, parentComponent);
-    children.push_back(ent); */
 }
 
-void TCompParent::delChild(const Entity ent){
+void TCompParent::addChild(CHandle hChild)
+{
+    CHandle hEntity = CHandle(this).getOwner();
+    CEntity* eChild = hChild;
+    PASSERT(eChild)
+    PASSERT(hChild != hEntity)
 
-/*     i32 idx = 0;
-    for(auto child : children){
-        if(child == ent){
-            children.erase(children.begin() + idx);
+    // Make sure child has no other parent, only one is valid.
+    TCompParent* cChildParent = eChild->get<TCompParent>();
+    if(cChildParent) {
+        if(cChildParent->parent == hEntity)
+            return;
+        CEntity* eOldParent = cChildParent->parent;
+        if(eOldParent) {
+            TCompParent* cOldParent = eOldParent->get<TCompParent>();
+            if(cOldParent)
+                cOldParent->delChild(hChild);
         }
-        idx++;
+    } else {
+        CHandle hChildParent;
+        hChildParent.create<TCompParent>();
+        eChild->set(hChildParent);
+        cChildParent = hChildParent;
+    }
+
+    cChildParent->parent = hEntity;
+    children.push_back(hChild);
+
+    TCompTransform* cTransform = get<TCompTransform>();
+    TCompTransform* cChildTransform = eChild->get<TCompTransform>();
+    if(cChildTransform)
+        cChildTransform->setParent(cTransform);
+}
+
+void TCompParent::delChild(CHandle hChild)
+{
+    auto it = std::find(children.begin(), children.end(), hChild);
+    if(it == children.end())
+        return;
+    children.erase(it);
+
+    // The child may be in the middle of its destruction.
+    CEntity* eChild = hChild;
+    if(!eChild)
+        return;
+    TCompParent* cChildParent = eChild->get<TCompParent>();
+    if(cChildParent)
+        cChildParent->parent = CHandle();
+    TCompTransform* cChildTransform = eChild->get<TCompTransform>();
+    if(cChildTransform)
+        cChildTransform->setParent(nullptr);
+}
+
+void TCompParent::load(const json& j, TEntityParseContext& ctx)
+{
+    if(j.count("children")) {
+        std::vector<std::string> names = j["children"];
+        childNames = names;
     }
-    TCompParent* parentComponent = &EntitySystem::Get()->getComponent<TCompParent>(ent);
-    parentComponent->parent = 0; */
+}
+
+void TCompParent::onEntityCreated()
+{
+    for(const auto& name : childNames) {
+        CHandle hChild = getEntityByName(name);
+        if(hChild.isValid())
+            addChild(hChild);
+        else
+            PWARN("TCompParent - child entity '%s' not found.", name.c_str());
+    }
+    childNames.clear();
 }
 
 void TCompParent::debugInMenu(){
+    CEntity* eParent = parent;
+    ImGui::Text("Parent: %s", eParent ? eParent->getName() : "<None>");
     if(ImGui::TreeNode("Children ... "))
     {
-        // TODO Rethink how to get all info from children ...
+        for(CHandle hChild : children) {
+            CEntity* eChild = hChild;
+            if(eChild)
+                ImGui::Text("%s", eChild->getName());
+        }
         ImGui::TreePop();
     }
-}
\ No newline at end of file
+}
@@ -1,14 +1,31 @@
 #pragma once
 
 #include "comp_base.h"
+#include "systems/entity/entity.h"
 
-using Entity = u32;
-
+/**
+ * Entity hierarchy. Both the parent and the children have this component.
+ * The transforms of the children are parented to the transform of the
+ * parent, so their position is relative to it.
+ */
 struct TCompParent : public TCompBase
 {
-    std::vector<Entity> children;
-    Entity parent;
-    void addChild(const Entity& parent, const Entity& ent);
-    void delChild(const Entity ent);
+    DECL_SIBILING_ACCESS();
+
+    VHandles children;  // Child entities.
+    CHandle parent;     // Parent entity.
+
+    TCompParent() = default;
+    TCompParent(TCompParent&& other) = default;
+    ~TCompParent();
+
+    void addChild(CHandle hChild);
+    void delChild(CHandle hChild);
+    void load(const json& j, TEntityParseContext& ctx);
+    void onEntityCreated();
     void debugInMenu();
-};
\ No newline at end of file
+
+private:
+    // Names from the json, resolved once all the entities exist.
+    std::vector<std::string> childNames;
+};
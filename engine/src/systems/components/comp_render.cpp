@@ -7,6 +7,7 @@ DECL_OBJ_MANAGER("render", TCompRender);
 
 TCompRender::~TCompRender()
 {
+    cleanFromRenderManager();
 }
 
 bool TCompRender::TDrawCall::load(const json& j)
@@ -42,26 +43,52 @@ void TCompRender::load(const json& j, TEntityParseContext& ctx)
     }
 }
 
-void TCompRender::updateRenderManager()
+void TCompRender::debugInMenu()
 {
-    cleanFromRenderManager();
+    for(u32 i = 0; i < drawCalls.size(); ++i)
+    {
+        bool active = drawCalls[i].active;
+        ImGui::PushID(i);
+        if(ImGui::Checkbox("Active", &active))
+            setDrawCallActive(i, active);
+        ImGui::PopID();
+    }
+}
 
+void TCompRender::updateRenderManager()
+{
     CHandle handle(this);
     for(auto& dc : drawCalls)
     {
-        if(dc.active == false)
+        // Keys already added are only toggled.
+        if(dc.key != INVALID_ID) {
+            CRenderManager::Get()->setKeyEnabled(dc.key, dc.active);
             continue;
-        
-        CRenderManager::Get()->addKey(
+        }
+
+        dc.key = CRenderManager::Get()->addKey(
             handle,
             dc.mesh,
-            dc.material
+            dc.material,
+            dc.active
         );
     }
 }
 
+void TCompRender::setDrawCallActive(u32 index, bool active)
+{
+    PASSERT(index < drawCalls.size())
+    TDrawCall& dc = drawCalls[index];
+    dc.active = active;
+    if(dc.key != INVALID_ID)
+        CRenderManager::Get()->setKeyEnabled(dc.key, active);
+}
+
 void TCompRender::cleanFromRenderManager()
 {
     CHandle handle(this);
-    CRenderManager::Get()->deleteKeysFromOwner(handle);
+    if(handle.isValid())
+        CRenderManager::Get()->deleteKeysFromOwner(handle);
+    for(auto& dc : drawCalls)
+        dc.key = INVALID_ID;
 }
\ No newline at end of file
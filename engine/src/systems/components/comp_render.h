@@ -11,7 +11,8 @@ struct TCompRender : public TCompBase
         Mesh* mesh;
         Material* material;
         u32 meshGroup;
-        bool active;
+        bool active = true;
+        u32 key = INVALID_ID;   // Key in the RenderManager, if added.
 
         /** Loads the information necessary to create a DrawCall for future rendering */
         bool load(const json& j);
@@ -19,7 +20,7 @@ struct TCompRender : public TCompBase
 
     ~TCompRender();
 
-    void debugInMenu() {};
+    void debugInMenu();
     void renderDebug() {};
     /** When the entity is created, update the RenderManager with its drawCalls. */
     void onEntityCreated();
@@ -29,6 +30,8 @@ struct TCompRender : public TCompBase
     /** Take information from the RenderComponent, clean them from the RenderManager if
      * previously loaded and update them. */
     void updateRenderManager();
+    /** Enables or disables a DrawCall in the RenderManager without rebuilding the others. */
+    void setDrawCallActive(u32 index, bool active);
 
 private:
     /** Pass this component as handle and clean its DrawCalls from the RenderManager. */
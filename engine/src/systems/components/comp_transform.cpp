@@ -4,28 +4,78 @@
 #include "comp_camera.h"
 #include "systems/entity/entityParser.h"
 #include "systems/entity/entity.h"
+#include "systems/transformSystem.h"
 
  DECL_OBJ_MANAGER("transform", TCompTransform);
 
+TCompTransform::TCompTransform(TCompTransform&& other)
+    : CTransform(other), TCompBase(other), node(other.node)
+{
+    other.node = INVALID_ID;
+}
+
+TCompTransform::~TCompTransform()
+{
+    if(node != INVALID_ID)
+        CTransformSystem::Get()->destroyNode(node);
+}
+
 void
 TCompTransform::load(const json& j, TEntityParseContext& ctx)
 {
     CTransform::fromJson(j);
-    //set(ctx.rootTransform.combinedWith(*this));
+    set(ctx.rootTransform.combinedWith(*this));
 }
 
 void TCompTransform::set(const CTransform& newT)
 {
     *(CTransform*)this = newT;
+    markDirty();
+}
+
+u32 TCompTransform::getNode()
+{
+    if(node == INVALID_ID) {
+        // Transforms stored by archetype have no handle and no node.
+        CHandle h(this);
+        if(h.isValid())
+            node = CTransformSystem::Get()->createNode(h);
+    }
+    return node;
+}
+
+void TCompTransform::markDirty()
+{
+    if(node != INVALID_ID)
+        CTransformSystem::Get()->markDirty(node);
+    else
+        getNode();
+}
+
+void TCompTransform::setParent(TCompTransform* parent)
+{
+    u32 id = getNode();
+    if(id == INVALID_ID)
+        return;
+    u32 parentId = parent ? parent->getNode() : INVALID_ID;
+    CTransformSystem::Get()->setParent(id, parentId);
+}
+
+glm::mat4 TCompTransform::getWorldMatrix() const
+{
+    if(node == INVALID_ID)
+        return asMatrix();
+    return CTransformSystem::Get()->getWorld(node);
 }
 
 void 
 TCompTransform::debugInMenu()
 {
-    CTransform::renderInMenu();
+    if(CTransform::renderInMenu())
+        markDirty();
 }
 
 void TCompTransform::renderDebug()
 {
 
-}
\ No newline at end of file
+}
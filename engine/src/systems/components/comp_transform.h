@@ -1,11 +1,43 @@
 #pragma once
 #include "comp_base.h"
 
+/**
+ * Transform of an entity, relative to the parent transform if it has one.
+ * The setters mark the node of the transform system so the world matrix
+ * is recomputed on the next update. Changing it through the CTransform
+ * base class is not noticed.
+ */
 class TCompTransform : public CTransform, public TCompBase
 {
+    u32 node = INVALID_ID;  // Node in the transform system, created on the first change.
+
+    void markDirty();
+
 public:
+    TCompTransform() = default;
+    TCompTransform(const TCompTransform& other) = delete;
+    TCompTransform(TCompTransform&& other);
+    ~TCompTransform();
+
     void debugInMenu();
     void renderDebug();
     void load(const json& j, TEntityParseContext& ctx);
     void set(const CTransform& newT);
-};
\ No newline at end of file
+
+    void setRotation(glm::quat newRotation) { CTransform::setRotation(newRotation); markDirty(); }
+    void setPosition(glm::vec3 newPos) { CTransform::setPosition(newPos); markDirty(); }
+    void setScale(glm::vec3 newScale) { CTransform::setScale(newScale); markDirty(); }
+    void setEulerAngles(f32 yaw, f32 pitch, f32 roll) { CTransform::setEulerAngles(yaw, pitch, roll); markDirty(); }
+    void lookAt(glm::vec3 eye, glm::vec3 target, glm::vec3 up) { CTransform::lookAt(eye, target, up); markDirty(); }
+    void fromMatrix(glm::mat4 matrix) { CTransform::fromMatrix(matrix); markDirty(); }
+
+    /** Node in the transform system, created if needed. INVALID_ID if not owned by the manager.*/
+    u32 getNode();
+
+    /** Parent transform, nullptr detaches it.*/
+    void setParent(TCompTransform* parent);
+
+    /** Local matrix combined with the parents, as of the last transform system update.*/
+    glm::mat4 getWorldMatrix() const;
+    glm::vec3 getWorldPosition() const { return glm::vec3(getWorldMatrix()[3]); }
+};
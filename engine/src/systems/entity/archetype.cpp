@@ -0,0 +1,296 @@
+#include "archetype.h"
+
+#include "memory/pmemory.h"
+#include "systems/entity/entityParser.h"
+#include "systems/components/comp_transform.h"
+#include "systems/components/comp_light_point.h"
+
+CArchetypeStorage::CArchetypeStorage()
+{
+    // Record 0 stays unused so a zeroed TArchetypeEntity is invalid.
+    records.resize(1);
+}
+
+CArchetypeStorage::~CArchetypeStorage()
+{
+    for(TArchetype* archetype : archetypes)
+    {
+        for(TArchetypeChunk& chunk : archetype->chunks)
+        {
+            for(u32 type : archetype->types) {
+                u8* column = archetype->columnOf(chunk, type);
+                for(u32 i = 0; i < chunk.count; ++i)
+                    components[type].destruct(column + components[type].size * i);
+            }
+            memFree(chunk.memory, chunkSize, MEMORY_TAG_ENTITY);
+        }
+        delete archetype;
+    }
+}
+
+CArchetypeStorage& CArchetypeStorage::get()
+{
+    static CArchetypeStorage storage;
+    return storage;
+}
+
+TArchetype* CArchetypeStorage::getOrCreateArchetype(const TComponentSignature& signature)
+{
+    auto it = archetypesBySignature.find(signature);
+    if(it != archetypesBySignature.end())
+        return it->second;
+
+    TArchetype* archetype = new TArchetype();
+    archetype->signature = signature;
+    u32 rowSize = sizeof(u32);
+    for(u32 type = 0; type < CHandle::maxTypes; ++type) {
+        if(!signature.test(type))
+            continue;
+        PASSERT_MSG(isRegistered(type), "Component type is not registered in the archetype storage.")
+        archetype->types.push_back(type);
+        rowSize += components[type].size;
+    }
+
+    // Fit as many rows as possible, each array aligned to its type.
+    u32 capacity = chunkSize / rowSize;
+    for(; capacity > 0; --capacity)
+    {
+        u32 offset = sizeof(u32) * capacity;
+        for(u32 type : archetype->types) {
+            const TArchetypeComponentInfo& info = components[type];
+            offset = (offset + info.alignment - 1) & ~(info.alignment - 1);
+            archetype->columnOffsets[type] = offset;
+            offset += info.size * capacity;
+        }
+        if(offset <= chunkSize)
+            break;
+    }
+    PASSERT_MSG(capacity > 0, "Archetype row does not fit in a chunk.")
+    archetype->chunkCapacity = capacity;
+
+    archetypes.push_back(archetype);
+    archetypesBySignature[signature] = archetype;
+    return archetype;
+}
+
+void CArchetypeStorage::allocateRow(TArchetype* archetype, u32 entityIndex)
+{
+    // Only the last chunk can have free rows.
+    if(archetype->chunks.empty() || archetype->chunks.back().count == archetype->chunkCapacity)
+    {
+        TArchetypeChunk chunk;
+        chunk.memory = (u8*)memAllocate(chunkSize, MEMORY_TAG_ENTITY);
+        chunk.count = 0;
+        archetype->chunks.push_back(chunk);
+    }
+
+    u32 chunkIndex = (u32)archetype->chunks.size() - 1;
+    TArchetypeChunk& chunk = archetype->chunks[chunkIndex];
+    u32 row = chunk.count++;
+    archetype->entitiesOf(chunk)[row] = entityIndex;
+
+    TEntityRecord& record = records[entityIndex];
+    record.archetype = archetype;
+    record.chunk = chunkIndex;
+    record.row = row;
+}
+
+void CArchetypeStorage::removeRow(TArchetype* archetype, u32 chunkIndex, u32 row, bool destroyComponents)
+{
+    TArchetypeChunk& chunk = archetype->chunks[chunkIndex];
+    TArchetypeChunk& lastChunk = archetype->chunks.back();
+    u32 lastRow = lastChunk.count - 1;
+
+    for(u32 type : archetype->types)
+    {
+        const TArchetypeComponentInfo& info = components[type];
+        u8* dst = archetype->columnOf(chunk, type) + info.size * row;
+        if(destroyComponents)
+            info.destruct(dst);
+        // Fill the hole with the last row to keep chunks dense.
+        if(&chunk != &lastChunk || row != lastRow)
+            info.move(archetype->columnOf(lastChunk, type) + info.size * lastRow, dst);
+    }
+
+    if(&chunk != &lastChunk || row != lastRow)
+    {
+        u32 movedEntity = archetype->entitiesOf(lastChunk)[lastRow];
+        archetype->entitiesOf(chunk)[row] = movedEntity;
+        records[movedEntity].chunk = chunkIndex;
+        records[movedEntity].row = row;
+    }
+
+    lastChunk.count--;
+    if(lastChunk.count == 0) {
+        memFree(lastChunk.memory, chunkSize, MEMORY_TAG_ENTITY);
+        archetype->chunks.pop_back();
+    }
+}
+
+TArchetypeEntity CArchetypeStorage::createEntity(const TComponentSignature& signature)
+{
+    u32 index = firstFreeRecord;
+    if(index != 0) {
+        firstFreeRecord = records[index].nextFree;
+    } else {
+        index = (u32)records.size();
+        records.emplace_back();
+    }
+
+    TArchetype* archetype = getOrCreateArchetype(signature);
+    allocateRow(archetype, index);
+
+    TEntityRecord& record = records[index];
+    TArchetypeChunk& chunk = archetype->chunks[record.chunk];
+    for(u32 type : archetype->types)
+        components[type].construct(archetype->columnOf(chunk, type) + components[type].size * record.row);
+
+    nEntities++;
+
+    TArchetypeEntity e;
+    e.index = index;
+    e.generation = record.generation;
+    return e;
+}
+
+void CArchetypeStorage::destroyEntity(TArchetypeEntity e)
+{
+    if(!isAlive(e))
+        return;
+
+    TEntityRecord& record = records[e.index];
+    removeRow(record.archetype, record.chunk, record.row, true);
+
+    record.archetype = nullptr;
+    record.generation++;
+    record.nextFree = firstFreeRecord;
+    firstFreeRecord = e.index;
+    nEntities--;
+}
+
+bool CArchetypeStorage::isAlive(TArchetypeEntity e) const
+{
+    return e.index != 0 && e.index < records.size()
+        && records[e.index].archetype
+        && records[e.index].generation == e.generation;
+}
+
+void* CArchetypeStorage::getComponent(TArchetypeEntity e, u32 type)
+{
+    if(!isAlive(e))
+        return nullptr;
+
+    const TEntityRecord& record = records[e.index];
+    if(!record.archetype->signature.test(type))
+        return nullptr;
+
+    const TArchetypeChunk& chunk = record.archetype->chunks[record.chunk];
+    return record.archetype->columnOf(chunk, type) + components[type].size * record.row;
+}
+
+void CArchetypeStorage::moveEntity(TArchetypeEntity e, const TComponentSignature& newSignature)
+{
+    TEntityRecord& record = records[e.index];
+    TArchetype* src = record.archetype;
+    TArchetype* dst = getOrCreateArchetype(newSignature);
+    u32 srcChunk = record.chunk;
+    u32 srcRow = record.row;
+
+    allocateRow(dst, e.index);
+    TArchetypeChunk& dstChunk = dst->chunks[records[e.index].chunk];
+    u32 dstRow = records[e.index].row;
+
+    for(u32 type : dst->types)
+    {
+        const TArchetypeComponentInfo& info = components[type];
+        u8* to = dst->columnOf(dstChunk, type) + info.size * dstRow;
+        if(src->signature.test(type))
+            info.move(src->columnOf(src->chunks[srcChunk], type) + info.size * srcRow, to);
+        else
+            info.construct(to);
+    }
+    for(u32 type : src->types)
+    {
+        if(!dst->signature.test(type))
+            components[type].destruct(src->columnOf(src->chunks[srcChunk], type) + components[type].size * srcRow);
+    }
+
+    // Components are already moved or destroyed, only fill the hole.
+    u32 dstChunkIndex = records[e.index].chunk;
+    removeRow(src, srcChunk, srcRow, false);
+    records[e.index].archetype = dst;
+    records[e.index].chunk = dstChunkIndex;
+    records[e.index].row = dstRow;
+}
+
+void CArchetypeStorage::addComponent(TArchetypeEntity e, u32 type)
+{
+    if(!isAlive(e))
+        return;
+    TComponentSignature signature = records[e.index].archetype->signature;
+    if(signature.test(type))
+        return;
+    signature.set(type);
+    moveEntity(e, signature);
+}
+
+void CArchetypeStorage::removeComponent(TArchetypeEntity e, u32 type)
+{
+    if(!isAlive(e))
+        return;
+    TComponentSignature signature = records[e.index].archetype->signature;
+    if(!signature.test(type))
+        return;
+    signature.reset(type);
+    moveEntity(e, signature);
+}
+
+TArchetypeEntity CArchetypeStorage::load(const json& j, TEntityParseContext& ctx)
+{
+    TComponentSignature signature;
+    for(const auto& it : j.items())
+    {
+        auto om = CHandleManager::getByName(it.key().c_str());
+        if(!om) {
+            PWARN("Uknown component with name '%s'.", it.key().c_str());
+            continue;
+        }
+        if(!isRegistered(om->getType())) {
+            PWARN("Component '%s' can not be stored in archetypes.", it.key().c_str());
+            continue;
+        }
+        signature.set(om->getType());
+    }
+
+    TArchetypeEntity e = createEntity(signature);
+    for(const auto& it : j.items())
+    {
+        auto om = CHandleManager::getByName(it.key().c_str());
+        if(!om || !signature.test(om->getType()))
+            continue;
+        components[om->getType()].load(getComponent(e, om->getType()), it.value(), ctx);
+    }
+    return e;
+}
+
+void CArchetypeStorage::debugInMenu()
+{
+    char buf[80];
+    snprintf(buf, sizeof(buf), "Archetypes [%u entities]###Archetypes", nEntities);
+    if(ImGui::TreeNode(buf))
+    {
+        for(TArchetype* archetype : archetypes)
+        {
+            u32 count = 0;
+            for(const TArchetypeChunk& chunk : archetype->chunks)
+                count += chunk.count;
+
+            std::string names;
+            for(u32 type : archetype->types)
+                names += std::string(CHandleManager::getByType(type)->getName()) + " ";
+            ImGui::Text("%s: %u entities in %u chunks of %u", names.c_str(), count,
+                (u32)archetype->chunks.size(), archetype->chunkCapacity);
+        }
+        ImGui::TreePop();
+    }
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include "systems/handle/handle.h"
+
+struct TEntityParseContext;
+
+/**
+ * Archetype storage.
+ * Optional alternative to the object managers for data only components.
+ * Entities with the same set of components share an archetype and are
+ * stored in 16KB chunks, with one array per component type inside each
+ * chunk. Queries walk those arrays linearly.
+ * Component types are the ones of the object managers and must be
+ * registered with registerComponent before use. Components stored here
+ * have no CHandle, so they must not use sibling access.
+ */
+
+// Identifies an entity of the archetype storage. All zeros is invalid.
+struct TArchetypeEntity
+{
+    u32 index = 0;
+    u32 generation = 0;
+
+    bool operator==(TArchetypeEntity other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(TArchetypeEntity other) const { return !(*this == other); }
+};
+
+struct TArchetypeComponentInfo
+{
+    u32 size = 0;
+    u32 alignment = 0;
+    void (*construct)(void* address) = nullptr;
+    void (*destruct)(void* address) = nullptr;
+    void (*move)(void* src, void* dst) = nullptr;
+    void (*load)(void* address, const json& j, TEntityParseContext& ctx) = nullptr;
+};
+
+struct TArchetypeChunk
+{
+    u8* memory = nullptr;
+    u32 count = 0;
+};
+
+struct TArchetype
+{
+    TComponentSignature signature;
+    std::vector<u32> types;
+    u32 columnOffsets[CHandle::maxTypes];   // Byte offset of each type array in a chunk.
+    u32 chunkCapacity = 0;                  // Entities per chunk.
+    std::vector<TArchetypeChunk> chunks;
+
+    // Entity indices of each row live at the start of the chunk.
+    u32* entitiesOf(const TArchetypeChunk& chunk) const { return (u32*)chunk.memory; }
+    u8* columnOf(const TArchetypeChunk& chunk, u32 type) const { return chunk.memory + columnOffsets[type]; }
+};
+
+// C++11 replacement of std::index_sequence used to expand query columns.
+template<u32... Is> struct TArchetypeIndices {};
+template<u32 N, u32... Is> struct TArchetypeMakeIndices : TArchetypeMakeIndices<N - 1, N - 1, Is...> {};
+template<u32... Is> struct TArchetypeMakeIndices<0, Is...> { typedef TArchetypeIndices<Is...> type; };
+
+class CArchetypeStorage
+{
+    static const u32 chunkSize = 16 * 1024;
+
+    struct TEntityRecord {
+        TArchetype* archetype = nullptr;
+        u32 chunk = 0;
+        u32 row = 0;
+        u32 generation = 1;
+        u32 nextFree = 0;
+    };
+
+    TArchetypeComponentInfo components[CHandle::maxTypes];
+    std::vector<TArchetype*> archetypes;
+    std::unordered_map<TComponentSignature, TArchetype*> archetypesBySignature;
+    std::vector<TEntityRecord> records;  // Index 0 is never used.
+    u32 firstFreeRecord = 0;
+    u32 nEntities = 0;
+
+    TArchetype* getOrCreateArchetype(const TComponentSignature& signature);
+    void allocateRow(TArchetype* archetype, u32 entityIndex);
+    void removeRow(TArchetype* archetype, u32 chunk, u32 row, bool destroyComponents);
+    void moveEntity(TArchetypeEntity e, const TComponentSignature& newSignature);
+
+    template<typename TFn, typename... TComps, u32... Is>
+    static void forEachInChunk(TFn& fn, u8** columns, u32 count, TArchetypeIndices<Is...>) {
+        for(u32 i = 0; i < count; ++i)
+            fn(reinterpret_cast<TComps*>(columns[Is])[i]...);
+    }
+
+public:
+    CArchetypeStorage();
+    ~CArchetypeStorage();
+
+    static CArchetypeStorage& get();
+
+    template<typename TComp>
+    void registerComponent() {
+        u32 type = getObjectManager<TComp>()->getType();
+        PASSERT_MSG(type != 0, "Register archetype components after the object managers are initialized.")
+        TArchetypeComponentInfo& info = components[type];
+        info.size = sizeof(TComp);
+        info.alignment = alignof(TComp);
+        info.construct = [](void* address) { new (address) TComp; };
+        info.destruct = [](void* address) { static_cast<TComp*>(address)->~TComp(); };
+        info.move = [](void* src, void* dst) {
+            new (dst) TComp(std::move(*static_cast<TComp*>(src)));
+            static_cast<TComp*>(src)->~TComp();
+        };
+        info.load = [](void* address, const json& j, TEntityParseContext& ctx) {
+            static_cast<TComp*>(address)->load(j, ctx);
+        };
+    }
+
+    bool isRegistered(u32 type) const { return type < CHandle::maxTypes && components[type].size > 0; }
+
+    template<typename TComp>
+    static u32 typeOf() { return getObjectManager<TComp>()->getType(); }
+
+    TArchetypeEntity createEntity(const TComponentSignature& signature);
+    void destroyEntity(TArchetypeEntity e);
+    bool isAlive(TArchetypeEntity e) const;
+    u32 size() const { return nEntities; }
+
+    void* getComponent(TArchetypeEntity e, u32 type);
+    void addComponent(TArchetypeEntity e, u32 type);
+    void removeComponent(TArchetypeEntity e, u32 type);
+
+    template<typename TComp>
+    TComp* get(TArchetypeEntity e) { return static_cast<TComp*>(getComponent(e, typeOf<TComp>())); }
+
+    template<typename TComp>
+    TComp* add(TArchetypeEntity e) {
+        addComponent(e, typeOf<TComp>());
+        return get<TComp>(e);
+    }
+
+    template<typename TComp>
+    void remove(TArchetypeEntity e) { removeComponent(e, typeOf<TComp>()); }
+
+    /**
+     * Calls fn(TComps&...) for every entity having all the given types.
+     */
+    template<typename... TComps, typename TFn>
+    void forEach(TFn fn) {
+        static_assert(sizeof...(TComps) > 0, "forEach needs at least one component type.");
+        const u32 nTypes = sizeof...(TComps);
+        u32 types[nTypes] = { typeOf<TComps>()... };
+        TComponentSignature query;
+        for(u32 t : types)
+            query.set(t);
+
+        u8* columns[nTypes];
+        for(TArchetype* archetype : archetypes)
+        {
+            if((archetype->signature & query) != query)
+                continue;
+            for(const TArchetypeChunk& chunk : archetype->chunks)
+            {
+                if(chunk.count == 0)
+                    continue;
+                for(u32 i = 0; i < nTypes; ++i)
+                    columns[i] = archetype->columnOf(chunk, types[i]);
+                forEachInChunk<TFn, TComps...>(fn, columns, chunk.count,
+                    typename TArchetypeMakeIndices<sizeof...(TComps)>::type());
+            }
+        }
+    }
+
+    /**
+     * Creates an entity from the same json used by CEntity::load.
+     * Components not registered in the storage are skipped.
+     */
+    TArchetypeEntity load(const json& j, TEntityParseContext& ctx);
+
+    void debugInMenu();
+};
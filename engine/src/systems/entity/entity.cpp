@@ -3,18 +3,61 @@
 
 DECL_OBJ_MANAGER("entity", CEntity);
 
+CEntity::CEntity(CEntity&& other)
+    : signature(other.signature)
+    , extraComps(other.extraComps)
+    , nComps(other.nComps)
+    , extraCapacity(other.extraCapacity)
+{
+    for(u32 i = 0; i < nInlineComps; ++i)
+        inlineComps[i] = other.inlineComps[i];
+    other.signature.reset();
+    other.extraComps = nullptr;
+    other.nComps = 0;
+    other.extraCapacity = 0;
+}
+
 CEntity::~CEntity() {
-    for(u32 i = 1; i < CHandleManager::getNumDefinedTypes(); ++i) {
-        CHandle h = comps[i];
-        if(comps[i].isValid())
-            comps[i].destroy();
+    for(u32 i = 0; i < nComps; ++i) {
+        CHandle h = compAt(i);
+        if(h.isValid())
+            h.destroy();
     }
+    if(extraComps)
+        memFree(extraComps, sizeof(CHandle) * extraCapacity, MEMORY_TAG_ENTITY);
 }
 
 void CEntity::set(u32 type, CHandle newComp) {
     PASSERT(type < CHandle::maxTypes)
-    PASSERT(!comps[type].isValid())
-    comps[type] = newComp;
+    PASSERT(!get(type).isValid())
+
+    // A stale handle of a destroyed component is replaced.
+    if(signature.test(type)) {
+        for(u32 i = 0; i < nComps; ++i) {
+            if(compAt(i).getType() == type) {
+                compAt(i) = newComp;
+                break;
+            }
+        }
+    } else {
+        if(nComps >= nInlineComps + extraCapacity) {
+            u16 newCapacity = (u16)(extraCapacity ? extraCapacity * 2 : nInlineComps);
+            CHandle* newExtra = (CHandle*)memAllocate(sizeof(CHandle) * newCapacity, MEMORY_TAG_ENTITY);
+            if(extraComps) {
+                memCopy(extraComps, newExtra, sizeof(CHandle) * extraCapacity);
+                memFree(extraComps, sizeof(CHandle) * extraCapacity, MEMORY_TAG_ENTITY);
+            }
+            extraComps = newExtra;
+            extraCapacity = newCapacity;
+        }
+
+        // Keep them sorted by type, like the order of the managers.
+        u32 i = nComps++;
+        for(; i > 0 && compAt(i - 1).getType() > type; --i)
+            compAt(i) = compAt(i - 1);
+        compAt(i) = newComp;
+        signature.set(type);
+    }
     newComp.setOwner(CHandle(this));
 }
 
@@ -30,15 +73,15 @@ const char* CEntity::getName() const {
 }
 
 void CEntity::onEntityCreated() {
-    for(u32 i = 0; i < CHandleManager::getNumDefinedTypes(); ++i) {
-        CHandle h = comps[i];
+    for(u32 i = 0; i < nComps; ++i) {
+        CHandle h = compAt(i);
         h.onEntityCreated();
     }
 }
 
 void CEntity::renderDebug() {
-    for(u32 i = 0; i < CHandleManager::getNumDefinedTypes(); ++i) {
-        CHandle h = comps[i];
+    for(u32 i = 0; i < nComps; ++i) {
+        CHandle h = compAt(i);
         if(h.isValid())
             h.renderDebug();
     }
@@ -49,9 +92,9 @@ void CEntity::debugInMenu()
     ImGui::PushID(this);
     if(ImGui::TreeNode(getName()))
     {
-        for(int i = 0; i < CHandle::maxTypes; ++i)
+        for(u32 i = 0; i < nComps; ++i)
         {
-            CHandle h = comps[i];
+            CHandle h = compAt(i);
             if(h.isValid())
             {
                 if(ImGui::TreeNode(h.getTypeName()))
@@ -85,7 +128,7 @@ void CEntity::load(const json& j, TEntityParseContext& ctx)
 
         u32 compType = om->getType();
 
-        CHandle component = comps[compType];
+        CHandle component = get(compType);
         if(component.isValid())
         {
             // Reconfigure the component from the json
@@ -95,6 +138,8 @@ void CEntity::load(const json& j, TEntityParseContext& ctx)
         {
             // Create a new fresh component and attach it to the entity
             component = om->createHandle();
+            if(!component.isValid())
+                continue;
             set(compType, component);
             component.load(compValue, ctx);
         }
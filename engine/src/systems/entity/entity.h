@@ -6,23 +6,64 @@ extern CHandle getEntityByName(const std::string& name);
 
 class CEntity : public TCompBase
 {
-    CHandle comps[CHandle::maxTypes];
+    // Most entities have a few components, they fit inline. The rest go
+    // to a heap array. Components are sorted by type.
+    static const u32 nInlineComps = 6;
+
+    TComponentSignature signature;
+    CHandle inlineComps[nInlineComps];
+    CHandle* extraComps = nullptr;
+    u16 nComps = 0;
+    u16 extraCapacity = 0;
+
+    CHandle& compAt(u32 i) {
+        return i < nInlineComps ? inlineComps[i] : extraComps[i - nInlineComps];
+    }
+    CHandle compAt(u32 i) const {
+        return i < nInlineComps ? inlineComps[i] : extraComps[i - nInlineComps];
+    }
 
 public:
+    CEntity() = default;
+    CEntity(const CEntity&) = delete;
+    CEntity(CEntity&& other);
     ~CEntity();
 
+    // A component destroyed on its own keeps its bit in the signature
+    // until it is replaced, so the handle is checked too.
+    bool has(u32 type) const {
+        return get(type).isValid();
+    }
+
+    template<typename TComp>
+    bool has() const {
+        auto om = getObjectManager<TComp>();
+        PASSERT(om)
+        return has(om->getType());
+    }
+
     CHandle get(u32 type) const {
         PASSERT(type < CHandle::maxTypes)
-        return comps[type];
+        if(!signature.test(type))
+            return CHandle();
+        for(u32 i = 0; i < nComps; ++i) {
+            CHandle h = compAt(i);
+            if(h.getType() == type)
+                return h;
+        }
+        return CHandle();
     }
 
     template<typename TComp>
     CHandle get() const {
         auto om = getObjectManager<TComp>();
         PASSERT(om)
-        return comps[om->getType()];
+        return get(om->getType());
     }
 
+    const TComponentSignature& getSignature() const { return signature; }
+    u32 getNumComponents() const { return nComps; }
+
     void debugInMenu();
     void renderDebug();
 
@@ -32,4 +73,4 @@ public:
     void onEntityCreated();
 
     const char* getName() const;
-};
\ No newline at end of file
+};
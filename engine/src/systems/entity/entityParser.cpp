@@ -1,5 +1,6 @@
 #include "entityParser.h"
 #include "systems/entity/entity.h"
+#include "systems/entity/archetype.h"
 
 TEntityParseContext::TEntityParseContext(TEntityParseContext& another, const CTransform& deltaTransform)
 {
@@ -38,11 +39,18 @@ bool parseScene(const std::string& filename, TEntityParseContext& ctx)
             // TODO Prefabs
             hentity.create<CEntity>();
             CEntity* entity = hentity;
+            if(!entity)
+                continue;
             entity->load(jentity, ctx);
             ctx.allEntitiesLoaded.push_back(hentity);
             ctx.entitiesLoaded.push_back(hentity);
         }
 
+        // Entities without handle, stored by archetype.
+        if(jitem.count("archetype_entity")) {
+            CArchetypeStorage::get().load(jitem["archetype_entity"], ctx);
+        }
+
         // TODO if multiple entities, do hierarchy
         if(ctx.entitiesLoaded.size() > 1)
         {
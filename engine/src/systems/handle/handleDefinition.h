@@ -1,6 +1,8 @@
 #pragma once
 #include "defines.h"
 
+#include <bitset>
+
 struct TEntityParseContext;
 
 class CHandleManager;
@@ -11,12 +13,23 @@ class CObjectManager;
 template<typename TObj>
 CObjectManager<TObj>* getObjectManager();
 
+// Handles take 32 bits by default, with room for 64K objects per manager
+// and 512 ages per slot. Define HANDLE_64_BITS to use 64 bit handles with
+// room for 32M objects.
+#ifdef HANDLE_64_BITS
+typedef u64 THandleBits;
+#define HANDLE_INDEX_BITS 25
+#else
+typedef u32 THandleBits;
+#define HANDLE_INDEX_BITS 16
+#endif
+
 class CHandle {
 public:
 
     static const u32 nBitsType  = 7;
-    static const u32 nBitsIndex = 14;
-    static const u32 nBitsAge   = 32 - nBitsIndex - nBitsType;
+    static const u32 nBitsIndex = HANDLE_INDEX_BITS;
+    static const u32 nBitsAge   = sizeof(THandleBits) * 8 - nBitsIndex - nBitsType;
     static const u32 maxTypes   = 1 << nBitsType;
 
     // Empty constructor. All zeros is an invalid handle.
@@ -33,9 +46,9 @@ public:
     }
 
     // Read-only getters.
-    u32 getType()               const { return type; }
-    u32 getIndex()              const { return index; }
-    u32 getAge()                const { return age; }
+    u32 getType()               const { return (u32)type; }
+    u32 getIndex()              const { return (u32)index; }
+    u32 getAge()                const { return (u32)age; }
     const char* getTypeName()   const;
 
     bool isValid() const;
@@ -98,8 +111,14 @@ public:
     void onEntityCreated();
 
 private:
-    // Save n bits per each member. CHandle should only take 32 bits.
-    u32 type : nBitsType;
-    u32 index : nBitsIndex;
-    u32 age : nBitsAge;
-};
\ No newline at end of file
+    // Save n bits per each member. CHandle takes the size of THandleBits.
+    THandleBits type : nBitsType;
+    THandleBits index : nBitsIndex;
+    THandleBits age : nBitsAge;
+};
+
+STATIC_ASSERT(sizeof(CHandle) == sizeof(THandleBits), "Expected CHandle to be packed in THandleBits.");
+STATIC_ASSERT(CHandle::nBitsAge <= 32, "Handle age must fit in 32 bits.");
+
+// One bit per component type.
+using TComponentSignature = std::bitset<CHandle::maxTypes>;
\ No newline at end of file
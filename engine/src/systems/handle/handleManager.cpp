@@ -1,5 +1,9 @@
 #include "handleManager.h"
 
+#include "systems/jobSystem.h"
+
+#include <algorithm>
+
 // Zero is predefined as invalid component
 u32                                     CHandleManager::nextTypeOfHandleManager = 1;
 CHandleManager*                         CHandleManager::allManagers[CHandle::maxTypes];
@@ -8,6 +12,8 @@ std::map<std::string, CHandleManager*>  CHandleManager::allManagersByName;
 CHandleManager* CHandleManager::predefinedManagers[CHandle::maxTypes];
 u32             CHandleManager::nPredefinedManagers = 0;
 bool            CHandleManager::anyHandleDestroyed = false;
+bool            CHandleManager::deferDestroys = false;
+std::vector<std::vector<CHandle>> CHandleManager::threadDestroys;
 
 void CHandleManager::destroyAllPendingObjects() {
     if(!anyHandleDestroyed)
@@ -23,6 +29,96 @@ void CHandleManager::destroyAllPendingObjects() {
     anyHandleDestroyed = false;
 }
 
+void CHandleManager::beginParallelUpdate() {
+    PASSERT(!deferDestroys)
+    if(threadDestroys.size() < jobSystemThreadCount())
+        threadDestroys.resize(jobSystemThreadCount());
+    deferDestroys = true;
+}
+
+void CHandleManager::endParallelUpdate() {
+    PASSERT(deferDestroys)
+    deferDestroys = false;
+    // Sync point, all threads are done. Apply requests in thread order.
+    for(auto& destroys : threadDestroys) {
+        for(auto h : destroys) {
+            auto hm = getByType(h.getType());
+            if(hm)
+                hm->destroyHandle(h);
+        }
+        destroys.clear();
+    }
+}
+
+void CHandleManager::buildUpdateStages(const std::vector<CHandleManager*>& managers,
+    std::vector<std::vector<CHandleManager*>>& outStages)
+{
+    // Each manager goes to the stage after the last one it conflicts
+    // with, so the order of the update list is kept for dependent managers.
+    outStages.clear();
+    for(auto om : managers)
+    {
+        size_t stageIndex = 0;
+        for(size_t i = outStages.size(); i > 0; --i)
+        {
+            bool conflict = false;
+            for(auto other : outStages[i - 1]) {
+                if(om->conflictsWith(other)) {
+                    conflict = true;
+                    break;
+                }
+            }
+            if(conflict) {
+                stageIndex = i;
+                break;
+            }
+        }
+
+        if(stageIndex == outStages.size())
+            outStages.emplace_back();
+        outStages[stageIndex].push_back(om);
+    }
+}
+
+struct TManagerUpdateJob
+{
+    CHandleManager* om;
+    f32 dt;
+};
+
+void CHandleManager::updateStage(const std::vector<CHandleManager*>& stage, f32 dt)
+{
+    beginParallelUpdate();
+
+    if(stage.size() == 1) {
+        stage[0]->updateAllParallel(dt);
+    }
+    else {
+        std::vector<TManagerUpdateJob> data(stage.size());
+        std::vector<Job> jobs(stage.size());
+        for(size_t i = 0; i < stage.size(); ++i)
+        {
+            data[i].om = stage[i];
+            data[i].dt = dt;
+            jobs[i].function = [](void* jobData, u32, u32) {
+                TManagerUpdateJob* job = static_cast<TManagerUpdateJob*>(jobData);
+                job->om->updateAllParallel(job->dt);
+            };
+            jobs[i].data = &data[i];
+            jobs[i].begin = 0;
+            jobs[i].end = 0;
+            jobs[i].counter = nullptr;
+        }
+
+        JobCounter counter;
+        counter.value.store(0);
+        jobSystemRun(jobs.data(), (u32)jobs.size(), &counter);
+        jobSystemWait(&counter);
+    }
+
+    endParallelUpdate();
+}
+
 u32 CHandleManager::getNumDefinedTypes() {
     return nextTypeOfHandleManager;
 }
@@ -38,14 +134,60 @@ CHandleManager* CHandleManager::getByName(const char* name) {
     return it->second;
 }
 
+/**
+ * Adds the next page of objects, the last one is cut to what handles can
+ * address. Returns false when the manager is already at that size.
+ */
+bool CHandleManager::grow()
+{
+    const u32 oldCapacity = capacity();
+    if(nPages >= maxPages || oldCapacity >= maxTotalObjectsAllowed)
+        return false;
+
+    u32 count = pageSize(nPages);
+    if(count > maxTotalObjectsAllowed - oldCapacity)
+        count = maxTotalObjectsAllowed - oldCapacity;
+
+    allocatePage(nPages, count);
+    nPages++;
+
+    const u32 newCapacity = oldCapacity + count;
+    externalToInternal.resize(newCapacity);
+    internalToExternal.resize(newCapacity);
+
+    // Chain the new external indices at the end of the free list.
+    for(u32 i = oldCapacity; i < newCapacity; ++i) {
+        auto& ed = externalToInternal[i];
+        ed.currentAge = 1;
+        ed.internalIndex = invalidIndex;
+        ed.nextExternalIndex = (i + 1 < newCapacity) ? i + 1 : invalidIndex;
+        internalToExternal[i] = invalidIndex;
+    }
+
+    if(lastFreeHandleExternalIndex == invalidIndex)
+        nextFreeHandleExternalIndex = oldCapacity;
+    else
+        externalToInternal[lastFreeHandleExternalIndex].nextExternalIndex = oldCapacity;
+    lastFreeHandleExternalIndex = newCapacity - 1;
+
+    if(nPages > 1)
+        PDEBUG("Handle manager '%s' grown to %u objects.", getName(), newCapacity);
+    return true;
+}
+
 CHandle CHandleManager::createHandle() {
 
     PASSERT(type != 0)
+    // Pages and free lists are not synchronized, only destroys are deferred.
+    PASSERT_MSG(!deferDestroys, "Objects can't be created while updating in parallel.")
 
-    const u32 nObjectsCapacity = capacity();
+    if(nextFreeHandleExternalIndex == invalidIndex && !grow()) {
+        PERROR("Handle manager '%s' is full with %u objects. Consider HANDLE_64_BITS.", getName(), capacity());
+        return CHandle();
+    }
 
     PASSERT(nextFreeHandleExternalIndex != invalidIndex)
-    PASSERT(nObjectsUsed < nObjectsCapacity)
+    PASSERT(nObjectsUsed < capacity())
     u32 externalIndex = nextFreeHandleExternalIndex;
     auto& ed = externalToInternal[externalIndex];
 
@@ -62,7 +204,8 @@ CHandle CHandleManager::createHandle() {
 
     // Update where is the next free for the next time we create another obj.
     nextFreeHandleExternalIndex = ed.nextExternalIndex;
-    PASSERT_MSG(nextFreeHandleExternalIndex != invalidIndex, "We run out of objects.")
+    if(nextFreeHandleExternalIndex == invalidIndex)
+        lastFreeHandleExternalIndex = invalidIndex;
 
     ed.nextExternalIndex = invalidIndex;
 
@@ -74,6 +217,11 @@ void CHandleManager::destroyHandle(CHandle h)
     if(!isValid(h))
         return;
 
+    if(deferDestroys) {
+        threadDestroys[jobSystemThreadIndex()].push_back(h);
+        return;
+    }
+
     anyHandleDestroyed = true;
 
     // Set to vector for objects pending to be destroyed.
@@ -102,13 +250,22 @@ bool CHandleManager::destroyPendingObjects()
 
         ed.currentAge++;
 
-        PASSERT(lastFreeHandleExternalIndex != invalidIndex)
-        auto& lastFreeEd = externalToInternal[lastFreeHandleExternalIndex];
-        PASSERT(lastFreeEd.nextExternalIndex == invalidIndex)
-
-        lastFreeHandleExternalIndex = externalIndex;
+        if(ed.currentOwner != CHandle()) {
+            unlinkOwner(ed.currentOwner);
+            ed.currentOwner = CHandle();
+        }
 
+        // Append the external index to the free list so it can be reused.
         PASSERT(ed.nextExternalIndex == invalidIndex);
+        if(lastFreeHandleExternalIndex == invalidIndex) {
+            nextFreeHandleExternalIndex = externalIndex;
+        } else {
+            auto& lastFreeEd = externalToInternal[lastFreeHandleExternalIndex];
+            PASSERT(lastFreeEd.nextExternalIndex == invalidIndex)
+            lastFreeEd.nextExternalIndex = externalIndex;
+        }
+        lastFreeHandleExternalIndex = externalIndex;
+        ed.internalIndex = invalidIndex;
 
         u32 internalIndexOfLastValidObject = nObjectsUsed - 1;
         if(internalIndex < internalIndexOfLastValidObject) {
@@ -131,11 +288,92 @@ bool CHandleManager::destroyPendingObjects()
     return somethingDeleted;
 }
 
+void CHandleManager::updateAllParallel(f32 dt)
+{
+    if(parallelGrain == 0 || nObjectsUsed <= parallelGrain) {
+        updateAll(dt);
+        return;
+    }
+
+    parallelFor(0, nObjectsUsed, parallelGrain, [this, dt](u32 begin, u32 end) {
+        updateRange(dt, begin, end);
+    });
+}
+
+void CHandleManager::setAccess(const std::vector<u32>& reads, const std::vector<u32>& writes)
+{
+    readTypes = reads;
+    writeTypes = writes;
+    // The manager always writes its own components.
+    if(std::find(writeTypes.begin(), writeTypes.end(), type) == writeTypes.end())
+        writeTypes.push_back(type);
+    accessDeclared = true;
+}
+
+bool CHandleManager::conflictsWith(const CHandleManager* other) const
+{
+    if(!accessDeclared || !other->accessDeclared)
+        return true;
+
+    auto contains = [](const std::vector<u32>& types, u32 t) {
+        return std::find(types.begin(), types.end(), t) != types.end();
+    };
+
+    for(u32 t : writeTypes) {
+        if(contains(other->writeTypes, t) || contains(other->readTypes, t))
+            return true;
+    }
+    for(u32 t : other->writeTypes) {
+        if(contains(readTypes, t))
+            return true;
+    }
+    return false;
+}
+
 void CHandleManager::setOwner(CHandle who, CHandle newOwner)
 {
     PASSERT(who.isValid())
     auto& ed = externalToInternal[who.getIndex()];
+    if(ed.currentOwner != CHandle())
+        unlinkOwner(ed.currentOwner);
     ed.currentOwner = newOwner;
+    if(newOwner != CHandle())
+        linkOwner(newOwner, who);
+}
+
+void CHandleManager::linkOwner(CHandle owner, CHandle who)
+{
+    PASSERT_MSG(!deferDestroys, "Owners can't be linked while updating in parallel.")
+    u32 i = owner.getIndex();
+    if(i >= ownerToDense.size())
+        ownerToDense.resize(i + 1, (u32)invalidIndex);
+
+    // An owner has at most one component of each type.
+    PASSERT(getComponentOf(owner) == CHandle())
+    ownerToDense[i] = (u32)denseOwners.size();
+    denseOwners.push_back(owner);
+    denseComponents.push_back(who);
+}
+
+void CHandleManager::unlinkOwner(CHandle owner)
+{
+    u32 i = owner.getIndex();
+    if(i >= ownerToDense.size() || ownerToDense[i] == invalidIndex)
+        return;
+    u32 dense = ownerToDense[i];
+    if(denseOwners[dense] != owner)
+        return;
+
+    // Fill the hole with the last one.
+    u32 last = (u32)denseOwners.size() - 1;
+    if(dense != last) {
+        denseOwners[dense] = denseOwners[last];
+        denseComponents[dense] = denseComponents[last];
+        ownerToDense[denseOwners[dense].getIndex()] = dense;
+    }
+    denseOwners.pop_back();
+    denseComponents.pop_back();
+    ownerToDense[i] = invalidIndex;
 }
 
 CHandle CHandleManager::getOwner(CHandle who) {
@@ -5,6 +5,21 @@
 #include "core/logger.h"
 #include "core/assert.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the highest set bit. Value must not be zero.
+inline u32 handleHighestBit(u32 value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return (u32)index;
+#else
+    return 31 - (u32)__builtin_clz(value);
+#endif
+}
+
 class CHandleManager {
 
     static const u32 maxTotalObjectsAllowed = 1 << CHandle::nBitsIndex;
@@ -25,6 +40,17 @@ class CHandleManager {
 
 protected:
 
+    // Objects live in pages that never move once allocated. Page k holds
+    // firstPageSize << k objects, so the page of an internal index is
+    // found in O(1) and a manager needs few pages to grow a lot.
+    static const u32 maxPages = 32;
+    u32 firstPageSize = 0;
+    u32 nPages = 0;
+
+    u32 pageBase(u32 page) const { return firstPageSize * ((1u << page) - 1); }
+    u32 pageSize(u32 page) const { return firstPageSize << page; }
+    u32 pageOf(u32 internalIndex) const { return handleHighestBit(internalIndex / firstPageSize + 1); }
+
     u32 type;
     std::vector<ExternalData> externalToInternal;
     std::vector<u32> internalToExternal;
@@ -32,10 +58,32 @@ protected:
     u32 nextFreeHandleExternalIndex;
     u32 lastFreeHandleExternalIndex;
 
+    // Sparse set from owner to component, indexed by the external index
+    // of the owner, entities in practice. Dense arrays stay packed.
+    std::vector<u32> ownerToDense;
+    std::vector<CHandle> denseOwners;
+    std::vector<CHandle> denseComponents;
+
+    void linkOwner(CHandle owner, CHandle who);
+    void unlinkOwner(CHandle owner);
+
     // Handles to be destroyed in a safe moment.
     std::vector<CHandle> objToDestroy;
     const char* name = nullptr;
 
+    // Component types read and written by updateAll, used to schedule
+    // managers concurrently. Undeclared managers run alone.
+    std::vector<u32> readTypes;
+    std::vector<u32> writeTypes;
+    bool accessDeclared = false;
+    // If not zero, updateAll is split in ranges of this size across threads.
+    // Opt-in from parallel_update in components.json.
+    u32 parallelGrain = 0;
+
+    // Destroy requests done while updating in parallel, one list per thread.
+    static bool                                     deferDestroys;
+    static std::vector<std::vector<CHandle>>        threadDestroys;
+
     // Shared by all managers.
     static u32                                      nextTypeOfHandleManager;
     // Handle array of type manager to easily access any manager.
@@ -51,6 +99,10 @@ protected:
     virtual void debugInMenuObj(u32 internal_idx) = 0;
     virtual void renderDebugObj(u32 internal_idx) = 0;
     virtual void onEntityCreatedObj(u32 internal_idx) = 0;
+    virtual void updateRange(f32 dt, u32 begin, u32 end) = 0;
+    virtual void allocatePage(u32 page, u32 count) = 0;
+
+    bool grow();
 
 public:
 
@@ -71,25 +123,18 @@ public:
         allManagersByName[getName()] = this;
 
         nObjectsUsed = 0;
-        u32 nObjectsCapacity = maxObjects;
-
-        externalToInternal.resize(nObjectsCapacity);
-        internalToExternal.resize(nObjectsCapacity);
-
-        u32 i = 0;
-        for (auto& ed : externalToInternal){
-            ed.currentAge = 1;
-            ed.internalIndex = invalidIndex;
-            if(i != nObjectsCapacity - 1)
-                ed.nextExternalIndex = i + 1;
-            else 
-                ed.nextExternalIndex = invalidIndex;
-            internalToExternal[i] = invalidIndex;
-            ++i;
-        }
-
-        nextFreeHandleExternalIndex = 0;
-        lastFreeHandleExternalIndex = nObjectsCapacity - 1;
+        firstPageSize = maxObjects;
+        nPages = 0;
+        externalToInternal.clear();
+        internalToExternal.clear();
+        ownerToDense.clear();
+        denseOwners.clear();
+        denseComponents.clear();
+        nextFreeHandleExternalIndex = invalidIndex;
+        lastFreeHandleExternalIndex = invalidIndex;
+
+        // First page, more are added when it runs out of objects.
+        grow();
     }
 
     bool isValid(CHandle h) const {
@@ -103,9 +148,12 @@ public:
     u32 getType() const { return type; }
     u32 size() const { return nObjectsUsed; }
     u32 capacity() const { return (u32)externalToInternal.size(); }
+    // Objects a manager can hold, what the index bits of a handle address.
+    static u32 maxCapacity() { return maxTotalObjectsAllowed; }
 
     bool destroyPendingObjects();
 
+    // Invalid handle when the manager is full.
     CHandle createHandle();
     void destroyHandle(CHandle h);
     void debugInMenu(CHandle h);
@@ -115,15 +163,40 @@ public:
 
     // Methods applying to all objects
     virtual void updateAll(f32 dt) = 0;
+    void updateAllParallel(f32 dt);
     virtual void renderDebugAll() = 0;
     virtual void debugInMenuAll() = 0;
 
+    void setAccess(const std::vector<u32>& reads, const std::vector<u32>& writes);
+    void setParallelGrain(u32 grain) { parallelGrain = grain; }
+    u32 getParallelGrain() const { return parallelGrain; }
+    bool conflictsWith(const CHandleManager* other) const;
+
     void setOwner(CHandle who, CHandle newOwner);
     CHandle getOwner(CHandle who);
+    // Component of this manager owned by owner, in O(1).
+    CHandle getComponentOf(CHandle owner) const {
+        u32 i = owner.getIndex();
+        if(i >= ownerToDense.size() || ownerToDense[i] == invalidIndex)
+            return CHandle();
+        u32 dense = ownerToDense[i];
+        return denseOwners[dense] == owner ? denseComponents[dense] : CHandle();
+    }
 
     static CHandleManager* getByType(u32 type);
     static CHandleManager* getByName(const char* name);
     static u32 getNumDefinedTypes();
     static void destroyAllPendingObjects();
+    // Between these calls destroy requests are kept per thread and
+    // applied when the parallel update ends.
+    static void beginParallelUpdate();
+    static void endParallelUpdate();
+    // Groups managers in stages, a manager goes after the last one it
+    // conflicts with. Managers of the same stage touch different components.
+    static void buildUpdateStages(const std::vector<CHandleManager*>& managers,
+        std::vector<std::vector<CHandleManager*>>& outStages);
+    // Updates the managers of a stage concurrently, each one split by its
+    // parallel grain. Creating objects or owners during it asserts.
+    static void updateStage(const std::vector<CHandleManager*>& stage, f32 dt);
     void dumpInternals() const;
 };
\ No newline at end of file
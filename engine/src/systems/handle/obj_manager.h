@@ -1,75 +1,106 @@
 #pragma once
 #include "handleManager.h"
 #include "defines.h"
+#include "memory/pmemory.h"
 
 struct TEntityParseContext;
 
 template<class TObj>
 class CObjectManager : public CHandleManager
 {
-    std::vector<u8> allocatedMemory;
+    TObj* pages[maxPages] = {};
+    u32 pageCounts[maxPages] = {};
 
-    TObj* objs = nullptr;
+    void allocatePage(u32 page, u32 count) override {
+        PASSERT(page < maxPages && !pages[page])
+        pages[page] = static_cast<TObj*>(memAllocate(sizeof(TObj) * count, MEMORY_TAG_MANAGER));
+        pageCounts[page] = count;
+    }
+
+    TObj* objAt(u32 internalIndex) const {
+        if(internalIndex < firstPageSize)
+            return pages[0] + internalIndex;
+        u32 page = pageOf(internalIndex);
+        return pages[page] + (internalIndex - pageBase(page));
+    }
+
+    // Calls fn for the objects in [begin, end) walking page by page.
+    template<typename TFn>
+    void forEachInRange(u32 begin, u32 end, TFn fn) {
+        while(begin < end) {
+            u32 page = pageOf(begin);
+            u32 base = pageBase(page);
+            u32 pageEnd = base + pageSize(page) < end ? base + pageSize(page) : end;
+            TObj* obj = pages[page] + (begin - base);
+            for(; begin < pageEnd; ++begin, ++obj)
+                fn(obj, begin);
+        }
+    }
 
     void createObj(u32 internalIndex) override {
-        TObj* address = objs + internalIndex;
+        TObj* address = objAt(internalIndex);
         new (address) TObj;
     }
 
     void destroyObj(u32 internalIndex) override {
-        TObj* address = objs + internalIndex;
+        TObj* address = objAt(internalIndex);
         address->~TObj();
     }
 
     void moveObj(u32 srcInternalIndex, u32 dstInternalIndex) override {
-        TObj* src = objs + srcInternalIndex;
-        TObj* dst = objs + dstInternalIndex;
+        TObj* src = objAt(srcInternalIndex);
+        TObj* dst = objAt(dstInternalIndex);
         new(dst)TObj(std::move(*src));
     }
 
     void debugInMenuObj(u32 internalIndex) override {
-        TObj* address = objs + internalIndex;
+        TObj* address = objAt(internalIndex);
         address->debugInMenu();
     }
 
     void renderDebugObj(u32 internalIndex) override {
-        TObj* address = objs + internalIndex;
+        TObj* address = objAt(internalIndex);
         address->renderDebug();
     }
 
     void onEntityCreatedObj(u32 internalIndex) override {
-        TObj* address = objs + internalIndex;
+        TObj* address = objAt(internalIndex);
         address->onEntityCreated();
     }
 
     void loadObj(u32 internalIndex, const json& j, TEntityParseContext& ctx) override {
-        TObj* address = objs + internalIndex;
+        TObj* address = objAt(internalIndex);
         address->load(j, ctx);
     }
 
 public:
     CObjectManager(const CObjectManager&) = delete;
-    CObjectManager(const char* newName) : objs(nullptr) 
+    CObjectManager(const char* newName)
     {
         name = newName;
         CHandleManager::predefinedManagers[CHandleManager::nPredefinedManagers] = this;
         CHandleManager::nPredefinedManagers++;
     }
 
-    void init(u32 maxObjects) override 
+    ~CObjectManager()
     {
-        CHandleManager::init(maxObjects);
-        allocatedMemory.resize(maxObjects * sizeof(TObj));
-        objs = static_cast<TObj*>((void*)allocatedMemory.data());
+        for(u32 i = 0; i < nPages; ++i)
+            memFree(pages[i], sizeof(TObj) * pageCounts[i], MEMORY_TAG_MANAGER);
     }
 
     CHandle getHandleFromAddress(TObj* address) {
-        auto internalIndex = address - objs;
-        if(internalIndex >= nObjectsUsed || internalIndex < 0)
-            return CHandle();
-        auto externalIndex = internalToExternal[internalIndex];
-        auto& ed = externalToInternal[externalIndex];
-        return CHandle(type, externalIndex, ed.currentAge);
+        // Few pages, each one twice the previous, so the scan is short.
+        for(u32 page = 0; page < nPages; ++page) {
+            if(address < pages[page] || address >= pages[page] + pageCounts[page])
+                continue;
+            u32 internalIndex = pageBase(page) + (u32)(address - pages[page]);
+            if(internalIndex >= nObjectsUsed)
+                return CHandle();
+            auto externalIndex = internalToExternal[internalIndex];
+            auto& ed = externalToInternal[externalIndex];
+            return CHandle(type, externalIndex, ed.currentAge);
+        }
+        return CHandle();
     }
 
     TObj* getAddressFromHandle(CHandle h) 
@@ -87,57 +118,65 @@ public:
         if(ed.currentAge != h.getAge())
             return nullptr;
         
-        return objs + ed.internalIndex;
+        return objAt(ed.internalIndex);
+    }
+
+    void updateRange(f32 dt, u32 begin, u32 end) override {
+        forEachInRange(begin, end, [dt](TObj* obj, u32) {
+            obj->update(dt);
+        });
     }
 
     void updateAll(f32 dt) override {
-        PASSERT(objs);
+        PASSERT(nPages > 0);
 
         if(!nObjectsUsed)
             return;
 
-        for(u32 i = 0; i < nObjectsUsed; ++i) {
-            objs[i].update(dt);
-        }
+        updateRange(dt, 0, nObjectsUsed);
     }
 
     void renderDebugAll() override {
-        PASSERT(objs)
-        for(u32 i = 0; i < nObjectsUsed; ++i) {
-            objs[i].renderDebug();
-        }
+        PASSERT(nPages > 0)
+        forEachInRange(0, nObjectsUsed, [](TObj* obj, u32) {
+            obj->renderDebug();
+        });
     }
 
     template<typename TFn>
     void forEach(TFn fn) {
-        PASSERT(objs)
-        for(u32 i = 0; i < nObjectsUsed; ++i) {
-            fn(objs + i);
-        }
+        PASSERT(nPages > 0)
+        forEachInRange(0, nObjectsUsed, [&fn](TObj* obj, u32) {
+            fn(obj);
+        });
     }
 
     template<typename TFn>
     void forEachWithExternalIndex(TFn fn) {
-        PASSERT(objs)
-        for(u32 i = 0; i < nObjectsUsed; ++i) {
-            fn(objs + i, internalToExternal[i]);
-        }
+        PASSERT(nPages > 0)
+        forEachInRange(0, nObjectsUsed, [this, &fn](TObj* obj, u32 i) {
+            fn(obj, internalToExternal[i]);
+        });
     }
 
-    TObj* getAddress() {return objs;}
+    // Objects are not contiguous, use this instead of indexing a base address.
+    TObj* getAddressAt(u32 internalIndex) {
+        PASSERT(internalIndex < nObjectsUsed)
+        return objAt(internalIndex);
+    }
 
     void debugInMenuAll() {
-        PASSERT(objs)
+        PASSERT(nPages > 0)
 
         char buf[80];
-        sprintf_s(buf, "%s [%d/%d (%dKb)]###OM%d", getName(), (int)size(), (int)capacity(), (int)(allocatedMemory.size() >> 10), getType());
+        sprintf_s(buf, "%s [%d/%d (%dKb)]###OM%d", getName(), (int)size(), (int)capacity(), (int)((capacity() * sizeof(TObj)) >> 10), getType());
         if (ImGui::TreeNode(buf)) {
-        for (uint32_t i = 0; i < nObjectsUsed; ++i) {
+        forEachInRange(0, nObjectsUsed, [](TObj* obj, u32 i) {
             ImGui::PushID(i);
-            objs[i].debugInMenu();
+            obj->debugInMenu();
             ImGui::PopID();
             ImGui::Separator();
-        }
+        });
         ImGui::TreePop();
         }
         // Report usage information about the object type ...
@@ -0,0 +1,391 @@
+#include "jobSystem.h"
+
+#include "core/logger.h"
+#include "core/assert.h"
+#include "memory/pmemory.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#define JOB_SYSTEM_DEFAULT_JOBS_PER_THREAD 4096
+
+/**
+ * Chase-Lev deque over a fixed ring of jobs.
+ * The owner works on the bottom, thieves on the top. A thief copies
+ * the job before claiming it with a CAS on top. The owner only reuses
+ * a slot once top has moved past it, so a claimed copy is never torn.
+ */
+struct JobQueue
+{
+    std::atomic<i64> top;
+    u8 topPadding[64 - sizeof(std::atomic<i64>)];
+    std::atomic<i64> bottom;
+    u8 bottomPadding[64 - sizeof(std::atomic<i64>)];
+    Job* jobs;
+    i64 mask;
+};
+
+/**
+ * Jobs submitted from threads outside the job system. They have no deque
+ * of their own and may not push on the owner end of another one, so they
+ * go to a ring behind a mutex that every thread checks before stealing.
+ */
+struct JobInjectionQueue
+{
+    std::mutex mutex;
+    Job* jobs;
+    u32 capacity;
+    u32 head;
+    std::atomic<u32> count;
+};
+
+typedef struct JobSystemState
+{
+    JobSystemConfig config;
+    u32 threadCount;        // Workers plus main thread.
+    JobQueue* queues;       // One per thread.
+    JobInjectionQueue injected; // Jobs of threads outside the job system.
+    std::thread* workers;   // threadCount - 1 workers.
+
+    std::atomic<bool> running;
+    std::atomic<u32> activeThreads; // Workers with a higher index sleep.
+    std::atomic<i64> queued; // Jobs pushed and not taken yet.
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+} JobSystemState;
+
+static JobSystemState* pState;
+// INVALID_ID on threads that are not the main thread or a worker.
+static thread_local u32 threadIndex = INVALID_ID;
+static thread_local u32 stealSeed = 0x9E3779B9;
+
+static u32 resolveWorkerCount(JobSystemConfig config)
+{
+    if(config.workerCount > 0)
+        return config.workerCount;
+    u32 cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+}
+
+static bool queuePush(JobQueue* queue, const Job& job)
+{
+    i64 b = queue->bottom.load(std::memory_order_relaxed);
+    i64 t = queue->top.load(std::memory_order_acquire);
+    if(b - t > queue->mask)
+        return false;
+
+    queue->jobs[b & queue->mask] = job;
+    std::atomic_thread_fence(std::memory_order_release);
+    queue->bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+static bool queuePop(JobQueue* queue, Job* outJob)
+{
+    i64 b = queue->bottom.load(std::memory_order_relaxed) - 1;
+    queue->bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 t = queue->top.load(std::memory_order_relaxed);
+
+    if(t > b) {
+        // Empty.
+        queue->bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    *outJob = queue->jobs[b & queue->mask];
+    if(t == b) {
+        // Last job, race against thieves for it.
+        bool won = queue->top.compare_exchange_strong(t, t + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed);
+        queue->bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+static bool queueSteal(JobQueue* queue, Job* outJob)
+{
+    i64 t = queue->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 b = queue->bottom.load(std::memory_order_acquire);
+    if(t >= b)
+        return false;
+
+    *outJob = queue->jobs[t & queue->mask];
+    return queue->top.compare_exchange_strong(t, t + 1,
+        std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+static bool injectionPush(JobInjectionQueue* queue, const Job& job)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    u32 count = queue->count.load(std::memory_order_relaxed);
+    if(count == queue->capacity)
+        return false;
+
+    queue->jobs[(queue->head + count) % queue->capacity] = job;
+    queue->count.store(count + 1, std::memory_order_relaxed);
+    return true;
+}
+
+static bool injectionPop(JobInjectionQueue* queue, Job* outJob)
+{
+    // Checked without the lock first, the queue is empty most of the time.
+    if(queue->count.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    u32 count = queue->count.load(std::memory_order_relaxed);
+    if(count == 0)
+        return false;
+
+    *outJob = queue->jobs[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count.store(count - 1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * Takes a job from the own deque, the injected ones, or steals one from
+ * another thread. Threads outside the job system only take the last two.
+ */
+static bool getJob(Job* outJob)
+{
+    if(threadIndex != INVALID_ID && queuePop(&pState->queues[threadIndex], outJob)) {
+        pState->queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    if(injectionPop(&pState->injected, outJob)) {
+        pState->queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // xorshift to pick where to start stealing.
+    stealSeed ^= stealSeed << 13;
+    stealSeed ^= stealSeed >> 17;
+    stealSeed ^= stealSeed << 5;
+    u32 start = stealSeed % pState->threadCount;
+    for(u32 i = 0; i < pState->threadCount; ++i)
+    {
+        u32 victim = (start + i) % pState->threadCount;
+        if(victim == threadIndex)
+            continue;
+        if(queueSteal(&pState->queues[victim], outJob)) {
+            pState->queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void executeJob(const Job& job)
+{
+    job.function(job.data, job.begin, job.end);
+    if(job.counter)
+        job.counter->value.fetch_sub(1, std::memory_order_release);
+}
+
+static void workerMain(u32 index)
+{
+    threadIndex = index;
+    stealSeed = 0x9E3779B9 * (index + 1);
+
+    Job job;
+    while(pState->running.load(std::memory_order_relaxed))
+    {
+        bool active = index < pState->activeThreads.load(std::memory_order_relaxed);
+        if(active && getJob(&job)) {
+            executeJob(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(pState->sleepMutex);
+        pState->wake.wait(lock, [index] {
+            return (pState->queued.load(std::memory_order_relaxed) > 0
+                    && index < pState->activeThreads.load(std::memory_order_relaxed))
+                || !pState->running.load(std::memory_order_relaxed);
+        });
+    }
+}
+
+bool jobSystemInit(u64* memoryRequirements, void* state, JobSystemConfig config)
+{
+    if(config.maxJobsPerThread == 0)
+        config.maxJobsPerThread = JOB_SYSTEM_DEFAULT_JOBS_PER_THREAD;
+    if((config.maxJobsPerThread & (config.maxJobsPerThread - 1)) != 0) {
+        PERROR("jobSystemInit - maxJobsPerThread must be a power of two.");
+        return false;
+    }
+
+    u32 workerCount = resolveWorkerCount(config);
+    u32 threadCount = workerCount + 1;
+
+    u64 stateMemoryRequirement = sizeof(JobSystemState);
+    u64 queuesMemoryRequirement = sizeof(JobQueue) * threadCount;
+    // One ring per deque plus the injection one.
+    u64 jobsMemoryRequirement = sizeof(Job) * config.maxJobsPerThread * (threadCount + 1);
+    u64 workersMemoryRequirement = sizeof(std::thread) * workerCount;
+    *memoryRequirements = stateMemoryRequirement + queuesMemoryRequirement
+        + jobsMemoryRequirement + workersMemoryRequirement;
+
+    if(!state)
+        return true;
+
+    memZero(state, *memoryRequirements);
+    pState = new (state) JobSystemState();
+    pState->config = config;
+    pState->config.workerCount = workerCount;
+    pState->threadCount = threadCount;
+
+    u8* memory = (u8*)state + stateMemoryRequirement;
+    pState->queues = (JobQueue*)memory;
+    memory += queuesMemoryRequirement;
+    Job* jobs = (Job*)memory;
+    memory += jobsMemoryRequirement;
+    pState->workers = (std::thread*)memory;
+
+    for(u32 i = 0; i < threadCount; ++i)
+    {
+        JobQueue* queue = new (&pState->queues[i]) JobQueue();
+        queue->top.store(0);
+        queue->bottom.store(0);
+        queue->jobs = jobs + (u64)i * config.maxJobsPerThread;
+        queue->mask = config.maxJobsPerThread - 1;
+    }
+    pState->injected.jobs = jobs + (u64)threadCount * config.maxJobsPerThread;
+    pState->injected.capacity = config.maxJobsPerThread;
+    pState->injected.head = 0;
+    pState->injected.count.store(0);
+
+    threadIndex = 0;
+    pState->queued.store(0);
+    pState->activeThreads.store(threadCount);
+    pState->running.store(true);
+    for(u32 i = 0; i < workerCount; ++i)
+    {
+        new (&pState->workers[i]) std::thread(workerMain, i + 1);
+    }
+
+    PINFO("Job system initialized with %u worker threads.", workerCount);
+    return true;
+}
+
+void jobSystemShutdown(void* state)
+{
+    if(pState)
+    {
+        {
+            std::lock_guard<std::mutex> lock(pState->sleepMutex);
+            pState->running.store(false);
+        }
+        pState->wake.notify_all();
+
+        for(u32 i = 0; i < pState->config.workerCount; ++i)
+        {
+            pState->workers[i].join();
+            pState->workers[i].~thread();
+        }
+        for(u32 i = 0; i < pState->threadCount; ++i)
+        {
+            pState->queues[i].~JobQueue();
+        }
+        pState->~JobSystemState();
+        pState = nullptr;
+    }
+}
+
+u32 jobSystemThreadCount()
+{
+    return pState ? pState->threadCount : 1;
+}
+
+void jobSystemSetActiveThreads(u32 count)
+{
+    if(!pState)
+        return;
+
+    if(count == 0 || count > pState->threadCount)
+        count = pState->threadCount;
+    {
+        std::lock_guard<std::mutex> lock(pState->sleepMutex);
+        pState->activeThreads.store(count);
+    }
+    pState->wake.notify_all();
+}
+
+u32 jobSystemActiveThreads()
+{
+    return pState ? pState->activeThreads.load(std::memory_order_relaxed) : 1;
+}
+
+u32 jobSystemThreadIndex()
+{
+    // Before init every thread runs jobs in place, as the main one.
+    return pState ? threadIndex : 0;
+}
+
+void jobSystemRun(const Job* jobs, u32 count, JobCounter* counter)
+{
+    if(!jobs || count == 0)
+        return;
+
+    if(counter)
+        counter->value.fetch_add(count, std::memory_order_relaxed);
+
+    // Without workers the jobs run in place.
+    if(!pState || pState->threadCount <= 1) {
+        for(u32 i = 0; i < count; ++i) {
+            Job job = jobs[i];
+            if(counter)
+                job.counter = counter;
+            executeJob(job);
+        }
+        return;
+    }
+
+    // Only the owner pushes on a deque, other threads inject.
+    JobQueue* queue = threadIndex != INVALID_ID ? &pState->queues[threadIndex] : nullptr;
+    u32 pushed = 0;
+    for(u32 i = 0; i < count; ++i)
+    {
+        Job job = jobs[i];
+        if(counter)
+            job.counter = counter;
+        if(queue ? queuePush(queue, job) : injectionPush(&pState->injected, job)) {
+            ++pushed;
+        } else {
+            executeJob(job);
+        }
+    }
+
+    if(pushed > 0)
+    {
+        pState->queued.fetch_add(pushed, std::memory_order_relaxed);
+        // Taking the lock makes sure a worker going to sleep sees the new jobs.
+        { std::lock_guard<std::mutex> lock(pState->sleepMutex); }
+        if(pushed == 1)
+            pState->wake.notify_one();
+        else
+            pState->wake.notify_all();
+    }
+}
+
+void jobSystemWait(JobCounter* counter)
+{
+    if(!counter)
+        return;
+
+    Job job;
+    while(counter->value.load(std::memory_order_acquire) > 0)
+    {
+        if(pState && getJob(&job)) {
+            executeJob(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "defines.h"
+
+#include <atomic>
+
+/**
+ * Work stealing job system.
+ * Every thread, main thread included, owns a Chase-Lev deque. A thread
+ * pushes and pops jobs from the bottom of its own deque while idle
+ * threads steal from the top of the others. Completion is tracked with
+ * counters, waiting on a counter runs pending jobs instead of blocking.
+ * Other threads submit through a shared queue behind a mutex.
+ */
+
+typedef void (*JobFunction)(void* data, u32 begin, u32 end);
+
+typedef struct JobCounter
+{
+    std::atomic<u32> value;
+} JobCounter;
+
+typedef struct Job
+{
+    JobFunction function;
+    void* data;
+    u32 begin;          // Range given to the function, used by parallelFor.
+    u32 end;
+    JobCounter* counter; // Decremented when the job finishes. Optional.
+} Job;
+
+typedef struct JobSystemConfig
+{
+    // Worker threads besides the main thread. 0 uses one per core minus one.
+    u32 workerCount;
+    // Capacity of each deque. Must be a power of two.
+    u32 maxJobsPerThread;
+} JobSystemConfig;
+
+bool jobSystemInit(u64* memoryRequirements, void* state, JobSystemConfig config);
+
+void jobSystemShutdown(void* state);
+
+/**
+ * Number of threads that run jobs, main thread included.
+ */
+u32 jobSystemThreadCount();
+
+/**
+ * Limits the threads taking jobs to the first count, main thread
+ * included. The rest of the workers sleep. 0 enables all of them.
+ * @param u32 count
+ */
+void jobSystemSetActiveThreads(u32 count);
+
+/**
+ * Threads taking jobs, as set by jobSystemSetActiveThreads.
+ */
+u32 jobSystemActiveThreads();
+
+/**
+ * Index of the calling thread. 0 is the main thread, workers go from 1.
+ * INVALID_ID for threads outside the job system.
+ */
+u32 jobSystemThreadIndex();
+
+/**
+ * Queues count jobs in the deque of the calling thread, or in the shared
+ * queue if it is not the main thread or a worker. If counter is given it
+ * is increased by count and each job decrements it when done.
+ * Jobs that do not fit in the queue are run right away.
+ * @param const Job* jobs
+ * @param u32 count
+ * @param JobCounter* counter Overrides the counter of the jobs. Optional.
+ */
+void jobSystemRun(const Job* jobs, u32 count, JobCounter* counter);
+
+/**
+ * Runs pending jobs until the counter reaches zero.
+ * @param JobCounter* counter
+ */
+void jobSystemWait(JobCounter* counter);
+
+/**
+ * Splits [begin, end) in ranges of grain elements and calls
+ * fn(rangeBegin, rangeEnd) for each of them across all threads.
+ * Returns when every range is done.
+ */
+template<typename Fn>
+void parallelFor(u32 begin, u32 end, u32 grain, Fn fn)
+{
+    if(begin >= end)
+        return;
+    if(grain == 0)
+        grain = 1;
+
+    JobFunction trampoline = [](void* data, u32 rangeBegin, u32 rangeEnd) {
+        (*static_cast<Fn*>(data))(rangeBegin, rangeEnd);
+    };
+
+    if(jobSystemThreadCount() <= 1 || end - begin <= grain) {
+        trampoline(&fn, begin, end);
+        return;
+    }
+
+    JobCounter counter;
+    counter.value.store(0, std::memory_order_relaxed);
+
+    // Submitted in batches to keep the job array on the stack.
+    const u32 batchSize = 64;
+    Job jobs[batchSize];
+    u32 jobCount = 0;
+    for(u32 i = begin; i < end; i += grain)
+    {
+        Job& job    = jobs[jobCount++];
+        job.function = trampoline;
+        job.data    = &fn;
+        job.begin   = i;
+        job.end     = end - i > grain ? i + grain : end;
+        job.counter = nullptr;
+        if(jobCount == batchSize) {
+            jobSystemRun(jobs, jobCount, &counter);
+            jobCount = 0;
+        }
+    }
+    if(jobCount > 0)
+        jobSystemRun(jobs, jobCount, &counter);
+
+    jobSystemWait(&counter);
+}
@@ -3,6 +3,7 @@
 #include "core/logger.h"
 #include "core/pstring.h"
 #include "memory/pmemory.h"
+#include "memory/poolAllocator.h"
 #include "renderer/rendererFrontend.h"
 
 #include "systems/textureSystem.h"
@@ -11,7 +12,7 @@ typedef struct MaterialSystemState
 {
     Material* defaultMaterial;
     MaterialSystemConfig config;
-    Material* materials;
+    PoolAllocator materials;    // Slot table, the material id is its block index.
 } MaterialSystemState;
 
 static MaterialSystemState* pState;
@@ -30,20 +31,16 @@ void materialSystemCreateDefaultMaterial()
 
 bool materialSystemInit(u64* memoryRequirements, void* state, MaterialSystemConfig config)
 {
-    *memoryRequirements = sizeof(MaterialSystemConfig) + sizeof(Material) * config.maxMaterialCount;
+    u64 stateMemoryRequirement = sizeof(MaterialSystemState);
+    *memoryRequirements = stateMemoryRequirement + poolAllocatorMemoryRequirement(sizeof(Material), config.maxMaterialCount);
     if(!state){
         return true;
     }
 
     pState = (MaterialSystemState*)state;
     pState->config = config;
-    pState->materials = (Material*)(pState + sizeof(MaterialSystemConfig));
-
-    for(u32 i = 0; i < pState->config.maxMaterialCount; ++i) {
-        pState->materials[i].id         = INVALID_ID;
-        pState->materials[i].rendererId = INVALID_ID;
-        pState->materials[i].generation = INVALID_ID;
-    }
+    pState->defaultMaterial = nullptr;
+    poolAllocatorCreate(sizeof(Material), config.maxMaterialCount, (u8*)state + stateMemoryRequirement, &pState->materials);
 
     //materialSystemCreateDefaultMaterial();
     //pState->materials[0] = *pState->defaultMaterial;
@@ -53,12 +50,8 @@ bool materialSystemInit(u64* memoryRequirements, void* state, MaterialSystemConf
 void materialSystemShutdown(void* state)
 {
     if(pState){
-
-        for(u32 i = 0; i < pState->config.maxMaterialCount; ++i)
-        {
-            // TODO destroy material
-            pState->materials[i].id = INVALID_ID;
-        }
+        // TODO destroy material
+        poolAllocatorDestroy(&pState->materials);
         pState = nullptr;
     }
 }
@@ -76,16 +69,14 @@ Material* materialSystemGetMaterialByName(const char* name)
 Material* materialSystemCreateFromData(MaterialData data)
 {
     // TODO select from hastable
-    // Select first empty material
-    Material* mat = nullptr;
-    for(u32 i = 0; i < pState->config.maxMaterialCount; ++i)
-    {
-        if(pState->materials[i].id == INVALID_ID){
-            mat = &pState->materials[i];
-            mat->id = i;
-            break;
-        }
+    Material* mat = (Material*)poolAllocatorAllocate(&pState->materials);
+    if(!mat){
+        PERROR("materialSystemCreateFromData - Material system is full. Increase maxMaterialCount.");
+        return nullptr;
     }
+    mat->id         = poolAllocatorIndexOf(&pState->materials, mat);
+    mat->rendererId = INVALID_ID;
+    mat->generation = INVALID_ID;
 
     mat->type = data.type;
     mat->diffuseColor = data.diffuseColor;
@@ -110,4 +101,17 @@ Material* materialSystemCreateFromData(MaterialData data)
     }
 
     return mat;
-}
\ No newline at end of file
+}
+
+void materialSystemDestroy(Material* material)
+{
+    if(!material){
+        return;
+    }
+
+    renderDestroyMaterial(material);
+    material->id            = INVALID_ID;
+    material->rendererId    = INVALID_ID;
+    material->generation    = INVALID_ID;
+    poolAllocatorFree(&pState->materials, material);
+}
@@ -12,5 +12,10 @@ bool materialSystemInit(u64* memoryRequirements, void* state, MaterialSystemConf
 void materialSystemShutdown(void* state);
 
 Material* materialSystemCreateFromData(MaterialData data);
+
+/**
+ * Frees the renderer resources of the material and gives its slot back.
+ */
+void materialSystemDestroy(Material* material);
 Material* materialSystemGetMaterialByName(const char* name);
 void materialSystemCreateDefaultMaterial();
\ No newline at end of file
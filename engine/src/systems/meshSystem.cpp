@@ -3,6 +3,7 @@
 #include "defines.h"
 #include "core/logger.h"
 #include "memory/pmemory.h"
+#include "memory/poolAllocator.h"
 #include "renderer/rendererFrontend.h"
 
 // TODO make own library
@@ -14,7 +15,7 @@ typedef struct MeshSystemState
 {
     MeshSystemConfig config;
     u32 meshCount;
-    Mesh* meshes;
+    PoolAllocator meshes;   // Slot table, the mesh id is its block index.
 } MeshSystemState;
 
 static MeshSystemState* pState;
@@ -22,7 +23,7 @@ static MeshSystemState* pState;
 bool meshSystemInit(u64* memoryRequirements, void* state, MeshSystemConfig configuration)
 {
     u64 stateMemoryRequirement = sizeof(MeshSystemState);
-    u64 meshesMemoryRequirement = sizeof(Mesh) * configuration.maxMeshesCount;
+    u64 meshesMemoryRequirement = poolAllocatorMemoryRequirement(sizeof(Mesh), configuration.maxMeshesCount);
 
     if(state == nullptr) {
         *memoryRequirements = stateMemoryRequirement + meshesMemoryRequirement;
@@ -31,11 +32,8 @@ bool meshSystemInit(u64* memoryRequirements, void* state, MeshSystemConfig confi
 
     pState = static_cast<MeshSystemState*>(state);
     pState->config = configuration;
-    pState->meshes = (Mesh*)(pState + stateMemoryRequirement);
-
-    for(u32 i = 0; i < pState->config.maxMeshesCount; ++i) {
-        pState->meshes[i].id = INVALID_ID;
-    }
+    pState->meshCount = 0;
+    poolAllocatorCreate(sizeof(Mesh), configuration.maxMeshesCount, (u8*)state + stateMemoryRequirement, &pState->meshes);
 
     PINFO("Mesh system initialized!");
     return true;
@@ -45,34 +43,35 @@ void meshSystemShutdown(void* state)
 {
     if(state) {
         // TODO render destroy mesh. Free GPU memory for all updated meshes.
+        poolAllocatorDestroy(&pState->meshes);
         pState = nullptr;
     }
 }
 
-static void meshSystemSetMesh(Mesh* mesh)
+/**
+ * Takes a free slot from the mesh table.
+ * @return Mesh* with its id set or nullptr if the table is full.
+ */
+static Mesh* meshSystemAcquireMesh()
 {
-    for(u32 i = 0; i < pState->config.maxMeshesCount; ++i)
-    {
-        if(pState->meshes[i].id == INVALID_ID)
-        {
-            pState->meshes[i] = *mesh;
-            pState->meshes[i].id = i;
-            mesh->id = i;
-            pState->meshCount++;
-            return;
-        }
-        if(mesh->id != INVALID_ID && pState->meshes[i].id == mesh->id){
-            PWARN("Mesh already set in system.");
-            return;
-        }
+    Mesh* mesh = (Mesh*)poolAllocatorAllocate(&pState->meshes);
+    if(!mesh) {
+        PERROR("Mesh system is full. Increase maxMeshesCount.");
+        return nullptr;
     }
+
+    mesh->id = poolAllocatorIndexOf(&pState->meshes, mesh);
+    mesh->rendererId = INVALID_ID;
+    pState->meshCount++;
+    return mesh;
 }
 
 Mesh* meshSystemGetTriangle()
 {
-    Mesh* m = (Mesh*)memAllocate(sizeof(Mesh), MEMORY_TAG_ENTITY);
-    m->id = INVALID_ID;
-    m->rendererId = INVALID_ID;
+    Mesh* m = meshSystemAcquireMesh();
+    if(!m) {
+        return nullptr;
+    }
 
     Vertex v[3];
     memZero(v, sizeof(Vertex) * 3);
@@ -91,7 +90,6 @@ Mesh* meshSystemGetTriangle()
     i[1] = 1;
     i[2] = 2;
 
-    meshSystemSetMesh(m);
     if(!renderCreateMesh(m, 3, v, 3, i)){
         return nullptr;
     }
@@ -102,9 +100,10 @@ Mesh* meshSystemGetTriangle()
 // TODO  make it configurable. Currently drawing at length 1.
 Mesh* meshSystemGetPlane(u32 width, u32 height)
 {
-    Mesh* m = (Mesh*)memAllocate(sizeof(Mesh), MEMORY_TAG_ENTITY);
-    m->id = INVALID_ID;
-    m->rendererId = INVALID_ID;
+    Mesh* m = meshSystemAcquireMesh();
+    if(!m) {
+        return nullptr;
+    }
 
     u32 vertexSize = sizeof(Vertex);
     u32 indexSize = sizeof(u32);
@@ -134,7 +133,6 @@ Mesh* meshSystemGetPlane(u32 width, u32 height)
 
     u32 i[6] = {0, 1, 2, 2, 3, 0};
     
-    meshSystemSetMesh(m);
     if(!renderCreateMesh(m, 4, v, 6, i)){
         return nullptr;
     }
@@ -146,9 +144,10 @@ Mesh* meshSystemGetPlane(u32 width, u32 height)
 // TODO fix circle creation.
 Mesh* meshSystemGetCircle(f32 r)
 {
-    Mesh* m = (Mesh*)memAllocate(sizeof(Mesh), MEMORY_TAG_ENTITY);
-    m->id = INVALID_ID;
-    m->rendererId = INVALID_ID;
+    Mesh* m = meshSystemAcquireMesh();
+    if(!m) {
+        return nullptr;
+    }
 
     const u32 nSegments = 6;
     const f32 radius = 1.0f;
@@ -176,7 +175,6 @@ Mesh* meshSystemGetCircle(f32 r)
                   4, 5, 7,
                   5, 6, 7 };
 
-    meshSystemSetMesh(m);
     if(!renderCreateMesh(m, nVertices, v, 18, i)){
         return nullptr;
     }
@@ -189,9 +187,10 @@ Mesh* meshSystemGetCircle(f32 r)
 Mesh*
 meshSystemGetCube()
 {
-    Mesh* m = (Mesh*)memAllocate(sizeof(Mesh), MEMORY_TAG_ENTITY);
-    m->id = INVALID_ID;
-    m->rendererId = INVALID_ID;
+    Mesh* m = meshSystemAcquireMesh();
+    if(!m) {
+        return nullptr;
+    }
 
     u32 vertexSize = sizeof(Vertex);
     u32 indexSize = sizeof(u32);
@@ -238,7 +237,6 @@ meshSystemGetCube()
         20, 21, 22, 22, 23, 20 
     };
     
-    meshSystemSetMesh(m);
     if(!renderCreateMesh(m, 24, v, 36, i)){
         return nullptr;
     }
@@ -249,18 +247,33 @@ meshSystemGetCube()
 Mesh* meshSystemCreateFromData(const MeshData* data)
 {
     if(!data) {
-        return false;
+        return nullptr;
     }
 
     // TODO make sure mesh is not already updated.
 
-    Mesh* mesh = (Mesh*)memAllocate(sizeof(Mesh), MEMORY_TAG_ENTITY);
-    mesh->id = INVALID_ID;
-    mesh->rendererId = INVALID_ID;
-    
-    meshSystemSetMesh(mesh);
+    Mesh* mesh = meshSystemAcquireMesh();
+    if(!mesh) {
+        return nullptr;
+    }
+
     if(!renderCreateMesh(mesh, data->vertexCount, data->vertices, data->indexCount, data->indices)) {
         PERROR("meshSystemCreateFromData - Error al create mesh in renderer.");
     }
     return mesh;
-}
\ No newline at end of file
+}
+
+void meshSystemDestroy(Mesh* mesh)
+{
+    if(!mesh) {
+        return;
+    }
+
+    if(mesh->rendererId != INVALID_ID) {
+        renderDestroyMesh(mesh);
+    }
+    mesh->id = INVALID_ID;
+    mesh->rendererId = INVALID_ID;
+    poolAllocatorFree(&pState->meshes, mesh);
+    pState->meshCount--;
+}
@@ -16,4 +16,9 @@ Mesh* meshSystemGetTriangle();
 Mesh* meshSystemGetPlane(u32 width, u32 height);
 Mesh* meshSystemGetCircle(f32 r);
 Mesh* meshSystemGetCube();
-Mesh* meshSystemCreateFromData(const MeshData* data);
\ No newline at end of file
+Mesh* meshSystemCreateFromData(const MeshData* data);
+
+/**
+ * Frees the renderer resources of the mesh and gives its slot back.
+ */
+void meshSystemDestroy(Mesh* mesh);
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include "module_entities.h"
 #include "systems/entity/entity.h"
+#include "systems/entity/archetype.h"
+#include "systems/components/comp_transform.h"
+#include "systems/transformSystem.h"
 
 void CModuleEntities::loadManagers(const json& j, std::vector<CHandleManager*>& managers)
 {
@@ -13,6 +16,52 @@ void CModuleEntities::loadManagers(const json& j, std::vector<CHandleManager*>&
     }
 }
 
+void CModuleEntities::loadUpdateAccess(const json& j)
+{
+    auto typesFromNames = [](const json& names) {
+        std::vector<u32> types;
+        for(const std::string& n : names) {
+            auto om = CHandleManager::getByName(n.c_str());
+            if(om)
+                types.push_back(om->getType());
+            else
+                PWARN("Unknown component '%s' in update access. Check file components.json.", n.c_str());
+        }
+        return types;
+    };
+
+    for(auto& it : j["access"].items())
+    {
+        auto om = CHandleManager::getByName(it.key().c_str());
+        if(!om) {
+            PWARN("Access declared for unknown manager '%s'.", it.key().c_str());
+            continue;
+        }
+        const json& access = it.value();
+        om->setAccess(typesFromNames(access.value("read", json::array())),
+            typesFromNames(access.value("write", json::array())));
+    }
+
+    for(auto& it : j["parallel_update"].items())
+    {
+        auto om = CHandleManager::getByName(it.key().c_str());
+        if(om)
+            om->setParallelGrain(it.value().get<u32>());
+    }
+}
+
+void CModuleEntities::buildUpdateStages()
+{
+    CHandleManager::buildUpdateStages(toUpdate, updateStages);
+    for(size_t i = 0; i < updateStages.size(); ++i)
+    {
+        std::string names;
+        for(auto om : updateStages[i])
+            names += std::string(" ") + om->getName();
+        PDEBUG("Update stage %d:%s", (i32)i, names.c_str());
+    }
+}
+
 bool CModuleEntities::start()
 {
     json j = loadJson("data/components/components.json");
@@ -45,6 +94,12 @@ bool CModuleEntities::start()
     loadManagers(j["update"], toUpdate);
     loadManagers(j["render_debug"], toRenderDebug);
 
+    loadUpdateAccess(j);
+    buildUpdateStages();
+
+    // Data only components that can also be stored by archetype.
+    CArchetypeStorage::get().registerComponent<TCompTransform>();
+
     return true;
 }
 
@@ -56,12 +111,14 @@ void CModuleEntities::stop()
 void CModuleEntities::update(f32 dt)
 {
     //PINFO("Updating module entities ...")
-    for(auto om : toUpdate)
+    for(auto& stage : updateStages)
     {
-        if(om)
-            om->updateAll(dt);
+        CHandleManager::updateStage(stage, dt);
         CHandleManager::destroyAllPendingObjects();
     }
+
+    // World matrices of the transforms changed by the components.
+    CTransformSystem::Get()->update();
 }
 
 void CModuleEntities::renderInMenu() {
@@ -77,6 +134,8 @@ void CModuleEntities::renderInMenu() {
             ImGui::PopID();
             
         });
+        CArchetypeStorage::get().debugInMenu();
+        CTransformSystem::Get()->debugInMenu();
         ImGui::TreePop();
     }
 }
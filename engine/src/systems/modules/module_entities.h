@@ -6,7 +6,13 @@ class CModuleEntities : public IModule
     std::vector<CHandleManager*> toUpdate;
     std::vector<CHandleManager*> toRenderDebug;
 
+    // Managers of toUpdate grouped in stages. Managers in the same stage
+    // do not touch the same components and are updated concurrently.
+    std::vector<std::vector<CHandleManager*>> updateStages;
+
     void loadManagers(const json& j, std::vector<CHandleManager*>& managers);
+    void loadUpdateAccess(const json& j);
+    void buildUpdateStages();
     void renderDebugOfComponents();
     void editRenderDebug();
 
@@ -1,72 +1,172 @@
 #include "renderSystem.h"
 
 #include "resourceSystem.h"
+#include "renderer/renderTypes.h"
+#include "memory/frameAllocator.h"
+#include "containers/radixSort.h"
 #include "systems/components/comp_transform.h"
 #include "systems/entity/entity.h"
 
 CRenderManager* CRenderManager::instance = nullptr;
 
-void CRenderManager::addKey(CHandle owner, Mesh* mesh, Material* material)
+u32 CRenderManager::addKey(CHandle owner, Mesh* mesh, Material* material, bool enabled)
 {
     PASSERT(mesh);
     PASSERT(material);
     PASSERT(owner.isValid())
 
-    TKey key;
-    key.material = material;
-    key.mesh = mesh;
-    key.hOwner = owner;
-    key.hTransform = CHandle();
+    u32 id = firstFreeKey;
+    if(id != INVALID_ID) {
+        firstFreeKey = keys[id].next;
+    } else {
+        id = (u32)keys.size();
+        keys.emplace_back();
+    }
+
+    // Chain it with the other keys of the owner.
+    u32 ownerIndex = owner.getIndex();
+    if(ownerIndex >= ownerFirstKey.size())
+        ownerFirstKey.resize(ownerIndex + 1, INVALID_ID);
+    u32 first = ownerFirstKey[ownerIndex];
+    if(first != INVALID_ID && keys[first].hOwner != owner)
+        first = INVALID_ID;
+    ownerFirstKey[ownerIndex] = id;
+
+    TKey& key = keys[id];
+    key.material    = material;
+    key.mesh        = mesh;
+    key.hOwner      = owner;
+    key.hTransform  = CHandle();
+    key.sortKey     = renderKeyEncode(0, materialIsTranslucent(material), material->type,
+        material->rendererId, mesh->rendererId, 0);
+    key.generation++;
+    key.next        = first;
+    key.used        = true;
+    key.enabled     = false;
+    // pending is kept, a slot freed before the last sortKeys is still in
+    // dirtyKeys and must not be queued twice.
+
+    setKeyEnabled(id, enabled);
+    return id;
+}
 
-    keys.push_back(key);
+void CRenderManager::setKeyEnabled(u32 id, bool enabled)
+{
+    PASSERT(id < keys.size())
+    TKey& key = keys[id];
+    if(!key.used || key.enabled == enabled)
+        return;
 
-    // New keys have been added, pending to sort them.
+    key.enabled = enabled;
+    if(enabled) {
+        // Sorted in on the next sortKeys.
+        if(!key.pending) {
+            key.pending = true;
+            dirtyKeys.push_back(id);
+        }
+    } else {
+        // The sorted entry, if any, becomes stale.
+        key.generation++;
+        nStaleKeys++;
+    }
     keysAreDirty = true;
 }
 
 void CRenderManager::sortKeys()
 {
-    // TODO filter given some parameters
-
-    for(auto& k : keys) {
-        if(k.hTransform.isValid() == false)
-        {
-            CEntity* owner = k.hOwner.getOwner();
-            PASSERT(owner)
-            k.hTransform = owner->get<TCompTransform>();
+    keysAreDirty = false;
+
+    // Stale entries are skipped when rendering, compact them only
+    // once they are a good part of the list.
+    if(dirtyKeys.empty() && nStaleKeys * 8 < sortedKeys.size())
+        return;
+
+    // Sort the new keys alone.
+    u32 nDirty = (u32)dirtyKeys.size();
+    u64* newSortKeys = nullptr;
+    u32* newKeys = nullptr;
+    if(nDirty > 0)
+    {
+        newSortKeys = frameAlloc<u64>(nDirty);
+        newKeys = frameAlloc<u32>(nDirty);
+        u64* tmpSortKeys = frameAlloc<u64>(nDirty);
+        u32* tmpKeys = frameAlloc<u32>(nDirty);
+        if(!newSortKeys || !newKeys || !tmpSortKeys || !tmpKeys) {
+            PERROR("CRenderManager::sortKeys - not enough frame memory for %u keys.", nDirty);
+            keysAreDirty = true;
+            return;
         }
+
+        u32 n = 0;
+        for(u32 id : dirtyKeys) {
+            TKey& k = keys[id];
+            k.pending = false;
+            // Disabled again before being sorted.
+            if(!k.used || !k.enabled)
+                continue;
+            if(k.hTransform.isValid() == false)
+            {
+                CEntity* owner = k.hOwner.getOwner();
+                PASSERT(owner)
+                k.hTransform = owner->get<TCompTransform>();
+            }
+            newSortKeys[n] = k.sortKey;
+            newKeys[n] = id;
+            ++n;
+        }
+        nDirty = n;
+        radixSort64(newSortKeys, newKeys, tmpSortKeys, tmpKeys, nDirty);
     }
+
+    // Merge both sorted lists dropping the stale entries.
+    mergedKeys.clear();
+    mergedKeys.reserve(sortedKeys.size() + nDirty);
+    u32 j = 0;
+    for(const TSortedKey& sk : sortedKeys)
+    {
+        if(!isValid(sk))
+            continue;
+        for(; j < nDirty && newSortKeys[j] < sk.sortKey; ++j)
+            mergedKeys.push_back({newSortKeys[j], newKeys[j], keys[newKeys[j]].generation});
+        mergedKeys.push_back(sk);
+    }
+    for(; j < nDirty; ++j)
+        mergedKeys.push_back({newSortKeys[j], newKeys[j], keys[newKeys[j]].generation});
+
+    sortedKeys.swap(mergedKeys);
+    dirtyKeys.clear();
+    nStaleKeys = 0;
 }
 
 void CRenderManager::deleteKeysFromOwner(CHandle hOwner)
 {
-    auto it = std::remove_if(
-        keys.begin(), 
-        keys.end(), 
-        [hOwner](const TKey& k1){return k1.hOwner == hOwner;});
-    
-    keys.erase(it, keys.end());
+    u32 ownerIndex = hOwner.getIndex();
+    if(ownerIndex >= ownerFirstKey.size())
+        return;
+
+    u32 id = ownerFirstKey[ownerIndex];
+    while(id != INVALID_ID && keys[id].used && keys[id].hOwner == hOwner)
+    {
+        TKey& key = keys[id];
+        u32 next = key.next;
+        if(key.enabled)
+            nStaleKeys++;
+        key.generation++;
+        key.used = false;
+        key.enabled = false;
+        key.hOwner = CHandle();
+        key.next = firstFreeKey;
+        firstFreeKey = id;
+        id = next;
+    }
+    ownerFirstKey[ownerIndex] = INVALID_ID;
+    keysAreDirty = true;
 }
 
 void CRenderManager::render()
 {
-    // TODO Sort keys if dirty.
-    if(keysAreDirty)
+    if(keysAreDirty) {
+        ++version;
         sortKeys();
-
-    u32 nDrawCalls = 0;
-
-    TKey nullKey = {};
-    const TKey* previousKey = &nullKey;
-    const TKey* key = &nullKey;
-
-    auto it = keys.begin();
-    auto end = keys.end();
-
-/*     while(it != end)
-    {
-        key = &(*it);
-
-        
-    } */
-}
\ No newline at end of file
+    }
+}
@@ -18,34 +18,72 @@ public:
     }
 
     /** Necessary information to pass to the Renderer to draw. 
-     * This is the DrawCall definition.*/
+     * This is the DrawCall definition. Keys live in a slot map, the
+     * index of a key does not change while it exists.*/
     struct TKey {
         Mesh* mesh = nullptr;
         Material* material = nullptr;
         CHandle hOwner;
         CHandle hTransform;
+        u64 sortKey = 0;
+        u32 generation = 0;             // Bumped on remove and disable, invalidates sorted entries.
+        u32 next = INVALID_ID;          // Next key of the same owner, or next free slot.
+        bool used = false;
+        bool enabled = false;
+        bool pending = false;           // Waiting in dirtyKeys.
     };
 
-    /** All active DrawCalls.*/ 
+    /** Entry of the sorted list. Stale if the generation does not match the key. */
+    struct TSortedKey {
+        u64 sortKey;
+        u32 key;
+        u32 generation;
+    };
+
+    /** Key slots, used or not.*/ 
     std::vector<TKey> keys;
 protected:
+    u32 firstFreeKey = INVALID_ID;
+    // First key of each owner, indexed by the external index of the owner.
+    std::vector<u32> ownerFirstKey;
+
+    // Enabled keys sorted by sortKey. New ones wait in dirtyKeys until
+    // the next sortKeys, stale ones are dropped then.
+    std::vector<TSortedKey> sortedKeys;
+    std::vector<TSortedKey> mergedKeys;
+    std::vector<u32> dirtyKeys;
+    u32 nStaleKeys = 0;
     bool keysAreDirty = false;
+    u32 version = 0;                // Bumped when the set of keys changes.
 
     /** Function to update DrawCalls each frame before rendering.
-     * Updates transforms and should filter given some parameters such as transparency.*/
+     * Resolves transforms of the new keys, sorts them and merges them
+     * into the sorted list. Keys already sorted are not sorted again.*/
     void sortKeys();
 
 public:
-    /** Add a DrawCall if active to render it.*/
-    void addKey(
+    /** Add a DrawCall to render it. Returns the key id.*/
+    u32 addKey(
         CHandle owner,
         Mesh* mesh,
-        Material* material
+        Material* material,
+        bool enabled = true
     );
 
+    /** Enable or disable a DrawCall without removing it. O(1). */
+    void setKeyEnabled(u32 key, bool enabled);
+    bool isKeyEnabled(u32 key) const { return key < keys.size() && keys[key].used && keys[key].enabled; }
+
     /** Delete all DrawCalls from specific handler/component. */
     void deleteKeysFromOwner(CHandle hOwner);
 
+    /** Sorted DrawCalls, entries whose key is disabled must be skipped. */
+    const std::vector<TSortedKey>& getSortedKeys() const { return sortedKeys; }
+    bool isValid(const TSortedKey& sk) const {
+        const TKey& k = keys[sk.key];
+        return k.used && k.enabled && k.generation == sk.generation;
+    }
+
     /** Render all submitted draw calls. */
     void render();
 
@@ -54,6 +92,9 @@ public:
 
     void setDirty() { keysAreDirty = true; }
 
+    /** Changes when keys are added, removed, enabled or disabled, as of the last render. */
+    u32 getVersion() const { return version; }
+
 private:
     CHandle activeCamera;
-};
\ No newline at end of file
+};
@@ -129,7 +129,9 @@ textureSystemInit(u64* memoryRequirements, void* state, TextureSystemConfig conf
 
     u64 stateMemoryRequirements = sizeof(TextureSystemState);
     u64 arrayMemoryRequirements = sizeof(Texture) * config.maxTextureCount;
-    u64 hashtableMemoryRequirements = sizeof(TextureReference) * config.maxTextureCount;
+    // Keep the table at most half full so probe chains stay short.
+    u32 hashtableElementCount = config.maxTextureCount * 2;
+    u64 hashtableMemoryRequirements = hashtableMemoryRequirement(sizeof(TextureReference), hashtableElementCount);
     *memoryRequirements = stateMemoryRequirements + arrayMemoryRequirements + hashtableMemoryRequirements;
 
     if(!state) {
@@ -138,20 +140,12 @@ textureSystemInit(u64* memoryRequirements, void* state, TextureSystemConfig conf
 
     pState = (TextureSystemState*)state;
     pState->config = config;
-    pState->textures = (Texture*)(pState + stateMemoryRequirements);
+    pState->textures = (Texture*)((u8*)state + stateMemoryRequirements);
 
-    void* hashtableMemoryBlock = pState->textures + arrayMemoryRequirements;
+    void* hashtableMemoryBlock = (u8*)pState->textures + arrayMemoryRequirements;
 
     // Create hashtable
-    hashtableCreate(sizeof(TextureReference), config.maxTextureCount, hashtableMemoryBlock, &pState->hashtable);
-
-    // Fill hashtable with invalid references
-    TextureReference invalidReference{};
-    invalidReference.autoRelease = false;
-    invalidReference.referenceCount = 0;
-    invalidReference.handle = INVALID_ID;
-    hashtableFill(&pState->hashtable, &invalidReference);
-    //pState->map.reserve(config.maxTextureCount);
+    hashtableCreate(sizeof(TextureReference), hashtableElementCount, hashtableMemoryBlock, &pState->hashtable);
 
     for(u32 i = 0;
         i < pState->config.maxTextureCount;
@@ -256,10 +250,17 @@ textureSystemGet(const char* name, bool autoRelease /*= false*/)
         return pState->defaultTexture;
     }
 
-    void* reference = nullptr;
-    TextureReference ref;
-    if(pState && hashtableGetValue(&pState->hashtable, name, &ref))
+    if(pState)
     {
+        // A texture not found in the table starts as an invalid reference.
+        TextureReference ref;
+        if(!hashtableGetValue(&pState->hashtable, name, &ref))
+        {
+            ref.autoRelease = false;
+            ref.referenceCount = 0;
+            ref.handle = INVALID_ID;
+        }
+
         if(ref.referenceCount == 0) {
             ref.autoRelease = autoRelease;
         }
@@ -332,15 +333,14 @@ textureSystemRelease(const char* name)
             // Destroy texture, including in render side.
             textureSystemDestroyTexture(t);
 
-            ref.handle = INVALID_ID;
-            ref.autoRelease = false;
+            // Nothing references it anymore, drop the entry.
+            hashtableErase(&pState->hashtable, nameCopy);
             PINFO("Released texture '%s'.", nameCopy);
         }
         else {
             PINFO("Released texture '%s'. It has now a reference count of %i.", nameCopy, ref.referenceCount);
+            hashtableSetValue(&pState->hashtable, nameCopy, &ref);
         }
-
-        hashtableSetValue(&pState->hashtable, nameCopy, &ref);
     }
     else {
         PERROR("textureSystemRelease - failed to release texture '%s'.", name);
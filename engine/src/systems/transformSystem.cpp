@@ -0,0 +1,291 @@
+#include "transformSystem.h"
+
+#include "systems/jobSystem.h"
+#include "systems/components/comp_transform.h"
+
+#include <algorithm>
+
+CTransformSystem* CTransformSystem::instance = nullptr;
+
+// Dirty nodes under this amount are updated on the calling thread.
+#define TRANSFORM_SYSTEM_PARALLEL_THRESHOLD 4096
+
+u32 CTransformSystem::createNode(CHandle transform)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    u32 id = firstFreeNode;
+    if(id != INVALID_ID) {
+        firstFreeNode = nodes[id].nextSibling;
+    } else {
+        id = (u32)nodes.size();
+        nodes.emplace_back();
+    }
+
+    // A new root goes at the end, the order stays valid.
+    u32 index = (u32)nodeIds.size();
+    TNode& node = nodes[id];
+    node.transform      = transform;
+    node.parent         = INVALID_ID;
+    node.firstChild     = INVALID_ID;
+    node.nextSibling    = INVALID_ID;
+    node.index          = index;
+    node.used           = true;
+
+    localMatrices.emplace_back(1.0f);
+    worldMatrices.emplace_back(1.0f);
+    parentIndices.push_back(INVALID_ID);
+    subtreeSizes.push_back(1);
+    nodeIds.push_back(id);
+    dirtyFlags.push_back(0);
+
+    markDirtyLocked(id);
+    return id;
+}
+
+void CTransformSystem::destroyNode(u32 id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    PASSERT(id < nodes.size() && nodes[id].used)
+
+    unlink(id);
+
+    // Children keep their local matrix, now relative to the world.
+    u32 child = nodes[id].firstChild;
+    while(child != INVALID_ID) {
+        u32 next = nodes[child].nextSibling;
+        nodes[child].parent = INVALID_ID;
+        nodes[child].nextSibling = INVALID_ID;
+        markDirtyLocked(child);
+        child = next;
+    }
+
+    // The slot in the sorted arrays is dropped on the next rebuild.
+    TNode& node = nodes[id];
+    dirtyFlags[node.index] = 0;
+    node.transform      = CHandle();
+    node.firstChild     = INVALID_ID;
+    node.index          = INVALID_ID;
+    node.used           = false;
+    node.nextSibling    = firstFreeNode;
+    firstFreeNode       = id;
+    orderIsDirty        = true;
+}
+
+void CTransformSystem::unlink(u32 id)
+{
+    u32 parent = nodes[id].parent;
+    if(parent == INVALID_ID)
+        return;
+
+    u32* link = &nodes[parent].firstChild;
+    while(*link != id) {
+        PASSERT(*link != INVALID_ID)
+        link = &nodes[*link].nextSibling;
+    }
+    *link = nodes[id].nextSibling;
+    nodes[id].parent = INVALID_ID;
+    nodes[id].nextSibling = INVALID_ID;
+}
+
+void CTransformSystem::setParent(u32 id, u32 parent)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    PASSERT(id < nodes.size() && nodes[id].used)
+    if(nodes[id].parent == parent)
+        return;
+
+    // Parenting to a descendant would make a loop.
+    for(u32 p = parent; p != INVALID_ID; p = nodes[p].parent) {
+        if(p == id) {
+            PERROR("CTransformSystem::setParent - node %u can't be parented to its own descendant %u.", id, parent);
+            return;
+        }
+    }
+
+    unlink(id);
+    if(parent != INVALID_ID) {
+        PASSERT(parent < nodes.size() && nodes[parent].used)
+        nodes[id].parent = parent;
+        nodes[id].nextSibling = nodes[parent].firstChild;
+        nodes[parent].firstChild = id;
+    }
+
+    orderIsDirty = true;
+    markDirtyLocked(id);
+}
+
+void CTransformSystem::markDirty(u32 id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    markDirtyLocked(id);
+}
+
+void CTransformSystem::markDirtyLocked(u32 id)
+{
+    PASSERT(id < nodes.size() && nodes[id].used)
+    u8& dirty = dirtyFlags[nodes[id].index];
+    if(dirty)
+        return;
+    dirty = 1;
+    dirtyNodes.push_back(id);
+}
+
+/**
+ * Sorts the arrays again in depth first order after nodes were
+ * removed or parented. Roots keep their relative order.
+ */
+void CTransformSystem::rebuildOrder()
+{
+    u32 oldCount = (u32)nodeIds.size();
+    std::vector<glm::mat4> newLocals;
+    std::vector<glm::mat4> newWorlds;
+    std::vector<u32> newParents;
+    std::vector<u32> newNodeIds;
+    std::vector<u8> newDirty;
+    newLocals.reserve(oldCount);
+    newWorlds.reserve(oldCount);
+    newParents.reserve(oldCount);
+    newNodeIds.reserve(oldCount);
+    newDirty.reserve(oldCount);
+
+    std::vector<u32> stack;
+    for(u32 i = 0; i < oldCount; ++i)
+    {
+        u32 root = nodeIds[i];
+        if(!nodes[root].used || nodes[root].index != i || nodes[root].parent != INVALID_ID)
+            continue;
+
+        stack.push_back(root);
+        while(!stack.empty())
+        {
+            u32 id = stack.back();
+            stack.pop_back();
+
+            TNode& node = nodes[id];
+            u32 oldIndex = node.index;
+            node.index = (u32)newNodeIds.size();
+            newLocals.push_back(localMatrices[oldIndex]);
+            newWorlds.push_back(worldMatrices[oldIndex]);
+            newParents.push_back(node.parent == INVALID_ID ? INVALID_ID : nodes[node.parent].index);
+            newNodeIds.push_back(id);
+            newDirty.push_back(dirtyFlags[oldIndex]);
+
+            for(u32 child = node.firstChild; child != INVALID_ID; child = nodes[child].nextSibling)
+                stack.push_back(child);
+        }
+    }
+
+    localMatrices.swap(newLocals);
+    worldMatrices.swap(newWorlds);
+    parentIndices.swap(newParents);
+    nodeIds.swap(newNodeIds);
+    dirtyFlags.swap(newDirty);
+
+    // Children are after their parent, going backwards sums them up.
+    u32 count = (u32)nodeIds.size();
+    subtreeSizes.assign(count, 1);
+    for(u32 i = count; i > 0; --i) {
+        u32 parent = parentIndices[i - 1];
+        if(parent != INVALID_ID)
+            subtreeSizes[parent] += subtreeSizes[i - 1];
+    }
+
+    // Ranges of the last update point to the old positions.
+    dirtyRanges.clear();
+    orderIsDirty = false;
+}
+
+void CTransformSystem::updateRange(u32 begin, u32 end)
+{
+    for(u32 i = begin; i < end; ++i)
+    {
+        if(dirtyFlags[i]) {
+            TCompTransform* cTransform = nodes[nodeIds[i]].transform;
+            localMatrices[i] = cTransform ? cTransform->asMatrix() : glm::mat4(1.0f);
+            dirtyFlags[i] = 0;
+        }
+        u32 parent = parentIndices[i];
+        worldMatrices[i] = parent == INVALID_ID ? localMatrices[i] : worldMatrices[parent] * localMatrices[i];
+    }
+}
+
+void CTransformSystem::update()
+{
+    if(orderIsDirty)
+        rebuildOrder();
+
+    nUpdatedLastFrame = 0;
+    if(dirtyNodes.empty())
+        return;
+
+    // Subtrees of dirty nodes inside another dirty subtree are already covered.
+    // The parent of each range is before it and not dirty, so ranges are independent.
+    dirtyRanges.clear();
+    u32 nDirty = 0;
+    const u32 count = (u32)nodeIds.size();
+    if(dirtyNodes.size() * 16 > count)
+    {
+        // Many dirty nodes, walking the flags in order is cheaper than sorting
+        // and jumping to each of them, already at 10% of 50k nodes.
+        for(u32 i = 0; i < count; ) {
+            if(!dirtyFlags[i]) {
+                ++i;
+                continue;
+            }
+            dirtyRanges.push_back(i);
+            i += subtreeSizes[i];
+            dirtyRanges.push_back(i);
+        }
+    }
+    else
+    {
+        // Positions of the dirty nodes, sorted so a parent comes before its subtree.
+        std::vector<u32>& positions = dirtyNodes;
+        u32 nPositions = 0;
+        for(u32 id : dirtyNodes) {
+            if(nodes[id].used)
+                positions[nPositions++] = nodes[id].index;
+        }
+        std::sort(positions.begin(), positions.begin() + nPositions);
+
+        u32 coveredEnd = 0;
+        for(u32 i = 0; i < nPositions; ++i) {
+            u32 begin = positions[i];
+            if(begin < coveredEnd)
+                continue;
+            coveredEnd = begin + subtreeSizes[begin];
+            dirtyRanges.push_back(begin);
+            dirtyRanges.push_back(coveredEnd);
+        }
+    }
+    dirtyNodes.clear();
+
+    u32 nRanges = (u32)dirtyRanges.size() / 2;
+    for(u32 i = 0; i < nRanges; ++i)
+        nDirty += dirtyRanges[i * 2 + 1] - dirtyRanges[i * 2];
+
+    if(nDirty < TRANSFORM_SYSTEM_PARALLEL_THRESHOLD || nRanges == 1) {
+        for(u32 i = 0; i < nRanges; ++i)
+            updateRange(dirtyRanges[i * 2], dirtyRanges[i * 2 + 1]);
+    } else {
+        u32 grain = nRanges / (jobSystemThreadCount() * 4);
+        parallelFor(0, nRanges, grain > 0 ? grain : 1, [this](u32 begin, u32 end) {
+            for(u32 i = begin; i < end; ++i)
+                updateRange(dirtyRanges[i * 2], dirtyRanges[i * 2 + 1]);
+        });
+    }
+    nUpdatedLastFrame = nDirty;
+    if(nDirty > 0)
+        ++version;
+}
+
+void CTransformSystem::debugInMenu()
+{
+    if(ImGui::TreeNode("Transforms ..."))
+    {
+        ImGui::Text("Nodes: %u", size());
+        ImGui::Text("Updated last frame: %u", nUpdatedLastFrame);
+        ImGui::TreePop();
+    }
+}
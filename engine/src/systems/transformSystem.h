@@ -0,0 +1,102 @@
+#pragma once
+
+#include <mutex>
+
+/**
+ * Cache of the world matrices of the transform components.
+ * Local and world matrices live in arrays sorted parent before child,
+ * in depth first order, so the subtree of a node is the range that
+ * starts at it. Changing a transform only marks its node, update then
+ * recomputes the dirty subtrees and leaves the rest untouched.
+ */
+class CTransformSystem
+{
+    static CTransformSystem* instance;
+
+    /** Hierarchy links, indexed by node id. The id of a node does not change.*/
+    struct TNode {
+        CHandle transform;
+        u32 parent = INVALID_ID;
+        u32 firstChild = INVALID_ID;
+        u32 nextSibling = INVALID_ID;   // Next child of the parent, or next free node.
+        u32 index = INVALID_ID;         // Position in the sorted arrays.
+        bool used = false;
+    };
+
+    std::vector<TNode> nodes;
+    u32 firstFreeNode = INVALID_ID;
+
+    // Sorted arrays, indexed by position. A parent is always before its children.
+    std::vector<glm::mat4> localMatrices;
+    std::vector<glm::mat4> worldMatrices;
+    std::vector<u32> parentIndices;
+    std::vector<u32> subtreeSizes;      // Nodes in the subtree, the node included.
+    std::vector<u32> nodeIds;
+    std::vector<u8> dirtyFlags;
+
+    std::vector<u32> dirtyNodes;        // Marked since the last update.
+    std::vector<u32> dirtyRanges;       // Begin and end of each subtree to update, kept until the next one.
+    bool orderIsDirty = false;
+    u32 nUpdatedLastFrame = 0;
+    u32 version = 0;                    // Bumped when world matrices change.
+
+    // Transforms may be changed by components updated from worker threads.
+    std::mutex mutex;
+
+    void markDirtyLocked(u32 node);
+    void unlink(u32 node);
+    void rebuildOrder();
+    void updateRange(u32 begin, u32 end);
+
+public:
+    /** Singleton getter.*/
+    static CTransformSystem* Get()
+    {
+        if(!instance){
+            instance = new CTransformSystem();
+        }
+        return instance;
+    }
+
+    /** Adds a root node for the transform component. Returns the node id.*/
+    u32 createNode(CHandle transform);
+
+    /** Removes the node, its children become roots.*/
+    void destroyNode(u32 node);
+
+    /** Parents node to parent, INVALID_ID makes it a root.*/
+    void setParent(u32 node, u32 parent);
+    u32 getParent(u32 node) const { return nodes[node].parent; }
+
+    /** The local matrix of the node changed, its subtree is recomputed on the next update.*/
+    void markDirty(u32 node);
+
+    /** Recomputes the world matrices of the dirty subtrees. Called on the main thread.*/
+    void update();
+
+    /** World matrix of the node as of the last update.*/
+    const glm::mat4& getWorld(u32 node) const {
+        PASSERT(node < nodes.size() && nodes[node].used)
+        return worldMatrices[nodes[node].index];
+    }
+
+    /** Changes every update that moves a world matrix.*/
+    u32 getVersion() const { return version; }
+
+    /** Nodes in the sorted arrays, removed ones are counted until the next update.*/
+    u32 size() const { return (u32)nodeIds.size(); }
+
+    /** Nodes recomputed by the last update.*/
+    u32 getUpdatedLastFrame() const { return nUpdatedLastFrame; }
+
+    /** Begin and end positions of the subtrees recomputed by the last update
+     * that changed the version. Empty once the order is rebuilt, the positions
+     * are not valid anymore then.*/
+    const std::vector<u32>& getUpdatedRanges() const { return dirtyRanges; }
+
+    /** Transform and world matrix at a position of the sorted arrays.*/
+    CHandle getTransformAt(u32 position) const { return nodes[nodeIds[position]].transform; }
+    const glm::mat4& getWorldAt(u32 position) const { return worldMatrices[position]; }
+
+    void debugInMenu();
+};
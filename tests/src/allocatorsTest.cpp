@@ -0,0 +1,130 @@
+#include "test.h"
+
+#include "memory/stackAllocator.h"
+#include "memory/poolAllocator.h"
+#include "memory/frameAllocator.h"
+
+#include <vector>
+
+void testStackAllocator()
+{
+    StackAllocator stack;
+    stackAllocatorCreate(1024, nullptr, &stack);
+    EXPECT(stack.memory != nullptr);
+
+    // Blocks come out aligned and in increasing addresses.
+    u8* a = (u8*)stackAllocatorPush(&stack, 10, 1);
+    u8* b = (u8*)stackAllocatorPush(&stack, 24, 16);
+    u8* c = (u8*)stackAllocatorPush(&stack, 8, 64);
+    EXPECT(a && b && c);
+    EXPECT(((u64)b & 15) == 0);
+    EXPECT(((u64)c & 63) == 0);
+    EXPECT(a + 10 <= b && b + 24 <= c);
+    EXPECT(stack.blockCount == 3);
+
+    // Popping in LIFO order gives back the space, a new push reuses it.
+    u64 topBeforeC = (u64)(b + 24 - (u8*)stack.memory);
+    stackAllocatorPop(&stack, c);
+    EXPECT(stack.blockCount == 2);
+    EXPECT(stack.top == topBeforeC);
+    u8* c2 = (u8*)stackAllocatorPush(&stack, 8, 64);
+    EXPECT(c2 == c);
+
+    // Rolling back to a marker pops everything pushed after it.
+    u64 marker = stackAllocatorGetMarker(&stack);
+    stackAllocatorPush(&stack, 100, 8);
+    stackAllocatorPush(&stack, 100, 8);
+    EXPECT(stack.blockCount == 5);
+    stackAllocatorFreeToMarker(&stack, marker);
+    EXPECT(stack.blockCount == 3);
+    EXPECT(stack.top == marker);
+
+    // A push that does not fit fails and leaves the stack as it was.
+    EXPECT(stackAllocatorPush(&stack, 2048, 8) == nullptr);
+    EXPECT(stack.top == marker);
+
+    stackAllocatorFreeAll(&stack);
+    EXPECT(stack.top == 0 && stack.blockCount == 0);
+    EXPECT(stackAllocatorPush(&stack, 10, 1) == a);
+    stackAllocatorFreeAll(&stack);
+
+    stackAllocatorDestroy(&stack);
+    EXPECT(stack.memory == nullptr);
+}
+
+void testPoolAllocator()
+{
+    // Blocks are at least a pointer and a multiple of 8 bytes.
+    EXPECT(poolAllocatorMemoryRequirement(4, 10) == 8 * 10);
+    EXPECT(poolAllocatorMemoryRequirement(20, 10) == 24 * 10);
+
+    const u32 count = 16;
+    PoolAllocator pool;
+    poolAllocatorCreate(20, count, nullptr, &pool);
+    EXPECT(pool.blockSize == 24 && pool.blockCount == count);
+
+    // Lower blocks are handed out first and keep their index.
+    void* blocks[count];
+    for(u32 i = 0; i < count; ++i)
+    {
+        blocks[i] = poolAllocatorAllocate(&pool);
+        EXPECT(blocks[i] != nullptr);
+        EXPECT(poolAllocatorIndexOf(&pool, blocks[i]) == i);
+        EXPECT(poolAllocatorBlockAt(&pool, i) == blocks[i]);
+    }
+    EXPECT(pool.usedCount == count);
+    EXPECT(poolAllocatorAllocate(&pool) == nullptr);
+
+    // Freed blocks are reused last in, first out and come back zeroed.
+    *(u64*)blocks[3] = 0xFFFFFFFFFFFFFFFFull;
+    poolAllocatorFree(&pool, blocks[3]);
+    poolAllocatorFree(&pool, blocks[7]);
+    EXPECT(pool.usedCount == count - 2);
+    EXPECT(poolAllocatorAllocate(&pool) == blocks[7]);
+    u64* reused = (u64*)poolAllocatorAllocate(&pool);
+    EXPECT(reused == blocks[3]);
+    EXPECT(reused[0] == 0 && reused[1] == 0 && reused[2] == 0);
+
+    poolAllocatorFreeAll(&pool);
+    EXPECT(pool.usedCount == 0);
+    EXPECT(poolAllocatorAllocate(&pool) == blocks[0]);
+
+    poolAllocatorDestroy(&pool);
+    EXPECT(pool.memory == nullptr);
+
+    // A pool can be carved from memory owned by someone else.
+    u64 external[4 * 2];
+    poolAllocatorCreate(16, 4, external, &pool);
+    EXPECT(poolAllocatorAllocate(&pool) == external);
+    poolAllocatorDestroy(&pool);
+}
+
+void testFrameAllocator()
+{
+    FrameAllocatorConfig config;
+    config.frameSize = 4096;
+    u64 requirement = 0;
+    frameAllocatorInit(&requirement, nullptr, config);
+    std::vector<u8> state(requirement);
+    EXPECT(frameAllocatorInit(&requirement, state.data(), config));
+
+    // Past the arena the blocks come from the heap, zeroed and aligned.
+    u8* a = (u8*)frameAllocate(3000, 16);
+    u8* b = (u8*)frameAllocate(3000, 64);
+    EXPECT(a && b);
+    EXPECT(((u64)b & 63) == 0);
+    EXPECT(b[0] == 0 && b[2999] == 0);
+    EXPECT(frameAllocatorUsedSize() >= 6000);
+
+    // Two frames later the same arena is back, grown to fit the whole frame.
+    frameAllocatorBeginFrame();
+    frameAllocatorBeginFrame();
+    EXPECT(frameAllocatorUsedSize() == 0);
+    u64 marker = frameAllocatorGetMarker();
+    frameAllocate(3000, 16);
+    frameAllocate(3000, 64);
+    EXPECT(frameAllocatorGetMarker() > marker);
+    EXPECT(frameAllocatorUsedSize() == frameAllocatorGetMarker());
+
+    frameAllocatorShutdown(state.data());
+}
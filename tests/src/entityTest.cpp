@@ -0,0 +1,50 @@
+#include "test.h"
+
+#include "systems/entity/entity.h"
+
+struct TCompTest : public TCompBase
+{
+    u32 value = 0;
+};
+
+DECL_OBJ_MANAGER("test", TCompTest);
+
+void testEntityComponents()
+{
+    auto entities = getObjectManager<CEntity>();
+    auto tests = getObjectManager<TCompTest>();
+    if(!entities->capacity())
+        entities->init(1024);
+    if(!tests->capacity())
+        tests->init(64);
+
+    CHandle hEntity = entities->createHandle();
+    CEntity* e = hEntity;
+    EXPECT(!e->has<TCompTest>());
+
+    CHandle hComp = tests->createHandle();
+    e->set(hComp);
+    EXPECT(e->has<TCompTest>());
+    EXPECT(e->get<TCompTest>() == hComp);
+    EXPECT(e->getNumComponents() == 1);
+
+    // Destroyed on its own, the entity must not report it anymore.
+    hComp.destroy();
+    CHandleManager::destroyAllPendingObjects();
+    e = hEntity;
+    EXPECT(!e->has<TCompTest>());
+    EXPECT(!e->get<TCompTest>().isValid());
+
+    // A new one replaces the stale handle instead of adding a second entry.
+    CHandle hNewComp = tests->createHandle();
+    e->set(hNewComp);
+    EXPECT(e->has<TCompTest>());
+    EXPECT(e->get<TCompTest>() == hNewComp);
+    EXPECT(e->getNumComponents() == 1);
+
+    // Destroying the entity destroys its components.
+    hEntity.destroy();
+    CHandleManager::destroyAllPendingObjects();
+    EXPECT(!hNewComp.isValid());
+    EXPECT(tests->size() == 0);
+}
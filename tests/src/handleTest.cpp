@@ -0,0 +1,149 @@
+#include "test.h"
+
+#include "systems/entity/entity.h"
+#include "platform/platform.h"
+
+#include <vector>
+
+/**
+ * Creates and destroys 1M entities over frames, like a game spawning
+ * and removing objects, and reports the cost of each handle operation.
+ * At most about 13K are alive at once, testHandleCapacity fills a manager.
+ */
+void testHandleStress()
+{
+    const u32 totalCreates = 1000000;
+    const u32 perFrame = 1000;
+    const u32 maxLive = 12000;
+
+    auto om = getObjectManager<CEntity>();
+    if(!om->capacity())
+        om->init(1024);
+
+    std::vector<CHandle> live;
+    std::vector<CHandle> destroyed;
+    live.reserve(maxLive + perFrame);
+    u32 seed = 1;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    f64 createTime = 0.0, destroyTime = 0.0, resolveTime = 0.0;
+    u64 resolves = 0, destroys = 0;
+    u32 wrong = 0, frames = 0;
+    for(u32 created = 0; created < totalCreates; created += perFrame, ++frames)
+    {
+        f64 start = platformGetCurrentTime();
+        for(u32 i = 0; i < perFrame; ++i)
+            live.push_back(om->createHandle());
+        createTime += platformGetCurrentTime() - start;
+
+        // Destroy a random share, more once the live count is high.
+        u32 toDestroy = live.size() > maxLive ? perFrame : random() % perFrame;
+        destroyed.clear();
+        start = platformGetCurrentTime();
+        for(u32 i = 0; i < toDestroy; ++i)
+        {
+            u32 index = random() % (u32)live.size();
+            CHandle h = live[index];
+            live[index] = live.back();
+            live.pop_back();
+            om->destroyHandle(h);
+            destroyed.push_back(h);
+        }
+        CHandleManager::destroyAllPendingObjects();
+        destroyTime += platformGetCurrentTime() - start;
+        destroys += toDestroy;
+
+        // Live handles resolve to their object, destroyed ones to nothing.
+        start = platformGetCurrentTime();
+        for(CHandle h : live)
+        {
+            CEntity* e = om->getAddressFromHandle(h);
+            wrong += e == nullptr;
+        }
+        for(CHandle h : destroyed)
+            wrong += om->getAddressFromHandle(h) != nullptr;
+        resolveTime += platformGetCurrentTime() - start;
+        resolves += live.size() + destroyed.size();
+
+        if(frames % 100 == 0)
+        {
+            for(CHandle h : live)
+                wrong += om->getHandleFromAddress(om->getAddressFromHandle(h)) != h;
+        }
+    }
+    EXPECT(wrong == 0);
+    EXPECT(om->size() == live.size());
+
+    printf("Handles: %u creates and %llu destroys over %u frames, %u live at the end, capacity %u.\n",
+        totalCreates, destroys, frames, (u32)live.size(), om->capacity());
+    printf("Handles: createHandle %.1f ns, destroyHandle %.1f ns, getAddressFromHandle %.1f ns.\n",
+        createTime * 1e9 / totalCreates, destroyTime * 1e9 / destroys, resolveTime * 1e9 / resolves);
+
+    for(CHandle h : live)
+        om->destroyHandle(h);
+    CHandleManager::destroyAllPendingObjects();
+    EXPECT(om->size() == 0);
+}
+
+/**
+ * Fills the entity manager to what handles can address, the last page is
+ * cut to fit, then one more create fails without growing. With 64 bit
+ * handles it grows past what 32 bit ones address instead.
+ */
+void testHandleCapacity()
+{
+    auto om = getObjectManager<CEntity>();
+    if(!om->capacity())
+        om->init(1024);
+
+#ifdef HANDLE_64_BITS
+    const u32 target = 200000;
+    EXPECT(sizeof(CHandle) == 8);
+#else
+    const u32 target = CHandleManager::maxCapacity();
+    EXPECT(sizeof(CHandle) == 4);
+#endif
+    EXPECT(om->size() == 0);
+
+    std::vector<CHandle> handles(target);
+    u32 invalid = 0;
+    for(u32 i = 0; i < target; ++i)
+    {
+        handles[i] = om->createHandle();
+        invalid += !handles[i].isValid();
+    }
+    EXPECT(invalid == 0);
+    EXPECT(om->size() == target);
+    EXPECT(om->capacity() >= target);
+
+#ifndef HANDLE_64_BITS
+    EXPECT(om->capacity() == target);
+    CHandle full = om->createHandle();
+    EXPECT(!full.isValid());
+    EXPECT(om->getAddressFromHandle(full) == nullptr);
+    EXPECT(om->size() == target);
+#endif
+
+    // Handles of every page, the last included, resolve to their objects.
+    u32 wrong = 0;
+    for(u32 i = 0; i < target; i += 97)
+        wrong += om->getHandleFromAddress(om->getAddressFromHandle(handles[i])) != handles[i];
+    wrong += om->getHandleFromAddress(om->getAddressFromHandle(handles[target - 1])) != handles[target - 1];
+    EXPECT(wrong == 0);
+
+    for(CHandle h : handles)
+        om->destroyHandle(h);
+    CHandleManager::destroyAllPendingObjects();
+    EXPECT(om->size() == 0);
+
+    // Freed slots are reused with a new age, no growth needed.
+    u32 capacity = om->capacity();
+    CHandle again = om->createHandle();
+    EXPECT(again.isValid() && !handles[0].isValid());
+    EXPECT(om->capacity() == capacity);
+    om->destroyHandle(again);
+    CHandleManager::destroyAllPendingObjects();
+}
@@ -0,0 +1,101 @@
+#include "test.h"
+
+#include "systems/jobSystem.h"
+#include "memory/pmemory.h"
+
+#include <thread>
+
+static void countJob(void* data, u32 begin, u32 end)
+{
+    std::atomic<u32>* total = static_cast<std::atomic<u32>*>(data);
+    total->fetch_add(end - begin, std::memory_order_relaxed);
+}
+
+void testJobSystem()
+{
+    JobSystemConfig config = {};
+    config.workerCount = 3;
+    u64 memoryRequirement = 0;
+    jobSystemInit(&memoryRequirement, nullptr, config);
+    void* state = memAllocate(memoryRequirement, MEMORY_TAG_JOB);
+    EXPECT(jobSystemInit(&memoryRequirement, state, config));
+    EXPECT(jobSystemThreadCount() == 4);
+    EXPECT(jobSystemThreadIndex() == 0);
+
+    // Every element is visited exactly once.
+    const u32 count = 100000;
+    u8* visits = (u8*)memAllocate(count, MEMORY_TAG_JOB);
+    parallelFor(0, count, 64, [visits](u32 begin, u32 end) {
+        for(u32 i = begin; i < end; ++i)
+            visits[i]++;
+    });
+    u32 wrong = 0;
+    for(u32 i = 0; i < count; ++i)
+        wrong += visits[i] != 1;
+    EXPECT(wrong == 0);
+
+    // Jobs started from jobs are waited on by the inner parallelFor.
+    std::atomic<u32> total(0);
+    parallelFor(0, 16, 1, [&total](u32 begin, u32 end) {
+        for(u32 i = begin; i < end; ++i)
+            parallelFor(0, 1000, 10, [&total](u32 b, u32 e) {
+                total.fetch_add(e - b, std::memory_order_relaxed);
+            });
+    });
+    EXPECT(total.load() == 16 * 1000);
+
+    // Counters reach zero once all the jobs ran.
+    Job jobs[32];
+    for(u32 i = 0; i < 32; ++i)
+    {
+        jobs[i].function = countJob;
+        jobs[i].data = &total;
+        jobs[i].begin = 0;
+        jobs[i].end = 10;
+        jobs[i].counter = nullptr;
+    }
+    total.store(0);
+    JobCounter counter;
+    counter.value.store(0);
+    jobSystemRun(jobs, 32, &counter);
+    jobSystemWait(&counter);
+    EXPECT(counter.value.load() == 0);
+    EXPECT(total.load() == 32 * 10);
+
+    // Threads outside the job system submit through the shared queue.
+    total.store(0);
+    u32 externalIndex = 0;
+    std::thread external([&jobs, &total, &externalIndex]() {
+        externalIndex = jobSystemThreadIndex();
+        for(u32 i = 0; i < 64; ++i) {
+            JobCounter externalCounter;
+            externalCounter.value.store(0);
+            jobSystemRun(jobs, 32, &externalCounter);
+            jobSystemWait(&externalCounter);
+        }
+    });
+    parallelFor(0, count, 64, [visits](u32 begin, u32 end) {
+        for(u32 i = begin; i < end; ++i)
+            visits[i]++;
+    });
+    external.join();
+    EXPECT(externalIndex == INVALID_ID);
+    EXPECT(total.load() == 64 * 32 * 10);
+
+    // With the workers asleep the main thread runs everything.
+    jobSystemSetActiveThreads(1);
+    memZero(visits, count);
+    parallelFor(0, count, 64, [visits](u32 begin, u32 end) {
+        for(u32 i = begin; i < end; ++i)
+            visits[i]++;
+    });
+    wrong = 0;
+    for(u32 i = 0; i < count; ++i)
+        wrong += visits[i] != 1;
+    EXPECT(wrong == 0);
+    jobSystemSetActiveThreads(0);
+
+    jobSystemShutdown(state);
+    memFree(visits, count, MEMORY_TAG_JOB);
+    memFree(state, memoryRequirement, MEMORY_TAG_JOB);
+}
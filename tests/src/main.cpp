@@ -0,0 +1,37 @@
+#include "test.h"
+
+u32 testFailures = 0;
+
+struct TestCase
+{
+    const char* name;
+    void (*function)();
+};
+
+static const TestCase tests[] = {
+    { "stack allocator",    testStackAllocator },
+    { "pool allocator",     testPoolAllocator },
+    { "frame allocator",    testFrameAllocator },
+    { "job system",         testJobSystem },
+    { "handle stress",      testHandleStress },
+    { "handle capacity",    testHandleCapacity },
+    { "entity components",  testEntityComponents },
+    { "render keys",        testRenderKeys },
+    { "vulkan uploads",     testVulkanUploads },
+};
+
+int main(int argc, char** argv)
+{
+    u32 failedTests = 0;
+    for(const TestCase& test : tests)
+    {
+        u32 failures = testFailures;
+        test.function();
+        bool passed = failures == testFailures;
+        failedTests += passed ? 0 : 1;
+        printf("[%s] %s\n", passed ? " OK " : "FAIL", test.name);
+    }
+
+    printf("%u of %u tests failed.\n", failedTests, (u32)(sizeof(tests) / sizeof(tests[0])));
+    return failedTests ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+#include "test.h"
+
+#include "systems/renderSystem.h"
+#include "systems/entity/entity.h"
+#include "systems/components/comp_transform.h"
+#include "memory/frameAllocator.h"
+#include "memory/pmemory.h"
+#include "renderer/renderTypes.h"
+
+static u32 validSortedCount(const CRenderManager& manager)
+{
+    u32 count = 0;
+    for(const CRenderManager::TSortedKey& sk : manager.getSortedKeys())
+        count += manager.isValid(sk) ? 1 : 0;
+    return count;
+}
+
+void testRenderKeys()
+{
+    auto entities = getObjectManager<CEntity>();
+    auto transforms = getObjectManager<TCompTransform>();
+    if(!entities->capacity())
+        entities->init(1024);
+    if(!transforms->capacity())
+        transforms->init(1024);
+
+    FrameAllocatorConfig frameConfig = { 1024 * 1024 };
+    u64 frameMemoryRequirement = 0;
+    frameAllocatorInit(&frameMemoryRequirement, nullptr, frameConfig);
+    void* frameMemory = memAllocate(frameMemoryRequirement, MEMORY_TAG_LINEAR_ALLOCATOR);
+    frameAllocatorInit(&frameMemoryRequirement, frameMemory, frameConfig);
+
+    Mesh meshes[2] = {};
+    meshes[1].rendererId = 1;
+    Material material = {};
+    material.diffuseColor = glm::vec4(1.0f);
+
+    CHandle hEntity = entities->createHandle();
+    CHandle hTransform = transforms->createHandle();
+    CEntity* e = hEntity;
+    e->set(hTransform);
+
+    CRenderManager manager;
+    frameAllocatorBeginFrame();
+    u32 first = manager.addKey(hTransform, &meshes[0], &material);
+    manager.render();
+    EXPECT(validSortedCount(manager) == 1);
+    EXPECT(manager.getSortedKeys().size() == 1);
+
+    // Deleted while still waiting to be sorted and added again in the
+    // same slot: it must be sorted in once.
+    frameAllocatorBeginFrame();
+    manager.deleteKeysFromOwner(hTransform);
+    u32 second = manager.addKey(hTransform, &meshes[1], &material);
+    manager.deleteKeysFromOwner(hTransform);
+    u32 third = manager.addKey(hTransform, &meshes[1], &material);
+    EXPECT(third == second);
+    manager.render();
+    EXPECT(validSortedCount(manager) == 1);
+    EXPECT(manager.getSortedKeys().size() == 1);
+    EXPECT(manager.getSortedKeys()[0].key == third);
+
+    // Disabled and enabled before sorting, still only once.
+    frameAllocatorBeginFrame();
+    manager.setKeyEnabled(third, false);
+    manager.setKeyEnabled(third, true);
+    manager.render();
+    EXPECT(validSortedCount(manager) == 1);
+
+    // Keys come out ordered by their sort key.
+    frameAllocatorBeginFrame();
+    manager.addKey(hTransform, &meshes[0], &material);
+    manager.render();
+    EXPECT(validSortedCount(manager) == 2);
+    const std::vector<CRenderManager::TSortedKey>& sorted = manager.getSortedKeys();
+    EXPECT(sorted.size() == 2 && sorted[0].sortKey <= sorted[1].sortKey);
+
+    hEntity.destroy();
+    CHandleManager::destroyAllPendingObjects();
+    frameAllocatorShutdown(frameMemory);
+    memFree(frameMemory, frameMemoryRequirement, MEMORY_TAG_LINEAR_ALLOCATOR);
+    (void)first;
+}
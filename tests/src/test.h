@@ -0,0 +1,31 @@
+#pragma once
+
+#include "defines.h"
+
+#include <stdio.h>
+
+/**
+ * Minimal test helpers. Every test is a function registered in main.cpp,
+ * failed expectations are printed and counted and the executable returns
+ * non-zero if any of them failed.
+ */
+
+extern u32 testFailures;
+
+#define EXPECT(expr) {                                              \
+    if(!(expr)) {                                                   \
+        printf("%s:%d: expected %s\n", __FILE__, __LINE__, #expr);  \
+        testFailures++;                                             \
+    }                                                               \
+}
+
+// Tests
+void testStackAllocator();
+void testPoolAllocator();
+void testFrameAllocator();
+void testJobSystem();
+void testHandleStress();
+void testHandleCapacity();
+void testEntityComponents();
+void testRenderKeys();
+void testVulkanUploads();
@@ -0,0 +1,206 @@
+#include "test.h"
+
+#include "renderer/vulkan/vulkanBuffer.h"
+#include "renderer/vulkan/vulkanCommandBuffer.h"
+#include "renderer/vulkan/vulkanMemory.h"
+#include "renderer/vulkan/vulkanUpload.h"
+
+#include <vector>
+
+#define UPLOAD_COUNT        4096
+#define UPLOAD_FLUSH_EVERY  128
+#define UPLOAD_CHECK_COUNT  64
+
+struct TestUpload
+{
+    VulkanBuffer buffer;
+    u32 size;
+    u32 seed;
+    u64 ticket;
+    bool alive;
+};
+
+static u32 patternAt(u32 seed, u32 index)
+{
+    return seed * 2654435761u + index * 40503u;
+}
+
+static bool createDevice(VkInstance* outInstance, VulkanDevice* device)
+{
+    VkApplicationInfo appInfo = {VK_STRUCTURE_TYPE_APPLICATION_INFO};
+    appInfo.pApplicationName    = "tests";
+    appInfo.apiVersion          = VK_API_VERSION_1_2;
+
+    VkInstanceCreateInfo instanceInfo = {VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+    instanceInfo.pApplicationInfo = &appInfo;
+    if(vkCreateInstance(&instanceInfo, nullptr, outInstance) != VK_SUCCESS)
+        return false;
+
+    u32 count = 1;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkResult result = vkEnumeratePhysicalDevices(*outInstance, &count, &physicalDevice);
+    if((result != VK_SUCCESS && result != VK_INCOMPLETE) || count == 0) {
+        vkDestroyInstance(*outInstance, nullptr);
+        return false;
+    }
+
+    // Graphics queues support transfers, one family does everything.
+    u32 familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    u32 family = familyCount;
+    for(u32 i = 0; i < familyCount && family == familyCount; ++i)
+        if(families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            family = i;
+    if(family == familyCount) {
+        vkDestroyInstance(*outInstance, nullptr);
+        return false;
+    }
+
+    f32 priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo = {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+    queueInfo.queueFamilyIndex  = family;
+    queueInfo.queueCount        = 1;
+    queueInfo.pQueuePriorities  = &priority;
+
+    VkDeviceCreateInfo deviceInfo = {VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos    = &queueInfo;
+    if(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device->handle) != VK_SUCCESS) {
+        vkDestroyInstance(*outInstance, nullptr);
+        return false;
+    }
+
+    device->physicalDevice      = physicalDevice;
+    device->graphicsQueueIndex  = family;
+    device->presentQueueIndex   = family;
+    device->transferQueueIndex  = family;
+    device->computeQueueIndex   = family;
+    vkGetDeviceQueue(device->handle, family, 0, &device->graphicsQueue);
+    device->presentQueue    = device->graphicsQueue;
+    device->computeQueue    = device->graphicsQueue;
+    device->transferQueue   = device->graphicsQueue;
+    vkGetPhysicalDeviceProperties(physicalDevice, &device->properties);
+    vkGetPhysicalDeviceFeatures(physicalDevice, &device->features);
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &device->memory);
+
+    VkCommandPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    poolInfo.flags              = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex   = family;
+    VK_CHECK(vkCreateCommandPool(device->handle, &poolInfo, nullptr, &device->commandPool));
+    device->transferCmdPool = device->commandPool;
+    return true;
+}
+
+static bool readBack(const VulkanDevice& device, VulkanBuffer& readback, const TestUpload& upload)
+{
+    VkCommandBuffer cmd;
+    vulkanCommandBufferAllocateAndBeginSingleUse(device, device.commandPool, cmd);
+    VkBufferCopy region = { 0, 0, upload.size };
+    vkCmdCopyBuffer(cmd, upload.buffer.handle, readback.handle, 1, &region);
+    vulkanCommandBufferEndSingleUse(device, device.commandPool, device.graphicsQueue, cmd);
+
+    const u32* words = (const u32*)readback.allocation.mapped;
+    for(u32 i = 0; i < upload.size / sizeof(u32); ++i)
+        if(words[i] != patternAt(upload.seed, i))
+            return false;
+    return true;
+}
+
+/**
+ * Thousands of buffers of mixed sizes are uploaded in batches while a part
+ * of them is freed, then a sample is read back. Needs a Vulkan device, the
+ * test passes without running when there is none.
+ */
+void testVulkanUploads()
+{
+    VkInstance instance;
+    VulkanDevice device = {};
+    if(!createDevice(&instance, &device)) {
+        printf("vulkan uploads: skipped, no Vulkan device.\n");
+        return;
+    }
+    EXPECT(vulkanMemoryCreate(&device));
+    EXPECT(vulkanUploadCreate(&device));
+
+    u32 seed = 1;
+    auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+
+    std::vector<TestUpload> uploads(UPLOAD_COUNT);
+    std::vector<u32> data(64 * 1024 / sizeof(u32));
+    u32 created = 0;
+    u64 lastTicket = 0;
+    for(u32 i = 0; i < UPLOAD_COUNT; ++i)
+    {
+        TestUpload& upload = uploads[i];
+        upload.size     = (1 + random() % 64) * 1024;
+        upload.seed     = i + 1;
+        upload.alive    = vulkanBufferCreate(
+            device,
+            upload.size,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            &upload.buffer);
+        EXPECT(upload.alive);
+        if(!upload.alive)
+            continue;
+        created++;
+
+        for(u32 w = 0; w < upload.size / sizeof(u32); ++w)
+            data[w] = patternAt(upload.seed, w);
+        upload.ticket = vulkanUploadBuffer(device, upload.buffer.handle, 0, data.data(), upload.size);
+        lastTicket = upload.ticket;
+
+        if((i + 1) % UPLOAD_FLUSH_EVERY == 0)
+        {
+            vulkanUploadFlush(device);
+            vulkanUploadUpdate(device);
+
+            // Free a quarter of what is alive, the ranges are reused by the next uploads.
+            for(u32 f = 0; f < UPLOAD_FLUSH_EVERY / 4; ++f)
+            {
+                TestUpload& victim = uploads[random() % (i + 1)];
+                if(!victim.alive)
+                    continue;
+                vulkanUploadWait(device, victim.ticket);
+                vulkanBufferDestroy(device, victim.buffer);
+                victim.alive = false;
+            }
+        }
+    }
+    vulkanUploadWait(device, lastTicket);
+    for(const TestUpload& upload : uploads)
+        EXPECT(!upload.alive || vulkanUploadIsComplete(device, upload.ticket));
+
+    // Every buffer got a range of a shared block.
+    MemoryGpuStats stats = vulkanMemoryGetStats(device);
+    EXPECT(stats.blockCount > 0);
+    EXPECT(stats.blockCount * 64 < created);
+
+    VulkanBuffer readback;
+    EXPECT(vulkanBufferCreate(device, 64 * 1024, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &readback));
+    u32 checked = 0;
+    for(u32 i = 0; checked < UPLOAD_CHECK_COUNT && i < UPLOAD_COUNT * 4; ++i)
+    {
+        const TestUpload& upload = uploads[random() % UPLOAD_COUNT];
+        if(!upload.alive)
+            continue;
+        EXPECT(readBack(device, readback, upload));
+        checked++;
+    }
+    EXPECT(checked == UPLOAD_CHECK_COUNT);
+    vulkanBufferDestroy(device, readback);
+
+    for(TestUpload& upload : uploads)
+        if(upload.alive)
+            vulkanBufferDestroy(device, upload.buffer);
+    vulkanUploadDestroy(&device);
+    EXPECT(vulkanMemoryGetStats(device).liveCount == 0);
+
+    vulkanMemoryDestroy(&device);
+    vkDestroyCommandPool(device.handle, device.commandPool, nullptr);
+    vkDestroyDevice(device.handle, nullptr);
+    vkDestroyInstance(instance, nullptr);
+}